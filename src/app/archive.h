@@ -3,6 +3,7 @@
 
 #include "common.h"
 #include <compare>
+#include <string_view>
 
 using ArchiveID = ID;
 
@@ -13,4 +14,13 @@ struct Archive {
   friend auto operator<=>(const Archive&, const Archive&) = default;
 };
 
-#endif
\ No newline at end of file
+// The extension of the archives a file with the given name is put in. Files
+// without an extension share the "<BLANK>" archives.
+inline auto archiveExtension(std::string_view fileName) -> Extension {
+  const auto dot = fileName.find_last_of('.');
+  if (dot == std::string_view::npos || dot == fileName.size() - 1)
+    return "<BLANK>";
+  return Extension{fileName.substr(dot)};
+}
+
+#endif
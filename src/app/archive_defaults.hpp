@@ -0,0 +1,16 @@
+#ifndef ARCHIVER_ARCHIVE_DEFAULTS_HPP
+#define ARCHIVER_ARCHIVE_DEFAULTS_HPP
+
+#include "common.h"
+
+// The defaults of the archive settings which can be left out of the config
+// file. They are kept apart from the classes which use them so the config can
+// be loaded without depending on those classes.
+
+// The memory a single zpaq -m5 job is expected to use.
+inline constexpr Size DefaultCompressionJobMemory = 2ull * 1024 * 1024 * 1024;
+// The limits an archive's revisions are split into parts within.
+inline constexpr Size DefaultArchivePartTargetSize = 1024ull * 1024 * 1024;
+inline constexpr std::size_t DefaultArchivePartMaxFiles = 100;
+
+#endif
@@ -0,0 +1,20 @@
+#include "archive_part.hpp"
+#include <algorithm>
+
+auto splitIntoParts(
+  std::span<const std::pair<ArchivedFileRevisionID, Size>> revisions,
+  const ArchivePartLimits& limits) -> std::vector<ArchivePart> {
+  std::vector<ArchivePart> parts;
+  for (const auto& [revisionId, size] : revisions) {
+    // Written so the sizes can't overflow.
+    const auto fits = [&](const ArchivePart& part) {
+      return part.revisions.size() < limits.maxFiles &&
+             size <= limits.targetSize - std::min(part.size, limits.targetSize);
+    };
+    if (parts.empty() || !fits(parts.back()))
+      parts.push_back({0, {}, 0});
+    parts.back().revisions.push_back(revisionId);
+    parts.back().size += size;
+  }
+  return parts;
+}
@@ -0,0 +1,41 @@
+#ifndef ARCHIVER_ARCHIVE_PART_HPP
+#define ARCHIVER_ARCHIVE_PART_HPP
+
+#include "archive_defaults.hpp"
+#include "archived_file_revision.hpp"
+#include "common.h"
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+// One of the zpaq parts an archive is compressed into, and the revisions which
+// were compressed into it. The parts of the single file archive each hold one
+// revision and are numbered by it.
+struct ArchivePart {
+  uint64_t number;
+  std::vector<ArchivedFileRevisionID> revisions;
+  // The total size of the revisions, before they were compressed.
+  Size size;
+
+  friend auto operator==(const ArchivePart&, const ArchivePart&)
+    -> bool = default;
+};
+
+// Where the revisions of an archive are split into parts. A part is cut once
+// adding the next revision would take it over the target size, or once it
+// holds the maximum number of files, so a revision larger than the target
+// size is a part by itself.
+struct ArchivePartLimits {
+  Size targetSize = DefaultArchivePartTargetSize;
+  std::size_t maxFiles = DefaultArchivePartMaxFiles;
+};
+
+// Splits the revisions, given with their sizes, into parts within the limits,
+// keeping them in order. The parts are left to be numbered by the caller, once
+// it knows how many part numbers to reserve.
+auto splitIntoParts(
+  std::span<const std::pair<ArchivedFileRevisionID, Size>> revisions,
+  const ArchivePartLimits& limits) -> std::vector<ArchivePart>;
+
+#endif
@@ -0,0 +1,96 @@
+#include "archive_planner.hpp"
+#include <set>
+
+namespace {
+const Archive singleFileArchive = {1, "<SINGLE>"};
+}
+
+ArchivePlanner::ArchivePlanner(
+  std::shared_ptr<ArchivedDatabase>& archivedDatabase,
+  Size singleFileArchiveSize)
+  : archivedDatabase(archivedDatabase),
+    targetSize(archivedDatabase->getArchiveTargetSize()),
+    singleFileArchiveSize(singleFileArchiveSize) {
+  for (auto& [archive, size] : archivedDatabase->listArchiveSizes()) {
+    auto extension = archive.extension;
+    newestArchives.insert_or_assign(std::move(extension),
+                                    std::pair{std::move(archive), size});
+  }
+}
+
+auto ArchivePlanner::assign(
+  std::span<const StagedFile> files,
+  const std::map<RevisionContents, ArchivedFileRevisionID>& archivedRevisions)
+  -> std::vector<Archive> {
+  const auto isNew = findNewContents(files, archivedRevisions);
+  // The sizes of the new contents given to the newest archive of each
+  // extension by this call, which aren't recorded until they have been added.
+  std::map<Extension, Size> plannedSizes;
+  std::vector<Archive> archives;
+  archives.reserve(files.size());
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    const auto& file = files[i];
+    if (file.size >= singleFileArchiveSize) {
+      archives.push_back(singleFileArchive);
+      continue;
+    }
+
+    const auto extension = archiveExtension(file.name);
+    auto newest = newestArchives.find(extension);
+    if (!isNew[i]) {
+      archives.push_back(newest == newestArchives.end() ? singleFileArchive
+                                                        : newest->second.first);
+      continue;
+    }
+    auto& plannedSize = plannedSizes[extension];
+    if (newest == newestArchives.end()) {
+      newest = newestArchives
+                 .emplace(extension,
+                          std::pair{archivedDatabase->addArchive(extension),
+                                    Size{0}})
+                 .first;
+    } else if (newest->second.second + plannedSize >= targetSize) {
+      newest->second = {archivedDatabase->addArchive(extension), 0};
+      plannedSize = 0;
+    }
+
+    plannedSize += file.size;
+    archives.push_back(newest->second.first);
+  }
+  return archives;
+}
+auto ArchivePlanner::assign(std::span<const StagedFile> files)
+  -> std::vector<Archive> {
+  return assign(files, archivedDatabase->findRevisionsWithContents(files));
+}
+
+void ArchivePlanner::recordAdded(const Archive& archive, Size size) {
+  addedSizes[archive] += size;
+  if (const auto newest = newestArchives.find(archive.extension);
+      newest != newestArchives.end() && newest->second.first == archive)
+    newest->second.second += size;
+}
+
+auto ArchivePlanner::findNewContents(
+  std::span<const StagedFile> files,
+  const std::map<RevisionContents, ArchivedFileRevisionID>& archivedRevisions)
+  -> std::vector<bool> {
+  // A file without a hash can't be looked up, so it is taken to be new.
+  std::vector<bool> isNew(files.size(), true);
+  std::set<RevisionContents> seenContents;
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    if (!files[i].hash)
+      continue;
+    const RevisionContents contents{files[i].size, *files[i].hash};
+    isNew[i] = !archivedRevisions.contains(contents) &&
+               seenContents.insert(contents).second;
+  }
+  return isNew;
+}
+
+void ArchivePlanner::save() {
+  const std::vector<std::pair<Archive, Size>> sizes{addedSizes.begin(),
+                                                    addedSizes.end()};
+  archivedDatabase->addToArchiveSizes(sizes);
+  addedSizes.clear();
+}
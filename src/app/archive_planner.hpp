@@ -0,0 +1,73 @@
+#ifndef ARCHIVER_ARCHIVE_PLANNER_HPP
+#define ARCHIVER_ARCHIVE_PLANNER_HPP
+
+#include "../database/archived_database.hpp"
+#include "archive.h"
+#include "common.h"
+#include "staged_file.hpp"
+#include <map>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Assigns staged files to archives. How full the newest archive of each
+// extension is gets loaded from the database once, and is then kept up to date
+// in memory as new revisions are added to it, so the database is only needed
+// to start a new archive once the newest one reaches the target size.
+class ArchivePlanner {
+public:
+  // Files of at least the single file archive size are put in the single file
+  // archive rather than the archive of their extension.
+  ArchivePlanner(std::shared_ptr<ArchivedDatabase>& archivedDatabase,
+                 Size singleFileArchiveSize);
+
+  // Assigns each of the files an archive, in order. An archive is given files
+  // until it reaches the target size, so the last file given to an archive can
+  // take it over the target size. A file whose contents are already archived,
+  // or are the same as those of an earlier one of the files, doesn't take up
+  // any room in its archive, so it is given the newest archive of its
+  // extension, or the single file archive if there is none, without an
+  // archive being started for it. archivedRevisions is what the archived
+  // database's findRevisionsWithContents returns for the files, so that it can
+  // be passed on to addFiles instead of being looked up again.
+  auto assign(
+    std::span<const StagedFile> files,
+    const std::map<RevisionContents, ArchivedFileRevisionID>& archivedRevisions)
+    -> std::vector<Archive>;
+  // As above, looking up the archived revisions of the files itself.
+  auto assign(std::span<const StagedFile> files) -> std::vector<Archive>;
+  // Records that a new revision of the given size was added to the archive.
+  // Only the sizes recorded this way count towards the size of an archive, so
+  // the new revisions added from one call to assign must be recorded before
+  // the next.
+  void recordAdded(const Archive& archive, Size size);
+  // Adds the sizes recorded since the last save to the sizes of the archives
+  // in the database.
+  void save();
+
+  ArchivePlanner() = delete;
+  ArchivePlanner(const ArchivePlanner&) = delete;
+  ArchivePlanner(ArchivePlanner&&) = default;
+  ~ArchivePlanner() = default;
+
+  ArchivePlanner& operator=(const ArchivePlanner&) = delete;
+  ArchivePlanner& operator=(ArchivePlanner&&) = default;
+
+private:
+  // Whether each of the files would be added as a new revision.
+  static auto findNewContents(
+    std::span<const StagedFile> files,
+    const std::map<RevisionContents, ArchivedFileRevisionID>& archivedRevisions)
+    -> std::vector<bool>;
+
+  std::shared_ptr<ArchivedDatabase> archivedDatabase;
+  Size targetSize;
+  Size singleFileArchiveSize;
+  // The newest archive of each extension, and its size so far.
+  std::map<Extension, std::pair<Archive, Size>> newestArchives;
+  // The sizes recorded since the last save.
+  std::map<Archive, Size> addedSizes;
+};
+
+#endif
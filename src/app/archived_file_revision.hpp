@@ -4,16 +4,21 @@
 #include "archive.h"
 #include "archive_operation.hpp"
 #include "common.h"
+#include "file_hash.hpp"
+#include <optional>
 
 using ArchivedFileRevisionID = ID;
 
 struct ArchivedFileRevision {
 public:
   ArchivedFileRevisionID id;
-  std::string hash;
+  FileHash hash;
   Size size;
   ArchiveID containingArchiveId;
   ArchiveOperationID containingOperation;
   bool isDuplicate;
+  // Not set for revisions archived before fast hashes were recorded.
+  std::optional<FastHash> fastHash = std::nullopt;
+  HashAlgorithm hashAlgorithm = HashAlgorithm::Linear;
 };
 #endif
@@ -1,29 +1,67 @@
 #include "archiver.hpp"
 #include "common.h"
 #include "compressor.hpp"
+#include "copy_engine.hpp"
+#include "raw_file.hpp"
+#include "tree_hash.hpp"
 #include <algorithm>
 #include <filesystem>
 #include <map>
 #include <ranges>
 #include <vector>
 
+namespace {
+template <typename T>
+auto yieldEach(const std::vector<T>& elements) -> Generator<T> {
+  for (T element : elements)
+    co_yield element;
+}
+}
+
 Archiver::Archiver(std::shared_ptr<ArchivedDatabase>& archivedDatabase,
                    const std::filesystem::path& stageDirectoryLocation,
                    const std::filesystem::path& archiveDirectoryLocation,
-                   Size singleFileArchiveSize)
+                   Size singleFileArchiveSize, PromotionMode promotionMode,
+                   std::span<char> fileReadBuffer,
+                   const CompressionScheduler::Settings& compressionSettings,
+                   const ArchivePartLimits& partLimits)
   : archivedDatabase(archivedDatabase), stageLocation(stageDirectoryLocation),
     archiveLocation(archiveDirectoryLocation),
-    singleFileArchiveSize(singleFileArchiveSize) {}
+    singleFileArchiveSize(singleFileArchiveSize), promotionMode(promotionMode),
+    readBuffer(fileReadBuffer), compressionSettings(compressionSettings),
+    partLimits(partLimits) {}
 
 void Archiver::archive(const std::vector<StagedDirectory>& stagedDirectories,
                        const std::vector<StagedFile>& stagedFiles) {
+  archive(yieldEach(stagedDirectories), yieldEach(stagedFiles));
+}
 
+void Archiver::archive(Generator<StagedDirectory> stagedDirectories,
+                       Generator<StagedFile> stagedFiles) {
   try {
+    // Finish off any archive operation which was interrupted while moving
+    // staged files, whichever mode this one promotes them in.
+    PromotionJournal::recover(archiveLocation, [&](ArchiveOperationID id) {
+      return archivedDatabase->hasArchiveOperation(id);
+    });
+
     archivedDatabase->startTransaction();
     auto archiveOperationId = archivedDatabase->createArchiveOperation();
+    if (promotionMode == PromotionMode::Move) {
+      // The journal is kept in the archive directory, which may not have
+      // been created yet.
+      std::filesystem::create_directories(archiveLocation);
+      promotionJournal.emplace(archiveLocation, archiveOperationId);
+    }
     archiveDirectories(stagedDirectories, archiveOperationId);
     archiveFiles(stagedFiles, archiveOperationId);
+    if (promotionJournal)
+      promotionJournal->sync();
     archivedDatabase->commit();
+    if (promotionJournal) {
+      promotionJournal->complete();
+      promotionJournal.reset();
+    }
 
     // Saving the archive parts takes a while and on failure should not undo the
     // entire archive operation.
@@ -32,12 +70,16 @@ void Archiver::archive(const std::vector<StagedDirectory>& stagedDirectories,
     archivedDatabase->commit();
   } catch (const std::exception& err) {
     archivedDatabase->rollback();
+    if (promotionJournal) {
+      promotionJournal->rollback();
+      promotionJournal.reset();
+    }
     throw;
   }
 }
 
 void Archiver::archiveDirectories(
-  const std::vector<StagedDirectory>& stagedDirectories,
+  Generator<StagedDirectory>& stagedDirectories,
   ArchiveOperationID archiveOperation) {
   for (const auto& stagedDirectory : stagedDirectories) {
     if (archivedDirectoryMap.contains(stagedDirectory.id))
@@ -61,8 +103,29 @@ void Archiver::archiveDirectories(
   }
 }
 
-void Archiver::archiveFiles(const std::vector<StagedFile>& stagedFiles,
+void Archiver::archiveFiles(Generator<StagedFile>& stagedFiles,
                             ArchiveOperationID archiveOperation) {
+  ArchivePlanner planner{archivedDatabase, singleFileArchiveSize};
+  linearRevisionSizes =
+    archivedDatabase->listLinearRevisionSizes(tree_hash::MinFileSize);
+  std::vector<StagedFile> batch;
+  batch.reserve(FileBatchSize);
+  for (const auto& unhashedFile : stagedFiles) {
+    batch.push_back(withHash(unhashedFile));
+    if (batch.size() == FileBatchSize) {
+      archiveFileBatch(batch, planner, archiveOperation);
+      batch.clear();
+    }
+  }
+  archiveFileBatch(batch, planner, archiveOperation);
+  planner.save();
+}
+
+void Archiver::archiveFileBatch(std::span<const StagedFile> stagedFiles,
+                                ArchivePlanner& planner,
+                                ArchiveOperationID archiveOperation) {
+  std::vector<ArchivedDirectory> parentArchivedDirectories;
+  parentArchivedDirectories.reserve(stagedFiles.size());
   for (const auto& stagedFile : stagedFiles) {
     if (const auto parentArchivedDirectory =
           archivedDirectoryMap.find(stagedFile.parent);
@@ -71,33 +134,89 @@ void Archiver::archiveFiles(const std::vector<StagedFile>& stagedFiles,
                               "parent hasn't been archived",
                               stagedFile.id);
     } else {
-      const auto archive = [&]() -> Archive {
-        if (stagedFile.size >= singleFileArchiveSize)
-          return {1, "<SINGLE>"};
-        else
-          return archivedDatabase->getArchiveForFile(stagedFile);
-      }();
-      const auto [archivedFileType, revisionId] = archivedDatabase->addFile(
-        stagedFile, parentArchivedDirectory->second, archive, archiveOperation);
+      parentArchivedDirectories.push_back(parentArchivedDirectory->second);
+    }
+  }
+
+  const auto archivedRevisions =
+    archivedDatabase->findRevisionsWithContents(stagedFiles);
+  const auto archives = planner.assign(stagedFiles, archivedRevisions);
+  const auto addedFiles =
+    archivedDatabase->addFiles(stagedFiles, parentArchivedDirectories, archives,
+                               archiveOperation, archivedRevisions);
+  for (std::size_t i = 0; i < stagedFiles.size(); ++i) {
+    const auto& stagedFile = stagedFiles[i];
+    const auto& archive = archives[i];
+    const auto [archivedFileType, revisionId] = addedFiles[i];
 
-      if (archivedFileType == ArchivedFileAddedType::NewRevision) {
-        const auto archiveDirectory =
-          archiveLocation / FORMAT_LIB::format("{}", archive.id);
-        if (!std::filesystem::exists(archiveDirectory))
-          std::filesystem::create_directories(archiveDirectory);
+    // There is nothing in the stage directory for a reference only file, so
+    // its contents must still be archived.
+    if (stagedFile.referenceOnly &&
+        archivedFileType != ArchivedFileAddedType::DuplicateRevision) {
+      throw ArchiverException(
+        "Could not archive staged file with ID {} as no copy of it was "
+        "staged and its contents are no longer archived",
+        stagedFile.id);
+    }
+    if (archivedFileType == ArchivedFileAddedType::NewRevision) {
+      const auto archiveDirectory =
+        archiveLocation / FORMAT_LIB::format("{}", archive.id);
+      if (!std::filesystem::exists(archiveDirectory))
+        std::filesystem::create_directories(archiveDirectory);
 
-        std::filesystem::copy_file(
-          stageLocation / FORMAT_LIB::format("{}", stagedFile.id),
-          archiveDirectory / FORMAT_LIB::format("{}", revisionId));
-        modifiedArchives.insert(archive);
-      }
+      promoteStagedFile(
+        stageLocation / FORMAT_LIB::format("{}", stagedFile.id),
+        archiveDirectory / FORMAT_LIB::format("{}", revisionId));
+      planner.recordAdded(archive, stagedFile.size);
+      modifiedArchives.insert(archive);
     }
   }
 }
 
-void Archiver::saveArchiveParts() {
-  Compressor compressor{archivedDatabase, {archiveLocation}};
-  for (const auto& archive : modifiedArchives) {
-    compressor.compress(archive);
+auto Archiver::withHash(const StagedFile& stagedFile) -> StagedFile {
+  // A file staged without checking for duplicates may have been tree hashed
+  // even though a revision of the same size was hashed linearly, such as one
+  // archived before large files were tree hashed, which it could only be
+  // matched with if it is hashed linearly as well.
+  const auto hashLinearly = stagedFile.hashAlgorithm == HashAlgorithm::Tree &&
+                            !stagedFile.referenceOnly && !readBuffer.empty() &&
+                            linearRevisionSizes.contains(stagedFile.size);
+  if (stagedFile.hash && !hashLinearly)
+    return stagedFile;
+  // Otherwise the file was staged under the tiered hash policy, and no other
+  // file was found with the same fast hash, so it is hashed from its staged
+  // copy.
+  if (readBuffer.empty()) {
+    throw ArchiverException("Could not archive staged file with ID {} as its "
+                            "hash isn't known",
+                            stagedFile.id);
   }
+  const RawFile rawFile{
+    stageLocation / FORMAT_LIB::format("{}", stagedFile.id), readBuffer,
+    HashPolicy::Full,
+    hashLinearly ? HashAlgorithm::Linear : stagedFile.hashAlgorithm};
+  auto hashedFile = stagedFile;
+  hashedFile.hash = rawFile.hash;
+  hashedFile.fastHash = rawFile.fastHash;
+  hashedFile.hashAlgorithm = rawFile.hashAlgorithm;
+  return hashedFile;
+}
+
+void Archiver::promoteStagedFile(const path& stagedPath,
+                                 const path& archivedPath) {
+  if (promotionJournal) {
+    promotionJournal->promote(stagedPath, archivedPath);
+    return;
+  }
+  const auto strategy = copyFile(stagedPath, archivedPath);
+  spdlog::debug("Copied \"{}\" to \"{}\" using {}", stagedPath, archivedPath,
+                copyStrategyName(strategy));
+}
+
+void Archiver::saveArchiveParts() {
+  Compressor compressor{archivedDatabase, {archiveLocation},
+                        compressionSettings, partLimits};
+  const std::vector<Archive> archives(modifiedArchives.begin(),
+                                      modifiedArchives.end());
+  compressor.compress(archives);
 }
\ No newline at end of file
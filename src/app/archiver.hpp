@@ -2,20 +2,50 @@
 #define ARCHIVER_ARCHIVER_HPP
 
 #include "../database/archived_database.hpp"
+#include "archive_part.hpp"
+#include "archive_planner.hpp"
 #include "common.h"
+#include "compression_scheduler.hpp"
+#include "promotion_journal.hpp"
 #include "staged_directory.h"
 #include "staged_file.hpp"
+#include "util/generator.hpp"
 #include <map>
 #include <set>
 #include <span>
 
 class Archiver {
 public:
+  // How staged files are placed in the archive directory. Moving them avoids
+  // keeping a second copy of every archived file in the stage directory.
+  enum class PromotionMode { Copy, Move };
+
+  // The read buffer is used to hash the staged files which were staged under
+  // the tiered hash policy without their cryptographic hash. Archiving such a
+  // file without a read buffer throws. It is also used to hash a tree hashed
+  // file linearly when a revision of the same size was hashed linearly, so
+  // the two can be matched. Without it the file is added as a new revision.
+  //
+  // The archives modified by an archive operation are compressed at the same
+  // time as each other, as the compression settings allow, into parts split
+  // within the part limits.
   Archiver(std::shared_ptr<ArchivedDatabase>& archivedDatabase,
            const std::filesystem::path& stageDirectoryLocation,
            const std::filesystem::path& archiveDirectoryLocation,
-           Size singleFileArchiveSize);
+           Size singleFileArchiveSize,
+           PromotionMode promotionMode = PromotionMode::Copy,
+           std::span<char> fileReadBuffer = {},
+           const CompressionScheduler::Settings& compressionSettings = {},
+           const ArchivePartLimits& partLimits = {});
 
+  // The staged directories must be in order of ID, so that each directory
+  // comes after its parent. The staged files are consumed one at a time, so
+  // they don't all need to be in memory at once. The staged directories are
+  // not: the archived directory of every one of them is kept in memory until
+  // the operation finishes, as the files aren't ordered by directory and any
+  // of them may be the parent of the last file.
+  void archive(Generator<StagedDirectory> stagedDirectories,
+               Generator<StagedFile> stagedFiles);
   void archive(const std::vector<StagedDirectory>& stagedDirectories,
                const std::vector<StagedFile>& stagedFiles);
 
@@ -28,20 +58,37 @@ public:
   Archiver& operator=(Archiver&&) = default;
 
 private:
+  // The number of staged files which are assigned archives and added to the
+  // archived database together.
+  static constexpr std::size_t FileBatchSize = 1024;
+
   std::shared_ptr<ArchivedDatabase> archivedDatabase;
   std::filesystem::path stageLocation;
   std::filesystem::path archiveLocation;
   Size singleFileArchiveSize;
+  PromotionMode promotionMode;
+  std::span<char> readBuffer;
+  CompressionScheduler::Settings compressionSettings;
+  ArchivePartLimits partLimits;
+  std::optional<PromotionJournal> promotionJournal;
   std::set<Archive> modifiedArchives;
+  std::set<Size> linearRevisionSizes;
 
+  // The archived directory of each staged directory archived so far, kept for
+  // the whole archive operation.
   std::map<StagedDirectoryID, ArchivedDirectory> archivedDirectoryMap;
 
   using path = std::filesystem::path;
 
-  void archiveDirectories(const std::vector<StagedDirectory>& stagedDirectories,
+  void archiveDirectories(Generator<StagedDirectory>& stagedDirectories,
                           ArchiveOperationID archiveOperation);
-  void archiveFiles(const std::vector<StagedFile>& stagedFiles,
+  void archiveFiles(Generator<StagedFile>& stagedFiles,
                     ArchiveOperationID archiveOperation);
+  void archiveFileBatch(std::span<const StagedFile> stagedFiles,
+                        ArchivePlanner& planner,
+                        ArchiveOperationID archiveOperation);
+  auto withHash(const StagedFile& stagedFile) -> StagedFile;
+  void promoteStagedFile(const path& stagedPath, const path& archivedPath);
   void saveArchiveParts();
 };
 
@@ -27,6 +27,9 @@ StageCommand::StageCommand()
       "being staged",
       cxxopts::value<std::string>()->default_value("")
     )
+    ("changed-only", "Skip files which the hash cache shows haven't changed "
+      "since they were last archived"
+    )
     ("paths", "List of paths to stage",
       cxxopts::value<std::vector<std::string>>(), "<paths>"
     )
@@ -65,6 +68,7 @@ int StageCommand::exec() {
     [](auto& path) { return std::filesystem::path{path}; });
 
   const auto config = Config((*this->parse_result)["config"].as<std::string>());
+  setIoMode(config.general.ioMode);
 
   const auto prefix =
     std::filesystem::path{(*this->parse_result)["prefix"].as<std::string>()}
@@ -85,10 +89,31 @@ int StageCommand::exec() {
     std::make_shared<database::mysql::StagedDatabase>(
       databaseConnectionConfig));
 
-  Stager stager(stagedDatabase, std::span{dataPointer.get(), size},
-                config.stager.stage_directory);
+  const auto changedOnly = this->parse_result->count("changed-only") > 0;
+  if (changedOnly && config.stager.hash_cache.empty())
+    throw CommandValidateException(
+      "stage command requires stager.hash_cache to be set in the "
+      "configuration file to use --changed-only");
+
+  auto hashCache = config.stager.hash_cache.empty()
+                     ? nullptr
+                     : std::make_shared<HashCache>(config.stager.hash_cache);
 
-  stager.stage(paths, prefix);
+  auto archivedDatabase = std::static_pointer_cast<ArchivedDatabase>(
+    std::make_shared<MysqlArchivedDatabase>(databaseConnectionConfig,
+                                            config.archive.target_size));
+
+  Stager stager(stagedDatabase, std::span{dataPointer.get(), size},
+                config.stager.stage_directory, config.stager.worker_count,
+                hashCache, archivedDatabase, config.stager.hash_policy,
+                config.stager.read_queue_depth, config.stager.read_order,
+                config.stager.check_duplicates);
+
+  if (changedOnly) {
+    stager.stageChanged(paths, prefix);
+  } else {
+    stager.stage(paths, prefix);
+  }
 
   return EXIT_SUCCESS;
 }
@@ -120,8 +145,10 @@ int ArchiveCommand::exec() {
     spdlog::set_level(spdlog::level::info);
 
   const auto config = Config((*this->parse_result)["config"].as<std::string>());
+  setIoMode(config.general.ioMode);
 
-  auto fakeReadBuffer = std::array<char, 1>{0};
+  auto [dataPointer, size] = getFileReadBuffer(config.general.fileReadSizes);
+  std::span readBuffer{dataPointer.get(), size};
 
   auto databaseConnectionConfig =
     std::make_shared<MysqlStagedDatabase::ConnectionConfig>();
@@ -137,13 +164,22 @@ int ArchiveCommand::exec() {
     std::make_shared<MysqlArchivedDatabase>(databaseConnectionConfig,
                                             config.archive.target_size));
 
-  Stager stager(stagedDatabase, std::span{fakeReadBuffer.data(), 1},
-                config.stager.stage_directory);
+  Stager stager(stagedDatabase, readBuffer, config.stager.stage_directory);
   Archiver archiver(archivedDatabase, config.stager.stage_directory,
                     config.archive.archive_directory,
-                    config.archive.single_archive_size);
-
-  archiver.archive(stager.getDirectoriesSorted(), stager.getFilesSorted());
+                    config.archive.single_archive_size,
+                    config.archive.move_staged_files
+                      ? Archiver::PromotionMode::Move
+                      : Archiver::PromotionMode::Copy,
+                    readBuffer,
+                    {config.archive.compression_worker_count,
+                     config.archive.compression_memory_limit,
+                     config.archive.compression_job_memory},
+                    {config.archive.part_target_size,
+                     config.archive.part_max_files});
+
+  archiver.archive(stager.streamDirectoriesSorted(),
+                   stager.streamFilesSorted());
 
   return EXIT_SUCCESS;
 }
@@ -182,6 +218,7 @@ int UploadCommand::exec() {
     spdlog::set_level(spdlog::level::info);
 
   const auto config = Config((*this->parse_result)["config"].as<std::string>());
+  setIoMode(config.general.ioMode);
 
   // TODO Upload archived, or staged files
   return EXIT_SUCCESS;
@@ -209,7 +246,8 @@ DearchiveCommand::DearchiveCommand()
     ("n, number", "Specify that only files/directories from the given archive "
       "operation should be dearchvied",
       cxxopts::value<ArchiveOperationID>()
-    );
+    )
+    ("sparse", "Leave the blocks of zeros in dearchived files as holes");
   // clang-format on
 
   options.parse_positional({"paths"});
@@ -240,6 +278,7 @@ int DearchiveCommand::exec() {
   }();
 
   const auto config = Config((*this->parse_result)["config"].as<std::string>());
+  setIoMode(config.general.ioMode);
 
   const auto& paths =
     (*this->parse_result)["paths"].as<std::vector<std::string>>();
@@ -262,8 +301,11 @@ int DearchiveCommand::exec() {
   auto [dataPointer, size] = getFileReadBuffer(config.general.fileReadSizes);
   std::span span{dataPointer.get(), size};
 
+  const auto holes = this->parse_result->count("sparse") > 0
+                       ? Holes::MakeFromZeros
+                       : Holes::Keep;
   Dearchiver dearchiver(archivedDatabase, config.archive.archive_directory,
-                        config.archive.temp_archive_directory, span);
+                        config.archive.temp_archive_directory, span, holes);
 
   for (const auto& path : paths) {
     dearchiver.dearchive(path, outputPath, archiveOperation);
@@ -300,6 +342,7 @@ int CheckCommand::exec() {
     spdlog::set_level(spdlog::level::info);
 
   const auto config = Config((*this->parse_result)["config"].as<std::string>());
+  setIoMode(config.general.ioMode);
 
   auto databaseConnectionConfig =
     std::make_shared<MysqlArchivedDatabase::ConnectionConfig>();
@@ -0,0 +1,95 @@
+#include "compression_scheduler.hpp"
+#include <algorithm>
+#include <utility>
+
+auto CompressionScheduler::workerCountFor(const Settings& settings)
+  -> std::size_t {
+  auto count = settings.workerCount;
+  if (count == 0)
+    count = std::max(1u, std::thread::hardware_concurrency());
+  if (settings.memoryLimit != 0 && settings.jobMemory != 0)
+    count = std::min<std::size_t>(
+      count, std::max<Size>(1, settings.memoryLimit / settings.jobMemory));
+  return count;
+}
+
+CompressionScheduler::CompressionScheduler(const Settings& settings) {
+  const auto count = workerCountFor(settings);
+  for (std::size_t i = 0; i < count; ++i)
+    workers.emplace_back([this]() { runWorker(); });
+}
+
+CompressionScheduler::~CompressionScheduler() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  jobsChanged.notify_all();
+  for (auto& worker : workers)
+    worker.join();
+}
+
+void CompressionScheduler::submit(std::string name, Task task) {
+  {
+    std::lock_guard lock(mutex);
+    queuedJobs.push_back({std::move(name), std::move(task)});
+    ++submittedJobs;
+  }
+  jobsChanged.notify_all();
+}
+
+void CompressionScheduler::finish() {
+  std::unique_lock lock(mutex);
+  jobsChanged.wait(lock,
+                   [&]() { return queuedJobs.empty() && runningJobs == 0; });
+  if (error)
+    std::rethrow_exception(std::exchange(error, nullptr));
+}
+
+auto CompressionScheduler::workerCount() const -> std::size_t {
+  return workers.size();
+}
+
+void CompressionScheduler::runWorker() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock lock(mutex);
+      jobsChanged.wait(lock, [&]() { return stopping || !queuedJobs.empty(); });
+      if (stopping)
+        return;
+      job = std::move(queuedJobs.front());
+      queuedJobs.pop_front();
+      if (error) {
+        // Skip the job, as the archive operation is going to fail anyway.
+        if (queuedJobs.empty() && runningJobs == 0)
+          jobsChanged.notify_all();
+        continue;
+      }
+      ++runningJobs;
+    }
+
+    spdlog::info("Compressing {}", job.name);
+    std::exception_ptr jobError;
+    try {
+      job.task([&](std::size_t done, std::size_t total) {
+        spdlog::info("Compressed {} of {} parts of {}", done, total, job.name);
+      });
+    } catch (...) {
+      jobError = std::current_exception();
+    }
+
+    {
+      std::lock_guard lock(mutex);
+      --runningJobs;
+      if (jobError && !error)
+        error = jobError;
+      if (!jobError) {
+        ++finishedJobs;
+        spdlog::info("Finished compressing {}, {} of {} jobs are done",
+                     job.name, finishedJobs, submittedJobs);
+      }
+    }
+    jobsChanged.notify_all();
+  }
+}
@@ -0,0 +1,79 @@
+#ifndef ARCHIVER_COMPRESSION_SCHEDULER_HPP
+#define ARCHIVER_COMPRESSION_SCHEDULER_HPP
+
+#include "archive_defaults.hpp"
+#include "common.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Runs compression jobs, such as compressing the parts of one archive, on a
+// fixed number of worker threads. Each job runs a single zpaq process at a
+// time, so at most one job per worker is using the memory zpaq needs. The jobs
+// don't use the archived database, anything which does, such as reserving
+// the part numbers a job writes, must be done by the caller before submitting
+// it.
+class CompressionScheduler {
+public:
+  struct Settings {
+    // 0 uses one worker per hardware thread.
+    std::size_t workerCount = 1;
+    // The memory the jobs running at once can use between them, 0 for no
+    // limit. There is always at least one worker, even if a single job needs
+    // more than this.
+    Size memoryLimit = 0;
+    // The memory a single zpaq -m5 job is expected to use.
+    Size jobMemory = DefaultCompressionJobMemory;
+  };
+  // Reports how many of the parts written by a job are done.
+  using Progress = std::function<void(std::size_t done, std::size_t total)>;
+  using Task = std::function<void(const Progress& progress)>;
+
+  // The number of workers used with the settings.
+  static auto workerCountFor(const Settings& settings) -> std::size_t;
+
+  explicit CompressionScheduler(const Settings& settings);
+  // Waits for the workers to finish the jobs they have already started.
+  ~CompressionScheduler();
+
+  // Queues a job, named in its progress reports.
+  void submit(std::string name, Task task);
+  // Waits for every submitted job to finish, then rethrows the first
+  // exception thrown by a job. Jobs which hadn't started when a job threw are
+  // skipped.
+  void finish();
+
+  auto workerCount() const -> std::size_t;
+
+  CompressionScheduler() = delete;
+  CompressionScheduler(const CompressionScheduler&) = delete;
+  CompressionScheduler(CompressionScheduler&&) = delete;
+
+  CompressionScheduler& operator=(const CompressionScheduler&) = delete;
+  CompressionScheduler& operator=(CompressionScheduler&&) = delete;
+
+private:
+  struct Job {
+    std::string name;
+    Task task;
+  };
+
+  void runWorker();
+
+  std::mutex mutex;
+  std::condition_variable jobsChanged;
+  std::deque<Job> queuedJobs;
+  std::size_t runningJobs = 0;
+  std::size_t submittedJobs = 0;
+  std::size_t finishedJobs = 0;
+  std::exception_ptr error;
+  bool stopping = false;
+
+  std::vector<std::thread> workers;
+};
+
+#endif
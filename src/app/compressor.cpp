@@ -1,60 +1,50 @@
 #include "compressor.hpp"
+#include <algorithm>
 #include <concepts>
 #include <filesystem>
 #include <functional>
+#include <iterator>
 #include <limits>
 #include <ranges>
 #include <subprocess.hpp>
 
+namespace {
+void runZpaq(const std::vector<std::string>& commandList,
+             const std::filesystem::path& workingDirectory) {
+  subprocess::run(commandList, {.cout = subprocess::PipeOption::cout,
+                                .cerr = subprocess::PipeOption::cerr,
+                                .cwd = workingDirectory,
+                                .check = true});
+}
+}
+
 Compressor::Compressor(
   std::shared_ptr<ArchivedDatabase>& archivedDatabase,
-  const std::vector<std::filesystem::path>& archiveLocations)
-  : archivedDatabase(archivedDatabase), archiveLocations(archiveLocations) {}
+  const std::vector<std::filesystem::path>& archiveLocations,
+  const CompressionScheduler::Settings& compressionSettings,
+  const ArchivePartLimits& partLimits)
+  : archivedDatabase(archivedDatabase), archiveLocations(archiveLocations),
+    compressionSettings(compressionSettings), partLimits(partLimits) {}
 
 void Compressor::compress(const Archive& archive) {
-  if (archive.id == 1)
-    return compressSingleArchives();
-
-  const auto archiveIndex =
-    archiveLocations.at(0) / FORMAT_LIB::format("{}_index", archive.id);
-
-  auto compressFiles = [&](const std::vector<std::string> files) {
-    const auto newArchiveName =
-      archiveLocations.at(0) /
-      FORMAT_LIB::format("{}_{}.zpaq", archive.id,
-                         archivedDatabase->getNextArchivePartNumber(archive));
-
-    std::vector<std::string> commandList = {"zpaq", "a", newArchiveName};
-    std::ranges::copy(files, std::back_inserter(commandList));
-    commandList.push_back("-m5");
-    commandList.push_back("-index");
-    commandList.push_back(archiveIndex.native());
-
-    subprocess::run(commandList, {.cout = subprocess::PipeOption::cout,
-                                  .cerr = subprocess::PipeOption::cerr,
-                                  .cwd = archiveLocations.at(0),
-                                  .check = true});
-
-    archivedDatabase->incrementNextArchivePartNumber(archive);
-  };
-
-  // Chunk and add the files to the archive.
-  std::vector<std::string> filesChunk;
-  const decltype(filesChunk)::size_type chunkSize = 100;
-  for (const auto& file : std::filesystem::directory_iterator(
-         archiveLocations.at(0) / FORMAT_LIB::format("{}", archive.id))) {
-    filesChunk.push_back(
-      std::filesystem::path(FORMAT_LIB::format("{}", archive.id)) /
-      file.path().filename());
-
-    if (filesChunk.size() == chunkSize) {
-      compressFiles(filesChunk);
-      filesChunk.clear();
-    }
-  }
-  if (!filesChunk.empty()) {
-    compressFiles(filesChunk);
+  compress(std::span{&archive, 1});
+}
+
+void Compressor::compress(std::span<const Archive> archives) {
+  CompressionScheduler scheduler{compressionSettings};
+  // zpaq otherwise compresses with a thread per core, so several jobs at once
+  // would each use many times the memory a job is expected to.
+  std::vector<std::string> options;
+  if (scheduler.workerCount() > 1)
+    options = {"-threads", "1"};
+
+  for (const auto& archive : archives) {
+    if (archive.id == 1)
+      queueSingleArchives(scheduler, options);
+    else
+      queueArchive(archive, scheduler, options);
   }
+  scheduler.finish();
 }
 
 void Compressor::decompress(ArchiveID archiveId,
@@ -100,21 +90,80 @@ void Compressor::decompressSingleArchive(
                                 .check = true});
 }
 
-void Compressor::compressSingleArchives() {
-  std::ranges::for_each(
-    std::filesystem::directory_iterator(archiveLocations.at(0) / "1"),
-    [&](const auto& file) {
-      const auto newArchiveName =
-        archiveLocations.at(0) /
-        FORMAT_LIB::format("1_{}.zpaq", file.path().filename());
-
-      std::vector<std::string> commandList = {
-        "zpaq", "a", newArchiveName,
-        std::filesystem::path("1") / file.path().filename(), "-m5"};
-
-      subprocess::run(commandList, {.cout = subprocess::PipeOption::cout,
-                                    .cerr = subprocess::PipeOption::cerr,
-                                    .cwd = archiveLocations.at(0),
-                                    .check = true});
+void Compressor::queueArchive(const Archive& archive,
+                              CompressionScheduler& scheduler,
+                              const std::vector<std::string>& options) {
+  auto parts = splitIntoParts(
+    archivedDatabase->listUncompressedRevisions(archive), partLimits);
+  if (parts.empty())
+    return;
+
+  // The parts are numbered and recorded here, as the jobs can't use the
+  // database. Should compressing them fail, the archive operation's
+  // transaction is rolled back, so they aren't left recorded.
+  const auto firstPartNumber =
+    archivedDatabase->reserveArchivePartNumbers(archive, parts.size());
+  for (std::size_t i = 0; i < parts.size(); ++i)
+    parts[i].number = firstPartNumber + i;
+  archivedDatabase->addArchiveParts(archive, parts);
+
+  scheduler.submit(
+    FORMAT_LIB::format("archive {}", archive.id),
+    [this, archive, options,
+     parts = std::move(parts)](const CompressionScheduler::Progress& progress) {
+      const auto archiveDirectory =
+        std::filesystem::path(FORMAT_LIB::format("{}", archive.id));
+      const auto archiveIndex =
+        archiveLocations.at(0) / FORMAT_LIB::format("{}_index", archive.id);
+
+      for (std::size_t i = 0; i < parts.size(); ++i) {
+        const auto newArchiveName =
+          archiveLocations.at(0) /
+          FORMAT_LIB::format("{}_{}.zpaq", archive.id, parts[i].number);
+
+        std::vector<std::string> commandList = {"zpaq", "a", newArchiveName};
+        for (const auto revisionId : parts[i].revisions)
+          commandList.push_back(archiveDirectory /
+                                FORMAT_LIB::format("{}", revisionId));
+        commandList.push_back("-m5");
+        commandList.push_back("-index");
+        commandList.push_back(archiveIndex.native());
+        std::ranges::copy(options, std::back_inserter(commandList));
+
+        runZpaq(commandList, archiveLocations.at(0));
+        progress(i + 1, parts.size());
+      }
     });
-}
\ No newline at end of file
+}
+
+void Compressor::queueSingleArchives(CompressionScheduler& scheduler,
+                                     const std::vector<std::string>& options) {
+  const Archive singleFileArchive{1, "<SINGLE>"};
+  const auto revisions =
+    archivedDatabase->listUncompressedRevisions(singleFileArchive);
+
+  // Each revision is a part of its own, numbered by the revision.
+  std::vector<ArchivePart> parts;
+  for (const auto& [revisionId, size] : revisions)
+    parts.push_back({revisionId, {revisionId}, size});
+  archivedDatabase->addArchiveParts(singleFileArchive, parts);
+
+  for (const auto& [revisionId, size] : revisions) {
+    scheduler.submit(
+      FORMAT_LIB::format("single file archive {}", revisionId),
+      [this, revisionId,
+       options](const CompressionScheduler::Progress& progress) {
+        const auto newArchiveName =
+          archiveLocations.at(0) / FORMAT_LIB::format("1_{}.zpaq", revisionId);
+
+        std::vector<std::string> commandList = {
+          "zpaq", "a", newArchiveName,
+          std::filesystem::path("1") / FORMAT_LIB::format("{}", revisionId),
+          "-m5"};
+        std::ranges::copy(options, std::back_inserter(commandList));
+
+        runZpaq(commandList, archiveLocations.at(0));
+        progress(1, 1);
+      });
+  }
+}
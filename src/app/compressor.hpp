@@ -3,7 +3,10 @@
 
 #include "../database/archived_database.hpp"
 #include "archive.h"
+#include "archive_part.hpp"
 #include "common.h"
+#include "compression_scheduler.hpp"
+#include <span>
 
 class Compressor {
 public:
@@ -13,9 +16,18 @@ public:
   ~Compressor() = default;
 
   Compressor(std::shared_ptr<ArchivedDatabase>& archivedDatabase,
-             const std::vector<std::filesystem::path>& archiveLocations);
+             const std::vector<std::filesystem::path>& archiveLocations,
+             const CompressionScheduler::Settings& compressionSettings = {},
+             const ArchivePartLimits& partLimits = {});
 
   void compress(const Archive& archive);
+  // Compresses the revisions of the archives which aren't in a part yet into
+  // new parts, split within the part limits, and records the parts in the
+  // archived database. The archives are compressed at the same time, on the
+  // workers of a scheduler with the compression settings. The parts of an
+  // archive share its index, so they are compressed one after another by the
+  // same job, while each single file archive is a job of its own.
+  void compress(std::span<const Archive> archives);
   void decompress(ArchiveID archiveId,
                   const std::filesystem::path& destination);
   void decompressSingleArchive(ArchivedFileRevisionID revisionId,
@@ -27,8 +39,14 @@ public:
 private:
   std::shared_ptr<ArchivedDatabase> archivedDatabase;
   std::vector<std::filesystem::path> archiveLocations;
-
-  void compressSingleArchives();
+  CompressionScheduler::Settings compressionSettings;
+  ArchivePartLimits partLimits;
+
+  // The options are added to every zpaq command.
+  void queueArchive(const Archive& archive, CompressionScheduler& scheduler,
+                    const std::vector<std::string>& options);
+  void queueSingleArchives(CompressionScheduler& scheduler,
+                           const std::vector<std::string>& options);
 };
 
 _make_exception_(CompressorException);
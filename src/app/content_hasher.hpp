@@ -0,0 +1,88 @@
+#ifndef ARCHIVER_CONTENT_HASHER_HPP
+#define ARCHIVER_CONTENT_HASHER_HPP
+
+#include "common.h"
+#include "file_hash.hpp"
+#include "hash_policy.hpp"
+#include "hash/blake2b.hpp"
+#include "hash/sha3_512.hpp"
+#include "hash/xxh3_128.hpp"
+#include "read_pipeline.hpp"
+#include <concepts>
+#include <optional>
+#include <vector>
+
+// The policies as types, so code which reads files can be specialised on the
+// policy at compile time rather than checking it for every block read.
+struct FullHashing {
+  static constexpr HashPolicy Policy = HashPolicy::Full;
+  static constexpr bool IsCryptographic = true;
+};
+struct TieredHashing {
+  static constexpr HashPolicy Policy = HashPolicy::Tiered;
+  static constexpr bool IsCryptographic = false;
+};
+
+template <typename T>
+concept HashingPolicy = requires {
+  { T::Policy } -> std::convertible_to<HashPolicy>;
+  { T::IsCryptographic } -> std::convertible_to<bool>;
+};
+
+// Calls function with the policy type for policy, and returns its result.
+template <typename Function>
+auto withHashingPolicy(HashPolicy policy, Function&& function) {
+  if (policy == HashPolicy::Tiered)
+    return function(TieredHashing{});
+  return function(FullHashing{});
+}
+
+// Computes the hashes of a file which the policy calls for as it is read. Each
+// hash is a separate ReadPipeline consumer, so they run in parallel.
+template <HashingPolicy Policy> class ContentHasher {
+public:
+  ContentHasher() = default;
+
+  auto consumers() -> std::vector<ReadPipeline::Consumer> {
+    std::vector<ReadPipeline::Consumer> consumers = {
+      [this](std::span<const char> data) {
+        xxh3.addData(data.data(), data.size());
+      }};
+    if constexpr (Policy::IsCryptographic) {
+      consumers.push_back([this](std::span<const char> data) {
+        sha3.addData(data.data(), data.size());
+      });
+      consumers.push_back([this](std::span<const char> data) {
+        blake2B.addData(data.data(), data.size());
+      });
+    }
+    return consumers;
+  }
+
+  auto finalizeFastHash() -> FastHash { return FastHash{xxh3.finalize()}; }
+  auto finalizeHash() -> std::optional<FileHash> {
+    if constexpr (Policy::IsCryptographic)
+      return FileHash{sha3.finalize(), blake2B.finalize()};
+    else
+      return std::nullopt;
+  }
+
+  ContentHasher(const ContentHasher&) = delete;
+  ContentHasher(ContentHasher&&) = delete;
+
+  ContentHasher& operator=(const ContentHasher&) = delete;
+  ContentHasher& operator=(ContentHasher&&) = delete;
+
+private:
+  struct NoHasher {};
+  using Sha3 =
+    std::conditional_t<Policy::IsCryptographic, hash::Sha3_512, NoHasher>;
+  using Blake2b =
+    std::conditional_t<Policy::IsCryptographic, hash::Blake2b, NoHasher>;
+
+  hash::Xxh3_128 xxh3;
+  [[no_unique_address]] Sha3 sha3;
+  [[no_unique_address]] Blake2b blake2B;
+};
+
+#endif
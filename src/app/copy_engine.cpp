@@ -0,0 +1,306 @@
+#include "copy_engine.hpp"
+#include "file_reader.hpp"
+#include "file_writer.hpp"
+#include "io_mode.hpp"
+#include "raw_file.hpp"
+#include <algorithm>
+#include <memory>
+#include <system_error>
+#include <utility>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+auto copyStrategyName(CopyStrategy strategy) -> std::string_view {
+  switch (strategy) {
+  case CopyStrategy::Reflink:
+    return "reflink";
+  case CopyStrategy::Sparse:
+    return "sparse";
+  case CopyStrategy::CopyFileRange:
+    return "copy_file_range";
+  case CopyStrategy::Sendfile:
+    return "sendfile";
+  case CopyStrategy::Buffered:
+    return "buffered";
+  }
+  return "unknown";
+}
+
+#ifdef __linux__
+namespace {
+constexpr std::size_t FallbackBufferSize = 1024 * 1024;
+
+auto errorMessage(int error) -> std::string {
+  return std::error_code(error, std::system_category()).message();
+}
+
+class FileDescriptor {
+public:
+  explicit FileDescriptor(int fd) : fd(fd) {}
+  ~FileDescriptor() {
+    if (fd >= 0)
+      ::close(fd);
+  }
+
+  FileDescriptor(const FileDescriptor&) = delete;
+  FileDescriptor(FileDescriptor&& other) : fd(std::exchange(other.fd, -1)) {}
+  FileDescriptor& operator=(const FileDescriptor&) = delete;
+  FileDescriptor& operator=(FileDescriptor&&) = delete;
+
+  auto get() const -> int { return fd; }
+  // Closes the file, reporting any error since for a file that was written
+  // to it can be the first sign of a failed write.
+  auto close() -> int {
+    const auto result = ::close(fd);
+    fd = -1;
+    return result;
+  }
+
+private:
+  int fd;
+};
+
+// Copies the rest of the source to the destination with the given system call,
+// returning false if the call isn't supported for these files. Support can
+// only be determined by the first call, a failure after data has been copied
+// is an error.
+template <typename CopyFunction>
+auto copyWith(CopyFunction&& copyChunk, std::uint64_t size,
+              const std::filesystem::path& from) -> bool {
+  std::uint64_t copied = 0;
+  while (copied < size) {
+    const auto result = copyChunk(static_cast<std::size_t>(size - copied));
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      if (copied == 0)
+        return false;
+      throw CopyException("There was an error copying \"{}\": {}", from,
+                          errorMessage(errno));
+    }
+    // Some filesystems which can't copy between the files report nothing
+    // being copied rather than an error, so the next strategy is tried.
+    if (result == 0 && copied == 0)
+      return false;
+    // The file was truncated while it was being copied.
+    if (result == 0)
+      break;
+    copied += static_cast<std::uint64_t>(result);
+  }
+  return true;
+}
+
+// Copies the source through the buffer, or a buffer allocated here if it is
+// empty, and so under the io mode. If skipZeros is set the blocks of zeros
+// are left as holes in the destination.
+void copyThroughBuffer(int destination, std::span<char> buffer,
+                       bool skipZeros, const std::filesystem::path& from,
+                       const std::filesystem::path& to) {
+  AlignedBuffer fallbackBuffer;
+  if (buffer.empty()) {
+    fallbackBuffer = makeAlignedBuffer(FallbackBufferSize);
+    buffer = {fallbackBuffer.get(), FallbackBufferSize};
+  }
+
+  try {
+    FileReader reader{from};
+    FileWriter writer{to, destination};
+    std::uint64_t offset = 0;
+    for (bool lastRead = false; !lastRead;) {
+      const auto read = reader.read(buffer, offset);
+      lastRead = read < buffer.size();
+
+      const std::span<const char> data{buffer.data(), read};
+      if (!skipZeros) {
+        writer.write(data, offset);
+        offset += data.size();
+        continue;
+      }
+      forEachZeroRun(data, DirectIoAlignment,
+                     [&](std::span<const char> run, bool isZeros) {
+                       if (!isZeros)
+                         writer.write(run, offset);
+                       offset += run.size();
+                     });
+    }
+    writer.finish(offset);
+  } catch (const FileException& err) {
+    throw CopyException("There was an error copying \"{}\" to \"{}\": {}",
+                        from, to, err.what());
+  }
+}
+
+// Has the kernel copy only the data segments of the source, and sets the size
+// of the destination at the end so the rest are holes. Returns false if the
+// kernel can't copy between these files. If the source was truncated while it
+// was being copied the destination ends where the source now does, as it
+// would with the other strategies, rather than being padded back out to the
+// original size.
+auto copyDataSegments(int source, int destination, std::uint64_t size,
+                      const std::filesystem::path& from,
+                      const std::filesystem::path& to) -> bool {
+  std::uint64_t end = size;
+  for (auto segment = findData(source, 0, size); segment;
+       segment = findData(source, segment->end, size)) {
+    loff_t sourceOffset = static_cast<loff_t>(segment->start);
+    loff_t destinationOffset = sourceOffset;
+    const auto copyFileRange = [&](std::size_t length) {
+      return ::copy_file_range(source, &sourceOffset, destination,
+                               &destinationOffset, length, 0);
+    };
+    if (!copyWith(copyFileRange, segment->end - segment->start, from))
+      return false;
+    if (static_cast<std::uint64_t>(destinationOffset) < segment->end) {
+      end = static_cast<std::uint64_t>(destinationOffset);
+      break;
+    }
+  }
+
+  // A truncation which only cut off holes stops the copy without a short
+  // segment.
+  struct stat sourceStatus;
+  if (::fstat(source, &sourceStatus) != 0) {
+    throw CopyException("There was an error reading the status of \"{}\": {}",
+                        from, errorMessage(errno));
+  }
+  end = std::min(end, static_cast<std::uint64_t>(sourceStatus.st_size));
+
+  if (::ftruncate(destination, static_cast<off_t>(end)) != 0) {
+    throw CopyException("There was an error writing \"{}\": {}", to,
+                        errorMessage(errno));
+  }
+  return true;
+}
+
+// Copies the whole of the source with the cheapest strategy after a reflink
+// which the filesystems support.
+auto copyContents(int source, int destination, std::uint64_t size,
+                  std::span<char> buffer, const std::filesystem::path& from,
+                  const std::filesystem::path& to) -> CopyStrategy {
+  const auto copyFileRange = [&](std::size_t length) {
+    return ::copy_file_range(source, nullptr, destination, nullptr, length, 0);
+  };
+  const auto sendfile = [&](std::size_t length) {
+    return ::sendfile(destination, source, nullptr, length);
+  };
+
+  if (copyWith(copyFileRange, size, from))
+    return CopyStrategy::CopyFileRange;
+  if (copyWith(sendfile, size, from))
+    return CopyStrategy::Sendfile;
+  copyThroughBuffer(destination, buffer, false, from, to);
+  return CopyStrategy::Buffered;
+}
+
+struct OpenFiles {
+  FileDescriptor source;
+  FileDescriptor destination;
+  std::uint64_t size;
+  // Whether the source has fewer blocks allocated than its size needs.
+  bool sparse;
+};
+
+auto openFiles(const std::filesystem::path& from,
+               const std::filesystem::path& to) -> OpenFiles {
+  FileDescriptor source{::open(from.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (source.get() < 0) {
+    throw CopyException("There was an error opening \"{}\" for reading: {}",
+                        from, errorMessage(errno));
+  }
+  struct stat sourceStatus;
+  if (::fstat(source.get(), &sourceStatus) != 0) {
+    throw CopyException("There was an error reading the status of \"{}\": {}",
+                        from, errorMessage(errno));
+  }
+  if (!S_ISREG(sourceStatus.st_mode)) {
+    throw CopyException("The path \"{}\" is not a file", from);
+  }
+
+  FileDescriptor destination{
+    ::open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+           sourceStatus.st_mode & 07777)};
+  if (destination.get() < 0) {
+    throw CopyException("There was an error creating \"{}\": {}", to,
+                        errorMessage(errno));
+  }
+  const auto size = static_cast<std::uint64_t>(sourceStatus.st_size);
+  return {std::move(source), std::move(destination), size,
+          static_cast<std::uint64_t>(sourceStatus.st_blocks) * 512 < size};
+}
+}
+
+auto copyFile(const std::filesystem::path& from,
+              const std::filesystem::path& to, std::span<char> buffer,
+              Holes holes) -> CopyStrategy {
+  auto [source, destination, size, sparse] = openFiles(from, to);
+
+  try {
+    auto strategy = CopyStrategy::Reflink;
+    // A reflink would share the blocks of zeros rather than leave holes.
+    if (holes == Holes::MakeFromZeros ||
+        ::ioctl(destination.get(), FICLONE, source.get()) != 0) {
+      const auto skipZeros = sparse || holes == Holes::MakeFromZeros;
+      strategy = skipZeros ? CopyStrategy::Sparse : CopyStrategy::Buffered;
+      // The kernel copies through the page cache, so under the other io
+      // modes the copy is made through the buffer instead.
+      if (ioMode() != IoMode::Buffered || holes == Holes::MakeFromZeros) {
+        copyThroughBuffer(destination.get(), buffer, skipZeros, from, to);
+      } else if (sparse) {
+        if (!copyDataSegments(source.get(), destination.get(), size, from,
+                              to))
+          copyThroughBuffer(destination.get(), buffer, true, from, to);
+      } else {
+        strategy = copyContents(source.get(), destination.get(), size, buffer,
+                                from, to);
+      }
+    }
+
+    if (destination.close() != 0) {
+      throw CopyException("There was an error writing \"{}\": {}", to,
+                          errorMessage(errno));
+    }
+    return strategy;
+  } catch (...) {
+    std::error_code error;
+    std::filesystem::remove(to, error);
+    throw;
+  }
+}
+
+auto reflinkFile(const std::filesystem::path& from,
+                 const std::filesystem::path& to) -> bool {
+  auto [source, destination, size, sparse] = openFiles(from, to);
+  if (::ioctl(destination.get(), FICLONE, source.get()) == 0 &&
+      destination.close() == 0)
+    return true;
+
+  std::error_code error;
+  std::filesystem::remove(to, error);
+  return false;
+}
+#else
+auto copyFile(const std::filesystem::path& from,
+              const std::filesystem::path& to, std::span<char>, Holes)
+  -> CopyStrategy {
+  try {
+    std::filesystem::copy_file(from, to);
+  } catch (const std::filesystem::filesystem_error& err) {
+    throw CopyException("There was an error copying \"{}\" to \"{}\": {}",
+                        from, to, err.what());
+  }
+  return CopyStrategy::Buffered;
+}
+
+auto reflinkFile(const std::filesystem::path&, const std::filesystem::path&)
+  -> bool {
+  return false;
+}
+#endif
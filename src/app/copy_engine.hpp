@@ -0,0 +1,50 @@
+#ifndef ARCHIVER_COPY_ENGINE_HPP
+#define ARCHIVER_COPY_ENGINE_HPP
+
+#include "common.h"
+#include <span>
+#include <string_view>
+
+// How the contents of a file were copied, from cheapest to most expensive.
+enum class CopyStrategy {
+  // The copy shares the extents of the original, only metadata is written.
+  Reflink,
+  // Only the data of the file was copied, its holes were left as holes in
+  // the copy.
+  Sparse,
+  // The kernel copied the data, possibly offloading it to the filesystem.
+  CopyFileRange,
+  // The kernel copied the data through the page cache.
+  Sendfile,
+  // The data was read into and written from a user space buffer.
+  Buffered
+};
+
+auto copyStrategyName(CopyStrategy strategy) -> std::string_view;
+
+// Which parts of a file are left as holes in a copy of it.
+enum class Holes {
+  // The holes of a sparse file.
+  Keep,
+  // Every block of zeros, such as for a file which lost its holes when it was
+  // compressed into an archive.
+  MakeFromZeros
+};
+
+// Copies the file at from to the new file to, trying each strategy in order
+// until one is supported by the filesystems involved. The buffer is used for
+// a buffered or sparse copy, if it is empty a buffer is allocated when
+// needed. The copy has the permissions of the original, and it is an error if
+// to already exists.
+auto copyFile(const std::filesystem::path& from,
+              const std::filesystem::path& to, std::span<char> buffer = {},
+              Holes holes = Holes::Keep) -> CopyStrategy;
+
+// Creates the new file to as a reflink of from. Returns false, without
+// leaving a file behind, if reflinks aren't supported between the two paths.
+auto reflinkFile(const std::filesystem::path& from,
+                 const std::filesystem::path& to) -> bool;
+
+_make_exception_(CopyException);
+
+#endif
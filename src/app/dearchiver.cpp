@@ -1,13 +1,17 @@
 #include "dearchiver.hpp"
 #include "common.h"
 #include "compressor.hpp"
+#include "copy_engine.hpp"
+#include "file_reader.hpp"
+#include "file_writer.hpp"
+#include "io_mode.hpp"
 #include "raw_file.hpp"
 #include "util/string_helpers.hpp"
 #include <concepts>
 
 #include <algorithm>
+#include <cstring>
 #include <filesystem>
-#include <fstream>
 #include <map>
 #include <ranges>
 #include <string>
@@ -17,11 +21,11 @@ Dearchiver::Dearchiver(
   std::shared_ptr<ArchivedDatabase>& archivedDatabase,
   const std::filesystem::path& archiveDirectoryLocation,
   const std::filesystem::path& archiveTempDirectoryLocation,
-  std::span<char> fileReadBuffer)
+  std::span<char> fileReadBuffer, Holes holes)
   : archivedDatabase(archivedDatabase),
     archiveLocation(archiveDirectoryLocation),
     archiveTempLocation(archiveTempDirectoryLocation),
-    readBuffer(fileReadBuffer) {
+    readBuffer(fileReadBuffer), holes(holes) {
   if (readBuffer.size() >
       static_cast<std::size_t>(std::numeric_limits<std::streamsize>::max()))
     throw std::logic_error(
@@ -98,9 +102,8 @@ void Dearchiver::dearchive(
       if (!std::filesystem::exists(archiveTempLocation /
                                    FORMAT_LIB::format("1/{}", revision.id)))
         compressor.decompressSingleArchive(revision.id, archiveTempLocation);
-      std::filesystem::copy_file(archiveTempLocation /
-                                   FORMAT_LIB::format("1/{}", revision.id),
-                                 containingDirectory / file.name);
+      copyFile(archiveTempLocation / FORMAT_LIB::format("1/{}", revision.id),
+               containingDirectory / file.name, readBuffer, holes);
       return;
     }
     if (!hasArchiveBeenDecompressed(revision.containingArchiveId) &&
@@ -117,10 +120,11 @@ void Dearchiver::dearchive(
     spdlog::info("Copying file revision from \"{}/{}\" to \"{}/{}\"",
                  revision.containingArchiveId, revision.id, containingDirectory,
                  file.name);
-    std::filesystem::copy_file(
+    const auto strategy = copyFile(
       archiveTempLocation /
         FORMAT_LIB::format("{}/{}", revision.containingArchiveId, revision.id),
-      containingDirectory / file.name);
+      containingDirectory / file.name, readBuffer, holes);
+    spdlog::info("Copied file revision using {}", copyStrategyName(strategy));
   };
 
   auto dearchiveDirectory =
@@ -252,7 +256,7 @@ void Dearchiver::check() {
         RawFile rawFile(archiveTempLocation /
                           FORMAT_LIB::format(
                             "{}/{}", revision.containingArchiveId, revision.id),
-                        readBuffer);
+                        readBuffer, HashPolicy::Full, revision.hashAlgorithm);
         if (rawFile.size != revision.size || rawFile.hash != revision.hash) {
           spdlog::warn("Revision with id {} is archived incorrectly",
                        revision.id);
@@ -323,12 +327,16 @@ void Dearchiver::mergeArchiveParts(ArchiveID archiveId) {
 
   const auto outputPath =
     archiveTempLocation / FORMAT_LIB::format("{}.zpaq", archiveId);
-  std::basic_ofstream<char> outputStream(outputPath, std::ios_base::binary |
-                                                       std::ios_base::trunc);
-  if (outputStream.bad() || !outputStream.is_open()) {
-    throw FileException("There was an error opening \"{}\" for writing",
-                        outputPath);
+  if (readBuffer.size() <= DirectIoAlignment) {
+    throw std::logic_error(
+      "Could not merge archive parts as the read buffer is too small");
   }
+  FileWriter output{outputPath};
+  std::uint64_t outputSize = 0;
+  // The parts are written in whole blocks, so the writes can be direct, by
+  // holding back the end of each read which doesn't fill a block until the
+  // next one.
+  std::size_t heldBack = 0;
 
   const auto archiveNameStart = FORMAT_LIB::format("{}_", archiveId);
 
@@ -361,28 +369,29 @@ void Dearchiver::mergeArchiveParts(ArchiveID archiveId) {
       archiveLocation /
       FORMAT_LIB::format("{}{}.zpaq", archiveNameStart, partNumber);
 
-    std::basic_ifstream<char> inputStream(archivePartPath,
-                                          std::ios_base::binary);
-
-    if (inputStream.bad() || !inputStream.is_open()) {
-      throw FileException("There was an error opening \"{}\" for reading",
-                          archivePartPath);
-    }
-
-    while (!inputStream.eof()) {
-      inputStream.read(readBuffer.data(),
-                       static_cast<std::streamsize>(readBuffer.size()));
-
-      if (inputStream.bad()) {
-        throw FileException("There was an error reading \"{}\"",
-                            archivePartPath);
+    FileReader input{archivePartPath};
+    for (std::uint64_t offset = 0; offset < input.size();) {
+      // Reads go to an aligned part of the buffer after the held back bytes,
+      // and are then moved to follow them.
+      const auto readStart = heldBack == 0 ? 0 : DirectIoAlignment;
+      const auto read = input.read(readBuffer.subspan(readStart), offset);
+      if (read == 0)
+        break;
+      if (readStart != heldBack) {
+        std::memmove(readBuffer.data() + heldBack,
+                     readBuffer.data() + readStart, read);
       }
-
-      Size read = static_cast<Size>(inputStream.gcount());
-
-      outputStream.write(readBuffer.data(), read);
+      offset += read;
+
+      const auto filled = heldBack + read;
+      const auto writeSize = filled / DirectIoAlignment * DirectIoAlignment;
+      output.write({readBuffer.data(), writeSize}, outputSize);
+      outputSize += writeSize;
+      heldBack = filled - writeSize;
+      std::memmove(readBuffer.data(), readBuffer.data() + writeSize, heldBack);
     }
   }
 
-  outputStream.flush();
+  output.write({readBuffer.data(), heldBack}, outputSize);
+  output.finish(outputSize + heldBack);
 }
@@ -3,14 +3,19 @@
 
 #include "../database/archived_database.hpp"
 #include "common.h"
+#include "copy_engine.hpp"
 #include <span>
 
 class Dearchiver {
 public:
+  // Files are restored with the cheapest copy the filesystems support. Archives
+  // don't keep the holes of sparse files, so with Holes::MakeFromZeros every
+  // block of zeros in a restored file is left as a hole instead, which reads
+  // every file through the buffer.
   Dearchiver(std::shared_ptr<ArchivedDatabase>& archivedDatabase,
              const std::filesystem::path& archiveDirectoryLocation,
              const std::filesystem::path& archiveTempDirectoryLocation,
-             std::span<char> fileReadBuffer);
+             std::span<char> fileReadBuffer, Holes holes = Holes::Keep);
 
   void dearchive(const std::filesystem::path& pathToDearchive,
                  const std::filesystem::path& dearchiveLocation,
@@ -32,6 +37,7 @@ private:
   std::filesystem::path archiveTempLocation;
   std::vector<ArchiveID> decompressedArchives;
   std::span<char> readBuffer;
+  Holes holes;
 
   bool hasArchiveBeenDecompressed(ArchiveID archiveId) const;
   void mergeArchiveParts(ArchiveID archiveId);
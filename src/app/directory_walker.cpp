@@ -0,0 +1,341 @@
+#include "directory_walker.hpp"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#ifdef __linux__
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+namespace {
+using Entry = DirectoryWalker::Entry;
+using EntryType = DirectoryWalker::EntryType;
+using Listing = DirectoryWalker::Listing;
+
+#ifdef __linux__
+constexpr std::size_t DirectoryBufferSize = 64 * 1024;
+
+// The layout of the records returned by getdents64, which glibc doesn't
+// declare.
+struct LinuxDirectoryEntry {
+  std::uint64_t inode;
+  std::int64_t offset;
+  unsigned short recordLength;
+  unsigned char type;
+  char name[];
+};
+
+auto entryType(mode_t mode) -> EntryType {
+  if (S_ISREG(mode))
+    return EntryType::File;
+  if (S_ISDIR(mode))
+    return EntryType::Directory;
+  return EntryType::Other;
+}
+
+// Looks up the type of a file when it isn't known from the directory entry.
+// Files which can't be looked up, such as broken symlinks, are reported as
+// EntryType::Other.
+auto statType(int directory, const char* name, bool followSymlinks)
+  -> std::pair<EntryType, bool> {
+  const int noFollow = followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW;
+  struct statx status;
+  if (::statx(directory, name, noFollow | AT_STATX_DONT_SYNC, STATX_TYPE,
+              &status) == 0) {
+    return {entryType(status.stx_mode), S_ISLNK(status.stx_mode)};
+  }
+  if (errno == ENOSYS) {
+    struct stat fallbackStatus;
+    if (::fstatat(directory, name, &fallbackStatus, noFollow) == 0) {
+      return {entryType(fallbackStatus.st_mode),
+              S_ISLNK(fallbackStatus.st_mode)};
+    }
+  }
+  return {EntryType::Other, false};
+}
+
+// Returns the inode of a file, following symlinks, if it has more than one
+// hard link.
+auto findHardLink(int directory, const char* name)
+  -> std::optional<DirectoryWalker::Inode> {
+  struct statx status;
+  if (::statx(directory, name, AT_STATX_DONT_SYNC, STATX_NLINK | STATX_INO,
+              &status) == 0) {
+    if (status.stx_nlink < 2)
+      return std::nullopt;
+    return DirectoryWalker::Inode{
+      makedev(status.stx_dev_major, status.stx_dev_minor), status.stx_ino};
+  }
+  struct stat fallbackStatus;
+  if (errno != ENOSYS || ::fstatat(directory, name, &fallbackStatus, 0) != 0 ||
+      fallbackStatus.st_nlink < 2)
+    return std::nullopt;
+  return DirectoryWalker::Inode{
+    static_cast<std::uint64_t>(fallbackStatus.st_dev),
+    static_cast<std::uint64_t>(fallbackStatus.st_ino)};
+}
+
+// Returns the type of the entry, following symlinks, and whether it is a
+// symlink.
+auto classify(int directory, const LinuxDirectoryEntry& entry)
+  -> std::pair<EntryType, bool> {
+  switch (entry.type) {
+  case DT_REG:
+    return {EntryType::File, false};
+  case DT_DIR:
+    return {EntryType::Directory, false};
+  case DT_LNK:
+    return {statType(directory, entry.name, true).first, true};
+  case DT_UNKNOWN: {
+    // Some filesystems don't fill in the type, so it has to be looked up.
+    const auto [type, isSymlink] = statType(directory, entry.name, false);
+    if (isSymlink)
+      return {statType(directory, entry.name, true).first, true};
+    return {type, false};
+  }
+  default:
+    return {EntryType::Other, false};
+  }
+}
+#endif
+
+struct WalkState {
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::filesystem::path> directories;
+  };
+
+  explicit WalkState(std::size_t workerCount) : queues(workerCount) {}
+
+  std::vector<Queue> queues;
+
+  // Guards everything below.
+  std::mutex mutex;
+  std::condition_variable workAvailable;
+  std::condition_variable listingsAvailable;
+  // Directories sitting in a queue.
+  std::size_t queuedDirectories = 0;
+  // Directories which are queued or being listed, the walk is over once there
+  // are none left.
+  std::size_t unfinishedDirectories = 0;
+  std::deque<Listing> listings;
+  std::exception_ptr error;
+  bool stopped = false;
+
+  auto takeDirectory(std::size_t worker)
+    -> std::optional<std::filesystem::path>;
+  void runWorker(std::size_t worker);
+  void stop(std::exception_ptr stopError);
+};
+
+auto WalkState::takeDirectory(std::size_t worker)
+  -> std::optional<std::filesystem::path> {
+  std::optional<std::filesystem::path> directory;
+  {
+    auto& own = queues[worker];
+    std::lock_guard lock(own.mutex);
+    if (!own.directories.empty()) {
+      directory = std::move(own.directories.back());
+      own.directories.pop_back();
+    }
+  }
+  for (std::size_t i = 1; !directory && i < queues.size(); ++i) {
+    auto& victim = queues[(worker + i) % queues.size()];
+    std::lock_guard lock(victim.mutex);
+    if (!victim.directories.empty()) {
+      directory = std::move(victim.directories.front());
+      victim.directories.pop_front();
+    }
+  }
+
+  if (directory) {
+    std::lock_guard lock(mutex);
+    --queuedDirectories;
+  }
+  return directory;
+}
+
+void WalkState::runWorker(std::size_t worker) {
+  while (true) {
+    auto directory = takeDirectory(worker);
+    if (!directory) {
+      std::unique_lock lock(mutex);
+      workAvailable.wait(lock, [&]() {
+        return stopped || queuedDirectories > 0 || unfinishedDirectories == 0;
+      });
+      if (stopped || unfinishedDirectories == 0)
+        return;
+      continue;
+    }
+
+    try {
+      Listing listing{*directory, DirectoryWalker::list(*directory)};
+      std::vector<std::filesystem::path> subdirectories;
+      for (const auto& entry : listing.entries) {
+        if (entry.type == EntryType::Directory && !entry.isSymlink)
+          subdirectories.push_back(entry.path);
+      }
+
+      // The listing is published before its subdirectories are queued, so no
+      // subdirectory can be listed, and published, before it.
+      {
+        std::lock_guard lock(mutex);
+        if (stopped)
+          return;
+        listings.push_back(std::move(listing));
+      }
+      listingsAvailable.notify_one();
+
+      // The subdirectories are counted before they are queued, as another
+      // worker can take one, and finish it, as soon as it is queued.
+      {
+        std::lock_guard lock(mutex);
+        queuedDirectories += subdirectories.size();
+        unfinishedDirectories += subdirectories.size();
+      }
+      {
+        auto& own = queues[worker];
+        std::lock_guard lock(own.mutex);
+        for (auto& subdirectory : subdirectories)
+          own.directories.push_back(std::move(subdirectory));
+      }
+      {
+        std::lock_guard lock(mutex);
+        --unfinishedDirectories;
+      }
+      workAvailable.notify_all();
+      listingsAvailable.notify_one();
+    } catch (...) {
+      stop(std::current_exception());
+      return;
+    }
+  }
+}
+
+void WalkState::stop(std::exception_ptr stopError) {
+  {
+    std::lock_guard lock(mutex);
+    if (!error)
+      error = stopError;
+    stopped = true;
+  }
+  workAvailable.notify_all();
+  listingsAvailable.notify_all();
+}
+}
+
+DirectoryWalker::DirectoryWalker(std::size_t workerCount)
+  : workerCount(workerCount != 0
+                  ? workerCount
+                  : std::max(1u, std::thread::hardware_concurrency())) {}
+
+void DirectoryWalker::walk(const std::filesystem::path& root,
+                           const Visitor& visit) {
+  WalkState state{workerCount};
+  state.queues[0].directories.push_back(root);
+  state.queuedDirectories = 1;
+  state.unfinishedDirectories = 1;
+
+  std::vector<std::thread> workers;
+  for (std::size_t i = 0; i < workerCount; ++i)
+    workers.emplace_back([&state, i]() { state.runWorker(i); });
+
+  while (true) {
+    Listing listing;
+    {
+      std::unique_lock lock(state.mutex);
+      state.listingsAvailable.wait(lock, [&]() {
+        return !state.listings.empty() || state.unfinishedDirectories == 0 ||
+               state.stopped;
+      });
+      if (state.stopped || state.listings.empty())
+        break;
+      listing = std::move(state.listings.front());
+      state.listings.pop_front();
+    }
+
+    try {
+      visit(std::move(listing));
+    } catch (...) {
+      state.stop(std::current_exception());
+      break;
+    }
+  }
+
+  for (auto& worker : workers)
+    worker.join();
+  if (state.error)
+    std::rethrow_exception(state.error);
+}
+
+#ifdef __linux__
+auto DirectoryWalker::list(const std::filesystem::path& directory)
+  -> std::vector<Entry> {
+  const int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    throw DirectoryWalkerException(
+      "There was an error opening the directory \"{}\": {}", directory,
+      std::error_code(errno, std::system_category()).message());
+  }
+
+  std::vector<Entry> entries;
+  alignas(LinuxDirectoryEntry) char buffer[DirectoryBufferSize];
+  while (true) {
+    const auto read = ::syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+    if (read < 0) {
+      if (errno == EINTR)
+        continue;
+      const auto error = errno;
+      ::close(fd);
+      throw DirectoryWalkerException(
+        "There was an error reading the directory \"{}\": {}", directory,
+        std::error_code(error, std::system_category()).message());
+    }
+    if (read == 0)
+      break;
+
+    for (long offset = 0; offset < read;) {
+      const auto& entry =
+        *reinterpret_cast<const LinuxDirectoryEntry*>(buffer + offset);
+      offset += entry.recordLength;
+
+      const std::string_view name = entry.name;
+      if (name == "." || name == "..")
+        continue;
+      const auto [type, isSymlink] = classify(fd, entry);
+      entries.push_back({directory / name, type, isSymlink,
+                         type == EntryType::File ? findHardLink(fd, entry.name)
+                                                 : std::nullopt});
+    }
+  }
+  ::close(fd);
+  return entries;
+}
+#else
+auto DirectoryWalker::list(const std::filesystem::path& directory)
+  -> std::vector<Entry> {
+  std::vector<Entry> entries;
+  try {
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+      const auto type = entry.is_regular_file() ? EntryType::File
+                        : entry.is_directory()  ? EntryType::Directory
+                                                : EntryType::Other;
+      entries.push_back({entry.path(), type, entry.is_symlink()});
+    }
+  } catch (const std::filesystem::filesystem_error& err) {
+    throw DirectoryWalkerException(
+      "There was an error reading the directory \"{}\": {}", directory,
+      err.what());
+  }
+  return entries;
+}
+#endif
@@ -0,0 +1,67 @@
+#ifndef ARCHIVER_DIRECTORY_WALKER_HPP
+#define ARCHIVER_DIRECTORY_WALKER_HPP
+
+#include "common.h"
+#include <compare>
+#include <functional>
+#include <optional>
+
+// Lists a directory tree using a pool of worker threads. Each worker keeps its
+// own deque of directories still to be listed, working depth first from the
+// back of it and stealing from the front of another worker's deque when its
+// own runs out. The listings are handed back to the calling thread, a
+// directory's listing always before the listings of its subdirectories.
+//
+// Like std::filesystem::recursive_directory_iterator, symlinks to directories
+// are listed as directories but are not descended into.
+class DirectoryWalker {
+public:
+  enum class EntryType { File, Directory, Other };
+  struct Inode {
+    std::uint64_t device;
+    std::uint64_t inode;
+
+    friend auto operator<=>(const Inode&, const Inode&) = default;
+  };
+  struct Entry {
+    std::filesystem::path path;
+    // The type of the file the entry refers to, following symlinks.
+    EntryType type;
+    bool isSymlink;
+    // Only set for a file with more than one hard link, so the entries which
+    // are links to the same file can be found. Following symlinks.
+    std::optional<Inode> hardLink = std::nullopt;
+  };
+  struct Listing {
+    std::filesystem::path directory;
+    std::vector<Entry> entries;
+  };
+  using Visitor = std::function<void(Listing&&)>;
+
+  // A worker count of 0 uses one worker per hardware thread.
+  explicit DirectoryWalker(std::size_t workerCount);
+
+  // Calls visit, on the calling thread, with the listing of root and of every
+  // directory below it. An exception thrown while listing a directory, or by
+  // visit, stops the walk and is rethrown once the workers have finished.
+  void walk(const std::filesystem::path& root, const Visitor& visit);
+
+  // Lists a single directory, skipping the "." and ".." entries.
+  static auto list(const std::filesystem::path& directory)
+    -> std::vector<Entry>;
+
+  DirectoryWalker() = delete;
+  DirectoryWalker(const DirectoryWalker&) = delete;
+  DirectoryWalker(DirectoryWalker&&) = default;
+  ~DirectoryWalker() = default;
+
+  DirectoryWalker& operator=(const DirectoryWalker&) = delete;
+  DirectoryWalker& operator=(DirectoryWalker&&) = default;
+
+private:
+  std::size_t workerCount;
+};
+
+_make_exception_(DirectoryWalkerException);
+
+#endif
@@ -0,0 +1,73 @@
+#include "file_hash.hpp"
+#include "util/hex_string.hpp"
+#include <algorithm>
+
+namespace {
+auto hexDigitValue(char digit) -> std::optional<std::uint8_t> {
+  if (digit >= '0' && digit <= '9')
+    return static_cast<std::uint8_t>(digit - '0');
+  if (digit >= 'a' && digit <= 'f')
+    return static_cast<std::uint8_t>(digit - 'a' + 10);
+  if (digit >= 'A' && digit <= 'F')
+    return static_cast<std::uint8_t>(digit - 'A' + 10);
+  return std::nullopt;
+}
+}
+
+FileHash::FileHash(std::span<const std::uint8_t, Sha3Size> sha3,
+                   std::span<const std::uint8_t, Blake2bSize> blake2b) {
+  std::ranges::copy(sha3, bytes.begin());
+  std::ranges::copy(blake2b, bytes.begin() + Sha3Size);
+}
+
+auto FileHash::fromBytes(std::span<const std::uint8_t> bytes) -> FileHash {
+  if (bytes.size() != Size) {
+    throw FileHashException("A file hash must be {} bytes long, not {}", Size,
+                            bytes.size());
+  }
+  FileHash hash;
+  std::ranges::copy(bytes, hash.bytes.begin());
+  return hash;
+}
+
+auto FileHash::fromHexString(std::string_view hex) -> FileHash {
+  if (hex.size() != 2 * Size) {
+    throw FileHashException("A file hash must be {} hex digits long, not {}",
+                            2 * Size, hex.size());
+  }
+  FileHash hash;
+  for (std::size_t i = 0; i < Size; ++i) {
+    const auto high = hexDigitValue(hex[2 * i]);
+    const auto low = hexDigitValue(hex[2 * i + 1]);
+    if (!high || !low) {
+      throw FileHashException("The file hash \"{}\" is not a hex string", hex);
+    }
+    hash.bytes[i] = static_cast<std::uint8_t>(*high << 4 | *low);
+  }
+  return hash;
+}
+
+auto FileHash::toHexString() const -> std::string {
+  return ::toHexString(bytes);
+}
+
+auto FastHash::fromBytes(std::span<const std::uint8_t> bytes) -> FastHash {
+  if (bytes.size() != Size) {
+    throw FileHashException("A fast hash must be {} bytes long, not {}", Size,
+                            bytes.size());
+  }
+  FastHash hash;
+  std::ranges::copy(bytes, hash.bytes.begin());
+  return hash;
+}
+
+auto FastHash::toHexString() const -> std::string {
+  return ::toHexString(bytes);
+}
+
+auto operator<<(std::ostream& stream, const FileHash& hash) -> std::ostream& {
+  return stream << hash.toHexString();
+}
+auto operator<<(std::ostream& stream, const FastHash& hash) -> std::ostream& {
+  return stream << hash.toHexString();
+}
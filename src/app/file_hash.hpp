@@ -0,0 +1,79 @@
+#ifndef ARCHIVER_FILE_HASH_HPP
+#define ARCHIVER_FILE_HASH_HPP
+
+#include "common.h"
+#include <array>
+#include <compare>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+_make_exception_(FileHashException);
+
+// The content hash of a file, the SHA3-512 digest followed by the BLAKE2b
+// digest. It is stored in binary, at half the size of its hex string form.
+struct FileHash {
+  static constexpr std::size_t Sha3Size = 64;
+  static constexpr std::size_t Blake2bSize = 64;
+  static constexpr std::size_t Size = Sha3Size + Blake2bSize;
+
+  std::array<std::uint8_t, Size> bytes{};
+
+  FileHash() = default;
+  FileHash(std::span<const std::uint8_t, Sha3Size> sha3,
+           std::span<const std::uint8_t, Blake2bSize> blake2b);
+
+  // Throws FileHashException if bytes isn't exactly Size bytes long.
+  static auto fromBytes(std::span<const std::uint8_t> bytes) -> FileHash;
+  // Throws FileHashException if hex isn't 2 * Size hex digits.
+  static auto fromHexString(std::string_view hex) -> FileHash;
+
+  auto toHexString() const -> std::string;
+
+  friend auto operator<=>(const FileHash&, const FileHash&) = default;
+};
+
+// The XXH3-128 digest of a file. Files with different fast hashes have
+// different contents, but files with the same fast hash are only known to have
+// the same contents once their FileHashes are compared.
+struct FastHash {
+  static constexpr std::size_t Size = 16;
+
+  std::array<std::uint8_t, Size> bytes{};
+
+  // Throws FileHashException if bytes isn't exactly Size bytes long.
+  static auto fromBytes(std::span<const std::uint8_t> bytes) -> FastHash;
+
+  auto toHexString() const -> std::string;
+
+  friend auto operator<=>(const FastHash&, const FastHash&) = default;
+};
+
+// How the hashes of a file were computed from its contents. Large files are
+// hashed as a tree so they can be hashed by many threads at once, see
+// tree_hash.hpp. The values are stored in the database.
+enum class HashAlgorithm : std::uint8_t { Linear = 0, Tree = 1 };
+
+auto operator<<(std::ostream& stream, const FileHash& hash) -> std::ostream&;
+auto operator<<(std::ostream& stream, const FastHash& hash) -> std::ostream&;
+
+template <typename CharT>
+struct FORMAT_LIB::formatter<FileHash, CharT>
+  : public FORMAT_LIB::formatter<std::string, CharT> {
+  template <typename FormatContext>
+  auto format(const FileHash& hash, FormatContext& fc) {
+    return FORMAT_LIB::formatter<std::string, CharT>::format(
+      hash.toHexString(), fc);
+  };
+};
+template <typename CharT>
+struct FORMAT_LIB::formatter<FastHash, CharT>
+  : public FORMAT_LIB::formatter<std::string, CharT> {
+  template <typename FormatContext>
+  auto format(const FastHash& hash, FormatContext& fc) {
+    return FORMAT_LIB::formatter<std::string, CharT>::format(
+      hash.toHexString(), fc);
+  };
+};
+
+#endif
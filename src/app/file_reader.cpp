@@ -0,0 +1,138 @@
+#include "file_reader.hpp"
+#include "io_mode.hpp"
+#include "raw_file.hpp"
+#include <cstring>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+auto isAllZeros(std::span<const char> data) -> bool {
+  return std::ranges::all_of(data, [](char byte) { return byte == 0; });
+}
+
+#ifdef __linux__
+auto findData(int fd, std::uint64_t offset, std::uint64_t end)
+  -> std::optional<DataSegment> {
+  if (offset >= end)
+    return std::nullopt;
+  const auto data = ::lseek(fd, static_cast<off_t>(offset), SEEK_DATA);
+  if (data < 0) {
+    // ENXIO means there is no more data after offset, any other error means
+    // the filesystem doesn't support finding it.
+    if (errno == ENXIO)
+      return std::nullopt;
+    return DataSegment{offset, end};
+  }
+  const auto dataStart = static_cast<std::uint64_t>(data);
+  if (dataStart >= end)
+    return std::nullopt;
+  const auto hole = ::lseek(fd, data, SEEK_HOLE);
+  if (hole < 0)
+    return DataSegment{dataStart, end};
+  return DataSegment{dataStart,
+                     std::min(end, static_cast<std::uint64_t>(hole))};
+}
+
+FileReader::FileReader(const std::filesystem::path& path) : path(path) {
+  fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw FileException("There was an error opening \"{}\" for reading", path);
+  struct stat status;
+  if (::fstat(fd, &status) != 0) {
+    ::close(fd);
+    throw FileException("There was an error reading the status of \"{}\"",
+                        path);
+  }
+  fileSize = static_cast<std::uint64_t>(status.st_size);
+  sparse = static_cast<std::uint64_t>(status.st_blocks) * 512 < fileSize;
+  directFd = openDirect(path.c_str(), O_RDONLY);
+}
+
+FileReader::~FileReader() {
+  ::close(fd);
+  if (directFd >= 0)
+    ::close(directFd);
+}
+
+auto FileReader::read(std::span<char> chunk, std::uint64_t offset)
+  -> std::size_t {
+  if (offset >= fileSize)
+    return 0;
+  auto end = std::min<std::uint64_t>(fileSize, offset + chunk.size());
+  std::size_t filled = 0;
+  while (offset + filled < end) {
+    const auto position = offset + filled;
+    const auto segment = findData(fd, position, end);
+    if (!segment) {
+      // A file which got shorter looks like it ends in a hole.
+      struct stat status;
+      if (::fstat(fd, &status) != 0)
+        throw FileException("There was an error reading \"{}\"", path);
+      end = std::clamp<std::uint64_t>(
+        static_cast<std::uint64_t>(status.st_size), position, end);
+    }
+
+    const auto holeEnd = segment ? segment->start : end;
+    std::memset(chunk.data() + filled, 0,
+                static_cast<std::size_t>(holeEnd - position));
+    filled += static_cast<std::size_t>(holeEnd - position);
+    if (!segment)
+      break;
+
+    while (offset + filled < segment->end) {
+      const auto position = offset + filled;
+      const auto size = static_cast<std::size_t>(segment->end - position);
+      // O_DIRECT can only read whole blocks, so the end of the file is read
+      // as a whole block if the chunk has room for it.
+      const auto directSize = (size + DirectIoAlignment - 1) /
+                              DirectIoAlignment * DirectIoAlignment;
+      const auto direct =
+        directFd >= 0 && filled + directSize <= chunk.size() &&
+        isDirectIoAligned(chunk.data() + filled, directSize, position);
+      const auto result =
+        ::pread(direct ? directFd : fd, chunk.data() + filled,
+                direct ? directSize : size, static_cast<off_t>(position));
+      if (result < 0 && errno == EINTR)
+        continue;
+      if (result < 0)
+        throw FileException("There was an error reading \"{}\"", path);
+      if (result == 0)
+        break;
+      filled += std::min(size, static_cast<std::size_t>(result));
+    }
+    if (offset + filled < segment->end)
+      break;
+  }
+  dropReadPages(fd, offset, filled);
+  return filled;
+}
+#else
+FileReader::FileReader(const std::filesystem::path& path)
+  : path(path), stream(path, std::ios_base::binary) {
+  if (!stream.is_open())
+    throw FileException("There was an error opening \"{}\" for reading", path);
+  fileSize = std::filesystem::file_size(path);
+}
+
+FileReader::~FileReader() = default;
+
+// Without positioned reads the threads take turns to seek and read.
+auto FileReader::read(std::span<char> chunk, std::uint64_t offset)
+  -> std::size_t {
+  if (offset >= fileSize)
+    return 0;
+  const auto size = static_cast<std::size_t>(
+    std::min<std::uint64_t>(chunk.size(), fileSize - offset));
+  std::lock_guard lock(mutex);
+  stream.clear();
+  stream.seekg(static_cast<std::streamoff>(offset));
+  stream.read(chunk.data(), static_cast<std::streamsize>(size));
+  if (stream.bad())
+    throw FileException("There was an error reading \"{}\"", path);
+  return static_cast<std::size_t>(stream.gcount());
+}
+#endif
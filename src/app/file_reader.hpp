@@ -0,0 +1,93 @@
+#ifndef ARCHIVER_FILE_READER_HPP
+#define ARCHIVER_FILE_READER_HPP
+
+#include "common.h"
+#include <algorithm>
+#include <optional>
+#include <span>
+
+#ifndef __linux__
+#include <fstream>
+#include <mutex>
+#endif
+
+// Reads a file from any offset, from any number of threads at once. The holes
+// of a sparse file are filled with zeros without being read, so reading it
+// costs about as much as its allocated size rather than its size. Only the
+// size of the file when it was opened is read, even if it grows after. Reads
+// use the page cache as the io mode says.
+class FileReader {
+public:
+  explicit FileReader(const std::filesystem::path& path);
+  ~FileReader();
+
+  // Fills as much of chunk as it can, only reading fewer bytes at the end of
+  // the file. Throws FileException if the file can't be read.
+  auto read(std::span<char> chunk, std::uint64_t offset) -> std::size_t;
+
+  auto size() const -> std::uint64_t { return fileSize; }
+  // Whether the file has fewer blocks allocated than its size needs, which
+  // means it has holes.
+  auto isSparse() const -> bool { return sparse; }
+
+  FileReader() = delete;
+  FileReader(const FileReader&) = delete;
+  FileReader(FileReader&&) = delete;
+
+  FileReader& operator=(const FileReader&) = delete;
+  FileReader& operator=(FileReader&&) = delete;
+
+private:
+  std::filesystem::path path;
+  std::uint64_t fileSize = 0;
+  bool sparse = false;
+#ifdef __linux__
+  int fd = -1;
+  // A second descriptor opened with O_DIRECT, used for aligned reads if the
+  // io mode is Direct.
+  int directFd = -1;
+#else
+  std::mutex mutex;
+  std::ifstream stream;
+#endif
+};
+
+#ifdef __linux__
+// A range of a file which holds data, from start up to end.
+struct DataSegment {
+  std::uint64_t start;
+  std::uint64_t end;
+};
+
+// Finds the first data in the open file from offset, limited to before end.
+// Returns std::nullopt if there is only a hole from offset to end. If the
+// filesystem can't report holes the whole range is data.
+auto findData(int fd, std::uint64_t offset, std::uint64_t end)
+  -> std::optional<DataSegment>;
+#endif
+
+auto isAllZeros(std::span<const char> data) -> bool;
+
+// Splits data into runs of blocks which are all zeros and runs of blocks which
+// aren't, and calls function(run, isZeros) for each of them in order. Only the
+// last block can be shorter than blockSize.
+template <typename Function>
+void forEachZeroRun(std::span<const char> data, std::size_t blockSize,
+                    Function&& function) {
+  std::size_t runStart = 0;
+  bool runIsZeros = false;
+  for (std::size_t offset = 0; offset < data.size(); offset += blockSize) {
+    const auto block =
+      data.subspan(offset, std::min(blockSize, data.size() - offset));
+    const auto blockIsZeros = isAllZeros(block);
+    if (offset != 0 && blockIsZeros != runIsZeros) {
+      function(data.subspan(runStart, offset - runStart), runIsZeros);
+      runStart = offset;
+    }
+    runIsZeros = blockIsZeros;
+  }
+  if (runStart < data.size())
+    function(data.subspan(runStart), runIsZeros);
+}
+
+#endif
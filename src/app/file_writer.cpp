@@ -0,0 +1,101 @@
+#include "file_writer.hpp"
+#include "io_mode.hpp"
+#include "raw_file.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+FileWriter::FileWriter(const std::filesystem::path& path)
+  : path(path), ownsFd(true) {
+  fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (fd < 0)
+    throw FileException("There was an error opening \"{}\" for writing", path);
+  directFd = openDirect(path.c_str(), O_WRONLY);
+}
+
+FileWriter::FileWriter(const std::filesystem::path& path, int fd)
+  : path(path), fd(fd) {
+  directFd = openDirect(path.c_str(), O_WRONLY);
+}
+
+FileWriter::~FileWriter() {
+  if (directFd >= 0)
+    ::close(directFd);
+  if (ownsFd && fd >= 0)
+    ::close(fd);
+}
+
+void FileWriter::write(std::span<const char> data, std::uint64_t offset) {
+  const auto direct = directFd >= 0 && isDirectIoAligned(data.data(),
+                                                         data.size(), offset);
+  for (std::size_t written = 0; written < data.size();) {
+    const auto result =
+      ::pwrite(direct ? directFd : fd, data.data() + written,
+               data.size() - written, static_cast<off_t>(offset + written));
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result < 0)
+      throw FileException("There was an error writing \"{}\"", path);
+    written += static_cast<std::size_t>(result);
+  }
+
+  if (ioMode() != IoMode::DontNeed || data.empty())
+    return;
+  // Writing back this range starts now, and is waited on after the next
+  // write so the two overlap.
+  ::sync_file_range(fd, static_cast<off_t>(offset),
+                    static_cast<off_t>(data.size()), SYNC_FILE_RANGE_WRITE);
+  if (lastWrite)
+    dropWrittenPages(*lastWrite);
+  lastWrite = Range{offset, data.size()};
+}
+
+void FileWriter::finish(std::uint64_t size) {
+  if (lastWrite)
+    dropWrittenPages(*lastWrite);
+  lastWrite.reset();
+
+  if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+    throw FileException("There was an error writing \"{}\"", path);
+  if (ownsFd) {
+    const auto result = ::close(fd);
+    fd = -1;
+    if (result != 0)
+      throw FileException("There was an error writing \"{}\"", path);
+  }
+}
+
+void FileWriter::dropWrittenPages(Range range) {
+  ::sync_file_range(fd, static_cast<off_t>(range.offset),
+                    static_cast<off_t>(range.size),
+                    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                      SYNC_FILE_RANGE_WAIT_AFTER);
+  ::posix_fadvise(fd, static_cast<off_t>(range.offset),
+                  static_cast<off_t>(range.size), POSIX_FADV_DONTNEED);
+}
+#else
+FileWriter::FileWriter(const std::filesystem::path& path)
+  : path(path),
+    stream(path, std::ios_base::binary | std::ios_base::trunc) {
+  if (!stream.is_open())
+    throw FileException("There was an error opening \"{}\" for writing", path);
+}
+
+FileWriter::~FileWriter() = default;
+
+void FileWriter::write(std::span<const char> data, std::uint64_t offset) {
+  stream.seekp(static_cast<std::streamoff>(offset));
+  stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+  if (stream.bad())
+    throw FileException("There was an error writing \"{}\"", path);
+}
+
+void FileWriter::finish(std::uint64_t size) {
+  stream.close();
+  if (stream.fail())
+    throw FileException("There was an error writing \"{}\"", path);
+  std::filesystem::resize_file(path, size);
+}
+#endif
@@ -0,0 +1,60 @@
+#ifndef ARCHIVER_FILE_WRITER_HPP
+#define ARCHIVER_FILE_WRITER_HPP
+
+#include "common.h"
+#include <optional>
+#include <span>
+
+#ifndef __linux__
+#include <fstream>
+#endif
+
+// Writes the contents of a file, using the page cache as the io mode says.
+// Under DontNeed each write is flushed and dropped from the page cache once
+// the next one has been made, as dirty pages can't be dropped.
+class FileWriter {
+public:
+  // Creates the file at path, truncating it if it already exists.
+  explicit FileWriter(const std::filesystem::path& path);
+#ifdef __linux__
+  // Writes to the open file fd, which the writer doesn't close.
+  FileWriter(const std::filesystem::path& path, int fd);
+#endif
+  ~FileWriter();
+
+  // Throws FileException if the data can't be written.
+  void write(std::span<const char> data, std::uint64_t offset);
+  // Sets the size of the file, which leaves a hole at the end if it is past
+  // the end of the last write, and closes the file if the writer opened it.
+  // Throws FileException if any of the data wasn't written.
+  void finish(std::uint64_t size);
+
+  FileWriter() = delete;
+  FileWriter(const FileWriter&) = delete;
+  FileWriter(FileWriter&&) = delete;
+
+  FileWriter& operator=(const FileWriter&) = delete;
+  FileWriter& operator=(FileWriter&&) = delete;
+
+private:
+  std::filesystem::path path;
+#ifdef __linux__
+  struct Range {
+    std::uint64_t offset;
+    std::uint64_t size;
+  };
+  void dropWrittenPages(Range range);
+
+  int fd = -1;
+  bool ownsFd = false;
+  // A second descriptor opened with O_DIRECT, used for aligned writes if the
+  // io mode is Direct.
+  int directFd = -1;
+  // The last write, which is still being flushed under DontNeed.
+  std::optional<Range> lastWrite;
+#else
+  std::ofstream stream;
+#endif
+};
+
+#endif
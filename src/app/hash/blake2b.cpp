@@ -0,0 +1,256 @@
+#include "blake2b.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef ARCHIVER_HASH_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace hash {
+namespace {
+constexpr std::array<std::uint64_t, 8> InitialVector = {
+  0x6A09E667F3BCC908, 0xBB67AE8584CAA73B, 0x3C6EF372FE94F82B,
+  0xA54FF53A5F1D36F1, 0x510E527FADE682D1, 0x9B05688C2B3E6C1F,
+  0x1F83D9ABFB41BD6B, 0x5BE0CD19137E2179};
+
+constexpr std::uint8_t Sigma[12][16] = {
+  {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+  {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+  {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+  {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+  {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+  {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+  {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+  {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+  {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+  {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+  {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+  {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3}};
+
+auto loadWords(const std::uint8_t* block, std::uint64_t* m) {
+  std::memcpy(m, block, 16 * sizeof(std::uint64_t));
+  if constexpr (std::endian::native == std::endian::big) {
+    for (int i = 0; i < 16; ++i) {
+      std::uint64_t swapped = 0;
+      for (int b = 0; b < 8; ++b)
+        swapped |= ((m[i] >> (8 * b)) & 0xFF) << (56 - 8 * b);
+      m[i] = swapped;
+    }
+  }
+}
+
+void advanceCounter(std::uint64_t* counter, std::uint64_t increment) {
+  counter[0] += increment;
+  if (counter[0] < increment)
+    ++counter[1];
+}
+
+void compressPortable(std::uint64_t* h, std::uint64_t* counter,
+                      const std::uint8_t* blocks, std::size_t blockCount,
+                      std::uint64_t increment, bool isFinal) {
+  for (std::size_t block = 0; block < blockCount; ++block) {
+    advanceCounter(counter, increment);
+
+    std::uint64_t m[16];
+    loadWords(blocks, m);
+    blocks += 128;
+
+    std::uint64_t v[16];
+    std::copy_n(h, 8, v);
+    std::copy_n(InitialVector.begin(), 8, v + 8);
+    v[12] ^= counter[0];
+    v[13] ^= counter[1];
+    if (isFinal && block + 1 == blockCount)
+      v[14] = ~v[14];
+
+    const auto g = [&v](int a, int b, int c, int d, std::uint64_t x,
+                        std::uint64_t y) {
+      v[a] = v[a] + v[b] + x;
+      v[d] = std::rotr(v[d] ^ v[a], 32);
+      v[c] = v[c] + v[d];
+      v[b] = std::rotr(v[b] ^ v[c], 24);
+      v[a] = v[a] + v[b] + y;
+      v[d] = std::rotr(v[d] ^ v[a], 16);
+      v[c] = v[c] + v[d];
+      v[b] = std::rotr(v[b] ^ v[c], 63);
+    };
+
+    for (const auto& s : Sigma) {
+      g(0, 4, 8, 12, m[s[0]], m[s[1]]);
+      g(1, 5, 9, 13, m[s[2]], m[s[3]]);
+      g(2, 6, 10, 14, m[s[4]], m[s[5]]);
+      g(3, 7, 11, 15, m[s[6]], m[s[7]]);
+      g(0, 5, 10, 15, m[s[8]], m[s[9]]);
+      g(1, 6, 11, 12, m[s[10]], m[s[11]]);
+      g(2, 7, 8, 13, m[s[12]], m[s[13]]);
+      g(3, 4, 9, 14, m[s[14]], m[s[15]]);
+    }
+
+    for (int i = 0; i < 8; ++i)
+      h[i] ^= v[i] ^ v[i + 8];
+  }
+}
+
+#ifdef ARCHIVER_HASH_X86_KERNELS
+struct Avx2Rows {
+  __m256i a;
+  __m256i b;
+  __m256i c;
+  __m256i d;
+};
+
+ARCHIVER_HASH_TARGET("avx2")
+inline void gAvx2(Avx2Rows& v, const std::uint64_t* m, const std::uint8_t* s) {
+  const auto rotate16 = _mm256_setr_epi8(
+    2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9, 2, 3, 4, 5, 6, 7, 0,
+    1, 10, 11, 12, 13, 14, 15, 8, 9);
+  const auto rotate24 = _mm256_setr_epi8(
+    3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10, 3, 4, 5, 6, 7, 0, 1,
+    2, 11, 12, 13, 14, 15, 8, 9, 10);
+  const auto x = _mm256_setr_epi64x(
+    static_cast<long long>(m[s[0]]), static_cast<long long>(m[s[2]]),
+    static_cast<long long>(m[s[4]]), static_cast<long long>(m[s[6]]));
+  const auto y = _mm256_setr_epi64x(
+    static_cast<long long>(m[s[1]]), static_cast<long long>(m[s[3]]),
+    static_cast<long long>(m[s[5]]), static_cast<long long>(m[s[7]]));
+
+  v.a = _mm256_add_epi64(_mm256_add_epi64(v.a, v.b), x);
+  v.d = _mm256_shuffle_epi32(_mm256_xor_si256(v.d, v.a), 0xB1);
+  v.c = _mm256_add_epi64(v.c, v.d);
+  v.b = _mm256_shuffle_epi8(_mm256_xor_si256(v.b, v.c), rotate24);
+  v.a = _mm256_add_epi64(_mm256_add_epi64(v.a, v.b), y);
+  v.d = _mm256_shuffle_epi8(_mm256_xor_si256(v.d, v.a), rotate16);
+  v.c = _mm256_add_epi64(v.c, v.d);
+  v.b = _mm256_xor_si256(v.b, v.c);
+  v.b = _mm256_xor_si256(_mm256_srli_epi64(v.b, 63), _mm256_add_epi64(v.b, v.b));
+}
+
+// The four rows of the working state each fit in a ymm register, so a round
+// runs the four column G functions at once, rotates the rows to line up the
+// diagonals, and runs the four diagonal G functions at once.
+ARCHIVER_HASH_TARGET("avx2")
+void compressAvx2(std::uint64_t* h, std::uint64_t* counter,
+                  const std::uint8_t* blocks, std::size_t blockCount,
+                  std::uint64_t increment, bool isFinal) {
+  auto h0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h));
+  auto h1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h + 4));
+  const auto iv0 =
+    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(InitialVector.data()));
+  const auto iv1 = _mm256_loadu_si256(
+    reinterpret_cast<const __m256i*>(InitialVector.data() + 4));
+
+  for (std::size_t block = 0; block < blockCount; ++block) {
+    advanceCounter(counter, increment);
+
+    std::uint64_t m[16];
+    loadWords(blocks, m);
+    blocks += 128;
+
+    const bool finalBlock = isFinal && block + 1 == blockCount;
+    Avx2Rows v{h0, h1, iv0,
+               _mm256_xor_si256(
+                 iv1, _mm256_setr_epi64x(static_cast<long long>(counter[0]),
+                                         static_cast<long long>(counter[1]),
+                                         finalBlock ? -1LL : 0LL, 0))};
+
+    for (const auto& s : Sigma) {
+      gAvx2(v, m, s);
+      v.b = _mm256_permute4x64_epi64(v.b, 0x39);
+      v.c = _mm256_permute4x64_epi64(v.c, 0x4E);
+      v.d = _mm256_permute4x64_epi64(v.d, 0x93);
+      gAvx2(v, m, s + 8);
+      v.b = _mm256_permute4x64_epi64(v.b, 0x93);
+      v.c = _mm256_permute4x64_epi64(v.c, 0x4E);
+      v.d = _mm256_permute4x64_epi64(v.d, 0x39);
+    }
+
+    h0 = _mm256_xor_si256(h0, _mm256_xor_si256(v.a, v.c));
+    h1 = _mm256_xor_si256(h1, _mm256_xor_si256(v.b, v.d));
+  }
+
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(h), h0);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(h + 4), h1);
+}
+#endif
+
+auto getCompressFunction(Kernel kernel) {
+  switch (kernel) {
+  case Kernel::Portable:
+    return &compressPortable;
+#ifdef ARCHIVER_HASH_X86_KERNELS
+  case Kernel::Avx2:
+    if (isKernelSupported(kernel))
+      return &compressAvx2;
+    break;
+#endif
+  default:
+    break;
+  }
+  throw std::logic_error("The requested BLAKE2b kernel is not available");
+}
+}
+
+Blake2b::Blake2b(Kernel kernel)
+    : compress(getCompressFunction(kernel)), h(InitialVector) {
+  // Parameter block for an unkeyed, sequential hash with a 64 byte digest.
+  h[0] ^= 0x01010000 ^ DigestSize;
+}
+
+void Blake2b::addData(const void* data, std::size_t size) {
+  auto bytes = static_cast<const std::uint8_t*>(data);
+  if (size == 0)
+    return;
+
+  // The last block has to be compressed with the final flag set, so a full
+  // buffer is only compressed once more data is known to follow it.
+  if (bufferSize > 0) {
+    const auto toCopy = std::min(size, BlockSize - bufferSize);
+    std::copy_n(bytes, toCopy, buffer.data() + bufferSize);
+    bufferSize += toCopy;
+    bytes += toCopy;
+    size -= toCopy;
+    if (size == 0)
+      return;
+    compress(h.data(), counter.data(), buffer.data(), 1, BlockSize, false);
+    bufferSize = 0;
+  }
+
+  const auto blockCount = (size - 1) / BlockSize;
+  if (blockCount > 0) {
+    compress(h.data(), counter.data(), bytes, blockCount, BlockSize, false);
+    bytes += blockCount * BlockSize;
+    size -= blockCount * BlockSize;
+  }
+
+  std::copy_n(bytes, size, buffer.data());
+  bufferSize = size;
+}
+
+auto Blake2b::finalize() -> Digest {
+  std::fill(buffer.begin() + static_cast<std::ptrdiff_t>(bufferSize),
+            buffer.end(), std::uint8_t{0});
+  compress(h.data(), counter.data(), buffer.data(), 1, bufferSize, true);
+  bufferSize = 0;
+
+  Digest digest;
+  for (std::size_t i = 0; i < DigestSize; ++i)
+    digest[i] = static_cast<std::uint8_t>(h[i / 8] >> (8 * (i % 8)));
+  return digest;
+}
+
+auto Blake2b::defaultKernel() -> Kernel {
+  static const Kernel kernel = availableKernels().back();
+  return kernel;
+}
+
+auto Blake2b::availableKernels() -> std::vector<Kernel> {
+  std::vector<Kernel> kernels = {Kernel::Portable};
+#ifdef ARCHIVER_HASH_X86_KERNELS
+  if (isKernelSupported(Kernel::Avx2))
+    kernels.push_back(Kernel::Avx2);
+#endif
+  return kernels;
+}
+}
@@ -0,0 +1,43 @@
+#ifndef ARCHIVER_HASH_BLAKE2B_HPP
+#define ARCHIVER_HASH_BLAKE2B_HPP
+
+#include "kernel.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hash {
+class Blake2b {
+public:
+  static constexpr std::size_t DigestSize = 64;
+  using Digest = std::array<std::uint8_t, DigestSize>;
+
+  explicit Blake2b(Kernel kernel = defaultKernel());
+
+  void addData(const void* data, std::size_t size);
+  auto finalize() -> Digest;
+
+  // The fastest kernel available on the running CPU, chosen the first time it
+  // is requested.
+  static auto defaultKernel() -> Kernel;
+  static auto availableKernels() -> std::vector<Kernel>;
+
+private:
+  static constexpr std::size_t BlockSize = 128;
+  // Compresses blockCount consecutive blocks, advancing the byte counter by
+  // increment before each one. The final flag only applies to the last block.
+  using CompressFunction = void (*)(std::uint64_t* h, std::uint64_t* counter,
+                                    const std::uint8_t* blocks,
+                                    std::size_t blockCount,
+                                    std::uint64_t increment, bool isFinal);
+
+  CompressFunction compress;
+  std::array<std::uint64_t, 8> h;
+  std::array<std::uint64_t, 2> counter{};
+  std::array<std::uint8_t, BlockSize> buffer{};
+  std::size_t bufferSize = 0;
+};
+}
+
+#endif
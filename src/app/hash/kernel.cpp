@@ -0,0 +1,32 @@
+#include "kernel.hpp"
+
+namespace hash {
+auto kernelName(Kernel kernel) -> std::string_view {
+  switch (kernel) {
+  case Kernel::Portable:
+    return "portable";
+  case Kernel::Avx2:
+    return "avx2";
+  case Kernel::Avx512:
+    return "avx512";
+  }
+  return "unknown";
+}
+
+auto isKernelSupported(Kernel kernel) -> bool {
+#ifdef ARCHIVER_HASH_X86_KERNELS
+  __builtin_cpu_init();
+  switch (kernel) {
+  case Kernel::Portable:
+    return true;
+  case Kernel::Avx2:
+    return __builtin_cpu_supports("avx2");
+  case Kernel::Avx512:
+    return __builtin_cpu_supports("avx512f");
+  }
+  return false;
+#else
+  return kernel == Kernel::Portable;
+#endif
+}
+}
@@ -0,0 +1,27 @@
+#ifndef ARCHIVER_HASH_KERNEL_HPP
+#define ARCHIVER_HASH_KERNEL_HPP
+
+#include <string_view>
+
+// The vectorized kernels are written with compiler intrinsics and enabled per
+// function through target attributes, so the rest of the application does not
+// need to be compiled for a specific instruction set. Other compilers only get
+// the portable kernels.
+#if (defined(__x86_64__) || defined(__i386__)) &&                             \
+  (defined(__GNUC__) || defined(__clang__))
+#define ARCHIVER_HASH_X86_KERNELS
+#define ARCHIVER_HASH_TARGET(instructionSet)                                   \
+  __attribute__((target(instructionSet)))
+#endif
+
+namespace hash {
+// The instruction set a hash kernel is implemented with.
+enum class Kernel { Portable, Avx2, Avx512 };
+
+auto kernelName(Kernel kernel) -> std::string_view;
+// Returns true if the running CPU, and the operating system, support the
+// instructions used by the kernel.
+auto isKernelSupported(Kernel kernel) -> bool;
+}
+
+#endif
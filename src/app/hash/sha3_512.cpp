@@ -0,0 +1,250 @@
+#include "sha3_512.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#ifdef ARCHIVER_HASH_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace hash {
+namespace {
+constexpr std::size_t RateLanes = 9;
+
+constexpr std::array<std::uint64_t, 24> RoundConstants = {
+  0x0000000000000001, 0x0000000000008082, 0x800000000000808A,
+  0x8000000080008000, 0x000000000000808B, 0x0000000080000001,
+  0x8000000080008081, 0x8000000000008009, 0x000000000000008A,
+  0x0000000000000088, 0x0000000080008009, 0x000000008000000A,
+  0x000000008000808B, 0x800000000000008B, 0x8000000000008089,
+  0x8000000000008003, 0x8000000000008002, 0x8000000000000080,
+  0x000000000000800A, 0x800000008000000A, 0x8000000080008081,
+  0x8000000000008080, 0x0000000080000001, 0x8000000080008008};
+
+// Rotation offsets indexed by x + 5 * y.
+constexpr std::array<int, 25> RhoOffsets = {
+  0,  1,  62, 28, 27, 36, 44, 6,  55, 20, 3,  10, 43,
+  25, 39, 41, 45, 15, 21, 8,  18, 2,  61, 56, 14};
+
+auto loadLane(const std::uint8_t* bytes) -> std::uint64_t {
+  std::uint64_t lane;
+  std::memcpy(&lane, bytes, sizeof(lane));
+  if constexpr (std::endian::native == std::endian::big) {
+    std::uint64_t swapped = 0;
+    for (int i = 0; i < 8; ++i)
+      swapped |= ((lane >> (8 * i)) & 0xFF) << (56 - 8 * i);
+    lane = swapped;
+  }
+  return lane;
+}
+
+// Calls function once for every index in the sequence, with the index as a
+// compile time constant. Keeps the permutation fully unrolled at -O2, which
+// makes the portable kernel several times faster.
+template <std::size_t... Indices, typename Function>
+inline void unrolled(std::index_sequence<Indices...>, Function&& function) {
+  (function(std::integral_constant<std::size_t, Indices>{}), ...);
+}
+
+constexpr auto Lanes = std::make_index_sequence<25>{};
+constexpr auto Columns = std::make_index_sequence<5>{};
+
+void keccakF1600(std::uint64_t* state) {
+  std::array<std::uint64_t, 25> a;
+  std::array<std::uint64_t, 25> b;
+  std::array<std::uint64_t, 5> c;
+  unrolled(Lanes, [&](auto i) { a[i] = state[i]; });
+
+  for (const auto roundConstant : RoundConstants) {
+    unrolled(Columns, [&](auto x) {
+      c[x] = a[x] ^ a[x + 5] ^ a[x + 10] ^ a[x + 15] ^ a[x + 20];
+    });
+    // Theta, rho, and pi, lane (x, y) moves to (y, 2x + 3y).
+    unrolled(Lanes, [&](auto i) {
+      constexpr std::size_t x = i % 5;
+      constexpr std::size_t y = i / 5;
+      const auto d = c[(x + 4) % 5] ^ std::rotl(c[(x + 1) % 5], 1);
+      b[y + 5 * ((2 * x + 3 * y) % 5)] = std::rotl(a[i] ^ d, RhoOffsets[i]);
+    });
+    // Chi
+    unrolled(Lanes, [&](auto i) {
+      constexpr std::size_t x = i % 5;
+      constexpr std::size_t row = i - x;
+      a[i] = b[i] ^ (~b[row + (x + 1) % 5] & b[row + (x + 2) % 5]);
+    });
+    // Iota
+    a[0] ^= roundConstant;
+  }
+
+  unrolled(Lanes, [&](auto i) { state[i] = a[i]; });
+}
+
+void absorbPortable(std::uint64_t* state, const std::uint8_t* blocks,
+                    std::size_t blockCount) {
+  for (std::size_t block = 0; block < blockCount; ++block) {
+    for (std::size_t lane = 0; lane < RateLanes; ++lane)
+      state[lane] ^= loadLane(blocks + 8 * lane);
+    keccakF1600(state);
+    blocks += RateLanes * 8;
+  }
+}
+
+#ifdef ARCHIVER_HASH_X86_KERNELS
+// Each row of the state is held in the low five lanes of a zmm register, which
+// lets theta and chi work on a whole row at once through vpermq and
+// vpternlogq, and rho becomes a single variable rotate per row. The upper three
+// lanes are kept zero by using the zero masking form of every permute.
+ARCHIVER_HASH_TARGET("avx512f")
+void absorbAvx512(std::uint64_t* state, const std::uint8_t* blocks,
+                  std::size_t blockCount) {
+  constexpr __mmask8 RowMask = 0x1F;
+
+  const auto minusOne = _mm512_setr_epi64(4, 0, 1, 2, 3, 5, 6, 7);
+  const auto plusOne = _mm512_setr_epi64(1, 2, 3, 4, 0, 5, 6, 7);
+  const auto plusTwo = _mm512_setr_epi64(2, 3, 4, 0, 1, 5, 6, 7);
+
+  __m512i rho[5];
+  // After pi, lane c of row r comes from lane (3r + c) % 5 of row c.
+  __m512i pi[5];
+  for (int y = 0; y < 5; ++y) {
+    rho[y] = _mm512_setr_epi64(RhoOffsets[5 * y], RhoOffsets[5 * y + 1],
+                               RhoOffsets[5 * y + 2], RhoOffsets[5 * y + 3],
+                               RhoOffsets[5 * y + 4], 0, 0, 0);
+    pi[y] = _mm512_setr_epi64((3 * y) % 5, (3 * y + 1) % 5, (3 * y + 2) % 5,
+                              (3 * y + 3) % 5, (3 * y + 4) % 5, 5, 6, 7);
+  }
+
+  __m512i row[5];
+  for (int y = 0; y < 5; ++y)
+    row[y] = _mm512_maskz_loadu_epi64(RowMask, state + 5 * y);
+
+  for (std::size_t block = 0; block < blockCount; ++block) {
+    std::uint64_t lanes[10] = {};
+    for (std::size_t lane = 0; lane < RateLanes; ++lane)
+      lanes[lane] = loadLane(blocks + 8 * lane);
+    row[0] = _mm512_xor_si512(row[0], _mm512_maskz_loadu_epi64(RowMask, lanes));
+    row[1] =
+      _mm512_xor_si512(row[1], _mm512_maskz_loadu_epi64(RowMask, lanes + 5));
+    blocks += RateLanes * 8;
+
+    for (const auto roundConstant : RoundConstants) {
+      // Theta
+      auto parity = _mm512_ternarylogic_epi64(row[0], row[1], row[2], 0x96);
+      parity = _mm512_ternarylogic_epi64(parity, row[3], row[4], 0x96);
+      const auto d = _mm512_xor_si512(
+        _mm512_maskz_permutexvar_epi64(RowMask, minusOne, parity),
+        _mm512_maskz_rol_epi64(
+          RowMask, _mm512_maskz_permutexvar_epi64(RowMask, plusOne, parity),
+          1));
+
+      // Rho
+      __m512i rotated[5];
+#pragma GCC unroll 5
+      for (int y = 0; y < 5; ++y)
+        rotated[y] = _mm512_maskz_rolv_epi64(
+          RowMask, _mm512_xor_si512(row[y], d), rho[y]);
+
+      // Pi
+#pragma GCC unroll 5
+      for (int r = 0; r < 5; ++r) {
+        row[r] = _mm512_maskz_permutexvar_epi64(1, pi[r], rotated[0]);
+#pragma GCC unroll 4
+        for (int c = 1; c < 5; ++c)
+          row[r] = _mm512_mask_permutexvar_epi64(
+            row[r], static_cast<__mmask8>(1 << c), pi[r], rotated[c]);
+      }
+
+      // Chi, a ^ (~b & c)
+#pragma GCC unroll 5
+      for (int y = 0; y < 5; ++y)
+        row[y] = _mm512_ternarylogic_epi64(
+          row[y], _mm512_maskz_permutexvar_epi64(RowMask, plusOne, row[y]),
+          _mm512_maskz_permutexvar_epi64(RowMask, plusTwo, row[y]), 0xD2);
+
+      // Iota
+      row[0] = _mm512_xor_si512(
+        row[0],
+        _mm512_maskz_set1_epi64(1, static_cast<long long>(roundConstant)));
+    }
+  }
+
+  for (int y = 0; y < 5; ++y)
+    _mm512_mask_storeu_epi64(state + 5 * y, RowMask, row[y]);
+}
+#endif
+
+auto getAbsorbFunction(Kernel kernel) {
+  switch (kernel) {
+  case Kernel::Portable:
+    return &absorbPortable;
+#ifdef ARCHIVER_HASH_X86_KERNELS
+  case Kernel::Avx512:
+    if (isKernelSupported(kernel))
+      return &absorbAvx512;
+    break;
+#endif
+  default:
+    break;
+  }
+  throw std::logic_error("The requested SHA3-512 kernel is not available");
+}
+}
+
+Sha3_512::Sha3_512(Kernel kernel) : absorb(getAbsorbFunction(kernel)) {}
+
+void Sha3_512::addData(const void* data, std::size_t size) {
+  auto bytes = static_cast<const std::uint8_t*>(data);
+
+  if (bufferSize > 0) {
+    const auto toCopy = std::min(size, Rate - bufferSize);
+    std::copy_n(bytes, toCopy, buffer.data() + bufferSize);
+    bufferSize += toCopy;
+    bytes += toCopy;
+    size -= toCopy;
+    if (bufferSize < Rate)
+      return;
+    absorb(state.data(), buffer.data(), 1);
+    bufferSize = 0;
+  }
+
+  const auto blockCount = size / Rate;
+  if (blockCount > 0) {
+    absorb(state.data(), bytes, blockCount);
+    bytes += blockCount * Rate;
+    size -= blockCount * Rate;
+  }
+
+  std::copy_n(bytes, size, buffer.data());
+  bufferSize = size;
+}
+
+auto Sha3_512::finalize() -> Digest {
+  std::fill(buffer.begin() + static_cast<std::ptrdiff_t>(bufferSize),
+            buffer.end(), std::uint8_t{0});
+  buffer[bufferSize] ^= 0x06;
+  buffer[Rate - 1] ^= 0x80;
+  absorb(state.data(), buffer.data(), 1);
+  bufferSize = 0;
+
+  Digest digest;
+  for (std::size_t i = 0; i < DigestSize; ++i)
+    digest[i] = static_cast<std::uint8_t>(state[i / 8] >> (8 * (i % 8)));
+  return digest;
+}
+
+auto Sha3_512::defaultKernel() -> Kernel {
+  static const Kernel kernel = availableKernels().back();
+  return kernel;
+}
+
+auto Sha3_512::availableKernels() -> std::vector<Kernel> {
+  std::vector<Kernel> kernels = {Kernel::Portable};
+#ifdef ARCHIVER_HASH_X86_KERNELS
+  if (isKernelSupported(Kernel::Avx512))
+    kernels.push_back(Kernel::Avx512);
+#endif
+  return kernels;
+}
+}
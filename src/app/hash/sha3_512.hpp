@@ -0,0 +1,39 @@
+#ifndef ARCHIVER_HASH_SHA3_512_HPP
+#define ARCHIVER_HASH_SHA3_512_HPP
+
+#include "kernel.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hash {
+class Sha3_512 {
+public:
+  static constexpr std::size_t DigestSize = 64;
+  using Digest = std::array<std::uint8_t, DigestSize>;
+
+  explicit Sha3_512(Kernel kernel = defaultKernel());
+
+  void addData(const void* data, std::size_t size);
+  auto finalize() -> Digest;
+
+  // The fastest kernel available on the running CPU, chosen the first time it
+  // is requested.
+  static auto defaultKernel() -> Kernel;
+  static auto availableKernels() -> std::vector<Kernel>;
+
+private:
+  static constexpr std::size_t Rate = 72;
+  using AbsorbFunction = void (*)(std::uint64_t* state,
+                                  const std::uint8_t* blocks,
+                                  std::size_t blockCount);
+
+  AbsorbFunction absorb;
+  std::array<std::uint64_t, 25> state{};
+  std::array<std::uint8_t, Rate> buffer{};
+  std::size_t bufferSize = 0;
+};
+}
+
+#endif
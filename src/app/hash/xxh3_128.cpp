@@ -0,0 +1,404 @@
+#include "xxh3_128.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef ARCHIVER_HASH_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace hash {
+namespace {
+constexpr std::uint32_t Prime32_1 = 0x9E3779B1;
+constexpr std::uint32_t Prime32_2 = 0x85EBCA77;
+constexpr std::uint32_t Prime32_3 = 0xC2B2AE3D;
+constexpr std::uint64_t Prime64_1 = 0x9E3779B185EBCA87;
+constexpr std::uint64_t Prime64_2 = 0xC2B2AE3D27D4EB4F;
+constexpr std::uint64_t Prime64_3 = 0x165667B19E3779F9;
+constexpr std::uint64_t Prime64_4 = 0x85EBCA77C2B2AE63;
+constexpr std::uint64_t Prime64_5 = 0x27D4EB2F165667C5;
+constexpr std::uint64_t PrimeMx1 = 0x165667919E3779F9;
+constexpr std::uint64_t PrimeMx2 = 0x9FB21C651E98DF25;
+
+constexpr std::array<std::uint8_t, 192> Secret = {
+  0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c,
+  0xf7, 0x21, 0xad, 0x1c, 0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb,
+  0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f, 0xcb, 0x79, 0xe6, 0x4e,
+  0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+  0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6,
+  0x81, 0x3a, 0x26, 0x4c, 0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb,
+  0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3, 0x71, 0x64, 0x48, 0x97,
+  0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+  0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7,
+  0xc7, 0x0b, 0x4f, 0x1d, 0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31,
+  0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64, 0xea, 0xc5, 0xac, 0x83,
+  0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+  0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26,
+  0x29, 0xd4, 0x68, 0x9e, 0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc,
+  0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce, 0x45, 0xcb, 0x3a, 0x8f,
+  0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e};
+
+// The accumulators are scrambled after each block of stripes, which uses the
+// secret up to its last stripe.
+constexpr std::size_t StripesPerBlock = (Secret.size() - 64) / 8;
+constexpr std::size_t ScrambleOffset = Secret.size() - 64;
+constexpr std::size_t LastStripeOffset = ScrambleOffset - 7;
+constexpr std::size_t MergeOffset = 11;
+constexpr std::size_t MidSizeStartOffset = 3;
+constexpr std::size_t MidSizeLastOffset = 17;
+constexpr std::size_t MinSecretSize = 136;
+
+struct Hash128 {
+  std::uint64_t low;
+  std::uint64_t high;
+};
+
+auto read32(const std::uint8_t* bytes) -> std::uint32_t {
+  std::uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  if constexpr (std::endian::native == std::endian::big)
+    value = __builtin_bswap32(value);
+  return value;
+}
+auto read64(const std::uint8_t* bytes) -> std::uint64_t {
+  std::uint64_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  if constexpr (std::endian::native == std::endian::big)
+    value = __builtin_bswap64(value);
+  return value;
+}
+
+auto multiply128(std::uint64_t a, std::uint64_t b) -> Hash128 {
+#ifdef __SIZEOF_INT128__
+  const auto product = static_cast<unsigned __int128>(a) * b;
+  return {static_cast<std::uint64_t>(product),
+          static_cast<std::uint64_t>(product >> 64)};
+#else
+  const auto lowLow = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+  const auto highLow = (a >> 32) * (b & 0xFFFFFFFF);
+  const auto lowHigh = (a & 0xFFFFFFFF) * (b >> 32);
+  const auto highHigh = (a >> 32) * (b >> 32);
+  const auto cross = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + lowHigh;
+  return {(cross << 32) | (lowLow & 0xFFFFFFFF),
+          (highLow >> 32) + (cross >> 32) + highHigh};
+#endif
+}
+auto multiplyFold64(std::uint64_t a, std::uint64_t b) -> std::uint64_t {
+  const auto product = multiply128(a, b);
+  return product.low ^ product.high;
+}
+
+auto xxh64Avalanche(std::uint64_t hash) -> std::uint64_t {
+  hash ^= hash >> 33;
+  hash *= Prime64_2;
+  hash ^= hash >> 29;
+  hash *= Prime64_3;
+  return hash ^ (hash >> 32);
+}
+auto avalanche(std::uint64_t hash) -> std::uint64_t {
+  hash ^= hash >> 37;
+  hash *= PrimeMx1;
+  return hash ^ (hash >> 32);
+}
+
+auto hash0(const std::uint8_t* secret) -> Hash128 {
+  return {xxh64Avalanche(read64(secret + 64) ^ read64(secret + 72)),
+          xxh64Avalanche(read64(secret + 80) ^ read64(secret + 88))};
+}
+auto hash1To3(const std::uint8_t* input, std::size_t size,
+              const std::uint8_t* secret) -> Hash128 {
+  const std::uint32_t combinedLow =
+    static_cast<std::uint32_t>(input[0]) << 16 |
+    static_cast<std::uint32_t>(input[size >> 1]) << 24 |
+    static_cast<std::uint32_t>(input[size - 1]) |
+    static_cast<std::uint32_t>(size) << 8;
+  const std::uint32_t combinedHigh =
+    std::rotl(__builtin_bswap32(combinedLow), 13);
+  const std::uint64_t flipLow = read32(secret) ^ read32(secret + 4);
+  const std::uint64_t flipHigh = read32(secret + 8) ^ read32(secret + 12);
+  return {xxh64Avalanche(combinedLow ^ flipLow),
+          xxh64Avalanche(combinedHigh ^ flipHigh)};
+}
+auto hash4To8(const std::uint8_t* input, std::size_t size,
+              const std::uint8_t* secret) -> Hash128 {
+  const std::uint64_t combined =
+    read32(input) + (static_cast<std::uint64_t>(read32(input + size - 4)) << 32);
+  const std::uint64_t flip = read64(secret + 16) ^ read64(secret + 24);
+  auto product = multiply128(combined ^ flip, Prime64_1 + (size << 2));
+  product.high += product.low << 1;
+  product.low ^= product.high >> 3;
+  product.low ^= product.low >> 35;
+  product.low *= PrimeMx2;
+  product.low ^= product.low >> 28;
+  product.high = avalanche(product.high);
+  return product;
+}
+auto hash9To16(const std::uint8_t* input, std::size_t size,
+               const std::uint8_t* secret) -> Hash128 {
+  const std::uint64_t flipLow = read64(secret + 32) ^ read64(secret + 40);
+  const std::uint64_t flipHigh = read64(secret + 48) ^ read64(secret + 56);
+  const auto inputLow = read64(input);
+  auto inputHigh = read64(input + size - 8);
+  auto product = multiply128(inputLow ^ inputHigh ^ flipLow, Prime64_1);
+  product.low += static_cast<std::uint64_t>(size - 1) << 54;
+  inputHigh ^= flipHigh;
+  product.high +=
+    inputHigh + (inputHigh & 0xFFFFFFFF) * (std::uint64_t{Prime32_2} - 1);
+  product.low ^= __builtin_bswap64(product.high);
+  auto hash = multiply128(product.low, Prime64_2);
+  hash.high += product.high * Prime64_2;
+  return {avalanche(hash.low), avalanche(hash.high)};
+}
+
+auto mix16(const std::uint8_t* input, const std::uint8_t* secret)
+  -> std::uint64_t {
+  return multiplyFold64(read64(input) ^ read64(secret),
+                        read64(input + 8) ^ read64(secret + 8));
+}
+void mix32(Hash128& accumulator, const std::uint8_t* input1,
+           const std::uint8_t* input2, const std::uint8_t* secret) {
+  accumulator.low += mix16(input1, secret);
+  accumulator.low ^= read64(input2) + read64(input2 + 8);
+  accumulator.high += mix16(input2, secret + 16);
+  accumulator.high ^= read64(input1) + read64(input1 + 8);
+}
+auto finishShort(const Hash128& accumulator, std::size_t size) -> Hash128 {
+  const auto high = accumulator.low * Prime64_1 +
+                    accumulator.high * Prime64_4 + size * Prime64_2;
+  return {avalanche(accumulator.low + accumulator.high), 0 - avalanche(high)};
+}
+auto hash17To128(const std::uint8_t* input, std::size_t size,
+                 const std::uint8_t* secret) -> Hash128 {
+  Hash128 accumulator{size * Prime64_1, 0};
+  if (size > 32) {
+    if (size > 64) {
+      if (size > 96)
+        mix32(accumulator, input + 48, input + size - 64, secret + 96);
+      mix32(accumulator, input + 32, input + size - 48, secret + 64);
+    }
+    mix32(accumulator, input + 16, input + size - 32, secret + 32);
+  }
+  mix32(accumulator, input, input + size - 16, secret);
+  return finishShort(accumulator, size);
+}
+auto hash129To240(const std::uint8_t* input, std::size_t size,
+                  const std::uint8_t* secret) -> Hash128 {
+  Hash128 accumulator{size * Prime64_1, 0};
+  for (std::size_t i = 32; i < 160; i += 32)
+    mix32(accumulator, input + i - 32, input + i - 16, secret + i - 32);
+  accumulator = {avalanche(accumulator.low), avalanche(accumulator.high)};
+  // If the size is a multiple of 32 the last 32 bytes are mixed in twice.
+  for (std::size_t i = 160; i <= size; i += 32)
+    mix32(accumulator, input + i - 32, input + i - 16,
+          secret + MidSizeStartOffset + i - 160);
+  mix32(accumulator, input + size - 16, input + size - 32,
+        secret + MinSecretSize - MidSizeLastOffset - 16);
+  return finishShort(accumulator, size);
+}
+
+void accumulatePortable(std::uint64_t* accumulators,
+                        const std::uint8_t* stripes, std::size_t stripeCount,
+                        const std::uint8_t* secret) {
+  for (std::size_t stripe = 0; stripe < stripeCount; ++stripe) {
+    for (std::size_t i = 0; i < 8; ++i) {
+      const auto value = read64(stripes + 8 * i);
+      const auto key = value ^ read64(secret + 8 * i);
+      accumulators[i ^ 1] += value;
+      accumulators[i] += (key & 0xFFFFFFFF) * (key >> 32);
+    }
+    stripes += 64;
+    secret += 8;
+  }
+}
+
+#ifdef ARCHIVER_HASH_X86_KERNELS
+// Each stripe is two ymm registers wide, as are the accumulators.
+ARCHIVER_HASH_TARGET("avx2")
+void accumulateAvx2(std::uint64_t* accumulators, const std::uint8_t* stripes,
+                    std::size_t stripeCount, const std::uint8_t* secret) {
+  auto* const accumulatorVectors = reinterpret_cast<__m256i*>(accumulators);
+  __m256i sums[2] = {_mm256_loadu_si256(accumulatorVectors),
+                     _mm256_loadu_si256(accumulatorVectors + 1)};
+  for (std::size_t stripe = 0; stripe < stripeCount; ++stripe) {
+    for (std::size_t i = 0; i < 2; ++i) {
+      const auto value = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(stripes + 32 * i));
+      const auto key = _mm256_xor_si256(
+        value, _mm256_loadu_si256(
+                 reinterpret_cast<const __m256i*>(secret + 32 * i)));
+      const auto product =
+        _mm256_mul_epu32(key, _mm256_srli_epi64(key, 32));
+      const auto swapped = _mm256_shuffle_epi32(value, 0x4E);
+      sums[i] = _mm256_add_epi64(product, _mm256_add_epi64(sums[i], swapped));
+    }
+    stripes += 64;
+    secret += 8;
+  }
+  _mm256_storeu_si256(accumulatorVectors, sums[0]);
+  _mm256_storeu_si256(accumulatorVectors + 1, sums[1]);
+}
+#endif
+
+void scramble(std::uint64_t* accumulators, const std::uint8_t* secret) {
+  for (std::size_t i = 0; i < 8; ++i) {
+    auto accumulator = accumulators[i];
+    accumulator ^= accumulator >> 47;
+    accumulator ^= read64(secret + 8 * i);
+    accumulators[i] = accumulator * Prime32_1;
+  }
+}
+
+auto mergeAccumulators(const std::uint64_t* accumulators,
+                       const std::uint8_t* secret, std::uint64_t start)
+  -> std::uint64_t {
+  auto result = start;
+  for (std::size_t i = 0; i < 4; ++i) {
+    result += multiplyFold64(accumulators[2 * i] ^ read64(secret + 16 * i),
+                             accumulators[2 * i + 1] ^
+                               read64(secret + 16 * i + 8));
+  }
+  return avalanche(result);
+}
+
+auto getAccumulateFunction(Kernel kernel) {
+  switch (kernel) {
+  case Kernel::Portable:
+    return &accumulatePortable;
+#ifdef ARCHIVER_HASH_X86_KERNELS
+  case Kernel::Avx2:
+    if (isKernelSupported(kernel))
+      return &accumulateAvx2;
+    break;
+#endif
+  default:
+    break;
+  }
+  throw std::logic_error("The requested XXH3 kernel is not available");
+}
+}
+
+Xxh3_128::Xxh3_128(Kernel kernel)
+  : accumulate(getAccumulateFunction(kernel)),
+    accumulators{Prime32_3, Prime64_1, Prime64_2, Prime64_3,
+                 Prime64_4, Prime32_2, Prime64_5, Prime32_1} {}
+
+void Xxh3_128::consumeStripes(std::uint64_t* accumulators,
+                              std::size_t& stripesInBlock,
+                              const std::uint8_t* stripes,
+                              std::size_t stripeCount) const {
+  while (stripeCount > 0) {
+    const auto count =
+      std::min(stripeCount, StripesPerBlock - stripesInBlock);
+    accumulate(accumulators, stripes, count,
+               Secret.data() + 8 * stripesInBlock);
+    stripes += count * StripeSize;
+    stripeCount -= count;
+    stripesInBlock += count;
+    if (stripesInBlock == StripesPerBlock) {
+      scramble(accumulators, Secret.data() + ScrambleOffset);
+      stripesInBlock = 0;
+    }
+  }
+}
+
+void Xxh3_128::addData(const void* data, std::size_t size) {
+  auto bytes = static_cast<const std::uint8_t*>(data);
+  totalSize += size;
+
+  if (bufferSize + size <= BufferSize) {
+    std::copy_n(bytes, size, buffer.data() + bufferSize);
+    bufferSize += size;
+    return;
+  }
+
+  if (bufferSize > 0) {
+    const auto toCopy = BufferSize - bufferSize;
+    std::copy_n(bytes, toCopy, buffer.data() + bufferSize);
+    bytes += toCopy;
+    size -= toCopy;
+    consumeStripes(accumulators.data(), stripesInBlock, buffer.data(),
+                   BufferSize / StripeSize);
+    bufferSize = 0;
+  }
+
+  // Every stripe which has data after it is accumulated straight from the
+  // input, rather than being copied into the buffer first.
+  if (size > BufferSize) {
+    const auto stripeCount = (size - 1) / StripeSize;
+    consumeStripes(accumulators.data(), stripesInBlock, bytes, stripeCount);
+    bytes += stripeCount * StripeSize;
+    size -= stripeCount * StripeSize;
+    std::copy_n(bytes - StripeSize, StripeSize,
+                buffer.data() + BufferSize - StripeSize);
+  }
+
+  std::copy_n(bytes, size, buffer.data());
+  bufferSize = size;
+}
+
+auto Xxh3_128::finalize() -> Digest {
+  Hash128 hash;
+  const auto* const secret = Secret.data();
+  if (totalSize <= 240) {
+    const auto* const input = buffer.data();
+    const auto size = static_cast<std::size_t>(totalSize);
+    if (size == 0)
+      hash = hash0(secret);
+    else if (size <= 3)
+      hash = hash1To3(input, size, secret);
+    else if (size <= 8)
+      hash = hash4To8(input, size, secret);
+    else if (size <= 16)
+      hash = hash9To16(input, size, secret);
+    else if (size <= 128)
+      hash = hash17To128(input, size, secret);
+    else
+      hash = hash129To240(input, size, secret);
+  } else {
+    auto finalAccumulators = accumulators;
+    auto finalStripesInBlock = stripesInBlock;
+    std::array<std::uint8_t, StripeSize> lastStripe;
+    if (bufferSize >= StripeSize) {
+      consumeStripes(finalAccumulators.data(), finalStripesInBlock,
+                     buffer.data(), (bufferSize - 1) / StripeSize);
+      std::copy_n(buffer.data() + bufferSize - StripeSize, StripeSize,
+                  lastStripe.data());
+    } else {
+      // The rest of the last stripe is the end of the data consumed before.
+      const auto fromBefore = StripeSize - bufferSize;
+      std::copy_n(buffer.data() + BufferSize - fromBefore, fromBefore,
+                  lastStripe.data());
+      std::copy_n(buffer.data(), bufferSize, lastStripe.data() + fromBefore);
+    }
+    accumulate(finalAccumulators.data(), lastStripe.data(), 1,
+               secret + LastStripeOffset);
+    hash = {mergeAccumulators(finalAccumulators.data(), secret + MergeOffset,
+                              totalSize * Prime64_1),
+            mergeAccumulators(finalAccumulators.data(),
+                              secret + Secret.size() - 64 - MergeOffset,
+                              ~(totalSize * Prime64_2))};
+  }
+
+  Digest digest;
+  for (std::size_t i = 0; i < 8; ++i) {
+    digest[i] = static_cast<std::uint8_t>(hash.high >> (56 - 8 * i));
+    digest[i + 8] = static_cast<std::uint8_t>(hash.low >> (56 - 8 * i));
+  }
+  return digest;
+}
+
+auto Xxh3_128::defaultKernel() -> Kernel {
+  static const Kernel kernel = availableKernels().back();
+  return kernel;
+}
+
+auto Xxh3_128::availableKernels() -> std::vector<Kernel> {
+  std::vector<Kernel> kernels = {Kernel::Portable};
+#ifdef ARCHIVER_HASH_X86_KERNELS
+  if (isKernelSupported(Kernel::Avx2))
+    kernels.push_back(Kernel::Avx2);
+#endif
+  return kernels;
+}
+}
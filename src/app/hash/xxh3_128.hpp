@@ -0,0 +1,57 @@
+#ifndef ARCHIVER_HASH_XXH3_128_HPP
+#define ARCHIVER_HASH_XXH3_128_HPP
+
+#include "kernel.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hash {
+// The 128 bit XXH3 hash, with the default secret and no seed. It is many times
+// faster than the cryptographic hashes but isn't collision resistant, so it is
+// only used to tell files apart, never to show that two files are the same.
+// The digest is in the canonical, big endian, form.
+class Xxh3_128 {
+public:
+  static constexpr std::size_t DigestSize = 16;
+  using Digest = std::array<std::uint8_t, DigestSize>;
+
+  explicit Xxh3_128(Kernel kernel = defaultKernel());
+
+  void addData(const void* data, std::size_t size);
+  auto finalize() -> Digest;
+
+  // The fastest kernel available on the running CPU, chosen the first time it
+  // is requested.
+  static auto defaultKernel() -> Kernel;
+  static auto availableKernels() -> std::vector<Kernel>;
+
+private:
+  static constexpr std::size_t StripeSize = 64;
+  static constexpr std::size_t BufferSize = 4 * StripeSize;
+  // Accumulates stripeCount consecutive stripes, using the secret from 8
+  // bytes further along for each one.
+  using AccumulateFunction = void (*)(std::uint64_t* accumulators,
+                                      const std::uint8_t* stripes,
+                                      std::size_t stripeCount,
+                                      const std::uint8_t* secret);
+
+  void consumeStripes(std::uint64_t* accumulators, std::size_t& stripesInBlock,
+                      const std::uint8_t* stripes,
+                      std::size_t stripeCount) const;
+
+  AccumulateFunction accumulate;
+  std::array<std::uint64_t, 8> accumulators;
+  std::size_t stripesInBlock = 0;
+  std::uint64_t totalSize = 0;
+  // The last stripe of the input is always hashed when the digest is
+  // finalized, so the buffer is only consumed once more data follows it. The
+  // last stripe of the data consumed is kept at the end of the buffer, in case
+  // less than a stripe follows it.
+  alignas(StripeSize) std::array<std::uint8_t, BufferSize> buffer{};
+  std::size_t bufferSize = 0;
+};
+}
+
+#endif
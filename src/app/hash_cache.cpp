@@ -0,0 +1,309 @@
+#include "hash_cache.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <span>
+#include <system_error>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr std::array<char, 8> Magic = {'A', 'R', 'C', 'H', 'H', 'A', 'S', 'H'};
+constexpr std::uint32_t Version = 3;
+constexpr std::uint64_t InitialCapacity = 1 << 14;
+
+enum class State : std::uint32_t { Ready = 1, Resizing = 2 };
+
+auto errorMessage(int error) -> std::string {
+  return std::error_code(error, std::system_category()).message();
+}
+
+// splitmix64, to spread the inode numbers, which are often sequential, over
+// the table.
+auto mix(std::uint64_t value) -> std::uint64_t {
+  value += 0x9E3779B97F4A7C15;
+  value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9;
+  value = (value ^ (value >> 27)) * 0x94D049BB133111EB;
+  return value ^ (value >> 31);
+}
+}
+
+struct HashCache::Header {
+  std::array<char, 8> magic;
+  std::uint32_t version;
+  State state;
+  std::uint64_t capacity;
+  std::uint64_t count;
+  std::array<std::uint64_t, 4> reserved;
+};
+
+struct HashCache::Entry {
+  Fingerprint fingerprint;
+  std::array<std::uint8_t, FastHash::Size> fastHash;
+  std::array<std::uint8_t, FileHash::Size> hash;
+  // 1 if hash is set, 0 if only the fast hash is known.
+  std::uint64_t hasHash;
+  // Never 0 for an entry in use, so a zeroed slot is empty.
+  std::uint64_t checksum;
+
+  auto computeChecksum() const -> std::uint64_t {
+    std::uint64_t checksum = mix(fingerprint.device);
+    for (const std::uint64_t value :
+         {fingerprint.inode, fingerprint.size,
+          static_cast<std::uint64_t>(fingerprint.modificationTime),
+          static_cast<std::uint64_t>(fingerprint.changeTime), hasHash})
+      checksum = mix(checksum ^ value);
+    const auto addBytes = [&](std::span<const std::uint8_t> bytes) {
+      for (std::size_t i = 0; i < bytes.size(); i += sizeof(std::uint64_t)) {
+        std::uint64_t value;
+        std::memcpy(&value, bytes.data() + i, sizeof(value));
+        checksum = mix(checksum ^ value);
+      }
+    };
+    addBytes(fastHash);
+    addBytes(hash);
+    return checksum | 1;
+  }
+  auto isUsed() const -> bool {
+    return checksum != 0 && checksum == computeChecksum();
+  }
+  auto isFor(const Fingerprint& other) const -> bool {
+    return fingerprint.device == other.device &&
+           fingerprint.inode == other.inode;
+  }
+};
+
+#ifdef __linux__
+HashCache::HashCache(const std::filesystem::path& path) : path(path) {
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    throw HashCacheException("There was an error opening the hash cache "
+                             "\"{}\": {}",
+                             path, errorMessage(errno));
+  }
+  if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+    const auto error = errno;
+    ::close(fd);
+    throw HashCacheException("Could not lock the hash cache \"{}\", it may be "
+                             "in use by another process: {}",
+                             path, errorMessage(error));
+  }
+
+  try {
+    struct stat status;
+    if (::fstat(fd, &status) != 0) {
+      throw HashCacheException("There was an error reading the hash cache "
+                               "\"{}\": {}",
+                               path, errorMessage(errno));
+    }
+    const auto fileSize = static_cast<std::uint64_t>(status.st_size);
+
+    Header existing{};
+    if (fileSize >= sizeof(Header) &&
+        ::pread(fd, &existing, sizeof(existing), 0) ==
+          static_cast<ssize_t>(sizeof(existing)) &&
+        existing.magic == Magic && existing.version == Version &&
+        existing.state == State::Ready && existing.capacity > 0 &&
+        (existing.capacity & (existing.capacity - 1)) == 0 &&
+        fileSize == sizeof(Header) + existing.capacity * sizeof(Entry)) {
+      map(existing.capacity);
+    } else {
+      if (fileSize != 0) {
+        spdlog::warn("The hash cache \"{}\" is invalid and will be emptied",
+                     path);
+      }
+      reset(InitialCapacity);
+    }
+  } catch (...) {
+    unmap();
+    ::close(fd);
+    throw;
+  }
+}
+
+HashCache::~HashCache() {
+  unmap();
+  if (fd >= 0)
+    ::close(fd);
+}
+
+auto HashCache::fingerprint(const std::filesystem::path& path)
+  -> std::optional<Fingerprint> {
+  constexpr auto toNanoseconds = [](auto seconds, auto nanoseconds) {
+    return static_cast<std::int64_t>(seconds) * 1'000'000'000 +
+           static_cast<std::int64_t>(nanoseconds);
+  };
+
+  struct statx status;
+  if (::statx(AT_FDCWD, path.c_str(), AT_STATX_SYNC_AS_STAT,
+              STATX_TYPE | STATX_INO | STATX_SIZE | STATX_MTIME | STATX_CTIME,
+              &status) == 0) {
+    if (!S_ISREG(status.stx_mode))
+      return std::nullopt;
+    return Fingerprint{
+      makedev(status.stx_dev_major, status.stx_dev_minor), status.stx_ino,
+      status.stx_size,
+      toNanoseconds(status.stx_mtime.tv_sec, status.stx_mtime.tv_nsec),
+      toNanoseconds(status.stx_ctime.tv_sec, status.stx_ctime.tv_nsec)};
+  }
+  if (errno != ENOSYS)
+    return std::nullopt;
+
+  struct stat fallbackStatus;
+  if (::stat(path.c_str(), &fallbackStatus) != 0 ||
+      !S_ISREG(fallbackStatus.st_mode))
+    return std::nullopt;
+  return Fingerprint{
+    static_cast<std::uint64_t>(fallbackStatus.st_dev),
+    static_cast<std::uint64_t>(fallbackStatus.st_ino),
+    static_cast<std::uint64_t>(fallbackStatus.st_size),
+    toNanoseconds(fallbackStatus.st_mtim.tv_sec,
+                  fallbackStatus.st_mtim.tv_nsec),
+    toNanoseconds(fallbackStatus.st_ctim.tv_sec,
+                  fallbackStatus.st_ctim.tv_nsec)};
+}
+
+void HashCache::map(std::uint64_t capacity) {
+  const auto size = sizeof(Header) + capacity * sizeof(Entry);
+  void* mapping =
+    ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    throw HashCacheException("There was an error mapping the hash cache "
+                             "\"{}\": {}",
+                             path, errorMessage(errno));
+  }
+  mappedSize = size;
+  header = static_cast<Header*>(mapping);
+  entries = reinterpret_cast<Entry*>(static_cast<char*>(mapping) +
+                                     sizeof(Header));
+}
+
+void HashCache::unmap() {
+  if (header)
+    ::munmap(header, mappedSize);
+  header = nullptr;
+  entries = nullptr;
+  mappedSize = 0;
+}
+
+void HashCache::reset(std::uint64_t capacity) {
+  unmap();
+  // Truncating to 0 first zeroes every entry, the file is sparse until
+  // entries are written.
+  if (::ftruncate(fd, 0) != 0 ||
+      ::ftruncate(fd, static_cast<off_t>(sizeof(Header) +
+                                         capacity * sizeof(Entry))) != 0) {
+    throw HashCacheException("There was an error resizing the hash cache "
+                             "\"{}\": {}",
+                             path, errorMessage(errno));
+  }
+  map(capacity);
+  header->magic = Magic;
+  header->version = Version;
+  header->capacity = capacity;
+  header->count = 0;
+  header->state = State::Ready;
+}
+#else
+HashCache::HashCache(const std::filesystem::path& path) : path(path) {
+  throw HashCacheException(
+    "The hash cache \"{}\" can't be opened as hash caches aren't supported on "
+    "this platform",
+    path);
+}
+
+HashCache::~HashCache() = default;
+
+auto HashCache::fingerprint(const std::filesystem::path&)
+  -> std::optional<Fingerprint> {
+  return std::nullopt;
+}
+
+void HashCache::map(std::uint64_t) {}
+void HashCache::unmap() {}
+void HashCache::reset(std::uint64_t) {}
+#endif
+
+auto HashCache::find(const Fingerprint& fingerprint) -> std::optional<Hashes> {
+  std::lock_guard lock(mutex);
+  if (!header)
+    return std::nullopt;
+  const auto& entry = findSlot(fingerprint);
+  if (!entry.isUsed() || entry.fingerprint != fingerprint)
+    return std::nullopt;
+  Hashes hashes{FastHash::fromBytes(entry.fastHash), std::nullopt};
+  if (entry.hasHash)
+    hashes.hash = FileHash::fromBytes(entry.hash);
+  return hashes;
+}
+
+void HashCache::insert(const Fingerprint& fingerprint,
+                       const FastHash& fastHash,
+                       const std::optional<FileHash>& hash) {
+  const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::system_clock::now().time_since_epoch())
+                     .count();
+  if (std::max(fingerprint.modificationTime, fingerprint.changeTime) >
+      now - RacyInterval)
+    return;
+
+  std::lock_guard lock(mutex);
+  if (!header)
+    return;
+  // Keep the table at most 3/4 full so probe sequences stay short.
+  if ((header->count + 1) * 4 > header->capacity * 3)
+    grow();
+
+  auto& entry = findSlot(fingerprint);
+  const auto used = entry.isUsed();
+  if (!used)
+    ++header->count;
+  if (!hash && used && entry.hasHash && entry.fingerprint == fingerprint &&
+      entry.fastHash == fastHash.bytes)
+    return;
+  Entry newEntry{fingerprint, fastHash.bytes, {}, hash.has_value(), 0};
+  if (hash)
+    newEntry.hash = hash->bytes;
+  newEntry.checksum = newEntry.computeChecksum();
+  entry = newEntry;
+}
+
+void HashCache::grow() {
+  std::vector<Entry> used;
+  used.reserve(header->count);
+  std::copy_if(entries, entries + header->capacity, std::back_inserter(used),
+               [](const Entry& entry) { return entry.isUsed(); });
+
+  // If the resize is interrupted the cache is emptied when it is next opened,
+  // rather than trusting a half copied table.
+  const auto capacity = header->capacity * 2;
+  reset(capacity);
+  header->state = State::Resizing;
+  for (const auto& entry : used) {
+    findSlot(entry.fingerprint) = entry;
+    ++header->count;
+  }
+  header->state = State::Ready;
+}
+
+auto HashCache::findSlot(const Fingerprint& fingerprint) -> Entry& {
+  // The capacity is always a power of 2 and never full, so this always finds
+  // either the entry for the file or an empty slot.
+  const auto mask = header->capacity - 1;
+  for (auto slot = mix(fingerprint.device ^ mix(fingerprint.inode)) & mask;;
+       slot = (slot + 1) & mask) {
+    auto& entry = entries[slot];
+    if (!entry.isUsed() || entry.isFor(fingerprint))
+      return entry;
+  }
+}
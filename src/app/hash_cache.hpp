@@ -0,0 +1,89 @@
+#ifndef ARCHIVER_HASH_CACHE_HPP
+#define ARCHIVER_HASH_CACHE_HPP
+
+#include "common.h"
+#include "file_hash.hpp"
+#include <mutex>
+#include <optional>
+
+// A persistent cache of file hashes, keyed by the metadata of the file each
+// hash was computed from. A file whose device, inode, size, and modification
+// and change times still match its entry is assumed to still have the cached
+// hash, so it doesn't need to be read again to be hashed.
+//
+// The cache is an open addressing hash table, with one entry per device and
+// inode, in a memory mapped file. The file is locked while it is open so two
+// processes can't write to it at once. Anything in the file which doesn't look
+// right, such as an entry torn by a crash, is treated as missing, as the worst
+// that can happen is a file being hashed again.
+class HashCache {
+public:
+  struct Fingerprint {
+    std::uint64_t device;
+    std::uint64_t inode;
+    std::uint64_t size;
+    // Nanoseconds since the epoch.
+    std::int64_t modificationTime;
+    std::int64_t changeTime;
+
+    friend auto operator==(const Fingerprint&, const Fingerprint&)
+      -> bool = default;
+  };
+
+  // Opens the cache file at path, creating it if it doesn't exist. A file
+  // which isn't a cache, or is from an incompatible version, is emptied.
+  explicit HashCache(const std::filesystem::path& path);
+  ~HashCache();
+
+  // Returns the fingerprint of the file at path, following symlinks, or
+  // nullopt if the file can't be looked up.
+  static auto fingerprint(const std::filesystem::path& path)
+    -> std::optional<Fingerprint>;
+
+  struct Hashes {
+    FastHash fastHash;
+    // Not set if the file was only hashed under the tiered policy.
+    std::optional<FileHash> hash;
+
+    friend auto operator==(const Hashes&, const Hashes&) -> bool = default;
+  };
+
+  auto find(const Fingerprint& fingerprint) -> std::optional<Hashes>;
+  // Records the hashes of a file, replacing any entry for the same device and
+  // inode. If hash isn't set, a cryptographic hash already recorded for the
+  // same fingerprint and fast hash is kept. A file changed in the last
+  // RacyInterval isn't recorded, since it could be changed again without its
+  // timestamps changing.
+  void insert(const Fingerprint& fingerprint, const FastHash& fastHash,
+              const std::optional<FileHash>& hash);
+
+  static constexpr std::int64_t RacyInterval = 2'000'000'000;
+
+  HashCache() = delete;
+  HashCache(const HashCache&) = delete;
+  HashCache(HashCache&&) = delete;
+
+  HashCache& operator=(const HashCache&) = delete;
+  HashCache& operator=(HashCache&&) = delete;
+
+private:
+  struct Header;
+  struct Entry;
+
+  void map(std::uint64_t capacity);
+  void unmap();
+  void reset(std::uint64_t capacity);
+  void grow();
+  auto findSlot(const Fingerprint& fingerprint) -> Entry&;
+
+  std::filesystem::path path;
+  int fd = -1;
+  std::mutex mutex;
+  Header* header = nullptr;
+  Entry* entries = nullptr;
+  std::size_t mappedSize = 0;
+};
+
+_make_exception_(HashCacheException);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef ARCHIVER_HASH_POLICY_HPP
+#define ARCHIVER_HASH_POLICY_HPP
+
+#include <optional>
+#include <string_view>
+
+// Which hashes are computed as a file is read. The fast hash is always
+// computed. Under the full policy the cryptographic hashes are as well, while
+// under the tiered policy they are only computed when the fast hash of a file
+// matches that of another file, to find whether they really are the same, and
+// otherwise once the file is archived.
+enum class HashPolicy { Full, Tiered };
+
+// Returns nullopt if name isn't the name of a policy.
+inline auto parseHashPolicy(std::string_view name)
+  -> std::optional<HashPolicy> {
+  if (name == "full")
+    return HashPolicy::Full;
+  if (name == "tiered")
+    return HashPolicy::Tiered;
+  return std::nullopt;
+}
+
+#endif
@@ -0,0 +1,110 @@
+#include "hashing_pool.hpp"
+#include "read_pipeline.hpp"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+HashingPool::HashingPool(std::span<char> buffer, std::size_t workerCount,
+                         Task task, std::size_t batchSize,
+                         BatchTask batchTask)
+  : task(std::move(task)), batchTask(std::move(batchTask)),
+    batchSize(this->batchTask ? std::max<std::size_t>(1, batchSize) : 1) {
+  if (workerCount == 0)
+    workerCount = std::max(1u, std::thread::hardware_concurrency());
+  workerCount = std::clamp<std::size_t>(
+    workerCount, 1, std::max<std::size_t>(
+                      1, buffer.size() / ReadPipeline::SlotAlignment));
+  maxQueuedJobs = 2 * workerCount * this->batchSize;
+
+  const auto sliceSize = buffer.size() / workerCount /
+                         ReadPipeline::SlotAlignment *
+                         ReadPipeline::SlotAlignment;
+  for (std::size_t i = 0; i < workerCount; ++i) {
+    const auto slice =
+      workerCount == 1 ? buffer : buffer.subspan(i * sliceSize, sliceSize);
+    workers.emplace_back([this, slice]() { runWorker(slice); });
+  }
+}
+
+HashingPool::~HashingPool() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  jobsChanged.notify_all();
+  for (auto& worker : workers)
+    worker.join();
+}
+
+void HashingPool::submit(Job job) {
+  {
+    std::unique_lock lock(mutex);
+    jobsChanged.wait(lock,
+                     [&]() { return queuedJobs.size() < maxQueuedJobs; });
+    queuedJobs.push_back(std::move(job));
+  }
+  jobsChanged.notify_all();
+}
+
+auto HashingPool::takeFinished() -> std::vector<Result> {
+  std::lock_guard lock(mutex);
+  return std::exchange(finishedJobs, {});
+}
+
+auto HashingPool::finish() -> std::vector<Result> {
+  std::unique_lock lock(mutex);
+  jobsChanged.wait(lock,
+                   [&]() { return queuedJobs.empty() && runningJobs == 0; });
+  return std::exchange(finishedJobs, {});
+}
+
+void HashingPool::runWorker(std::span<char> buffer) {
+  std::optional<SmallFileReader> reader;
+  if (batchSize > 1)
+    reader.emplace(buffer, batchSize);
+  const auto workerBatchSize = reader && reader->usesIoUring() ? batchSize : 1;
+
+  while (true) {
+    std::vector<Result> batch;
+    {
+      std::unique_lock lock(mutex);
+      jobsChanged.wait(lock, [&]() { return stopping || !queuedJobs.empty(); });
+      if (stopping)
+        return;
+      // A batch is whatever is queued, up to its size, rather than waiting
+      // for it to fill.
+      while (batch.size() < workerBatchSize && !queuedJobs.empty()) {
+        batch.push_back(Result{std::move(queuedJobs.front()), std::nullopt,
+                               nullptr});
+        queuedJobs.pop_front();
+      }
+      runningJobs += batch.size();
+    }
+    jobsChanged.notify_all();
+
+    if (batch.size() == 1) {
+      auto& result = batch.front();
+      try {
+        result.file = task(result.job, buffer);
+      } catch (...) {
+        result.error = std::current_exception();
+      }
+    } else {
+      try {
+        batchTask(batch, *reader, buffer);
+      } catch (...) {
+        for (auto& result : batch) {
+          if (!result.file && !result.error)
+            result.error = std::current_exception();
+        }
+      }
+    }
+
+    {
+      std::lock_guard lock(mutex);
+      std::ranges::move(batch, std::back_inserter(finishedJobs));
+      runningJobs -= batch.size();
+    }
+    jobsChanged.notify_all();
+  }
+}
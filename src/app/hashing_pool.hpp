@@ -0,0 +1,114 @@
+#ifndef ARCHIVER_HASHING_POOL_HPP
+#define ARCHIVER_HASHING_POOL_HPP
+
+#include "archived_file_revision.hpp"
+#include "common.h"
+#include "directory_walker.hpp"
+#include "raw_file.hpp"
+#include "small_file_reader.hpp"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+
+// Reads files on a fixed number of worker threads, each with its own slice of
+// the read buffer. Only a bounded number of jobs can be waiting for a worker,
+// submitting more blocks the caller, so a fast producer such as a directory
+// walk can't queue up an unbounded amount of work. Finished jobs are collected
+// by the caller, which is where anything that isn't thread safe, such as
+// adding the files to a database, should be done.
+class HashingPool {
+public:
+  struct Job {
+    // Why a file which has already been hashed is queued again, other than to
+    // copy it. These only happen under the tiered hash policy, where the fast
+    // hash of a file matching that of another doesn't show they are the same.
+    enum class Confirmation {
+      None,
+      // The file is hashed with its cryptographic hash, to find whether it
+      // has really been archived.
+      Archived,
+      // The file has been linked to a staged copy, which it is compared to
+      // before the link is kept.
+      Linked
+    };
+
+    std::filesystem::path path;
+    std::filesystem::path stagePath;
+    std::filesystem::path partialPath;
+    // The latest archived revision of the file, if it only needs to be staged
+    // when it has changed since then.
+    std::optional<ArchivedFileRevision> archivedRevision;
+    // Set if the file has already been hashed without being copied, and is
+    // queued again now that it is known to need a copy.
+    std::optional<RawFile> hashedFile = std::nullopt;
+    // Set if the file has more than one hard link. Only the first of them to
+    // be found is hashed, the others wait for it.
+    std::optional<DirectoryWalker::Inode> hardLink = std::nullopt;
+    Confirmation confirmation = Confirmation::None;
+  };
+  struct Result {
+    Job job;
+    // Not set if the file was skipped.
+    std::optional<RawFile> file;
+    // Set instead of file if the job threw.
+    std::exception_ptr error;
+  };
+  // Returns nullopt if the file was skipped.
+  using Task =
+    std::function<std::optional<RawFile>(const Job&, std::span<char> buffer)>;
+  // Runs several jobs at once, setting the file or error of each of their
+  // results. The reader's slots are the worker's slice of the buffer, so it
+  // can't be used while anything else is being read into the buffer.
+  using BatchTask =
+    std::function<void(std::span<Result> results, SmallFileReader& reader,
+                       std::span<char> buffer)>;
+
+  // A worker count of 0 uses one worker per hardware thread. There are never
+  // more workers than there are ReadPipeline::SlotAlignment sized slices of
+  // the buffer. If a batch size of more than 1 and a batch task are given,
+  // each worker takes up to that many jobs from the queue at once and runs
+  // them with the batch task, through a SmallFileReader which keeps as many
+  // files in flight. Workers run one job at a time with task if io_uring
+  // isn't available.
+  HashingPool(std::span<char> buffer, std::size_t workerCount, Task task,
+              std::size_t batchSize = 1, BatchTask batchTask = nullptr);
+  // Waits for the workers to finish the jobs they have already started.
+  ~HashingPool();
+
+  // Queues a job, first waiting for space in the queue if it is full.
+  void submit(Job job);
+  // Returns the jobs which have finished since the last call, without waiting.
+  auto takeFinished() -> std::vector<Result>;
+  // Waits for every submitted job to finish and returns those not yet taken.
+  auto finish() -> std::vector<Result>;
+
+  HashingPool() = delete;
+  HashingPool(const HashingPool&) = delete;
+  HashingPool(HashingPool&&) = delete;
+
+  HashingPool& operator=(const HashingPool&) = delete;
+  HashingPool& operator=(HashingPool&&) = delete;
+
+private:
+  void runWorker(std::span<char> buffer);
+
+  Task task;
+  BatchTask batchTask;
+  std::size_t batchSize;
+  std::size_t maxQueuedJobs;
+
+  std::mutex mutex;
+  std::condition_variable jobsChanged;
+  std::deque<Job> queuedJobs;
+  std::size_t runningJobs = 0;
+  std::vector<Result> finishedJobs;
+  bool stopping = false;
+
+  std::vector<std::thread> workers;
+};
+
+#endif
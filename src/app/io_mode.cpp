@@ -0,0 +1,38 @@
+#include "io_mode.hpp"
+#include <atomic>
+#include <new>
+
+#ifdef __linux__
+#include <fcntl.h>
+#endif
+
+namespace {
+std::atomic<IoMode> currentIoMode = IoMode::Buffered;
+}
+
+void setIoMode(IoMode mode) { currentIoMode = mode; }
+auto ioMode() -> IoMode { return currentIoMode; }
+
+void AlignedBufferDeleter::operator()(char* data) const {
+  ::operator delete[](data, std::align_val_t{DirectIoAlignment});
+}
+
+auto makeAlignedBuffer(std::size_t size) -> AlignedBuffer {
+  return AlignedBuffer{new (std::align_val_t{DirectIoAlignment}) char[size]};
+}
+
+#ifdef __linux__
+auto openDirect(const char* path, int flags) -> int {
+  if (ioMode() != IoMode::Direct)
+    return -1;
+  return ::open(path, flags | O_DIRECT | O_CLOEXEC);
+}
+
+void dropReadPages(int fd, std::uint64_t offset, std::uint64_t size) {
+  if (ioMode() != IoMode::DontNeed || size == 0)
+    return;
+  // Only advice, a failure leaves the pages cached and changes nothing else.
+  ::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(size),
+                  POSIX_FADV_DONTNEED);
+}
+#endif
@@ -0,0 +1,69 @@
+#ifndef ARCHIVER_IO_MODE_HPP
+#define ARCHIVER_IO_MODE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+// How bulk reads and writes of file contents use the page cache.
+enum class IoMode {
+  // Through the page cache, as normal.
+  Buffered,
+  // Bypassing the page cache with O_DIRECT where the buffer, offset and size
+  // of a read or write are aligned, and through it otherwise.
+  Direct,
+  // Through the page cache, but dropping each window of a file from it once
+  // the window has been read or written, so the pages other programs are
+  // using aren't evicted.
+  DontNeed
+};
+
+// Returns nullopt if name isn't the name of a mode.
+inline auto parseIoMode(std::string_view name) -> std::optional<IoMode> {
+  if (name == "buffered")
+    return IoMode::Buffered;
+  if (name == "direct")
+    return IoMode::Direct;
+  if (name == "dontneed")
+    return IoMode::DontNeed;
+  return std::nullopt;
+}
+
+// The mode is the same for every file the process reads or writes, so it is
+// set once from the configuration when a command starts.
+void setIoMode(IoMode mode);
+auto ioMode() -> IoMode;
+
+// The alignment O_DIRECT needs of buffers, offsets and sizes, which is the
+// largest logical block size in common use.
+inline constexpr std::size_t DirectIoAlignment = 4096;
+
+inline auto isDirectIoAligned(const void* data, std::uint64_t size,
+                              std::uint64_t offset) -> bool {
+  return reinterpret_cast<std::uintptr_t>(data) % DirectIoAlignment == 0 &&
+         size % DirectIoAlignment == 0 && offset % DirectIoAlignment == 0;
+}
+
+struct AlignedBufferDeleter {
+  void operator()(char* data) const;
+};
+using AlignedBuffer = std::unique_ptr<char[], AlignedBufferDeleter>;
+
+// Allocates a buffer which can be used for direct I/O. Throws std::bad_alloc
+// if it can't be allocated.
+auto makeAlignedBuffer(std::size_t size) -> AlignedBuffer;
+
+#ifdef __linux__
+// Opens a second descriptor for the file at path with O_DIRECT added to
+// flags, if the mode is Direct. Returns -1 if the mode isn't Direct or the
+// filesystem doesn't support O_DIRECT, and the file should only be accessed
+// through its first descriptor.
+auto openDirect(const char* path, int flags) -> int;
+
+// Drops a range of a file which has been read from the page cache, if the
+// mode is DontNeed.
+void dropReadPages(int fd, std::uint64_t offset, std::uint64_t size);
+#endif
+
+#endif
@@ -0,0 +1,189 @@
+#include "promotion_journal.hpp"
+#include "copy_engine.hpp"
+#include "util/string_helpers.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <ranges>
+#include <set>
+#include <system_error>
+#include <unistd.h>
+
+namespace {
+constexpr std::string_view journalPrefix = ".promotion_";
+constexpr std::string_view journalSuffix = ".journal";
+constexpr std::string_view renameEntry = "rename";
+constexpr std::string_view copyEntry = "copy";
+
+// Flushes a file, or the entries of a directory, to disk.
+void syncPath(const std::filesystem::path& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1 || ::fsync(fd) == -1) {
+    const std::error_code error{errno, std::system_category()};
+    if (fd != -1)
+      ::close(fd);
+    throw PromotionJournalException("There was an error syncing \"{}\": {}",
+                                    path, error.message());
+  }
+  ::close(fd);
+}
+}
+
+PromotionJournal::PromotionJournal(
+  const std::filesystem::path& archiveDirectoryLocation,
+  ArchiveOperationID archiveOperation)
+  : journalPath(archiveDirectoryLocation / journalName(archiveOperation)) {
+  journal.open(journalPath, std::ios_base::trunc);
+  if (!journal.is_open()) {
+    throw PromotionJournalException(
+      "There was an error creating the promotion journal \"{}\"", journalPath);
+  }
+  syncPath(archiveDirectoryLocation);
+}
+
+void PromotionJournal::promote(const std::filesystem::path& stagedPath,
+                               const std::filesystem::path& archivedPath) {
+  record({MoveType::Rename, stagedPath, archivedPath});
+  std::error_code error;
+  std::filesystem::rename(stagedPath, archivedPath, error);
+  if (!error)
+    return;
+  if (error != std::errc::cross_device_link) {
+    throw PromotionJournalException(
+      "There was an error moving \"{}\" to \"{}\": {}", stagedPath,
+      archivedPath, error.message());
+  }
+
+  record({MoveType::Copy, stagedPath, archivedPath});
+  const auto strategy = copyFile(stagedPath, archivedPath);
+  syncPath(archivedPath);
+  spdlog::debug("Copied \"{}\" to \"{}\" across filesystems using {}",
+                stagedPath, archivedPath, copyStrategyName(strategy));
+}
+
+void PromotionJournal::sync() {
+  // New archive directories are entries of the archive directory itself.
+  std::set<std::filesystem::path> directories{journalPath.parent_path()};
+  for (const auto& move : moves)
+    directories.insert(move.archivedPath.parent_path());
+  for (const auto& directory : directories)
+    syncPath(directory);
+}
+
+void PromotionJournal::complete() {
+  complete(moves);
+  moves.clear();
+  journal.close();
+  std::filesystem::remove(journalPath);
+}
+
+void PromotionJournal::rollback() {
+  rollback(moves);
+  moves.clear();
+  journal.close();
+  std::filesystem::remove(journalPath);
+}
+
+void PromotionJournal::recover(
+  const std::filesystem::path& archiveDirectoryLocation,
+  const std::function<bool(ArchiveOperationID)>& isCommitted) {
+  // The archive directory is only created once something is archived.
+  if (!std::filesystem::exists(archiveDirectoryLocation))
+    return;
+  std::vector<std::filesystem::path> journalPaths;
+  for (const auto& entry :
+       std::filesystem::directory_iterator(archiveDirectoryLocation)) {
+    const auto fileName = entry.path().filename().string();
+    if (entry.is_regular_file() && fileName.starts_with(journalPrefix) &&
+        fileName.ends_with(journalSuffix))
+      journalPaths.push_back(entry.path());
+  }
+
+  for (const auto& path : journalPaths) {
+    const auto fileName = path.filename().string();
+    const auto archiveOperation = [&]() -> std::optional<ArchiveOperationID> {
+      try {
+        return std::stoull(std::string{
+          removeSuffix(removePrefix(fileName, journalPrefix), journalSuffix)});
+      } catch (const std::logic_error&) {
+        return std::nullopt;
+      }
+    }();
+    if (!archiveOperation) {
+      spdlog::warn("Ignoring unrecognized promotion journal \"{}\"", path);
+      continue;
+    }
+
+    // An entry is only acted on after it has been fully written, so a partial
+    // entry at the end of the journal can be ignored.
+    std::vector<Move> moves;
+    std::ifstream journal(path);
+    std::string type, stagedPath, archivedPath;
+    while (std::getline(journal, type) && std::getline(journal, stagedPath) &&
+           std::getline(journal, archivedPath)) {
+      moves.push_back(
+        {type == copyEntry ? MoveType::Copy : MoveType::Rename,
+         stagedPath, archivedPath});
+    }
+    journal.close();
+
+    if (isCommitted(*archiveOperation)) {
+      spdlog::info("Completing promotion journal for archive operation {}",
+                   *archiveOperation);
+      complete(moves);
+    } else {
+      spdlog::info("Rolling back promotion journal for archive operation {}",
+                   *archiveOperation);
+      rollback(moves);
+    }
+    std::filesystem::remove(path);
+  }
+}
+
+void PromotionJournal::record(const Move& move) {
+  journal << (move.type == MoveType::Copy ? copyEntry : renameEntry) << '\n'
+          << move.stagedPath.string() << '\n'
+          << move.archivedPath.string() << std::endl;
+  if (journal.bad()) {
+    throw PromotionJournalException(
+      "There was an error writing the promotion journal \"{}\"", journalPath);
+  }
+  // The entry has to reach the disk before the move does, or a crash could
+  // leave a move which recover() doesn't know to undo.
+  syncPath(journalPath);
+  moves.push_back(move);
+}
+
+void PromotionJournal::complete(const std::vector<Move>& moves) {
+  for (const auto& move : moves) {
+    if (move.type != MoveType::Copy)
+      continue;
+    std::error_code error;
+    std::filesystem::remove(move.stagedPath, error);
+    if (error) {
+      spdlog::warn("Unable to remove promoted staged file \"{}\": {}",
+                   move.stagedPath, error.message());
+    }
+  }
+}
+
+void PromotionJournal::rollback(const std::vector<Move>& moves) {
+  for (const auto& move : std::views::reverse(moves)) {
+    std::error_code error;
+    if (move.type == MoveType::Copy) {
+      std::filesystem::remove(move.archivedPath, error);
+    } else if (std::filesystem::exists(move.archivedPath) &&
+               !std::filesystem::exists(move.stagedPath)) {
+      std::filesystem::rename(move.archivedPath, move.stagedPath, error);
+    }
+    if (error) {
+      spdlog::error("Unable to undo the promotion of \"{}\" to \"{}\": {}",
+                    move.stagedPath, move.archivedPath, error.message());
+    }
+  }
+}
+
+auto PromotionJournal::journalName(ArchiveOperationID archiveOperation)
+  -> std::string {
+  return FORMAT_LIB::format("{}{}{}", journalPrefix, archiveOperation,
+                            journalSuffix);
+}
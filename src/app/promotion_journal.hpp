@@ -0,0 +1,73 @@
+#ifndef ARCHIVER_PROMOTION_JOURNAL_HPP
+#define ARCHIVER_PROMOTION_JOURNAL_HPP
+
+#include "archive_operation.hpp"
+#include "common.h"
+#include <fstream>
+#include <functional>
+
+// Moves staged files into the archive directory for an archive operation,
+// recording each move in a journal file before it is made. Until the archive
+// operation is committed the moves can be undone, either by rollback() or, if
+// the process dies, by recover() the next time the archive directory is used.
+//
+// Files are renamed when the stage and archive directories are on the same
+// filesystem. Otherwise the file is copied and the staged file is only removed
+// once the archive operation has been committed.
+//
+// Each journal entry is synced to disk before its move is made, so the moves
+// can also be undone after a crash. sync() has to be called before the archive
+// operation is committed, so that the moves survive a crash after it.
+class PromotionJournal {
+public:
+  PromotionJournal(const std::filesystem::path& archiveDirectoryLocation,
+                   ArchiveOperationID archiveOperation);
+
+  void promote(const std::filesystem::path& stagedPath,
+               const std::filesystem::path& archivedPath);
+  // Syncs the directories the files were moved into to disk.
+  void sync();
+  // Finishes the moves once the archive operation has been committed.
+  void complete();
+  // Undoes the moves made so far, restoring the staged files.
+  void rollback();
+
+  // Completes or rolls back the journals left in the archive directory by
+  // interrupted archive operations, depending on whether isCommitted reports
+  // that their archive operation made it into the database. This assumes no
+  // other archive operation is using the archive directory at the same time.
+  // Does nothing if the archive directory doesn't exist yet.
+  static void recover(
+    const std::filesystem::path& archiveDirectoryLocation,
+    const std::function<bool(ArchiveOperationID)>& isCommitted);
+
+  PromotionJournal() = delete;
+  PromotionJournal(const PromotionJournal&) = delete;
+  PromotionJournal(PromotionJournal&&) = default;
+  ~PromotionJournal() = default;
+
+  PromotionJournal& operator=(const PromotionJournal&) = delete;
+  PromotionJournal& operator=(PromotionJournal&&) = default;
+
+private:
+  enum class MoveType { Rename, Copy };
+  struct Move {
+    MoveType type;
+    std::filesystem::path stagedPath;
+    std::filesystem::path archivedPath;
+  };
+
+  std::filesystem::path journalPath;
+  std::ofstream journal;
+  std::vector<Move> moves;
+
+  void record(const Move& move);
+
+  static void complete(const std::vector<Move>& moves);
+  static void rollback(const std::vector<Move>& moves);
+  static auto journalName(ArchiveOperationID archiveOperation) -> std::string;
+};
+
+_make_exception_(PromotionJournalException);
+
+#endif
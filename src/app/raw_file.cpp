@@ -1,9 +1,87 @@
 #include "raw_file.hpp"
-#include <Hash/src/blake2.h>
-#include <Hash/src/sha3.h>
-#include <fstream>
+#include "copy_engine.hpp"
+#include "file_reader.hpp"
+#include "file_writer.hpp"
+#include "read_pipeline.hpp"
+#include "tree_hash.hpp"
 
-RawFile::RawFile(const std::filesystem::path& path, std::span<char> buffer) {
+RawFile::RawFile(const std::filesystem::path& path, std::span<char> buffer,
+                 HashPolicy policy)
+  : path(path) {
+  withHashingPolicy(policy, [&]<typename Policy>(Policy) {
+    read<Policy>(buffer, nullptr);
+  });
+}
+
+RawFile::RawFile(const std::filesystem::path& path, std::span<char> buffer,
+                 const std::filesystem::path& copyPath, HashPolicy policy)
+  : path(path) {
+  withHashingPolicy(policy, [&]<typename Policy>(Policy) {
+    read<Policy>(buffer, &copyPath);
+  });
+}
+
+RawFile::RawFile(const std::filesystem::path& path, std::span<char> buffer,
+                 HashPolicy policy, HashAlgorithm algorithm)
+  : path(path) {
+  withHashingPolicy(policy, [&]<typename Policy>(Policy) {
+    read<Policy>(buffer, nullptr, algorithm);
+  });
+}
+
+RawFile::RawFile(const std::filesystem::path& path, std::span<char> buffer,
+                 const std::filesystem::path& copyPath, HashPolicy policy,
+                 HashAlgorithm algorithm)
+  : path(path) {
+  withHashingPolicy(policy, [&]<typename Policy>(Policy) {
+    read<Policy>(buffer, &copyPath, algorithm);
+  });
+}
+
+RawFile::RawFile(const std::filesystem::path& path, std::uint64_t size,
+                 const FastHash& fastHash, const std::optional<FileHash>& hash)
+  : size(size), fastHash(fastHash), hash(hash), path(path),
+    hashAlgorithm(tree_hash::algorithmFor(size)) {}
+
+auto RawFile::fromContents(const std::filesystem::path& path,
+                           std::span<const char> contents, HashPolicy policy)
+  -> RawFile {
+  return hashContents(path, contents, nullptr, policy);
+}
+
+auto RawFile::fromContents(const std::filesystem::path& path,
+                           std::span<const char> contents,
+                           const std::filesystem::path& copyPath,
+                           HashPolicy policy) -> RawFile {
+  return hashContents(path, contents, &copyPath, policy);
+}
+
+auto RawFile::hashContents(const std::filesystem::path& path,
+                           std::span<const char> contents,
+                           const std::filesystem::path* copyPath,
+                           HashPolicy policy) -> RawFile {
+  if (copyPath) {
+    FileWriter copyWriter{*copyPath};
+    copyWriter.write(contents, 0);
+    copyWriter.finish(contents.size());
+    std::filesystem::permissions(*copyPath,
+                                 std::filesystem::status(path).permissions());
+  }
+  return withHashingPolicy(policy, [&]<typename Policy>(Policy) {
+    ContentHasher<Policy> hasher;
+    for (const auto& consumer : hasher.consumers())
+      consumer(contents);
+    RawFile file{path, contents.size(), hasher.finalizeFastHash(),
+                 hasher.finalizeHash()};
+    file.hashAlgorithm = HashAlgorithm::Linear;
+    return file;
+  });
+}
+
+template <HashingPolicy Policy>
+void RawFile::read(std::span<char> buffer,
+                   const std::filesystem::path* copyPath,
+                   std::optional<HashAlgorithm> algorithm) {
   if (buffer.size() >
       static_cast<std::size_t>(std::numeric_limits<std::streamsize>::max()))
     throw std::logic_error(
@@ -16,30 +94,72 @@ RawFile::RawFile(const std::filesystem::path& path, std::span<char> buffer) {
     throw NotAFile("The path \"{}\" is not a file", path);
   }
 
-  std::basic_ifstream<char> inputStream(path, std::ios_base::binary);
-
-  if (inputStream.bad() || !inputStream.is_open()) {
-    throw FileException("There was an error opening \"{}\" for reading", path);
+  hashAlgorithm = algorithm.value_or(
+    tree_hash::algorithmFor(std::filesystem::file_size(path)));
+  if (hashAlgorithm == HashAlgorithm::Linear) {
+    readLinear<Policy>(buffer, copyPath);
+    return;
   }
 
-  Chocobo1::SHA3_512 sha3;
-  Chocobo1::Blake2 blake2B;
+  // The copy is hashed, rather than the file, so the hash is of what was
+  // copied even if the file changes while it is being copied.
+  if (copyPath) {
+    std::filesystem::remove(*copyPath);
+    copyFile(path, *copyPath, buffer);
+  }
+  const auto digests =
+    tree_hash::hashFile<Policy>(copyPath ? *copyPath : path, buffer);
+  size = digests.size;
+  fastHash = digests.fastHash;
+  hash = digests.hash;
+}
 
-  while (!inputStream.eof()) {
-    inputStream.read(buffer.data(),
-                     static_cast<std::streamsize>(buffer.size()));
+template <HashingPolicy Policy>
+void RawFile::readLinear(std::span<char> buffer,
+                         const std::filesystem::path* copyPath) {
+  FileReader reader{path};
 
-    if (inputStream.bad()) {
-      throw FileException("There was an error reading \"{}\"", path);
-    }
+  std::optional<FileWriter> copyWriter;
+  if (copyPath)
+    copyWriter.emplace(*copyPath);
 
-    Size read = static_cast<Size>(inputStream.gcount());
+  ContentHasher<Policy> hasher;
 
-    sha3.addData(buffer.data(), read);
-    blake2B.addData(buffer.data(), read);
+  std::uint64_t readOffset = 0;
+  const auto readChunk = [&](std::span<char> chunk) -> std::size_t {
+    const auto read = reader.read(chunk, readOffset);
+    readOffset += read;
+    return read;
+  };
+  auto consumers = hasher.consumers();
+  // The copy of a sparse file skips the blocks of zeros, which leaves holes
+  // where the file has them.
+  const auto sparseCopy = reader.isSparse();
+  std::uint64_t writeOffset = 0;
+  if (copyWriter) {
+    consumers.push_back([&](std::span<const char> data) {
+      if (!sparseCopy) {
+        copyWriter->write(data, writeOffset);
+        writeOffset += data.size();
+        return;
+      }
+      forEachZeroRun(data, ReadPipeline::SlotAlignment,
+                     [&](std::span<const char> run, bool isZeros) {
+                       if (!isZeros)
+                         copyWriter->write(run, writeOffset);
+                       writeOffset += run.size();
+                     });
+    });
   }
 
-  this->hash = sha3.finalize().toString() + blake2B.finalize().toString();
-  this->size = std::filesystem::file_size(path);
-  this->path = path;
-}
\ No newline at end of file
+  this->size = ReadPipeline(buffer).run(readChunk, consumers);
+  this->fastHash = hasher.finalizeFastHash();
+  this->hash = hasher.finalizeHash();
+
+  if (copyWriter) {
+    // Setting the size also extends the copy over a hole at the end.
+    copyWriter->finish(this->size);
+    std::filesystem::permissions(*copyPath,
+                                 std::filesystem::status(path).permissions());
+  }
+}
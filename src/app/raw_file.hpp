@@ -2,6 +2,9 @@
 #define ARCHIVER_RAW_FILE_HPP
 
 #include "common.h"
+#include "content_hasher.hpp"
+#include "file_hash.hpp"
+#include <optional>
 #include <span>
 
 _make_exception_(FileDoesNotExist);
@@ -11,9 +14,58 @@ _make_exception_(FileException);
 struct RawFile {
 public:
   std::uint64_t size;
-  std::string hash;
+  FastHash fastHash;
+  // Not set if the file was hashed under the tiered policy.
+  std::optional<FileHash> hash;
   std::filesystem::path path;
+  HashAlgorithm hashAlgorithm = HashAlgorithm::Linear;
 
-  RawFile(const std::filesystem::path& path, std::span<char> buffer);
+  // Files of at least tree_hash::MinFileSize bytes are tree hashed, others
+  // are hashed linearly.
+  RawFile(const std::filesystem::path& path, std::span<char> buffer,
+          HashPolicy policy = HashPolicy::Full);
+  // Hashes the file and writes a copy of it to copyPath from the same reads,
+  // so the file is only read once. A file which is tree hashed is copied
+  // first and the copy is hashed instead. copyPath is overwritten if it
+  // exists.
+  RawFile(const std::filesystem::path& path, std::span<char> buffer,
+          const std::filesystem::path& copyPath,
+          HashPolicy policy = HashPolicy::Full);
+  // Hashes the file with the given algorithm whatever its size, such as to
+  // check it against hashes computed before.
+  RawFile(const std::filesystem::path& path, std::span<char> buffer,
+          HashPolicy policy, HashAlgorithm algorithm);
+  // The same as the above, but also writes a copy of the file to copyPath.
+  RawFile(const std::filesystem::path& path, std::span<char> buffer,
+          const std::filesystem::path& copyPath, HashPolicy policy,
+          HashAlgorithm algorithm);
+  // A file whose hashes are already known, such as from a HashCache. The file
+  // isn't read.
+  RawFile(const std::filesystem::path& path, std::uint64_t size,
+          const FastHash& fastHash, const std::optional<FileHash>& hash);
+
+  // Hashes the contents of a file which has already been read whole, such as
+  // by a SmallFileReader. The file isn't read again.
+  static auto fromContents(const std::filesystem::path& path,
+                           std::span<const char> contents,
+                           HashPolicy policy = HashPolicy::Full) -> RawFile;
+  // The same as the above, but also writes the contents to copyPath, which is
+  // overwritten if it exists.
+  static auto fromContents(const std::filesystem::path& path,
+                           std::span<const char> contents,
+                           const std::filesystem::path& copyPath,
+                           HashPolicy policy = HashPolicy::Full) -> RawFile;
+
+private:
+  template <HashingPolicy Policy>
+  void read(std::span<char> buffer, const std::filesystem::path* copyPath,
+            std::optional<HashAlgorithm> algorithm = std::nullopt);
+  template <HashingPolicy Policy>
+  void readLinear(std::span<char> buffer,
+                  const std::filesystem::path* copyPath);
+  static auto hashContents(const std::filesystem::path& path,
+                           std::span<const char> contents,
+                           const std::filesystem::path* copyPath,
+                           HashPolicy policy) -> RawFile;
 };
 #endif
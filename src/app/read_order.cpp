@@ -0,0 +1,64 @@
+#include "read_order.hpp"
+#include <array>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+// Returns the physical offset of the first extent of the open file, if the
+// filesystem can report it and the extent has been allocated.
+auto firstExtentOffset(int fd) -> std::optional<std::uint64_t> {
+  // Room for the request and the one extent asked for.
+  alignas(fiemap) std::array<char, sizeof(fiemap) + sizeof(fiemap_extent)>
+    storage{};
+  auto* const request = reinterpret_cast<fiemap*>(storage.data());
+  request->fm_start = 0;
+  request->fm_length = FIEMAP_MAX_OFFSET;
+  request->fm_extent_count = 1;
+  if (::ioctl(fd, FS_IOC_FIEMAP, request) != 0 ||
+      request->fm_mapped_extents == 0)
+    return std::nullopt;
+  const auto& extent = request->fm_extents[0];
+  if (extent.fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DATA_INLINE |
+                         FIEMAP_EXTENT_NOT_ALIGNED))
+    return std::nullopt;
+  return extent.fe_physical;
+}
+}
+
+auto physicalLocation(const std::filesystem::path& path) -> PhysicalLocation {
+  struct stat status;
+  const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+  if (fd < 0) {
+    // A file which can't be opened, such as one without read permission, can
+    // still be located by its inode.
+    if (::stat(path.c_str(), &status) != 0)
+      return {};
+    return {static_cast<std::uint64_t>(status.st_dev), true,
+            static_cast<std::uint64_t>(status.st_ino)};
+  }
+
+  PhysicalLocation location;
+  if (::fstat(fd, &status) == 0) {
+    location.device = static_cast<std::uint64_t>(status.st_dev);
+    location.offset = static_cast<std::uint64_t>(status.st_ino);
+    if (const auto offset = firstExtentOffset(fd)) {
+      location.isInode = false;
+      location.offset = *offset;
+    }
+  }
+  ::close(fd);
+  return location;
+}
+#else
+// Without a portable way to find either, every file has the same location,
+// which leaves them in the order they were found.
+auto physicalLocation(const std::filesystem::path&) -> PhysicalLocation {
+  return {};
+}
+#endif
@@ -0,0 +1,71 @@
+#ifndef ARCHIVER_READ_ORDER_HPP
+#define ARCHIVER_READ_ORDER_HPP
+
+#include "common.h"
+#include <algorithm>
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// The order files found by walking a directory are read in when staging.
+enum class ReadOrder {
+  // The order the walk finds them in.
+  Walk,
+  // The order their data is laid out on disk, so a spinning disk seeks as
+  // little as possible between them.
+  Physical
+};
+
+// Returns nullopt if name isn't the name of an order.
+inline auto parseReadOrder(std::string_view name) -> std::optional<ReadOrder> {
+  if (name == "walk")
+    return ReadOrder::Walk;
+  if (name == "physical")
+    return ReadOrder::Physical;
+  return std::nullopt;
+}
+
+// Where the data of a file starts on its device. Files whose first extent can
+// be found with FIEMAP are located by its physical offset, and the others,
+// such as files on filesystems which can't report extents, empty files, and
+// files whose data is still to be allocated, are located by their inode
+// number instead, which most filesystems allocate roughly in the same order as
+// their data. The two kinds of location can't be compared, so files located by
+// inode come after those located by extent.
+struct PhysicalLocation {
+  std::uint64_t device = 0;
+  bool isInode = true;
+  std::uint64_t offset = 0;
+
+  friend auto operator<=>(const PhysicalLocation&,
+                          const PhysicalLocation&) = default;
+};
+
+// Files which can't be looked up, such as files which no longer exist, are
+// given the first location, and fail when they are read instead.
+auto physicalLocation(const std::filesystem::path& path) -> PhysicalLocation;
+
+// Sorts items by the physical location of the file projection(item) is the
+// path of. Items with the same location keep their order.
+template <typename T, typename Projection>
+void sortByPhysicalLocation(std::vector<T>& items, Projection projection) {
+  std::vector<std::pair<PhysicalLocation, std::size_t>> locations;
+  locations.reserve(items.size());
+  for (std::size_t i = 0; i < items.size(); ++i)
+    locations.emplace_back(
+      physicalLocation(std::invoke(projection, items[i])), i);
+  std::ranges::stable_sort(locations, {},
+                           &std::pair<PhysicalLocation, std::size_t>::first);
+
+  std::vector<T> sorted;
+  sorted.reserve(items.size());
+  for (const auto& [location, index] : locations)
+    sorted.push_back(std::move(items[index]));
+  items = std::move(sorted);
+}
+
+#endif
@@ -0,0 +1,157 @@
+#include "read_pipeline.hpp"
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+ReadPipeline::ReadPipeline(std::span<char> buffer) : buffer(buffer) {
+  void* start = buffer.data();
+  std::size_t space = buffer.size();
+  if (!std::align(SlotAlignment, SlotAlignment, start, space))
+    return;
+
+  // At least two slots are needed for reading and processing to overlap.
+  const auto slotSize =
+    std::min(MaxSlotSize, space / 2) / SlotAlignment * SlotAlignment;
+  if (slotSize == 0)
+    return;
+
+  const auto slotCount = std::min(MaxSlotCount, space / slotSize);
+  auto slotStart = static_cast<char*>(start);
+  for (std::size_t i = 0; i < slotCount; ++i, slotStart += slotSize)
+    slots.emplace_back(slotStart, slotSize);
+}
+
+auto ReadPipeline::run(const Source& source,
+                       std::span<const Consumer> consumers) -> std::uint64_t {
+  if (slots.empty())
+    return runSequential(source, consumers);
+
+  struct Slot {
+    std::span<char> data;
+    std::size_t size = 0;
+    std::size_t pendingConsumers = 0;
+  };
+  std::vector<Slot> ring;
+  for (const auto slot : slots)
+    ring.push_back({slot});
+
+  // Small inputs are done on this thread, starting threads would cost more
+  // than overlapping the reads would save.
+  ring[0].size = source(ring[0].data);
+  if (ring[0].size < ring[0].data.size()) {
+    const std::span<const char> data{ring[0].data.data(), ring[0].size};
+    for (const auto& consumer : consumers)
+      consumer(data);
+    return data.size();
+  }
+
+  std::mutex mutex;
+  std::condition_variable slotsChanged;
+  // Number of slots which have been filled, consumers process them in order
+  // so slot i is in ring[i % ring.size()].
+  std::uint64_t filledSlots = 1;
+  bool finishedReading = false;
+  bool consumerFailed = false;
+  std::vector<std::exception_ptr> consumerErrors(consumers.size());
+  ring[0].pendingConsumers = consumers.size();
+
+  std::vector<std::thread> workers;
+  for (std::size_t i = 0; i < consumers.size(); ++i) {
+    workers.emplace_back([&, i]() {
+      for (std::uint64_t next = 0;; ++next) {
+        Slot* slot;
+        {
+          std::unique_lock lock(mutex);
+          slotsChanged.wait(
+            lock, [&]() { return next < filledSlots || finishedReading; });
+          if (next >= filledSlots)
+            return;
+          slot = &ring[next % ring.size()];
+        }
+
+        // Once a consumer has failed it keeps releasing slots, without
+        // processing them, so the reader and other consumers can't stall.
+        if (!consumerErrors[i]) {
+          try {
+            consumers[i]({slot->data.data(), slot->size});
+          } catch (...) {
+            consumerErrors[i] = std::current_exception();
+          }
+        }
+
+        {
+          std::lock_guard lock(mutex);
+          --slot->pendingConsumers;
+          consumerFailed = consumerFailed || consumerErrors[i];
+        }
+        slotsChanged.notify_all();
+      }
+    });
+  }
+
+  std::uint64_t bytesRead = ring[0].size;
+  std::exception_ptr sourceError;
+  for (bool lastSlot = false; !lastSlot;) {
+    auto& slot = ring[filledSlots % ring.size()];
+    {
+      std::unique_lock lock(mutex);
+      slotsChanged.wait(lock, [&]() {
+        return slot.pendingConsumers == 0 || consumerFailed;
+      });
+      if (consumerFailed)
+        break;
+    }
+
+    try {
+      slot.size = source(slot.data);
+    } catch (...) {
+      sourceError = std::current_exception();
+      break;
+    }
+    if (slot.size == 0)
+      break;
+    lastSlot = slot.size < slot.data.size();
+    bytesRead += slot.size;
+
+    {
+      std::lock_guard lock(mutex);
+      slot.pendingConsumers = consumers.size();
+      ++filledSlots;
+    }
+    slotsChanged.notify_all();
+  }
+
+  {
+    std::lock_guard lock(mutex);
+    finishedReading = true;
+  }
+  slotsChanged.notify_all();
+  for (auto& worker : workers)
+    worker.join();
+
+  if (sourceError)
+    std::rethrow_exception(sourceError);
+  for (const auto& error : consumerErrors)
+    if (error)
+      std::rethrow_exception(error);
+
+  return bytesRead;
+}
+
+auto ReadPipeline::runSequential(const Source& source,
+                                 std::span<const Consumer> consumers)
+  -> std::uint64_t {
+  std::uint64_t bytesRead = 0;
+  for (bool lastRead = false; !lastRead && !buffer.empty();) {
+    const auto read = source(buffer);
+    lastRead = read < buffer.size();
+    bytesRead += read;
+
+    const std::span<const char> data{buffer.data(), read};
+    for (const auto& consumer : consumers)
+      consumer(data);
+  }
+  return bytesRead;
+}
@@ -0,0 +1,50 @@
+#ifndef ARCHIVER_READ_PIPELINE_HPP
+#define ARCHIVER_READ_PIPELINE_HPP
+
+#include "common.h"
+#include <functional>
+#include <span>
+
+// Streams the contents of a file to a set of consumers while overlapping the
+// reads with the processing. The read buffer is split into a ring of aligned
+// slots; the calling thread fills the slots and each consumer works through
+// them on its own thread, so a slot is reused once every consumer is done
+// with it. Inputs which fit in a single slot are handled on the calling thread
+// without starting any threads.
+class ReadPipeline {
+public:
+  // Fills as much of the given buffer as it can and returns the number of
+  // bytes written. Returning fewer bytes than the size of the buffer signals
+  // the end of the input.
+  using Source = std::function<std::size_t(std::span<char>)>;
+  using Consumer = std::function<void(std::span<const char>)>;
+
+  explicit ReadPipeline(std::span<char> buffer);
+
+  // Passes the whole input to every consumer, in order, and returns the number
+  // of bytes read. An exception thrown by the source or by a consumer stops
+  // the pipeline and is rethrown once all threads have finished.
+  auto run(const Source& source, std::span<const Consumer> consumers)
+    -> std::uint64_t;
+
+  ReadPipeline() = delete;
+  ReadPipeline(const ReadPipeline&) = delete;
+  ReadPipeline(ReadPipeline&&) = default;
+  ~ReadPipeline() = default;
+
+  ReadPipeline& operator=(const ReadPipeline&) = delete;
+  ReadPipeline& operator=(ReadPipeline&&) = default;
+
+  static constexpr std::size_t SlotAlignment = 4096;
+  static constexpr std::size_t MaxSlotSize = 8 * 1024 * 1024;
+  static constexpr std::size_t MaxSlotCount = 8;
+
+private:
+  auto runSequential(const Source& source,
+                     std::span<const Consumer> consumers) -> std::uint64_t;
+
+  std::span<char> buffer;
+  std::vector<std::span<char>> slots;
+};
+
+#endif
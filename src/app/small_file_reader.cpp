@@ -0,0 +1,349 @@
+#include "small_file_reader.hpp"
+#include "io_mode.hpp"
+#include "read_pipeline.hpp"
+#include <algorithm>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+// Opening a file into the ring's file table and reading it in the same chain
+// of requests needs the file of each request to be looked up as it runs.
+#ifdef IORING_FEAT_LINKED_FILE
+#define ARCHIVER_HAS_IO_URING
+#endif
+#endif
+
+namespace {
+// Keeps the ring within the kernel's limit on entries.
+constexpr std::size_t MaxQueueDepth = 1024;
+}
+
+#ifdef ARCHIVER_HAS_IO_URING
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <numeric>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+// Each file is looked up, opened, read and closed by a chain of four requests,
+// which are told apart in their completions by the low bits of their user
+// data. The rest of the user data is the slot the file is read into.
+enum Operation : std::uint64_t { Stat, Open, Read, Close };
+constexpr std::uint64_t OperationBits = 2;
+constexpr std::uint64_t OperationMask = (1 << OperationBits) - 1;
+constexpr std::size_t RequestsPerFile = 4;
+
+auto userData(std::size_t slot, Operation operation) -> std::uint64_t {
+  return (static_cast<std::uint64_t>(slot) << OperationBits) | operation;
+}
+}
+
+struct SmallFileReader::Ring {
+  // Returns nullptr if the kernel doesn't support everything the reader
+  // needs, or has io_uring disabled.
+  static auto create(std::span<char> buffer, std::size_t queueDepth,
+                     std::size_t slotSize) -> std::unique_ptr<Ring>;
+  ~Ring();
+
+  // The entries of the chain for a file are queued together, and submitted by
+  // the next call to submitAndWait.
+  void queueFile(const char* path, std::size_t slot, std::span<char> data,
+                 struct statx& status);
+  // Submits the queued entries and waits for at least one completion.
+  void submitAndWait();
+  template <typename Function> void forEachCompletion(Function&& function);
+
+  int fd = -1;
+  void* submissionMapping = MAP_FAILED;
+  std::size_t submissionMappingSize = 0;
+  void* completionMapping = MAP_FAILED;
+  std::size_t completionMappingSize = 0;
+  io_uring_sqe* entries = nullptr;
+  std::size_t entriesSize = 0;
+
+  unsigned* submissionTail = nullptr;
+  unsigned submissionMask = 0;
+  unsigned* submissionArray = nullptr;
+  unsigned* completionHead = nullptr;
+  unsigned* completionTail = nullptr;
+  unsigned completionMask = 0;
+  io_uring_cqe* completions = nullptr;
+
+  unsigned nextTail = 0;
+  unsigned queued = 0;
+  // Whether the slots are registered with the ring. Registering them locks
+  // their pages in memory, which can go over RLIMIT_MEMLOCK, in which case
+  // the files are read with plain reads instead.
+  bool fixedBuffers = false;
+
+private:
+  auto nextEntry() -> io_uring_sqe&;
+};
+
+auto SmallFileReader::Ring::create(std::span<char> buffer,
+                                   std::size_t queueDepth,
+                                   std::size_t slotSize)
+  -> std::unique_ptr<Ring> {
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  const auto ringFd =
+    static_cast<int>(::syscall(__NR_io_uring_setup,
+                               queueDepth * RequestsPerFile, &params));
+  if (ringFd < 0)
+    return nullptr;
+  auto ring = std::make_unique<Ring>();
+  ring->fd = ringFd;
+  if (!(params.features & IORING_FEAT_LINKED_FILE))
+    return nullptr;
+
+  ring->submissionMappingSize =
+    params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->completionMappingSize =
+    params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const auto singleMapping = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (singleMapping) {
+    ring->submissionMappingSize = ring->completionMappingSize = std::max(
+      ring->submissionMappingSize, ring->completionMappingSize);
+  }
+  ring->submissionMapping =
+    ::mmap(nullptr, ring->submissionMappingSize, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+  if (ring->submissionMapping == MAP_FAILED)
+    return nullptr;
+  if (!singleMapping) {
+    ring->completionMapping =
+      ::mmap(nullptr, ring->completionMappingSize, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    if (ring->completionMapping == MAP_FAILED)
+      return nullptr;
+  }
+  ring->entriesSize = params.sq_entries * sizeof(io_uring_sqe);
+  const auto entries =
+    ::mmap(nullptr, ring->entriesSize, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+  if (entries == MAP_FAILED)
+    return nullptr;
+  ring->entries = static_cast<io_uring_sqe*>(entries);
+
+  const auto submission = static_cast<char*>(ring->submissionMapping);
+  const auto completion = static_cast<char*>(
+    singleMapping ? ring->submissionMapping : ring->completionMapping);
+  ring->submissionTail =
+    reinterpret_cast<unsigned*>(submission + params.sq_off.tail);
+  ring->submissionMask =
+    *reinterpret_cast<unsigned*>(submission + params.sq_off.ring_mask);
+  ring->submissionArray =
+    reinterpret_cast<unsigned*>(submission + params.sq_off.array);
+  ring->completionHead =
+    reinterpret_cast<unsigned*>(completion + params.cq_off.head);
+  ring->completionTail =
+    reinterpret_cast<unsigned*>(completion + params.cq_off.tail);
+  ring->completionMask =
+    *reinterpret_cast<unsigned*>(completion + params.cq_off.ring_mask);
+  ring->completions =
+    reinterpret_cast<io_uring_cqe*>(completion + params.cq_off.cqes);
+  ring->nextTail = *ring->submissionTail;
+
+  // Registering the slots saves mapping their pages for every read, and an
+  // empty file table gives each slot a place for its file to be opened into.
+  std::vector<iovec> slots(queueDepth);
+  for (std::size_t i = 0; i < queueDepth; ++i)
+    slots[i] = iovec{buffer.data() + i * slotSize, slotSize};
+  ring->fixedBuffers =
+    ::syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS,
+              slots.data(), static_cast<unsigned>(slots.size())) == 0;
+  const std::vector<int> files(queueDepth, -1);
+  if (::syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_FILES,
+                files.data(), static_cast<unsigned>(files.size())) != 0)
+    return nullptr;
+  return ring;
+}
+
+SmallFileReader::Ring::~Ring() {
+  if (entries)
+    ::munmap(entries, entriesSize);
+  if (completionMapping != MAP_FAILED)
+    ::munmap(completionMapping, completionMappingSize);
+  if (submissionMapping != MAP_FAILED)
+    ::munmap(submissionMapping, submissionMappingSize);
+  if (fd >= 0)
+    ::close(fd);
+}
+
+auto SmallFileReader::Ring::nextEntry() -> io_uring_sqe& {
+  const auto index = nextTail++ & submissionMask;
+  submissionArray[index] = index;
+  ++queued;
+  auto& entry = entries[index];
+  std::memset(&entry, 0, sizeof(entry));
+  return entry;
+}
+
+void SmallFileReader::Ring::queueFile(const char* path, std::size_t slot,
+                                      std::span<char> data,
+                                      struct statx& status) {
+  // If the file can't be looked up or opened the rest of the chain is
+  // cancelled. The read is hard linked to the close, so the file is closed
+  // even if the read fails or is short, which it is for every file smaller
+  // than its slot.
+  auto& stat = nextEntry();
+  stat.opcode = IORING_OP_STATX;
+  stat.flags = IOSQE_IO_LINK;
+  stat.fd = AT_FDCWD;
+  stat.addr = reinterpret_cast<std::uintptr_t>(path);
+  stat.len = STATX_TYPE | STATX_SIZE;
+  stat.off = reinterpret_cast<std::uintptr_t>(&status);
+  stat.user_data = userData(slot, Stat);
+
+  auto& open = nextEntry();
+  open.opcode = IORING_OP_OPENAT;
+  open.flags = IOSQE_IO_LINK;
+  open.fd = AT_FDCWD;
+  open.addr = reinterpret_cast<std::uintptr_t>(path);
+  open.open_flags = O_RDONLY;
+  open.file_index = static_cast<std::uint32_t>(slot + 1);
+  open.user_data = userData(slot, Open);
+
+  auto& read = nextEntry();
+  read.opcode = fixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+  read.flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+  read.fd = static_cast<std::int32_t>(slot);
+  read.addr = reinterpret_cast<std::uintptr_t>(data.data());
+  read.len = static_cast<std::uint32_t>(data.size());
+  read.off = 0;
+  if (fixedBuffers)
+    read.buf_index = static_cast<std::uint16_t>(slot);
+  read.user_data = userData(slot, Read);
+
+  auto& close = nextEntry();
+  close.opcode = IORING_OP_CLOSE;
+  close.file_index = static_cast<std::uint32_t>(slot + 1);
+  close.user_data = userData(slot, Close);
+}
+
+void SmallFileReader::Ring::submitAndWait() {
+  std::atomic_ref{*submissionTail}.store(nextTail, std::memory_order_release);
+  while (true) {
+    const auto result = ::syscall(__NR_io_uring_enter, fd, queued, 1,
+                                  IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (result >= 0) {
+      queued -= static_cast<unsigned>(result);
+      if (queued == 0)
+        return;
+    } else if (errno != EINTR) {
+      throw SmallFileReaderException(
+        "There was an error submitting reads to io_uring : {}",
+        std::strerror(errno));
+    }
+  }
+}
+
+template <typename Function>
+void SmallFileReader::Ring::forEachCompletion(Function&& function) {
+  auto head = *completionHead;
+  const auto tail =
+    std::atomic_ref{*completionTail}.load(std::memory_order_acquire);
+  for (; head != tail; ++head) {
+    const auto& completion = completions[head & completionMask];
+    function(completion.user_data, completion.res);
+  }
+  std::atomic_ref{*completionHead}.store(head, std::memory_order_release);
+}
+
+void SmallFileReader::read(std::span<const std::filesystem::path> paths,
+                           const Callback& onRead) {
+  if (!ring || ioMode() != IoMode::Buffered)
+    return;
+
+  std::vector<std::size_t> freeSlots(queueDepth);
+  std::iota(freeSlots.rbegin(), freeSlots.rend(), 0);
+  std::vector<std::size_t> slotFiles(queueDepth);
+  std::vector<int> slotReads(queueDepth);
+  std::vector<struct statx> slotStatus(queueDepth);
+  const auto slotData = [&](std::size_t slot) {
+    return buffer.subspan(slot * readSlotSize, readSlotSize);
+  };
+
+  std::size_t nextFile = 0;
+  std::size_t inFlight = 0;
+  std::exception_ptr error;
+  while (inFlight > 0 || (nextFile < paths.size() && !error)) {
+    for (; nextFile < paths.size() && !error && !freeSlots.empty();
+         ++nextFile) {
+      const auto slot = freeSlots.back();
+      freeSlots.pop_back();
+      slotFiles[slot] = nextFile;
+      slotReads[slot] = -1;
+      slotStatus[slot] = {};
+      ring->queueFile(paths[nextFile].c_str(), slot, slotData(slot),
+                      slotStatus[slot]);
+      ++inFlight;
+    }
+    ring->submitAndWait();
+    ring->forEachCompletion([&](std::uint64_t data, int result) {
+      const auto slot = static_cast<std::size_t>(data >> OperationBits);
+      if ((data & OperationMask) == Read)
+        slotReads[slot] = result;
+      if ((data & OperationMask) != Close)
+        return;
+
+      // The close is always last in the chain, even if it was cancelled, so
+      // the slot is finished with. A file which isn't regular, is too large
+      // for its slot, or changed size while it was read is left to be read
+      // another way.
+      const auto& status = slotStatus[slot];
+      const auto read = static_cast<std::uint64_t>(slotReads[slot]);
+      if (!error && slotReads[slot] >= 0 && S_ISREG(status.stx_mode) &&
+          status.stx_size == read && read < readSlotSize) {
+        try {
+          onRead(slotFiles[slot], slotData(slot).first(read));
+        } catch (...) {
+          error = std::current_exception();
+        }
+      }
+      freeSlots.push_back(slot);
+      --inFlight;
+    });
+  }
+  if (error)
+    std::rethrow_exception(error);
+}
+#else
+struct SmallFileReader::Ring {};
+
+void SmallFileReader::read(std::span<const std::filesystem::path>,
+                           const Callback&) {}
+#endif
+
+SmallFileReader::SmallFileReader(std::span<char> buffer,
+                                 std::size_t queueDepth)
+  : buffer(buffer),
+    queueDepth(std::min({queueDepth, MaxQueueDepth,
+                         buffer.size() / ReadPipeline::SlotAlignment})) {
+  if (this->queueDepth == 0)
+    return;
+  // Larger files gain little from being read together.
+  readSlotSize = std::min(ReadPipeline::MaxSlotSize,
+                          this->buffer.size() / this->queueDepth /
+                            ReadPipeline::SlotAlignment *
+                            ReadPipeline::SlotAlignment);
+#ifdef ARCHIVER_HAS_IO_URING
+  ring = Ring::create(this->buffer, this->queueDepth, readSlotSize);
+  if (!ring) {
+    spdlog::info("io_uring isn't available, so small files will be read one "
+                 "at a time");
+  } else if (!ring->fixedBuffers) {
+    spdlog::info("The small file read buffers couldn't be registered with "
+                 "io_uring, which may need a higher RLIMIT_MEMLOCK, so they "
+                 "will be mapped for every read");
+  }
+#endif
+}
+
+SmallFileReader::~SmallFileReader() = default;
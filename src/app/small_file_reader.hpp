@@ -0,0 +1,60 @@
+#ifndef ARCHIVER_SMALL_FILE_READER_HPP
+#define ARCHIVER_SMALL_FILE_READER_HPP
+
+#include "common.h"
+#include <functional>
+#include <memory>
+#include <span>
+
+// Reads the whole of many small files at once through io_uring, so opening,
+// reading and closing each of them doesn't cost a round of syscalls of its
+// own. The buffer is split into one slot per file in flight, which are
+// registered with the ring, and a file is only read whole if it is smaller
+// than a slot.
+//
+// Where io_uring isn't available, such as on kernels older than 5.17 or where
+// it has been disabled, or if the io mode isn't Buffered, no files are read
+// and every file is left to be read one at a time as before.
+class SmallFileReader {
+public:
+  // Called with the index of a file in the paths given to read and its
+  // contents, which are only valid until it returns.
+  using Callback =
+    std::function<void(std::size_t index, std::span<const char> contents)>;
+
+  // Keeps up to queueDepth files in flight, fewer if the buffer doesn't have
+  // room for a slot of at least ReadPipeline::SlotAlignment bytes for each.
+  // The buffer must outlive the reader.
+  SmallFileReader(std::span<char> buffer, std::size_t queueDepth);
+  ~SmallFileReader();
+
+  // Calls onRead for each file which was read whole, in the order they finish.
+  // Files which are too large, or which couldn't be opened or read, are
+  // skipped, and reading them another way reports why. Any exception onRead
+  // throws is rethrown once the files in flight have finished.
+  void read(std::span<const std::filesystem::path> paths,
+            const Callback& onRead);
+
+  auto usesIoUring() const -> bool { return ring != nullptr; }
+  // Files of this size or larger aren't read.
+  auto slotSize() const -> std::size_t { return readSlotSize; }
+
+  SmallFileReader() = delete;
+  SmallFileReader(const SmallFileReader&) = delete;
+  SmallFileReader(SmallFileReader&&) = delete;
+
+  SmallFileReader& operator=(const SmallFileReader&) = delete;
+  SmallFileReader& operator=(SmallFileReader&&) = delete;
+
+private:
+  struct Ring;
+
+  std::span<char> buffer;
+  std::size_t queueDepth = 0;
+  std::size_t readSlotSize = 0;
+  std::unique_ptr<Ring> ring;
+};
+
+_make_exception_(SmallFileReaderException);
+
+#endif
@@ -2,7 +2,9 @@
 #define ARCHIVER_STAGED_FILE_HPP
 
 #include "common.h"
+#include "file_hash.hpp"
 #include "staged_directory.h"
+#include <optional>
 
 using StagedFileID = ID;
 
@@ -11,6 +13,13 @@ struct StagedFile {
   StagedDirectoryID parent;
   std::string name;
   Size size;
-  std::string hash;
+  // Not set if the file was staged under the tiered hash policy and its
+  // cryptographic hash wasn't needed, it is then computed when it is archived.
+  std::optional<FileHash> hash;
+  // Set if no copy of the file was staged, as its contents had already been
+  // archived, so archiving it only records a duplicate revision.
+  bool referenceOnly = false;
+  std::optional<FastHash> fastHash = std::nullopt;
+  HashAlgorithm hashAlgorithm = HashAlgorithm::Linear;
 };
 #endif
@@ -1,16 +1,73 @@
 #include "stager.hpp"
 #include "common.h"
+#include "copy_engine.hpp"
+#include "directory_walker.hpp"
+#include "tree_hash.hpp"
 #include "util/string_helpers.hpp"
 #include <algorithm>
 #include <filesystem>
+#include <iterator>
+#include <random>
 #include <ranges>
 #include <vector>
 
+namespace {
+auto removePathPrefix(const std::filesystem::path& fullPath,
+                      std::string_view prefixToRemove)
+  -> std::filesystem::path {
+  auto stringPath = fullPath.generic_string();
+  std::string_view stringPathView = stringPath;
+  // Need to make a copy because the string that stringPathView is viewing is
+  // local.
+  return {removePrefix(stringPathView, prefixToRemove)};
+}
+
+struct FilesAndStagePaths {
+  std::vector<RawFile> files;
+  std::vector<std::filesystem::path> stagePaths;
+};
+auto splitResults(const std::vector<HashingPool::Result>& results)
+  -> FilesAndStagePaths {
+  FilesAndStagePaths split;
+  split.files.reserve(results.size());
+  split.stagePaths.reserve(results.size());
+  for (const auto& result : results) {
+    split.files.push_back(*result.file);
+    split.stagePaths.push_back(result.job.stagePath);
+  }
+  return split;
+}
+
+// Whether a file is the same as the latest archived revision at the same path.
+// The fast hashes are compared if either cryptographic hash isn't known, which
+// is enough to find whether a file has changed, though not to find whether two
+// different files are the same.
+auto isUnchanged(const ArchivedFileRevision& revision, const RawFile& file)
+  -> bool {
+  if (revision.size != file.size ||
+      revision.hashAlgorithm != file.hashAlgorithm)
+    return false;
+  if (file.hash)
+    return revision.hash == *file.hash;
+  return revision.fastHash == file.fastHash;
+}
+}
+
 Stager::Stager(std::shared_ptr<StagedDatabase>& stagedDatabase,
                std::span<char> fileReadBuffer,
-               const path& stageDirectoryLocation)
+               const path& stageDirectoryLocation, std::size_t workerCount,
+               std::shared_ptr<HashCache> hashCache,
+               std::shared_ptr<ArchivedDatabase> archivedDatabase,
+               HashPolicy hashPolicy, std::size_t readQueueDepth,
+               ReadOrder readOrder, bool checkDuplicates)
   : stagedDatabase(stagedDatabase), readBuffer(fileReadBuffer),
-    stageLocation(stageDirectoryLocation) {}
+    stageLocation(stageDirectoryLocation),
+    partialFilePrefix(
+      FORMAT_LIB::format(".partial_{:08x}_", std::random_device{}())),
+    workerCount(workerCount), hashCache(std::move(hashCache)),
+    archivedDatabase(std::move(archivedDatabase)), hashPolicy(hashPolicy),
+    readQueueDepth(readQueueDepth), readOrder(readOrder),
+    checkDuplicates(checkDuplicates && this->archivedDatabase) {}
 
 void Stager::stage(const std::vector<path>& paths,
                    std::string_view prefixToRemove) {
@@ -18,57 +75,73 @@ void Stager::stage(const std::vector<path>& paths,
   // path that path will be missing a leading forward slash.
   prefixToRemove = removeSuffix(prefixToRemove, "/");
 
-  const auto removePrefix = [&](const path& fullPath) -> path {
-    auto stringPath = fullPath.generic_string();
-    std::string_view stringPathView = stringPath;
-    // Need to make a copy because the string that stringPathView is viewing is
-    // local.
-    return {::removePrefix(stringPathView, prefixToRemove)};
-  };
-
-  const auto stagePath = [&](const path& itemPath) {
-    if (std::filesystem::is_regular_file(itemPath)) {
-      stageFile(itemPath, removePrefix(itemPath));
-    } else if (std::filesystem::is_directory(itemPath))
-      stageDirectory(itemPath, removePrefix(itemPath));
-    else {
-      throw StagerException(
-        "The provided path \"{}\" was neither a regular file or a directory",
-        itemPath);
-    }
-  };
-
+  stagedContents.clear();
+  hardLinks.clear();
+  if (archivedDatabase) {
+    linearRevisionSizes =
+      archivedDatabase->listLinearRevisionSizes(tree_hash::MinFileSize);
+  }
   for (const auto& currentPath : paths) {
     stagedDatabase->startTransaction();
     try {
-      // If path isn't a directory then we need to stage it, and if it is a
-      // directory then we need to stage the root directory before we iterate
-      // through it since recursive_directory_iterator will not visit the root.
-      stagePath(currentPath);
-      if (std::filesystem::is_directory(currentPath)) {
-        std::ranges::for_each(
-          std::filesystem::recursive_directory_iterator(currentPath),
-          stagePath);
+      if (std::filesystem::is_regular_file(currentPath)) {
+        stageFile(currentPath, removePathPrefix(currentPath, prefixToRemove));
+      } else if (std::filesystem::is_directory(currentPath)) {
+        stageDirectory(currentPath,
+                       removePathPrefix(currentPath, prefixToRemove));
+        stageTree(currentPath, prefixToRemove);
+      } else {
+        throw StagerException(
+          "The provided path \"{}\" was neither a regular file or a directory",
+          currentPath);
       }
     } catch (StagerException& err) {
       spdlog::error("Unable to stage \"{}\", skipping. {}", currentPath,
                     err.what());
       stagedDatabase->rollback();
+      removeStagedCopies();
       continue;
     }
     stagedDatabase->commit();
+    stagedCopies.clear();
   }
+  stagedContents.clear();
+  hardLinks.clear();
+  linearRevisionSizes.clear();
+}
+
+void Stager::stageChanged(const std::vector<path>& paths,
+                          std::string_view prefixToRemove) {
+  if (!hashCache || !archivedDatabase) {
+    throw StagerException("Only changed files can't be staged without a hash "
+                          "cache and the archived database");
+  }
+  changedOnly = true;
+  const auto reset = [&]() {
+    changedOnly = false;
+    archivedDirectories.clear();
+    listedArchivedDirectories.clear();
+  };
+  try {
+    stage(paths, prefixToRemove);
+  } catch (...) {
+    reset();
+    throw;
+  }
+  reset();
 }
 
 auto Stager::getDirectoriesSorted() -> std::vector<StagedDirectory> {
-  auto directories = stagedDatabase->listAllDirectories();
-  std::ranges::sort(directories, {}, &StagedDirectory::id);
-  return directories;
+  return stagedDatabase->listAllDirectoriesSorted();
 }
 auto Stager::getFilesSorted() -> std::vector<StagedFile> {
-  auto files = stagedDatabase->listAllFiles();
-  std::ranges::sort(files, {}, &StagedFile::parent);
-  return files;
+  return stagedDatabase->listAllFilesSorted();
+}
+auto Stager::streamDirectoriesSorted() -> Generator<StagedDirectory> {
+  return stagedDatabase->streamDirectoriesSorted();
+}
+auto Stager::streamFilesSorted() -> Generator<StagedFile> {
+  return stagedDatabase->streamFilesSorted();
 }
 
 void Stager::stageDirectory(const std::filesystem::path& path,
@@ -83,22 +156,743 @@ void Stager::stageDirectory(const std::filesystem::path& path,
       "An unknown error occurred while trying to stage directory \"{}\"", path);
   }
 }
+void Stager::stageTree(const std::filesystem::path& root,
+                       std::string_view prefixToRemove) {
+  // Directories are queued for staging as they are listed, which is always
+  // before any of their children are, and files are handed to the hashing
+  // pool. Both are added to the database in batches, directories first, and
+  // everything which touches the database happens on this thread.
+  HashingPool hashingPool{
+    readBuffer, workerCount,
+    [this](const HashingPool::Job& job, std::span<char> buffer) {
+      return copyAndHash(job, buffer);
+    },
+    readQueueDepth,
+    [this](std::span<HashingPool::Result> results, SmallFileReader& reader,
+           std::span<char> buffer) {
+      copyAndHashBatch(results, reader, buffer);
+    }};
+  lastBatchTime = std::chrono::steady_clock::now();
+  try {
+    DirectoryWalker{workerCount}.walk(
+      root, [&](DirectoryWalker::Listing&& listing) {
+        const auto archivedRevisions =
+          changedOnly ? getArchivedRevisions(removePathPrefix(
+                          listing.directory, prefixToRemove))
+                      : std::map<std::string, ArchivedFileRevision>{};
+        std::vector<HashingPool::Result> laterLinks;
+        for (const auto& entry : listing.entries) {
+          const auto stagePath = removePathPrefix(entry.path, prefixToRemove);
+          if (entry.type == DirectoryWalker::EntryType::File) {
+            const auto archivedRevision =
+              archivedRevisions.find(entry.path.filename().string());
+            HashingPool::Job job{entry.path, stagePath, nextPartialPath(),
+                                 archivedRevision == archivedRevisions.end()
+                                   ? std::nullopt
+                                   : std::optional{archivedRevision->second}};
+            job.hardLink = entry.hardLink;
+            if (!entry.hardLink) {
+              submitFound(std::move(job), hashingPool);
+              continue;
+            }
+            auto [hardLink, isFirstLink] =
+              hardLinks.try_emplace(*entry.hardLink);
+            if (hardLink->second.contents) {
+              queueLaterLink(std::move(job), *hardLink->second.contents,
+                             laterLinks);
+            } else if (!isFirstLink) {
+              hardLink->second.waiting.push_back(std::move(job));
+            } else {
+              submitFound(std::move(job), hashingPool);
+            }
+          } else if (entry.type == DirectoryWalker::EntryType::Directory) {
+            pendingDirectories.push_back(stagePath);
+          } else {
+            throw StagerException("The provided path \"{}\" was neither a "
+                                  "regular file or a directory",
+                                  entry.path);
+          }
+        }
+        if (!laterLinks.empty())
+          queueUncopiedFiles(std::move(laterLinks), hashingPool);
+        queueHashedFiles(hashingPool.takeFinished(), hashingPool);
+        if (pendingDirectories.size() + pendingFiles.size() +
+                pendingReferences.size() >=
+              MaxBatchSize ||
+            std::chrono::steady_clock::now() - lastBatchTime >= MaxBatchDelay)
+          addBatch();
+      });
+    submitPlanned(hashingPool);
+    // Finished files can queue others, such as files found to need a copy,
+    // so this keeps going until nothing more has been queued.
+    for (auto results = hashingPool.finish(); !results.empty();
+         results = hashingPool.finish())
+      queueHashedFiles(std::move(results), hashingPool);
+    addBatch();
+  } catch (const DirectoryWalkerException& err) {
+    plannedFiles.clear();
+    discardBatch(hashingPool.finish());
+    throw StagerException("Could not stage directory \"{}\" : {}", root,
+                          err.what());
+  } catch (...) {
+    plannedFiles.clear();
+    discardBatch(hashingPool.finish());
+    throw;
+  }
+}
 void Stager::stageFile(const std::filesystem::path& path,
                        const std::filesystem::path& stagePath) {
+  // The staged copy is made under a temporary name since the ID it is staged
+  // under isn't known until it has been added to the database. The rename
+  // makes the staged copy appear all at once.
+  HashingPool::Job job{path, stagePath, nextPartialPath(), std::nullopt};
   try {
-    RawFile rawFile{path, readBuffer};
-    auto stagedFile = stagedDatabase->add(rawFile, stagePath);
-    std::filesystem::copy(rawFile.path.native(),
-                          stageLocation /
-                            FORMAT_LIB::format("{}", stagedFile.id));
-  } catch (const std::filesystem::filesystem_error& err) {
+    if (changedOnly) {
+      const auto archivedRevisions =
+        getArchivedRevisions(stagePath.parent_path());
+      if (const auto archivedRevision =
+            archivedRevisions.find(stagePath.filename().string());
+          archivedRevision != archivedRevisions.end())
+        job.archivedRevision = archivedRevision->second;
+    }
+    auto rawFile = copyAndHash(job, readBuffer);
+    if (!rawFile) {
+      spdlog::info("Skipping \"{}\" as it hasn't changed since it was "
+                   "archived",
+                   path);
+      return;
+    }
+    if (checkDuplicates) {
+      if (!rawFile->hash &&
+          archivedDatabase->hasRevisionsWithFastHashes({&*rawFile, 1})
+            .front()) {
+        job.hashedFile = std::move(rawFile);
+        job.confirmation = HashingPool::Job::Confirmation::Archived;
+        rawFile = copyAndHash(job, readBuffer);
+      }
+      if (rawFile->hash &&
+          archivedDatabase->hasRevisionsWithContents({&*rawFile, 1}).front()) {
+        stagedDatabase->addReferences({&*rawFile, 1}, {&stagePath, 1});
+        return;
+      }
+      const auto staged = stagedContents.find(contentsOf(*rawFile));
+      if (staged == stagedContents.end() || !staged->second.copyPath ||
+          !linkStagedCopy(*staged->second.copyPath, job.partialPath)) {
+        job.hashedFile = std::move(rawFile);
+        job.confirmation = HashingPool::Job::Confirmation::None;
+        rawFile = copyAndHash(job, readBuffer);
+      } else if (needsConfirmation(job, staged->second)) {
+        job.hashedFile = std::move(rawFile);
+        job.confirmation = HashingPool::Job::Confirmation::Linked;
+        rawFile = copyAndHash(job, readBuffer);
+      }
+    }
+    auto stagedFile = stagedDatabase->add(*rawFile, stagePath);
+    const auto stagedCopyPath =
+      stageLocation / FORMAT_LIB::format("{}", stagedFile.id);
+    std::filesystem::rename(job.partialPath, stagedCopyPath);
+    stagedCopies.push_back(stagedCopyPath);
+    if (checkDuplicates) {
+      stagedContents.try_emplace(contentsOf(*rawFile),
+                                 StagedCopy{stagedCopyPath, job.hardLink});
+    }
+  } catch (...) {
+    throwStageFileError(job, std::current_exception());
+  }
+}
+auto Stager::copyAndHash(const HashingPool::Job& job, std::span<char> buffer)
+  -> std::optional<RawFile> {
+  using Confirmation = HashingPool::Job::Confirmation;
+  // The file is hashed again as it is copied, in case it has changed since.
+  if (job.hashedFile) {
+    switch (job.confirmation) {
+    case Confirmation::Archived:
+      return RawFile{job.path, buffer, HashPolicy::Full,
+                     job.hashedFile->hashAlgorithm};
+    case Confirmation::Linked:
+      return confirmLink(job, buffer);
+    case Confirmation::None:
+      break;
+    }
+    return hashFile(job.path, buffer, job.partialPath, hashPolicy,
+                    job.hashedFile->hashAlgorithm);
+  }
+
+  const auto fingerprint =
+    hashCache ? HashCache::fingerprint(job.path) : std::nullopt;
+  std::optional<RawFile> cachedFile;
+  if (stageCachedFile(job, fingerprint, buffer, cachedFile))
+    return cachedFile;
+  return hashUncachedFile(job, fingerprint, buffer);
+}
+void Stager::copyAndHashBatch(std::span<HashingPool::Result> results,
+                              SmallFileReader& reader,
+                              std::span<char> buffer) {
+  const auto run = [](HashingPool::Result& result, auto&& function) {
+    try {
+      result.file = function();
+    } catch (...) {
+      result.error = std::current_exception();
+    }
+  };
+
+  // The files which have to be read to hash them are read together, and the
+  // others, along with any the reader couldn't read whole, are staged one at
+  // a time.
+  std::vector<HashingPool::Result*> unread;
+  std::vector<std::filesystem::path> unreadPaths;
+  std::vector<std::optional<HashCache::Fingerprint>> fingerprints;
+  for (auto& result : results) {
+    if (result.job.hashedFile) {
+      run(result, [&]() { return copyAndHash(result.job, buffer); });
+      continue;
+    }
+    try {
+      auto fingerprint =
+        hashCache ? HashCache::fingerprint(result.job.path) : std::nullopt;
+      if (stageCachedFile(result.job, fingerprint, buffer, result.file))
+        continue;
+      unread.push_back(&result);
+      unreadPaths.push_back(result.job.path);
+      fingerprints.push_back(std::move(fingerprint));
+    } catch (...) {
+      result.error = std::current_exception();
+    }
+  }
+
+  std::vector<bool> isRead(unread.size(), false);
+  reader.read(unreadPaths,
+              [&](std::size_t index, std::span<const char> contents) {
+                isRead[index] = true;
+                run(*unread[index], [&]() {
+                  return hashUncachedFile(unread[index]->job,
+                                          fingerprints[index], buffer,
+                                          contents);
+                });
+              });
+  for (std::size_t i = 0; i < unread.size(); ++i) {
+    if (isRead[i])
+      continue;
+    run(*unread[i], [&]() {
+      return hashUncachedFile(unread[i]->job, fingerprints[i], buffer);
+    });
+  }
+}
+auto Stager::stageCachedFile(
+  const HashingPool::Job& job,
+  const std::optional<HashCache::Fingerprint>& fingerprint,
+  std::span<char> buffer, std::optional<RawFile>& file) -> bool {
+  // The cache only holds hashes made with the algorithm for the size of the
+  // file, so a file which has to be hashed linearly is hashed again.
+  if (!fingerprint || hashAlgorithmFor(fingerprint->size) !=
+                        tree_hash::algorithmFor(fingerprint->size))
+    return false;
+  // An entry from staging under the tiered policy only has the fast hash,
+  // which isn't enough under the full policy.
+  const auto hashes = hashCache->find(*fingerprint);
+  if (!hashes || (!hashes->hash && hashPolicy != HashPolicy::Tiered))
+    return false;
+
+  RawFile cachedFile{job.path, fingerprint->size, hashes->fastHash,
+                     hashes->hash};
+  if (job.archivedRevision && isUnchanged(*job.archivedRevision, cachedFile)) {
+    file.reset();
+    return true;
+  }
+  // When checking for duplicates the copy is made later, if at all.
+  if (checkDuplicates) {
+    file = std::move(cachedFile);
+    return true;
+  }
+
+  // The copy can be made without reading the file into memory, but it only
+  // matches the cached hash if the file didn't change while it was being
+  // copied.
+  copyFile(job.path, job.partialPath, buffer);
+  if (HashCache::fingerprint(job.path) == fingerprint) {
+    file = std::move(cachedFile);
+    return true;
+  }
+  std::filesystem::remove(job.partialPath);
+  return false;
+}
+auto Stager::hashUncachedFile(
+  const HashingPool::Job& job,
+  const std::optional<HashCache::Fingerprint>& fingerprint,
+  std::span<char> buffer, std::optional<std::span<const char>> contents)
+  -> std::optional<RawFile> {
+  // Contents which have already been read are hashed, and copied from, rather
+  // than reading the file again.
+  auto rawFile = [&]() {
+    if (contents) {
+      return checkDuplicates
+               ? RawFile::fromContents(job.path, *contents, hashPolicy)
+               : hashContents(job.path, *contents, job.partialPath,
+                              hashPolicy);
+    }
+    const auto algorithm = hashAlgorithmFor(
+      fingerprint ? fingerprint->size : std::filesystem::file_size(job.path));
+    return checkDuplicates
+             ? RawFile{job.path, buffer, hashPolicy, algorithm}
+             : hashFile(job.path, buffer, job.partialPath, hashPolicy,
+                        algorithm);
+  }();
+  if (fingerprint && rawFile.size == fingerprint->size &&
+      rawFile.hashAlgorithm == tree_hash::algorithmFor(rawFile.size) &&
+      HashCache::fingerprint(job.path) == fingerprint)
+    hashCache->insert(*fingerprint, rawFile.fastHash, rawFile.hash);
+  // A file without a cache entry, such as one which had to be hashed linearly,
+  // may still not have changed since it was archived. When checking for
+  // duplicates no copy has been made yet, otherwise the copy is removed.
+  if (job.archivedRevision && isUnchanged(*job.archivedRevision, rawFile)) {
+    if (!checkDuplicates)
+      removePartialFile(job.partialPath);
+    return std::nullopt;
+  }
+  return rawFile;
+}
+auto Stager::confirmLink(const HashingPool::Job& job, std::span<char> buffer)
+  -> RawFile {
+  // The link is to the staged copy, so hashing it hashes the copy.
+  const auto algorithm = job.hashedFile->hashAlgorithm;
+  RawFile file{job.path, buffer, HashPolicy::Full, algorithm};
+  const RawFile copy{job.partialPath, buffer, HashPolicy::Full, algorithm};
+  if (copy.size == file.size && copy.hash == file.hash)
+    return file;
+  spdlog::debug("\"{}\" has the same fast hash as a different staged copy, "
+                "it will be copied instead",
+                job.path);
+  std::filesystem::remove(job.partialPath);
+  return hashFile(job.path, buffer, job.partialPath, HashPolicy::Full,
+                  algorithm);
+}
+auto Stager::contentsOf(const RawFile& file) const -> Contents {
+  if (hashPolicy == HashPolicy::Tiered)
+    return {file.size, file.fastHash, std::nullopt};
+  return {file.size, file.fastHash, file.hash};
+}
+auto Stager::hashAlgorithmFor(Size size) const -> HashAlgorithm {
+  // A large file can only be matched with an archived revision of the same
+  // size, or found not to have changed since it was archived, if it is hashed
+  // the same way, so it is hashed linearly if that revision was.
+  if (linearRevisionSizes.contains(size))
+    return HashAlgorithm::Linear;
+  return tree_hash::algorithmFor(size);
+}
+auto Stager::needsConfirmation(const HashingPool::Job& job,
+                               const StagedCopy& copy) const -> bool {
+  // A hard link to the file the copy was made from needs no confirmation.
+  return hashPolicy == HashPolicy::Tiered &&
+         !(job.hardLink && job.hardLink == copy.inode);
+}
+auto Stager::findArchivedDirectory(const std::filesystem::path& stagePath)
+  -> std::optional<ArchivedDirectory> {
+  if (const auto found = archivedDirectories.find(stagePath);
+      found != archivedDirectories.end())
+    return found->second;
+
+  if (stagePath == StagedDirectory::RootDirectoryName) {
+    return archivedDirectories
+      .emplace(stagePath, archivedDatabase->getRootDirectory())
+      .first->second;
+  }
+  // Every child of a directory is looked up at once, rather than one at a
+  // time as each is staged.
+  const auto parentPath = stagePath.parent_path();
+  if (parentPath != stagePath &&
+      !listedArchivedDirectories.contains(parentPath)) {
+    listedArchivedDirectories.insert(parentPath);
+    if (const auto parent = findArchivedDirectory(parentPath)) {
+      for (const auto& child : archivedDatabase->listChildDirectories(*parent))
+        archivedDirectories.emplace(parentPath / child.name, child);
+    }
+    return findArchivedDirectory(stagePath);
+  }
+  return archivedDirectories.emplace(stagePath, std::nullopt).first->second;
+}
+auto Stager::getArchivedRevisions(const std::filesystem::path& stagePath)
+  -> std::map<std::string, ArchivedFileRevision> {
+  std::map<std::string, ArchivedFileRevision> archivedRevisions;
+  try {
+    const auto directory = findArchivedDirectory(stagePath);
+    if (!directory)
+      return archivedRevisions;
+    for (const auto& file : archivedDatabase->listChildFiles(*directory)) {
+      if (file.revisions.empty())
+        continue;
+      archivedRevisions.emplace(
+        file.name, *std::ranges::max_element(file.revisions, {},
+                                             &ArchivedFileRevision::id));
+    }
+  } catch (const std::exception& err) {
     throw StagerException(
-      "Could not stage file \"{}\" there was a filesystem error : {}", path,
+      "Could not look up the archived files in \"{}\" : {}", stagePath,
       err.what());
+  }
+  return archivedRevisions;
+}
+auto Stager::hashFile(const std::filesystem::path& path,
+                      std::span<char> buffer,
+                      const std::filesystem::path& partialPath,
+                      HashPolicy policy, HashAlgorithm algorithm) -> RawFile {
+  // If the filesystem supports reflinks the copy costs nothing and only has
+  // to be read to hash it, otherwise the copy is written while the file is
+  // hashed. The copy is hashed rather than the file, so the hash is of what
+  // was staged even if the file changes after the reflink.
+  if (reflinkFile(path, partialPath)) {
+    RawFile file{partialPath, buffer, policy, algorithm};
+    file.path = path;
+    return file;
+  }
+  return RawFile{path, buffer, partialPath, policy, algorithm};
+}
+auto Stager::hashContents(const std::filesystem::path& path,
+                          std::span<const char> contents,
+                          const std::filesystem::path& partialPath,
+                          HashPolicy policy) -> RawFile {
+  if (reflinkFile(path, partialPath))
+    return RawFile::fromContents(path, contents, policy);
+  return RawFile::fromContents(path, contents, partialPath, policy);
+}
+void Stager::queueHashedFiles(std::vector<HashingPool::Result>&& results,
+                              HashingPool& hashingPool) {
+  // The other files are queued first so that any copies of them are removed
+  // along with the rest of the batch.
+  const auto failed = std::ranges::find_if(
+    results, [](const auto& result) { return result.error != nullptr; });
+  if (failed != results.end()) {
+    const auto failedFile = std::move(*failed);
+    results.erase(failed);
+    std::ranges::move(results, std::back_inserter(pendingFiles));
+    throwStageFileError(failedFile.job, failedFile.error);
+  }
+
+  using Confirmation = HashingPool::Job::Confirmation;
+  std::vector<HashingPool::Result> uncopiedFiles;
+  for (auto& result : results) {
+    if (result.job.hardLink && !result.job.hashedFile)
+      releaseHardLinks(result, uncopiedFiles, hashingPool);
+
+    if (!result.file) {
+      spdlog::info("Skipping \"{}\" as it hasn't changed since it was "
+                   "archived",
+                   result.job.path);
+    } else if (result.job.confirmation == Confirmation::Linked) {
+      pendingFiles.push_back(std::move(result));
+    } else if (result.job.confirmation == Confirmation::Archived) {
+      uncopiedFiles.push_back(std::move(result));
+    } else if (result.job.hashedFile) {
+      queueCopiedFile(std::move(result), hashingPool);
+    } else if (!checkDuplicates) {
+      pendingFiles.push_back(std::move(result));
+    } else {
+      uncopiedFiles.push_back(std::move(result));
+    }
+  }
+  if (!uncopiedFiles.empty())
+    queueUncopiedFiles(std::move(uncopiedFiles), hashingPool);
+}
+void Stager::queueUncopiedFiles(std::vector<HashingPool::Result>&& results,
+                                HashingPool& hashingPool) {
+  // Files with only a fast hash are looked up by it, and those it matches
+  // are hashed again to find whether they really have been archived.
+  std::vector<bool> archived(results.size(), false);
+  std::vector<bool> mayBeArchived(results.size(), false);
+  if (checkDuplicates) {
+    std::vector<RawFile> hashedFiles;
+    std::vector<RawFile> fastHashedFiles;
+    std::vector<std::size_t> hashedIndices;
+    std::vector<std::size_t> fastHashedIndices;
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      if (results[i].file->hash) {
+        hashedFiles.push_back(*results[i].file);
+        hashedIndices.push_back(i);
+      } else {
+        fastHashedFiles.push_back(*results[i].file);
+        fastHashedIndices.push_back(i);
+      }
+    }
+    try {
+      const auto found =
+        archivedDatabase->hasRevisionsWithContents(hashedFiles);
+      for (std::size_t i = 0; i < found.size(); ++i)
+        archived[hashedIndices[i]] = found[i];
+      const auto foundFast =
+        archivedDatabase->hasRevisionsWithFastHashes(fastHashedFiles);
+      for (std::size_t i = 0; i < foundFast.size(); ++i)
+        mayBeArchived[fastHashedIndices[i]] = foundFast[i];
+    } catch (const std::exception& err) {
+      throw StagerException(
+        "Could not look up the archived revisions of {} files : {}",
+        results.size(), err.what());
+    }
+  }
+
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    auto& result = results[i];
+    if (archived[i]) {
+      pendingReferences.push_back(std::move(result));
+      continue;
+    }
+    if (mayBeArchived[i]) {
+      resubmit(std::move(result), HashingPool::Job::Confirmation::Archived,
+               hashingPool);
+      continue;
+    }
+    const auto contents = contentsOf(*result.file);
+    const auto staged = stagedContents.find(contents);
+    if (staged == stagedContents.end()) {
+      stagedContents.emplace(contents,
+                             StagedCopy{std::nullopt, result.job.hardLink});
+      submitCopy(std::move(result), hashingPool);
+    } else if (!staged->second.copyPath) {
+      waitingForCopy.emplace(contents, std::move(result));
+    } else {
+      queueLinkedFile(std::move(result), staged->second, hashingPool);
+    }
+  }
+}
+void Stager::queueLinkedFile(HashingPool::Result&& result,
+                             const StagedCopy& copy,
+                             HashingPool& hashingPool) {
+  if (!linkStagedCopy(*copy.copyPath, result.job.partialPath))
+    submitCopy(std::move(result), hashingPool);
+  else if (needsConfirmation(result.job, copy))
+    resubmit(std::move(result), HashingPool::Job::Confirmation::Linked,
+             hashingPool);
+  else
+    pendingFiles.push_back(std::move(result));
+}
+void Stager::queueCopiedFile(HashingPool::Result&& result,
+                             HashingPool& hashingPool) {
+  const auto hashedContents = contentsOf(*result.job.hashedFile);
+  const auto copiedContents = contentsOf(*result.file);
+  if (auto& copy = stagedContents[copiedContents]; !copy.copyPath)
+    copy = {result.job.partialPath, result.job.hardLink};
+  pendingFiles.push_back(std::move(result));
+  releaseWaitingFiles(copiedContents, hashingPool);
+
+  // If the file changed between being hashed and being copied, the files
+  // waiting for a copy of what it used to contain need copies of their own.
+  if (hashedContents != copiedContents) {
+    if (const auto staged = stagedContents.find(hashedContents);
+        staged != stagedContents.end() && !staged->second.copyPath)
+      stagedContents.erase(staged);
+    releaseWaitingFiles(hashedContents, hashingPool);
+  }
+}
+void Stager::releaseWaitingFiles(const Contents& contents,
+                                 HashingPool& hashingPool) {
+  const auto [first, last] = waitingForCopy.equal_range(contents);
+  std::vector<HashingPool::Result> waiting;
+  for (auto waitingFile = first; waitingFile != last; ++waitingFile)
+    waiting.push_back(std::move(waitingFile->second));
+  waitingForCopy.erase(first, last);
+
+  const auto staged = stagedContents.find(contents);
+  for (auto& result : waiting) {
+    if (staged != stagedContents.end() && staged->second.copyPath)
+      queueLinkedFile(std::move(result), staged->second, hashingPool);
+    else
+      submitCopy(std::move(result), hashingPool);
+  }
+}
+void Stager::submitFound(HashingPool::Job&& job, HashingPool& hashingPool) {
+  if (readOrder == ReadOrder::Walk) {
+    hashingPool.submit(std::move(job));
+    return;
+  }
+  plannedFiles.push_back(std::move(job));
+  if (plannedFiles.size() >= ReadOrderWindow)
+    submitPlanned(hashingPool);
+}
+void Stager::submitPlanned(HashingPool& hashingPool) {
+  sortByPhysicalLocation(plannedFiles, &HashingPool::Job::path);
+  for (auto& job : plannedFiles)
+    hashingPool.submit(std::move(job));
+  plannedFiles.clear();
+}
+void Stager::submitCopy(HashingPool::Result&& result,
+                        HashingPool& hashingPool) {
+  resubmit(std::move(result), HashingPool::Job::Confirmation::None,
+           hashingPool);
+}
+void Stager::resubmit(HashingPool::Result&& result,
+                      HashingPool::Job::Confirmation confirmation,
+                      HashingPool& hashingPool) {
+  auto job = std::move(result.job);
+  job.hashedFile = std::move(result.file);
+  job.confirmation = confirmation;
+  hashingPool.submit(std::move(job));
+}
+void Stager::releaseHardLinks(const HashingPool::Result& firstLink,
+                              std::vector<HashingPool::Result>& uncopiedFiles,
+                              HashingPool& hashingPool) {
+  // Every link has the hard link set, but only the first to be hashed
+  // releases the others.
+  const auto hardLink = hardLinks.find(*firstLink.job.hardLink);
+  if (hardLink == hardLinks.end() || hardLink->second.contents)
+    return;
+  auto waiting = std::move(hardLink->second.waiting);
+  // If the first link was skipped its hash isn't known, so the other links
+  // are hashed themselves.
+  if (!firstLink.file) {
+    hardLinks.erase(hardLink);
+    for (auto& job : waiting)
+      hashingPool.submit(std::move(job));
+    return;
+  }
+
+  const auto contents = contentsOf(*firstLink.file);
+  hardLink->second.contents = contents;
+  // Without checking for duplicates the first link was copied as it was
+  // hashed, and the other links are linked to that copy.
+  if (!checkDuplicates) {
+    stagedContents.try_emplace(
+      contents, StagedCopy{firstLink.job.partialPath, firstLink.job.hardLink});
+  }
+  for (auto& job : waiting)
+    queueLaterLink(std::move(job), contents, uncopiedFiles);
+}
+void Stager::queueLaterLink(HashingPool::Job&& job, const Contents& contents,
+                            std::vector<HashingPool::Result>& uncopiedFiles) {
+  RawFile file{job.path, contents.size, contents.fastHash, contents.hash};
+  file.hashAlgorithm = hashAlgorithmFor(contents.size);
+  if (job.archivedRevision && isUnchanged(*job.archivedRevision, file)) {
+    spdlog::info("Skipping \"{}\" as it hasn't changed since it was "
+                 "archived",
+                 job.path);
+    return;
+  }
+  uncopiedFiles.push_back({std::move(job), std::move(file), nullptr});
+}
+auto Stager::linkStagedCopy(const std::filesystem::path& copyPath,
+                            const std::filesystem::path& partialPath) -> bool {
+  std::error_code error;
+  std::filesystem::create_hard_link(copyPath, partialPath, error);
+  if (error) {
+    spdlog::debug("Could not link \"{}\" to the staged copy \"{}\", it will "
+                  "be copied instead: {}",
+                  partialPath, copyPath, error.message());
+    return false;
+  }
+  return true;
+}
+void Stager::addBatch() {
+  lastBatchTime = std::chrono::steady_clock::now();
+
+  if (!pendingDirectories.empty()) {
+    try {
+      stagedDatabase->addDirectories(pendingDirectories);
+    } catch (const std::exception& err) {
+      throw StagerException("Could not stage {} directories : {}",
+                            pendingDirectories.size(), err.what());
+    }
+    pendingDirectories.clear();
+  }
+  if (!pendingReferences.empty()) {
+    const auto references = splitResults(pendingReferences);
+    try {
+      stagedDatabase->addReferences(references.files, references.stagePaths);
+    } catch (const std::exception& err) {
+      throw StagerException("Could not stage {} files : {}",
+                            references.files.size(), err.what());
+    }
+    pendingReferences.clear();
+  }
+  if (pendingFiles.empty())
+    return;
+
+  const auto stagedFiles = [&]() {
+    const auto [files, stagePaths] = splitResults(pendingFiles);
+    try {
+      return stagedDatabase->addFiles(files, stagePaths);
+    } catch (const std::exception& err) {
+      throw StagerException("Could not stage {} files : {}", files.size(),
+                            err.what());
+    }
+  }();
+
+  for (std::size_t i = 0; i < stagedFiles.size(); ++i) {
+    const auto stagedCopyPath =
+      stageLocation / FORMAT_LIB::format("{}", stagedFiles[i].id);
+    std::error_code error;
+    std::filesystem::rename(pendingFiles[i].job.partialPath, stagedCopyPath,
+                            error);
+    if (error) {
+      const auto failedFile = std::move(pendingFiles[i]);
+      pendingFiles.erase(pendingFiles.begin(), pendingFiles.begin() + i + 1);
+      throwStageFileError(
+        failedFile.job,
+        std::make_exception_ptr(std::filesystem::filesystem_error(
+          "Could not rename the staged copy", failedFile.job.partialPath,
+          error)));
+    }
+    stagedCopies.push_back(stagedCopyPath);
+    // Later files with the same contents are linked to the copy's new name.
+    if (const auto staged =
+          stagedContents.find(contentsOf(*pendingFiles[i].file));
+        staged != stagedContents.end() &&
+        staged->second.copyPath == pendingFiles[i].job.partialPath)
+      staged->second.copyPath = stagedCopyPath;
+  }
+  pendingFiles.clear();
+}
+void Stager::discardBatch(std::vector<HashingPool::Result>&& unqueuedResults) {
+  pendingDirectories.clear();
+  pendingReferences.clear();
+  // Nothing was copied for the waiting files, and the copies they were
+  // waiting for won't be made now.
+  waitingForCopy.clear();
+  std::erase_if(stagedContents,
+                [](const auto& staged) { return !staged.second.copyPath; });
+  std::erase_if(hardLinks,
+                [](const auto& hardLink) { return !hardLink.second.contents; });
+  std::ranges::move(unqueuedResults, std::back_inserter(pendingFiles));
+  for (const auto& pendingFile : pendingFiles)
+    removePartialFile(pendingFile.job.partialPath);
+  pendingFiles.clear();
+}
+void Stager::removeStagedCopies() {
+  // Nothing can be linked to the removed copies, so later files with the same
+  // contents are copied again.
+  const std::set<std::filesystem::path> removedCopies{stagedCopies.begin(),
+                                                      stagedCopies.end()};
+  std::erase_if(stagedContents, [&](const auto& staged) {
+    return staged.second.copyPath &&
+           removedCopies.contains(*staged.second.copyPath);
+  });
+  for (const auto& copyPath : stagedCopies)
+    removePartialFile(copyPath);
+  stagedCopies.clear();
+}
+void Stager::throwStageFileError(const HashingPool::Job& job,
+                                 std::exception_ptr error) {
+  removePartialFile(job.partialPath);
+  try {
+    std::rethrow_exception(error);
+  } catch (const std::filesystem::filesystem_error& err) {
+    throw StagerException(
+      "Could not stage file \"{}\" there was a filesystem error : {}",
+      job.path, err.what());
   } catch (const std::exception& err) {
-    throw StagerException("Could not stage file \"{}\" : {}", path, err.what());
+    throw StagerException("Could not stage file \"{}\" : {}", job.path,
+                          err.what());
   } catch (...) {
     throw StagerException(
-      "An unknown error occurred while trying to stage file \"{}\"", path);
+      "An unknown error occurred while trying to stage file \"{}\"",
+      job.path);
+  }
+}
+auto Stager::nextPartialPath() -> std::filesystem::path {
+  return stageLocation /
+         FORMAT_LIB::format("{}{}", partialFilePrefix, nextPartialFileNumber++);
+}
+void Stager::removePartialFile(const std::filesystem::path& partialPath) {
+  std::error_code error;
+  std::filesystem::remove(partialPath, error);
+  if (error) {
+    spdlog::warn("Unable to remove partially staged file \"{}\": {}",
+                 partialPath, error.message());
   }
 }
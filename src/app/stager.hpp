@@ -1,21 +1,68 @@
 #ifndef ARCHIVER_STAGER_HPP
 #define ARCHIVER_STAGER_HPP
 
+#include "../database/archived_database.hpp"
 #include "../database/staged_database.hpp"
 #include "common.h"
+#include "content_hasher.hpp"
+#include "directory_walker.hpp"
+#include "hash_cache.hpp"
+#include "hashing_pool.hpp"
+#include "read_order.hpp"
+#include <chrono>
+#include <map>
+#include <set>
 #include <span>
 
 class Stager {
 public:
+  // Directories are walked, and their files hashed, by workerCount threads
+  // each. A worker count of 0 uses one worker per hardware thread. If a hash
+  // cache is given, files it has an entry for are copied without being read
+  // to hash them, and the hashes of the files which are read are added to it.
+  // If the archived database is given and checkDuplicates is set, files are
+  // hashed before they are copied. Files whose contents are already archived
+  // are staged as references without a copy, and files with the same contents
+  // as another file staged by the same call to stage are linked to its copy.
+  // This reads a file with new contents twice, once to hash it and once to
+  // copy it, unless it has a hash cache entry or is reflinked. Otherwise each
+  // file is copied as it is hashed, and the archived database is only used to
+  // stage changed files.
+  //
+  // Under the tiered hash policy files are only given their fast hash. The
+  // cryptographic hash of a file is computed when its fast hash matches that
+  // of an archived revision or a staged copy, to find whether they really are
+  // the same, and otherwise when the file is archived.
+  //
+  // If the read queue depth is more than 1, each worker keeps up to that many
+  // small files being opened and read at once through io_uring, where it is
+  // available, rather than reading them one at a time. Under the physical read
+  // order, the files found by walking a directory are read in windows of
+  // ReadOrderWindow files, each sorted into the order of their data on disk.
   Stager(std::shared_ptr<StagedDatabase>& stagedDatabase,
          std::span<char> fileReadBuffer,
-         const std::filesystem::path& stageDirectoryLocation);
+         const std::filesystem::path& stageDirectoryLocation,
+         std::size_t workerCount = 0,
+         std::shared_ptr<HashCache> hashCache = nullptr,
+         std::shared_ptr<ArchivedDatabase> archivedDatabase = nullptr,
+         HashPolicy hashPolicy = HashPolicy::Full,
+         std::size_t readQueueDepth = 0,
+         ReadOrder readOrder = ReadOrder::Walk, bool checkDuplicates = true);
 
   void stage(const std::vector<std::filesystem::path>& paths,
              std::string_view prefixToRemove);
+  // The same as stage, except that files the hash cache shows to be the same
+  // as the latest archived revision of the file at the same path are skipped.
+  // Files which aren't in the hash cache are always staged. Requires both the
+  // hash cache and the archived database.
+  void stageChanged(const std::vector<std::filesystem::path>& paths,
+                    std::string_view prefixToRemove);
 
   auto getDirectoriesSorted() -> std::vector<StagedDirectory>;
   auto getFilesSorted() -> std::vector<StagedFile>;
+  // The same as the above, but read from the database as they are iterated.
+  auto streamDirectoriesSorted() -> Generator<StagedDirectory>;
+  auto streamFilesSorted() -> Generator<StagedFile>;
 
   Stager() = delete;
   Stager(const Stager&) = delete;
@@ -26,14 +73,160 @@ public:
   Stager& operator=(Stager&&) = default;
 
 private:
+  // Under the tiered policy files are told apart by their fast hash alone,
+  // and the cryptographic hash is left unset.
+  struct Contents {
+    Size size;
+    FastHash fastHash;
+    std::optional<FileHash> hash;
+
+    friend auto operator<=>(const Contents&, const Contents&) = default;
+  };
+  struct StagedCopy {
+    // Not set while the copy is still being made.
+    std::optional<std::filesystem::path> copyPath;
+    // The file the copy was made from, if it has more than one hard link.
+    std::optional<DirectoryWalker::Inode> inode;
+  };
+
   void stageFile(const std::filesystem::path& path,
                  const std::filesystem::path& stagePath);
   void stageDirectory(const std::filesystem::path& path,
                       const std::filesystem::path& stagePath);
+  void stageTree(const std::filesystem::path& root,
+                 std::string_view prefixToRemove);
+  void queueHashedFiles(std::vector<HashingPool::Result>&& results,
+                        HashingPool& hashingPool);
+  void queueUncopiedFiles(std::vector<HashingPool::Result>&& results,
+                          HashingPool& hashingPool);
+  void queueCopiedFile(HashingPool::Result&& result, HashingPool& hashingPool);
+  void queueLinkedFile(HashingPool::Result&& result, const StagedCopy& copy,
+                       HashingPool& hashingPool);
+  void releaseWaitingFiles(const Contents& contents, HashingPool& hashingPool);
+  void releaseHardLinks(const HashingPool::Result& firstLink,
+                        std::vector<HashingPool::Result>& uncopiedFiles,
+                        HashingPool& hashingPool);
+  void queueLaterLink(HashingPool::Job&& job, const Contents& contents,
+                      std::vector<HashingPool::Result>& uncopiedFiles);
+  void submitFound(HashingPool::Job&& job, HashingPool& hashingPool);
+  void submitPlanned(HashingPool& hashingPool);
+  void submitCopy(HashingPool::Result&& result, HashingPool& hashingPool);
+  void resubmit(HashingPool::Result&& result,
+                HashingPool::Job::Confirmation confirmation,
+                HashingPool& hashingPool);
+  auto linkStagedCopy(const std::filesystem::path& copyPath,
+                      const std::filesystem::path& partialPath) -> bool;
+  void addBatch();
+  void discardBatch(std::vector<HashingPool::Result>&& unqueuedResults);
+  // Removes the copies renamed into the stage directory while staging the
+  // current path, once its transaction has been rolled back.
+  void removeStagedCopies();
+  [[noreturn]] void throwStageFileError(const HashingPool::Job& job,
+                                        std::exception_ptr error);
+  auto nextPartialPath() -> std::filesystem::path;
+  void removePartialFile(const std::filesystem::path& partialPath);
+
+  auto copyAndHash(const HashingPool::Job& job, std::span<char> buffer)
+    -> std::optional<RawFile>;
+  void copyAndHashBatch(std::span<HashingPool::Result> results,
+                        SmallFileReader& reader, std::span<char> buffer);
+  // Returns whether the file was staged from its hash cache entry, in which
+  // case file is set to it or left unset if the file is skipped.
+  auto stageCachedFile(const HashingPool::Job& job,
+                       const std::optional<HashCache::Fingerprint>& fingerprint,
+                       std::span<char> buffer, std::optional<RawFile>& file)
+    -> bool;
+  auto hashUncachedFile(
+    const HashingPool::Job& job,
+    const std::optional<HashCache::Fingerprint>& fingerprint,
+    std::span<char> buffer,
+    std::optional<std::span<const char>> contents = std::nullopt)
+    -> std::optional<RawFile>;
+  auto confirmLink(const HashingPool::Job& job, std::span<char> buffer)
+    -> RawFile;
+  auto contentsOf(const RawFile& file) const -> Contents;
+  auto hashAlgorithmFor(Size size) const -> HashAlgorithm;
+  auto needsConfirmation(const HashingPool::Job& job,
+                         const StagedCopy& copy) const -> bool;
+  auto findArchivedDirectory(const std::filesystem::path& stagePath)
+    -> std::optional<ArchivedDirectory>;
+  auto getArchivedRevisions(const std::filesystem::path& stagePath)
+    -> std::map<std::string, ArchivedFileRevision>;
+
+  static auto hashFile(const std::filesystem::path& path,
+                       std::span<char> buffer,
+                       const std::filesystem::path& partialPath,
+                       HashPolicy policy, HashAlgorithm algorithm) -> RawFile;
+  static auto hashContents(const std::filesystem::path& path,
+                           std::span<const char> contents,
+                           const std::filesystem::path& partialPath,
+                           HashPolicy policy) -> RawFile;
 
   std::shared_ptr<StagedDatabase> stagedDatabase;
   std::span<char> readBuffer;
   std::filesystem::path stageLocation;
+  // Partially staged files are named with a random prefix so stagers sharing
+  // a stage directory don't write to the same file.
+  std::string partialFilePrefix;
+  std::uint64_t nextPartialFileNumber = 0;
+  std::size_t workerCount;
+  std::shared_ptr<HashCache> hashCache;
+  std::shared_ptr<ArchivedDatabase> archivedDatabase;
+  HashPolicy hashPolicy;
+  std::size_t readQueueDepth;
+  ReadOrder readOrder;
+  // Only set if the archived database is given.
+  bool checkDuplicates;
+
+  // Only used while staging changed files. The archived directories are
+  // looked up by stage path, and the children of a directory are listed at
+  // most once.
+  bool changedOnly = false;
+  std::map<std::filesystem::path, std::optional<ArchivedDirectory>>
+    archivedDirectories;
+  std::set<std::filesystem::path> listedArchivedDirectories;
+
+  // The sizes of the large archived revisions which were hashed linearly,
+  // looked up by each call to stage when given the archived database.
+  std::set<Size> linearRevisionSizes;
+
+  // The staged copies, made by the current call to stage, which later files
+  // with the same contents are linked to. Files with the same contents as a
+  // copy being made wait for it to finish so they can be linked to it. Every
+  // distinct file is recorded when checking for duplicates, otherwise only
+  // files with hard links are.
+  std::map<Contents, StagedCopy> stagedContents;
+  std::multimap<Contents, HashingPool::Result> waitingForCopy;
+  // The staged copies renamed to their staged file's ID while staging the
+  // current path, which have no staged file once its transaction is rolled
+  // back.
+  std::vector<std::filesystem::path> stagedCopies;
+
+  // The files with more than one hard link found by the current call to
+  // stage. Only the first link found to each is hashed, the contents are
+  // known once it has been, and the links found before then wait for it.
+  struct HardLink {
+    std::optional<Contents> contents;
+    std::vector<HashingPool::Job> waiting;
+  };
+  std::map<DirectoryWalker::Inode, HardLink> hardLinks;
+
+  // Under the physical read order, files found by walking a directory are
+  // held back until a window of them has been found, or the walk ends, and
+  // are then read in order of their data on disk. Only a window of files is
+  // held at once, however many the walk finds.
+  static constexpr std::size_t ReadOrderWindow = 4096;
+  std::vector<HashingPool::Job> plannedFiles;
+
+  // Directories and files found while staging a directory are added to the
+  // database in batches, once either limit is reached.
+  static constexpr std::size_t MaxBatchSize = 1000;
+  static constexpr std::chrono::milliseconds MaxBatchDelay{1000};
+  std::vector<std::filesystem::path> pendingDirectories;
+  std::vector<HashingPool::Result> pendingFiles;
+  // Files which had no copy staged, as their contents were already archived.
+  std::vector<HashingPool::Result> pendingReferences;
+  std::chrono::steady_clock::time_point lastBatchTime;
 
   using path = std::filesystem::path;
 };
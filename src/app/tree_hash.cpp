@@ -0,0 +1,219 @@
+#include "tree_hash.hpp"
+#include "file_reader.hpp"
+#include "hash/blake2b.hpp"
+#include "hash/sha3_512.hpp"
+#include "hash/xxh3_128.hpp"
+#include "raw_file.hpp"
+#include "read_pipeline.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tree_hash {
+namespace {
+constexpr std::array<char, 16> Magic = {'A', 'R', 'C', 'H', 'I', 'V', 'E', 'R',
+                                        'T', 'R', 'E', 'E', 'H', 'A', 'S', 'H'};
+
+// Every root digest starts with this, so a tree hash can't be the same as the
+// linear hash of a file which happens to hold the leaf digests, and so the
+// digests depend on the leaf size.
+auto makeHeader(std::uint64_t leafSize, std::uint64_t size)
+  -> std::array<std::uint8_t, Magic.size() + 16> {
+  std::array<std::uint8_t, Magic.size() + 16> header{};
+  std::memcpy(header.data(), Magic.data(), Magic.size());
+  for (std::size_t i = 0; i < 8; ++i) {
+    header[Magic.size() + i] = static_cast<std::uint8_t>(leafSize >> (8 * i));
+    header[Magic.size() + 8 + i] = static_cast<std::uint8_t>(size >> (8 * i));
+  }
+  return header;
+}
+
+// The threads which hash leaves for every file being tree hashed, so that
+// several large files being hashed at once, such as by the workers of a
+// HashingPool, don't start more threads between them than there are hardware
+// threads. The tasks only read and hash, they never wait for each other.
+class LeafPool {
+public:
+  static auto instance() -> LeafPool& {
+    static LeafPool pool;
+    return pool;
+  }
+
+  void submit(std::function<void()> task) {
+    {
+      std::lock_guard lock(mutex);
+      tasks.push_back(std::move(task));
+    }
+    tasksChanged.notify_one();
+  }
+  auto threadCount() const -> std::size_t { return threads.size(); }
+
+  LeafPool(const LeafPool&) = delete;
+  LeafPool(LeafPool&&) = delete;
+
+  LeafPool& operator=(const LeafPool&) = delete;
+  LeafPool& operator=(LeafPool&&) = delete;
+
+private:
+  LeafPool() {
+    const auto count = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t i = 0; i < count; ++i)
+      threads.emplace_back([this]() { runThread(); });
+  }
+  ~LeafPool() {
+    {
+      std::lock_guard lock(mutex);
+      stopping = true;
+    }
+    tasksChanged.notify_all();
+    for (auto& thread : threads)
+      thread.join();
+  }
+
+  void runThread() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock lock(mutex);
+        tasksChanged.wait(lock, [&]() { return stopping || !tasks.empty(); });
+        if (tasks.empty())
+          return;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable tasksChanged;
+  std::deque<std::function<void()>> tasks;
+  bool stopping = false;
+  std::vector<std::thread> threads;
+};
+}
+
+template <HashingPolicy Policy>
+auto hashFile(const std::filesystem::path& path, std::span<char> buffer,
+              std::uint64_t leafSize, std::size_t threadCount) -> Digests {
+  if (leafSize == 0)
+    throw std::logic_error("The leaf size of a tree hash can't be 0");
+  if (buffer.size() < ReadPipeline::SlotAlignment) {
+    throw std::logic_error(
+      "Could not tree hash a file as the given buffer is too small");
+  }
+
+  FileReader reader{path};
+  const auto size = reader.size();
+  const auto leafCount = std::max<std::uint64_t>(1, (size + leafSize - 1) /
+                                                      leafSize);
+
+  auto& pool = LeafPool::instance();
+  if (threadCount == 0)
+    threadCount = pool.threadCount();
+  threadCount = static_cast<std::size_t>(
+    std::min<std::uint64_t>({threadCount, leafCount,
+                             buffer.size() / ReadPipeline::SlotAlignment}));
+
+  std::vector<FastHash> leafFastHashes(leafCount);
+  std::vector<std::optional<FileHash>> leafHashes(leafCount);
+  std::atomic<std::uint64_t> nextLeaf = 0;
+  std::mutex errorMutex;
+  std::exception_ptr error;
+
+  const auto hashLeaves = [&](std::span<char> slice) {
+    try {
+      for (auto leaf = nextLeaf++; leaf < leafCount; leaf = nextLeaf++) {
+        ContentHasher<Policy> hasher;
+        const auto consumers = hasher.consumers();
+        const auto leafStart = leaf * leafSize;
+        const auto leafEnd = std::min(size, leafStart + leafSize);
+        for (auto offset = leafStart; offset < leafEnd;) {
+          const auto chunk = slice.first(static_cast<std::size_t>(
+            std::min<std::uint64_t>(slice.size(), leafEnd - offset)));
+          if (reader.read(chunk, offset) != chunk.size()) {
+            throw FileException("\"{}\" got shorter while it was being hashed",
+                                path);
+          }
+          for (const auto& consumer : consumers)
+            consumer(chunk);
+          offset += chunk.size();
+        }
+        leafFastHashes[leaf] = hasher.finalizeFastHash();
+        leafHashes[leaf] = hasher.finalizeHash();
+      }
+    } catch (...) {
+      // Stop the other threads from starting any more leaves.
+      nextLeaf = leafCount;
+      std::lock_guard lock(errorMutex);
+      if (!error)
+        error = std::current_exception();
+    }
+  };
+
+  // The calling thread hashes leaves too, so the file is still hashed if
+  // every thread of the pool is busy with other files. A slice which the pool
+  // only gets to once every leaf has been taken does nothing.
+  const auto sliceSize = buffer.size() / threadCount /
+                         ReadPipeline::SlotAlignment *
+                         ReadPipeline::SlotAlignment;
+  std::mutex finishedMutex;
+  std::condition_variable sliceFinished;
+  std::size_t unfinishedSlices = threadCount - 1;
+  for (std::size_t i = 1; i < threadCount; ++i) {
+    pool.submit([&, slice = buffer.subspan(i * sliceSize, sliceSize)]() {
+      hashLeaves(slice);
+      // Notified under the lock, as the waiting thread returns, destroying
+      // the condition variable, as soon as it sees the last slice finish.
+      std::lock_guard lock(finishedMutex);
+      --unfinishedSlices;
+      sliceFinished.notify_all();
+    });
+  }
+  hashLeaves(buffer.first(threadCount == 1 ? buffer.size() : sliceSize));
+  {
+    std::unique_lock lock(finishedMutex);
+    sliceFinished.wait(lock, [&]() { return unfinishedSlices == 0; });
+  }
+  if (error)
+    std::rethrow_exception(error);
+
+  const auto header = makeHeader(leafSize, size);
+  hash::Xxh3_128 rootFastHash;
+  rootFastHash.addData(header.data(), header.size());
+  for (const auto& leafFastHash : leafFastHashes)
+    rootFastHash.addData(leafFastHash.bytes.data(), leafFastHash.bytes.size());
+  Digests digests{size, FastHash{rootFastHash.finalize()}, std::nullopt};
+
+  if constexpr (Policy::IsCryptographic) {
+    hash::Sha3_512 rootSha3;
+    hash::Blake2b rootBlake2b;
+    rootSha3.addData(header.data(), header.size());
+    rootBlake2b.addData(header.data(), header.size());
+    for (const auto& leafHash : leafHashes) {
+      rootSha3.addData(leafHash->bytes.data(), FileHash::Sha3Size);
+      rootBlake2b.addData(leafHash->bytes.data() + FileHash::Sha3Size,
+                          FileHash::Blake2bSize);
+    }
+    digests.hash = FileHash{rootSha3.finalize(), rootBlake2b.finalize()};
+  }
+  return digests;
+}
+
+template auto hashFile<FullHashing>(const std::filesystem::path& path,
+                                    std::span<char> buffer,
+                                    std::uint64_t leafSize,
+                                    std::size_t threadCount) -> Digests;
+template auto hashFile<TieredHashing>(const std::filesystem::path& path,
+                                      std::span<char> buffer,
+                                      std::uint64_t leafSize,
+                                      std::size_t threadCount) -> Digests;
+}
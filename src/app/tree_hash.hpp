@@ -0,0 +1,43 @@
+#ifndef ARCHIVER_TREE_HASH_HPP
+#define ARCHIVER_TREE_HASH_HPP
+
+#include "common.h"
+#include "content_hasher.hpp"
+#include "file_hash.hpp"
+#include <optional>
+#include <span>
+
+// Hashes a file as a tree, so that a single large file can be hashed by many
+// threads at once. The file is split into leaves of leafSize bytes, which are
+// read with their own positioned reads and hashed in parallel, and each root
+// digest is the hash of a header followed by the digests of the leaves, in
+// order, made with the same algorithm. The digests aren't the same as those of
+// the file hashed linearly, so which of the two a hash is must be recorded.
+namespace tree_hash {
+inline constexpr std::uint64_t LeafSize = 64 * 1024 * 1024;
+// Files at least this large are tree hashed. It has to stay the same for
+// files with the same contents to have the same hash.
+inline constexpr std::uint64_t MinFileSize = 4ull * 1024 * 1024 * 1024;
+
+inline auto algorithmFor(std::uint64_t size) -> HashAlgorithm {
+  return size >= MinFileSize ? HashAlgorithm::Tree : HashAlgorithm::Linear;
+}
+
+struct Digests {
+  std::uint64_t size;
+  FastHash fastHash;
+  std::optional<FileHash> hash;
+};
+
+// Hashes the leaves on up to threadCount threads at once, each with its own
+// slice of the buffer: the calling thread and those of a pool shared by every
+// file being tree hashed, which has one thread per hardware thread. 0 uses as
+// many threads as the pool has. Throws FileException if the file can't be
+// read, including if it gets shorter while it is being read.
+template <HashingPolicy Policy>
+auto hashFile(const std::filesystem::path& path, std::span<char> buffer,
+              std::uint64_t leafSize = LeafSize, std::size_t threadCount = 0)
+  -> Digests;
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef ARCHIVER_GENERATOR_HPP
+#define ARCHIVER_GENERATOR_HPP
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// A lazily evaluated sequence produced by a coroutine which co_yields each
+// element. The coroutine only runs as the generator is iterated, and only
+// until it yields the next element, so a sequence never has to be held in
+// memory all at once. A generator can only be iterated once.
+template <typename T> class Generator {
+public:
+  using value_type = std::remove_cvref_t<T>;
+  using reference = std::conditional_t<std::is_reference_v<T>, T, T&>;
+  using pointer = std::add_pointer_t<reference>;
+
+  class promise_type {
+  public:
+    auto get_return_object() noexcept -> Generator {
+      return Generator{
+        std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    auto initial_suspend() const noexcept -> std::suspend_always { return {}; }
+    auto final_suspend() const noexcept -> std::suspend_always { return {}; }
+
+    // The yielded value lives in the coroutine frame until it is resumed, so
+    // only its address needs to be kept.
+    auto yield_value(std::remove_reference_t<reference>& value) noexcept
+      -> std::suspend_always {
+      current = std::addressof(value);
+      return {};
+    }
+    auto yield_value(std::remove_reference_t<reference>&& value) noexcept
+      -> std::suspend_always {
+      current = std::addressof(value);
+      return {};
+    }
+    void return_void() const noexcept {}
+    void unhandled_exception() noexcept {
+      exception = std::current_exception();
+    }
+
+    // Generators can't co_await anything.
+    template <typename U> std::suspend_never await_transform(U&&) = delete;
+
+    auto value() const noexcept -> reference {
+      return static_cast<reference>(*current);
+    }
+    void rethrowIfException() {
+      if (exception)
+        std::rethrow_exception(std::exchange(exception, nullptr));
+    }
+
+  private:
+    pointer current = nullptr;
+    std::exception_ptr exception;
+  };
+
+  class Iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = Generator::value_type;
+    using reference = Generator::reference;
+    using pointer = Generator::pointer;
+
+    Iterator() noexcept = default;
+    explicit Iterator(std::coroutine_handle<promise_type> coroutine) noexcept
+      : coroutine(coroutine) {}
+
+    auto operator*() const noexcept -> reference {
+      return coroutine.promise().value();
+    }
+    auto operator->() const noexcept -> pointer {
+      return std::addressof(**this);
+    }
+    auto operator++() -> Iterator& {
+      coroutine.resume();
+      if (coroutine.done())
+        coroutine.promise().rethrowIfException();
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+
+    friend auto operator==(const Iterator& iterator,
+                           std::default_sentinel_t) noexcept -> bool {
+      return !iterator.coroutine || iterator.coroutine.done();
+    }
+
+  private:
+    std::coroutine_handle<promise_type> coroutine = nullptr;
+  };
+
+  // Runs the coroutine up to its first element, rethrowing anything it
+  // throws before then.
+  auto begin() -> Iterator {
+    if (coroutine) {
+      coroutine.resume();
+      if (coroutine.done())
+        coroutine.promise().rethrowIfException();
+    }
+    return Iterator{coroutine};
+  }
+  auto end() const noexcept -> std::default_sentinel_t { return {}; }
+
+  Generator() = delete;
+  Generator(const Generator&) = delete;
+  Generator(Generator&& other) noexcept
+    : coroutine(std::exchange(other.coroutine, nullptr)) {}
+  ~Generator() {
+    if (coroutine)
+      coroutine.destroy();
+  }
+
+  Generator& operator=(const Generator&) = delete;
+  Generator& operator=(Generator&& other) noexcept {
+    if (this != &other) {
+      if (coroutine)
+        coroutine.destroy();
+      coroutine = std::exchange(other.coroutine, nullptr);
+    }
+    return *this;
+  }
+
+private:
+  explicit Generator(std::coroutine_handle<promise_type> coroutine) noexcept
+    : coroutine(coroutine) {}
+
+  std::coroutine_handle<promise_type> coroutine;
+};
+
+#endif
@@ -3,15 +3,17 @@
 
 #include "../../config/config.h"
 #include "../common.h"
+#include "../io_mode.hpp"
 #include <memory>
 #include <vector>
 
 namespace {
-std::pair<std::unique_ptr<char[]>, Size>
+// The buffer is aligned for direct I/O.
+std::pair<AlignedBuffer, Size>
 getFileReadBuffer(const std::vector<Size> potentialSizes) {
   for (auto size : potentialSizes) {
     try {
-      auto data = std::make_unique<char[]>(size);
+      auto data = makeAlignedBuffer(size);
       return std::make_pair(std::move(data), size);
     } catch (const std::bad_alloc&) {
       // If there was a bad alloc, try the next available size
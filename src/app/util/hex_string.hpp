@@ -0,0 +1,21 @@
+#ifndef ARCHIVER_HEX_STRING_HPP
+#define ARCHIVER_HEX_STRING_HPP
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace {
+std::string toHexString(std::span<const std::uint8_t> bytes) {
+  constexpr char digits[] = "0123456789abcdef";
+  std::string hex;
+  hex.reserve(bytes.size() * 2);
+  for (const auto byte : bytes) {
+    hex.push_back(digits[byte >> 4]);
+    hex.push_back(digits[byte & 0x0F]);
+  }
+  return hex;
+}
+}
+
+#endif
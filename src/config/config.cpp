@@ -1,4 +1,5 @@
 #include "config.h"
+#include "../app/archive_defaults.hpp"
 #include <fstream>
 #include <json.hpp>
 
@@ -49,15 +50,60 @@ Config::Config(const std::filesystem::path& path) {
     }
   };
 
+  const auto getOptionalValue = [&](const std::string& jsonPointer, auto& var,
+                                    const auto& defaultValue) {
+    if (configuration.contains(json::json_pointer{jsonPointer}))
+      getRequiredValue(jsonPointer, var);
+    else
+      var = defaultValue;
+  };
+
   // Call getRequired with on objects even though their values need to be
   // retrieved separately, this is so that an error is generated if the section
   // does not exist.
 
   getRequired("/general"s);
   getRequiredValue("/general/file_read_sizes"s, this->general.fileReadSizes);
+  std::string ioMode;
+  getOptionalValue("/general/io_mode"s, ioMode, "buffered"s);
+  if (const auto mode = parseIoMode(ioMode)) {
+    this->general.ioMode = *mode;
+  } else {
+    throw ConfigError("Config file could not be loaded as the entry "
+                      "\"general/io_mode\" is \"{}\", rather than "
+                      "\"buffered\", \"direct\" or \"dontneed\"",
+                      ioMode);
+  }
 
   getRequired("/stager"s);
   getRequiredValue("/stager/stage_directory"s, this->stager.stage_directory);
+  getOptionalValue("/stager/worker_count"s, this->stager.worker_count, 0);
+  getOptionalValue("/stager/hash_cache"s, this->stager.hash_cache,
+                   std::filesystem::path{});
+  std::string hashPolicy;
+  getOptionalValue("/stager/hash_policy"s, hashPolicy, "full"s);
+  if (const auto policy = parseHashPolicy(hashPolicy)) {
+    this->stager.hash_policy = *policy;
+  } else {
+    throw ConfigError("Config file could not be loaded as the entry "
+                      "\"stager/hash_policy\" is \"{}\", rather than "
+                      "\"full\" or \"tiered\"",
+                      hashPolicy);
+  }
+  getOptionalValue("/stager/read_queue_depth"s, this->stager.read_queue_depth,
+                   32);
+  std::string readOrder;
+  getOptionalValue("/stager/read_order"s, readOrder, "walk"s);
+  if (const auto order = parseReadOrder(readOrder)) {
+    this->stager.read_order = *order;
+  } else {
+    throw ConfigError("Config file could not be loaded as the entry "
+                      "\"stager/read_order\" is \"{}\", rather than "
+                      "\"walk\" or \"physical\"",
+                      readOrder);
+  }
+  getOptionalValue("/stager/check_duplicates"s, this->stager.check_duplicates,
+                   false);
 
   getRequired("/archive"s);
   getRequiredValue("/archive/archive_directory"s,
@@ -67,6 +113,20 @@ Config::Config(const std::filesystem::path& path) {
   getRequiredValue("/archive/target_size"s, this->archive.target_size);
   getRequiredValue("/archive/single_archive_size"s,
                    this->archive.single_archive_size);
+  getOptionalValue("/archive/move_staged_files"s,
+                   this->archive.move_staged_files, false);
+  getOptionalValue("/archive/compression_worker_count"s,
+                   this->archive.compression_worker_count, 1);
+  getOptionalValue("/archive/compression_memory_limit"s,
+                   this->archive.compression_memory_limit, 0);
+  getOptionalValue("/archive/compression_job_memory"s,
+                   this->archive.compression_job_memory,
+                   DefaultCompressionJobMemory);
+  getOptionalValue("/archive/part_target_size"s,
+                   this->archive.part_target_size,
+                   DefaultArchivePartTargetSize);
+  getOptionalValue("/archive/part_max_files"s, this->archive.part_max_files,
+                   DefaultArchivePartMaxFiles);
 
   getRequired("/database"s);
   getRequiredValue("/database/user"s, this->database.user);
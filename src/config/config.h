@@ -2,6 +2,9 @@
 #define _CONFIG_H
 
 #include "../app/common.h"
+#include "../app/hash_policy.hpp"
+#include "../app/io_mode.hpp"
+#include "../app/read_order.hpp"
 
 _make_exception_(ConfigError);
 
@@ -9,15 +12,28 @@ struct Config {
 public:
   struct General {
     std::vector<Size> fileReadSizes;
+    IoMode ioMode;
   } general;
   struct Stager {
     std::filesystem::path stage_directory;
+    std::size_t worker_count;
+    std::filesystem::path hash_cache;
+    HashPolicy hash_policy;
+    std::size_t read_queue_depth;
+    ReadOrder read_order;
+    bool check_duplicates;
   } stager;
   struct Archive {
     std::filesystem::path archive_directory;
     std::filesystem::path temp_archive_directory;
     Size target_size;
     Size single_archive_size;
+    bool move_staged_files;
+    std::size_t compression_worker_count;
+    Size compression_memory_limit;
+    Size compression_job_memory;
+    Size part_target_size;
+    std::size_t part_max_files;
   } archive;
   struct Database {
     std::string user;
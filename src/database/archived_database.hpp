@@ -2,29 +2,79 @@
 #define ARCHIVER_ARCHIVED_DATABASE_HPP
 
 #include "../app/archive.h"
+#include "../app/archive_part.hpp"
 #include "../app/archive_operation.hpp"
 #include "../app/archived_directory.hpp"
 #include "../app/archived_file.hpp"
 #include "../app/common.h"
+#include "../app/raw_file.hpp"
 #include "../app/staged_directory.h"
 #include "../app/staged_file.hpp"
 #include "database.hpp"
 #include <concepts>
+#include <map>
+#include <set>
+#include <span>
+#include <utility>
+#include <vector>
 
 enum class ArchivedFileAddedType : uint8_t { NewRevision, DuplicateRevision };
 
+// The contents of a revision are identified by its size and hash.
+using RevisionContents = std::pair<Size, FileHash>;
+
 interface ArchivedDatabase : public Database {
   // Listing
   virtual auto listChildDirectories(const ArchivedDirectory& archivedDirectory)
     -> std::vector<ArchivedDirectory> abstract;
   virtual auto listChildFiles(const ArchivedDirectory& archivedDirectory)
     -> std::vector<ArchivedFile> abstract;
+  // The archive a single file should be added to, going by the archive sizes
+  // recorded in the database. Assigning many files at once should be done with
+  // an ArchivePlanner instead.
   virtual auto getArchiveForFile(const StagedFile& stagedFile)
     -> Archive abstract;
+  // The newest archive of each extension, and the total size of the revisions
+  // which were added to it.
+  virtual auto listArchiveSizes()
+    -> std::vector<std::pair<Archive, Size>> abstract;
+  // The size archives are filled up to before a new archive is started for
+  // their extension.
+  virtual auto getArchiveTargetSize() -> Size abstract;
   virtual auto getNextArchivePartNumber(const Archive& archive)
     -> uint64_t abstract;
+  // The parts the archive has been compressed into, in order of number.
+  virtual auto listArchiveParts(const Archive& archive)
+    -> std::vector<ArchivePart> abstract;
+  // The revisions added to the archive which aren't in any of its parts yet,
+  // with their sizes, in order of ID.
+  virtual auto listUncompressedRevisions(const Archive& archive)
+    -> std::vector<std::pair<ArchivedFileRevisionID, Size>> abstract;
   virtual auto getRootDirectory() -> ArchivedDirectory abstract;
+  virtual auto hasArchiveOperation(ArchiveOperationID archiveOperation)
+    -> bool abstract;
+  // Whether a revision with the same size and hash as each of the files has
+  // been archived, in the order the files were given.
+  virtual auto hasRevisionsWithContents(std::span<const RawFile> files)
+    -> std::vector<bool> abstract;
+  // The ID of an archived revision with the same size and hash as each of the
+  // files whose contents have already been archived. Files whose hash isn't
+  // known are skipped.
+  virtual auto findRevisionsWithContents(std::span<const StagedFile> files)
+    -> std::map<RevisionContents, ArchivedFileRevisionID> abstract;
+  // Whether a revision with the same size and fast hash as each of the files
+  // has been archived. As the fast hash isn't collision resistant, a match
+  // only means the file may have been archived.
+  virtual auto hasRevisionsWithFastHashes(std::span<const RawFile> files)
+    -> std::vector<bool> abstract;
+  // The sizes of at least minimumSize bytes of the revisions which were hashed
+  // linearly, such as those archived before large files were tree hashed. A
+  // file of one of these sizes has to be hashed linearly to be matched with
+  // them.
+  virtual auto listLinearRevisionSizes(Size minimumSize)
+    -> std::set<Size> abstract;
   // Adding
+  virtual auto addArchive(const Extension& extension) -> Archive abstract;
   virtual auto createArchiveOperation() -> ArchiveOperationID abstract;
   virtual auto addDirectory(const StagedDirectory& stagedDirectory,
                             const ArchivedDirectory& archivedParent,
@@ -35,8 +85,33 @@ interface ArchivedDatabase : public Database {
                        const Archive& archive,
                        const ArchiveOperationID archiveOperation)
     -> std::pair<ArchivedFileAddedType, ArchivedFileRevisionID> abstract;
+  // Adds each of the files to the directory and archive at the same index,
+  // with the same results as adding them one at a time in order. A file whose
+  // contents match an earlier one of the files is added as a duplicate of it.
+  // archivedRevisions has to be what findRevisionsWithContents returns for the
+  // files in the same transaction, so that the caller can share the lookup.
+  virtual auto addFiles(
+    std::span<const StagedFile> stagedFiles,
+    std::span<const ArchivedDirectory> archivedDirectories,
+    std::span<const Archive> archives, const ArchiveOperationID archiveOperation,
+    const std::map<RevisionContents, ArchivedFileRevisionID>& archivedRevisions)
+    -> std::vector<std::pair<ArchivedFileAddedType, ArchivedFileRevisionID>>
+      abstract;
   // Updating
   virtual void incrementNextArchivePartNumber(const Archive& archive) abstract;
+  // Reserves count consecutive part numbers of the archive and returns the
+  // first of them. The archive stays locked until the transaction ends, so
+  // no other archive operation can reserve the same part numbers.
+  virtual auto reserveArchivePartNumbers(const Archive& archive,
+                                         uint64_t count) -> uint64_t abstract;
+  // Records the parts of the archive, and which revisions are in each.
+  virtual void addArchiveParts(const Archive& archive,
+                               std::span<const ArchivePart> parts) abstract;
+  // Adds each size to the recorded size of its archive. Adding a file doesn't
+  // change the size of its archive, so the sizes of the revisions added to
+  // each archive must be added with this.
+  virtual void
+  addToArchiveSizes(std::span<const std::pair<Archive, Size>> sizes) abstract;
 
   virtual ~ArchivedDatabase() = default;
 };
@@ -9,7 +9,30 @@ const std::string ArchivedDatabase::noExtensionArchiveContents = "<BLANK>"s;
 ArchivedDatabase::ArchivedDatabase(
   std::shared_ptr<ArchivedDatabase::ConnectionConfig>& config,
   Size archiveTargetSize)
-  : database::mysql::Database(config), targetSize(archiveTargetSize) {}
+  : database::mysql::Database(config), targetSize(archiveTargetSize),
+    prepared(databaseConnection) {}
+
+ArchivedDatabase::PreparedStatements::PreparedStatements(
+  sqlpp::mysql::connection& connection)
+  : selectChildDirectory(
+      connection.prepare(statements::selectChildDirectory())),
+    selectChildDirectories(
+      connection.prepare(statements::selectChildDirectories())),
+    insertDirectory(connection.prepare(statements::insertDirectory())),
+    insertDirectoryParent(
+      connection.prepare(statements::insertDirectoryParent())),
+    insertDirectoryArchiveOperation(
+      connection.prepare(statements::insertDirectoryArchiveOperation())),
+    selectChildFiles(connection.prepare(statements::selectChildFiles())),
+    selectChildFileRevisions(
+      connection.prepare(statements::selectChildFileRevisions())),
+    selectNextArchivePartNumber(
+      connection.prepare(statements::selectNextArchivePartNumber())),
+    incrementNextArchivePartNumber(
+      connection.prepare(statements::incrementNextArchivePartNumber())),
+    reserveArchivePartNumbers(
+      connection.prepare(statements::reserveArchivePartNumbers())),
+    addToArchiveSize(connection.prepare(statements::addToArchiveSize())) {}
 
 ArchivedDatabase::~ArchivedDatabase() {
   try {
@@ -61,30 +84,57 @@ void ArchivedDatabase::commit() {
 }
 
 auto ArchivedDatabase::getArchiveForFile(const StagedFile& file) -> Archive {
-  const std::string_view fileName = file.name;
-  const auto fileExtension = [&]() {
-    if (fileName.find_last_of('.') == std::string_view::npos)
-      return std::string{"<BLANK>"};
-    else
-      return std::string{fileName.substr(fileName.find_last_of('.'))};
-  }();
-
-  auto archiveForExtension = getArchiveForExtension(fileExtension);
+  const auto extension = archiveExtension(file.name);
+  try {
+    auto archiveResults =
+      databaseConnection(select(all_of(archivesTable))
+                           .from(archivesTable)
+                           .where(archivesTable.contents == extension)
+                           .order_by(archivesTable.id.desc())
+                           .limit(1u));
 
-  if (getArchiveSize(archiveForExtension) < targetSize) {
-    return archiveForExtension;
+    if (!archiveResults.empty() &&
+        archiveResults.front().currentSize.value() < targetSize)
+      return {archiveResults.front().id, archiveResults.front().contents};
+  } catch (const sqlpp::exception& err) {
+    throw ArchivedDatabaseException(
+      "Could not get archive for extension \"{}\": {}", extension, err);
+  }
+  return addArchive(extension);
+}
+SQLPP_ALIAS_PROVIDER(NewestArchiveTable);
+SQLPP_ALIAS_PROVIDER(newestArchiveId);
+auto ArchivedDatabase::listArchiveSizes()
+  -> std::vector<std::pair<Archive, Size>> {
+  try {
+    // Archives are only ever added, so the newest archive of an extension is
+    // the one with the largest id, and only those are read.
+    const auto newestArchiveTable = archivesTable.as(NewestArchiveTable);
+    std::vector<std::pair<Archive, Size>> archiveSizes;
+    for (const auto& row : databaseConnection(
+           select(all_of(archivesTable))
+             .from(archivesTable)
+             .where(archivesTable.id.in(
+               select(max(newestArchiveTable.id).as(newestArchiveId))
+                 .from(newestArchiveTable)
+                 .unconditionally()
+                 .group_by(newestArchiveTable.contents))))) {
+      archiveSizes.emplace_back(Archive{row.id, row.contents.value()},
+                                static_cast<Size>(row.currentSize.value()));
+    }
+    return archiveSizes;
+  } catch (const sqlpp::exception& err) {
+    throw ArchivedDatabaseException("Could not list the archive sizes: {}",
+                                    err);
   }
-
-  return addArchiveForExtension(fileExtension);
 }
+auto ArchivedDatabase::getArchiveTargetSize() -> Size { return targetSize; }
 auto ArchivedDatabase::getNextArchivePartNumber(const Archive& archive)
   -> uint64_t {
   try {
+    prepared.selectNextArchivePartNumber.params.id = archive.id;
     auto archiveResults =
-      databaseConnection(select(archivesTable.nextPartNumber)
-                           .from(archivesTable)
-                           .where(archivesTable.id == archive.id)
-                           .limit(1u));
+      databaseConnection(prepared.selectNextArchivePartNumber);
 
     if (archiveResults.empty())
       throw ArchivedDatabaseException("Could not find archive with id {}",
@@ -99,10 +149,9 @@ auto ArchivedDatabase::getNextArchivePartNumber(const Archive& archive)
 }
 void ArchivedDatabase::incrementNextArchivePartNumber(const Archive& archive) {
   try {
-    auto rowsUpdated = databaseConnection(
-      update(archivesTable)
-        .set(archivesTable.nextPartNumber = archivesTable.nextPartNumber + 1)
-        .where(archivesTable.id == archive.id));
+    prepared.incrementNextArchivePartNumber.params.id = archive.id;
+    auto rowsUpdated =
+      databaseConnection(prepared.incrementNextArchivePartNumber);
 
     if (rowsUpdated != 1)
       throw ArchivedDatabaseException(
@@ -114,33 +163,113 @@ void ArchivedDatabase::incrementNextArchivePartNumber(const Archive& archive) {
       archive.id, err);
   }
 }
+auto ArchivedDatabase::reserveArchivePartNumbers(const Archive& archive,
+                                                 uint64_t count) -> uint64_t {
+  try {
+    // Updating the archive first locks it, so the part number read back can't
+    // have been changed by another archive operation in between.
+    prepared.reserveArchivePartNumbers.params.nextPartNumber = count;
+    prepared.reserveArchivePartNumbers.params.id = archive.id;
+    auto rowsUpdated = databaseConnection(prepared.reserveArchivePartNumbers);
 
-auto ArchivedDatabase::getArchiveForExtension(const std::string& extension)
-  -> Archive {
-  std::string extensionName = extension;
+    if (rowsUpdated != 1)
+      throw ArchivedDatabaseException(
+        "Could not reserve part numbers of archive with id {}", archive.id);
+    return getNextArchivePartNumber(archive) - count;
+  } catch (const sqlpp::exception& err) {
+    throw ArchivedDatabaseException(
+      "Could not reserve part numbers of archive with id {}: {}", archive.id,
+      err);
+  }
+}
+auto ArchivedDatabase::listArchiveParts(const Archive& archive)
+  -> std::vector<ArchivePart> {
   try {
-    if (extension.empty()) {
-      extensionName = noExtensionArchiveContents;
+    std::vector<ArchivePart> parts;
+    std::map<uint64_t, std::size_t> partIndices;
+    for (const auto& row :
+         databaseConnection(select(archivePartTable.partNumber,
+                                   archivePartTable.size)
+                              .from(archivePartTable)
+                              .where(archivePartTable.archiveId == archive.id)
+                              .order_by(archivePartTable.partNumber.asc()))) {
+      partIndices.emplace(row.partNumber, parts.size());
+      parts.push_back({row.partNumber, {}, row.size});
     }
-    auto archiveResults =
-      databaseConnection(select(all_of(archivesTable))
-                           .from(archivesTable)
-                           .where(archivesTable.contents == extensionName)
-                           .order_by(archivesTable.id.desc())
-                           .limit(1u));
 
-    if (archiveResults.empty())
-      return addArchiveForExtension(extensionName);
-    else
-      return {archiveResults.front().id, archiveResults.front().contents};
+    for (const auto& row : databaseConnection(
+           select(fileRevisionArchiveTable.revisionId,
+                  fileRevisionArchiveTable.partNumber)
+             .from(fileRevisionArchiveTable)
+             .where(fileRevisionArchiveTable.archiveId == archive.id and
+                    fileRevisionArchiveTable.partNumber.is_not_null())
+             .order_by(fileRevisionArchiveTable.revisionId.asc()))) {
+      // Revisions archived before parts were recorded are in a part which
+      // isn't listed.
+      const auto part = partIndices.find(row.partNumber.value());
+      if (part != partIndices.end())
+        parts[part->second].revisions.push_back(row.revisionId);
+    }
+    return parts;
+  } catch (const sqlpp::exception& err) {
+    throw ArchivedDatabaseException(
+      "Could not list the parts of archive with id {}: {}", archive.id, err);
+  }
+}
+auto ArchivedDatabase::listUncompressedRevisions(const Archive& archive)
+  -> std::vector<std::pair<ArchivedFileRevisionID, Size>> {
+  try {
+    std::vector<std::pair<ArchivedFileRevisionID, Size>> revisions;
+    for (const auto& row : databaseConnection(
+           select(fileRevisionTable.id, fileRevisionTable.size)
+             .from(fileRevisionTable.join(fileRevisionArchiveTable)
+                     .on(fileRevisionTable.id ==
+                         fileRevisionArchiveTable.revisionId))
+             .where(fileRevisionArchiveTable.archiveId == archive.id and
+                    fileRevisionArchiveTable.partNumber.is_null())
+             .order_by(fileRevisionTable.id.asc()))) {
+      revisions.emplace_back(row.id, row.size.value());
+    }
+    return revisions;
+  } catch (const sqlpp::exception& err) {
+    throw ArchivedDatabaseException(
+      "Could not list the uncompressed revisions of archive with id {}: {}",
+      archive.id, err);
+  }
+}
+void ArchivedDatabase::addArchiveParts(const Archive& archive,
+                                       std::span<const ArchivePart> parts) {
+  if (parts.empty())
+    return;
+  try {
+    auto insertParts =
+      insert_into(archivePartTable)
+        .columns(archivePartTable.archiveId, archivePartTable.partNumber,
+                 archivePartTable.fileCount, archivePartTable.size);
+    for (const auto& part : parts) {
+      insertParts.values.add(
+        archivePartTable.archiveId = archive.id,
+        archivePartTable.partNumber = part.number,
+        archivePartTable.fileCount = part.revisions.size(),
+        archivePartTable.size = part.size);
+    }
+    databaseConnection(insertParts);
+
+    for (const auto& part : parts) {
+      databaseConnection(
+        update(fileRevisionArchiveTable)
+          .set(fileRevisionArchiveTable.partNumber = part.number)
+          .where(fileRevisionArchiveTable.archiveId == archive.id and
+                 fileRevisionArchiveTable.revisionId.in(
+                   value_list(part.revisions))));
+    }
   } catch (const sqlpp::exception& err) {
     throw ArchivedDatabaseException(
-      "Could not get archive for extension \"{}\": {}", extensionName, err);
+      "Could not add the parts of archive with id {}: {}", archive.id, err);
   }
 }
 
-auto ArchivedDatabase::addArchiveForExtension(const std::string& extension)
-  -> Archive {
+auto ArchivedDatabase::addArchive(const Extension& extension) -> Archive {
   std::string extensionName = extension;
   try {
     if (extension.empty()) {
@@ -156,35 +285,30 @@ auto ArchivedDatabase::addArchiveForExtension(const std::string& extension)
       "Could not add archive for extension \"{}\": {}", extensionName, err);
   }
 }
-
-auto ArchivedDatabase::getArchiveSize(const Archive& archive) -> Size {
-  try {
-    return databaseConnection(
-             select(sum(fileRevisionTable.size))
-               .from(fileRevisionTable.join(fileRevisionArchiveTable)
-                       .on(fileRevisionTable.id ==
-                           fileRevisionArchiveTable.revisionId))
-               .where(fileRevisionArchiveTable.archiveId == archive.id))
-      .front()
-      .sum;
-  } catch (const sqlpp::exception& err) {
-    throw ArchivedDatabaseException(
-      "Could not get archive size for archive with id {}: {}", archive.id, err);
+void ArchivedDatabase::addToArchiveSizes(
+  std::span<const std::pair<Archive, Size>> sizes) {
+  for (const auto& [archive, size] : sizes) {
+    try {
+      prepared.addToArchiveSize.params.currentSize = size;
+      prepared.addToArchiveSize.params.id = archive.id;
+      auto rowsUpdated = databaseConnection(prepared.addToArchiveSize);
+
+      if (rowsUpdated != 1)
+        throw ArchivedDatabaseException(
+          "Could not update the size of archive with id {}", archive.id);
+    } catch (const sqlpp::exception& err) {
+      throw ArchivedDatabaseException(
+        "Could not update the size of archive with id {}: {}", archive.id,
+        err);
+    }
   }
 }
 
 auto ArchivedDatabase::listChildDirectories(const ArchivedDirectory& directory)
   -> std::vector<ArchivedDirectory> {
   try {
-    auto results = databaseConnection(
-      select(all_of(directoriesTable),
-             directoryArchiveOperationTable.archiveOperationId)
-        .from(directoriesTable.join(directoryParentTable)
-                .on(directoriesTable.id == directoryParentTable.childId)
-                .join(directoryArchiveOperationTable)
-                .on(directoriesTable.id ==
-                    directoryArchiveOperationTable.directoryId))
-        .where(directoryParentTable.parentId == directory.id));
+    prepared.selectChildDirectories.params.parentId = directory.id;
+    auto results = databaseConnection(prepared.selectChildDirectories);
 
     std::vector<ArchivedDirectory> childDirectories;
 
@@ -208,42 +332,34 @@ auto ArchivedDatabase::addDirectory(const StagedDirectory& directory,
   if (directory.name == ArchivedDirectory::RootDirectoryName)
     return getRootDirectory();
   try {
-    auto matchingDirectory = databaseConnection(
-      select(directoriesTable.id,
-             directoryArchiveOperationTable.archiveOperationId)
-        .from(directoryParentTable.join(directoriesTable)
-                .on(directoryParentTable.childId == directoriesTable.id)
-                .join(directoryArchiveOperationTable)
-                .on(directoriesTable.id ==
-                    directoryArchiveOperationTable.directoryId))
-        .where(directoryParentTable.parentId == parent.id and
-               directoriesTable.name ==
-                 verbatim_t<sqlpp::text>(FORMAT_LIB::format(
-                   "\"{}\" COLLATE utf8mb3_bin", directory.name))));
-    if (!matchingDirectory.empty()) {
+    // Names are compared exactly, as the name column has a binary collation.
+    prepared.selectChildDirectory.params.parentId = parent.id;
+    prepared.selectChildDirectory.params.name = directory.name;
+    const auto matchingDirectory = [&]() -> std::optional<ArchivedDirectory> {
+      auto results = databaseConnection(prepared.selectChildDirectory);
+      if (results.empty())
+        return std::nullopt;
+      return ArchivedDirectory{results.front().id, directory.name, parent.id,
+                               results.front().archiveOperationId};
+    }();
+    prepared.insertDirectoryArchiveOperation.params.archiveOperationId =
+      archiveOperation;
+    if (matchingDirectory) {
       // Add an entry to the directory_archive_operation table
-      databaseConnection(
-        insert_into(directoryArchiveOperationTable)
-          .set(directoryArchiveOperationTable.directoryId =
-                 matchingDirectory.front().id,
-               directoryArchiveOperationTable.archiveOperationId =
-                 archiveOperation));
-
-      return {matchingDirectory.front().id, directory.name, parent.id,
-              matchingDirectory.front().archiveOperationId};
+      prepared.insertDirectoryArchiveOperation.params.directoryId =
+        matchingDirectory->id;
+      databaseConnection(prepared.insertDirectoryArchiveOperation);
+      return *matchingDirectory;
     }
 
-    auto directoryId =
-      databaseConnection(insert_into(directoriesTable)
-                           .set(directoriesTable.name = directory.name));
-    databaseConnection(insert_into(directoryParentTable)
-                         .set(directoryParentTable.parentId = parent.id,
-                              directoryParentTable.childId = directoryId));
-    databaseConnection(
-      insert_into(directoryArchiveOperationTable)
-        .set(directoryArchiveOperationTable.directoryId = directoryId,
-             directoryArchiveOperationTable.archiveOperationId =
-               archiveOperation));
+    prepared.insertDirectory.params.name = directory.name;
+    const ArchivedDirectoryID directoryId =
+      databaseConnection(prepared.insertDirectory);
+    prepared.insertDirectoryParent.params.parentId = parent.id;
+    prepared.insertDirectoryParent.params.childId = directoryId;
+    databaseConnection(prepared.insertDirectoryParent);
+    prepared.insertDirectoryArchiveOperation.params.directoryId = directoryId;
+    databaseConnection(prepared.insertDirectoryArchiveOperation);
 
     return {directoryId, directory.name, parent.id, archiveOperation};
   } catch (const sqlpp::exception& err) {
@@ -269,17 +385,30 @@ auto ArchivedDatabase::getRootDirectory() -> ArchivedDirectory {
 auto ArchivedDatabase::listChildFiles(const ArchivedDirectory& directory)
   -> std::vector<ArchivedFile> {
   try {
-    auto results =
-      databaseConnection(select(all_of(filesTable))
-                           .from(filesTable.join(fileParentTable)
-                                   .on(filesTable.id == fileParentTable.fileId))
-                           .where(fileParentTable.directoryId == directory.id));
-
     std::vector<ArchivedFile> childFiles;
-
-    for (const auto& row : results) {
-      childFiles.push_back(
-        {row.id, row.name, directory, getFileRevisionsForFile(row.id)});
+    std::map<ArchivedFileID, std::size_t> childFileIndices;
+
+    // Every row is read before the revisions are listed, as a connection
+    // can't run another statement while the rows of a prepared statement are
+    // still being read.
+    prepared.selectChildFiles.params.directoryId = directory.id;
+    for (const auto& row : databaseConnection(prepared.selectChildFiles)) {
+      childFileIndices.emplace(row.id, std::size(childFiles));
+      childFiles.push_back({row.id, row.name.value(), directory, {}});
+    }
+    if (childFiles.empty())
+      return childFiles;
+
+    // The revisions of all the files are listed at once, rather than with a
+    // query per file.
+    prepared.selectChildFileRevisions.params.directoryId = directory.id;
+    for (const auto& row :
+         databaseConnection(prepared.selectChildFileRevisions)) {
+      childFiles[childFileIndices.at(row.fileId)].revisions.push_back(
+        {row.revisionId, FileHash::fromBytes(row.revisionHash.value()),
+         row.revisionSize, row.revisionArchiveId, row.archiveOperationId,
+         row.isDuplicate, fromNullableBlob<FastHash>(row.revisionFastHash),
+         hashAlgorithmFrom(row.revisionHashAlgorithm)});
     }
 
     return childFiles;
@@ -291,188 +420,348 @@ auto ArchivedDatabase::listChildFiles(const ArchivedDirectory& directory)
   }
 }
 
-namespace get_file_revisions_for_file_table_alias {
-SQLPP_ALIAS_PROVIDER(DuplicateRevisionTable);
-SQLPP_ALIAS_PROVIDER(RelevantRevisionTable);
-SQLPP_ALIAS_PROVIDER(RelevantRevisionWithDuplicateTable);
-SQLPP_ALIAS_PROVIDER(revisionId);
-SQLPP_ALIAS_PROVIDER(revisionSize);
-SQLPP_ALIAS_PROVIDER(revisionHash);
-SQLPP_ALIAS_PROVIDER(revisionArchiveId);
-SQLPP_ALIAS_PROVIDER(isDuplicate);
-}
-auto ArchivedDatabase::getFileRevisionsForFile(ArchivedFileID fileId)
-  -> std::vector<ArchivedFileRevision> {
-  using namespace get_file_revisions_for_file_table_alias;
-  try {
-    auto duplicateRevisionTable = fileRevisionTable.as(DuplicateRevisionTable);
-    auto relevantFileRevisions =
-      select(
-        all_of(fileRevisionTable),
-        fileRevisionDuplicateTable.originalRevisionId,
-        fileRevisionDuplicateTable.revisionId.is_not_null().as(isDuplicate),
-        fileRevisionArchiveOperationTable.archiveOperationId)
-        .from(
-          fileRevisionTable.join(fileRevisionParentTable)
-            .on(fileRevisionTable.id == fileRevisionParentTable.revisionId)
-            .left_outer_join(fileRevisionDuplicateTable)
-            .on(fileRevisionTable.id == fileRevisionDuplicateTable.revisionId)
-            .join(fileRevisionArchiveOperationTable)
-            .on(fileRevisionTable.id ==
-                fileRevisionArchiveOperationTable.revisionId))
-        .where(fileRevisionParentTable.fileId == fileId)
-        .as(RelevantRevisionTable);
-    auto relevantFileRevisionsWithDuplicateInfo =
-      select(case_when(relevantFileRevisions.isDuplicate == false)
-               .then(relevantFileRevisions.id)
-               .else_(duplicateRevisionTable.id)
-               .as(revisionId),
-             case_when(relevantFileRevisions.isDuplicate == false)
-               .then(relevantFileRevisions.hash)
-               .else_(duplicateRevisionTable.hash)
-               .as(revisionHash),
-             case_when(relevantFileRevisions.isDuplicate == false)
-               .then(relevantFileRevisions.size)
-               .else_(duplicateRevisionTable.size)
-               .as(revisionSize),
-             relevantFileRevisions.archiveOperationId,
-             relevantFileRevisions.isDuplicate)
-        .from(relevantFileRevisions.left_outer_join(duplicateRevisionTable)
-                .on(relevantFileRevisions.originalRevisionId ==
-                    duplicateRevisionTable.id))
-        .unconditionally()
-        .as(RelevantRevisionWithDuplicateTable);
-    auto relevantFileRevisionsWithDuplicateAndArchiveInfo =
-      select(all_of(relevantFileRevisionsWithDuplicateInfo),
-             fileRevisionArchiveTable.archiveId.as(revisionArchiveId))
-        .from(relevantFileRevisionsWithDuplicateInfo
-                .left_outer_join(fileRevisionArchiveTable)
-                .on(relevantFileRevisionsWithDuplicateInfo.revisionId ==
-                    fileRevisionArchiveTable.revisionId))
-        .unconditionally();
-    auto fileRevisionResults =
-      databaseConnection(relevantFileRevisionsWithDuplicateAndArchiveInfo);
-
-    std::vector<ArchivedFileRevision> revisions;
-
-    for (const auto& row : fileRevisionResults) {
-      ArchivedFileRevision a = {row.revisionId,         row.revisionHash,
-                                row.revisionSize,       row.revisionArchiveId,
-                                row.archiveOperationId, row.isDuplicate};
-      revisions.push_back(a);
-    }
-
-    return revisions;
-
-  } catch (const sqlpp::exception& err) {
-    throw ArchivedDatabaseException(
-      "Could not list revisions for archived file with id {}: {}", fileId, err);
-  }
-}
-
 auto ArchivedDatabase::addFile(const StagedFile& file,
                                const ArchivedDirectory& directory,
                                const Archive& archive,
                                const ArchiveOperationID archiveOperation)
   -> std::pair<ArchivedFileAddedType, ArchivedFileRevisionID> {
+  return addFiles({&file, 1}, {&directory, 1}, {&archive, 1}, archiveOperation,
+                  findRevisionsWithContents({&file, 1}))
+    .front();
+}
+auto ArchivedDatabase::addFiles(
+  std::span<const StagedFile> files,
+  std::span<const ArchivedDirectory> directories,
+  std::span<const Archive> archives, const ArchiveOperationID archiveOperation,
+  const std::map<RevisionContents, ArchivedFileRevisionID>& archivedRevisions)
+  -> std::vector<std::pair<ArchivedFileAddedType, ArchivedFileRevisionID>> {
+  if (files.size() != directories.size() || files.size() != archives.size()) {
+    throw ArchivedDatabaseException(
+      "Could not add files to archived files as {} files were given with {} "
+      "directories and {} archives",
+      files.size(), directories.size(), archives.size());
+  }
+  for (const auto& file : files) {
+    if (!file.hash) {
+      throw ArchivedDatabaseException(
+        "Could not add file to archived files as the hash of staged file with "
+        "id {} isn't known",
+        file.id);
+    }
+  }
+  if (files.empty())
+    return {};
+
   try {
-    const auto fileId = [&]() {
-      auto existingFile = getFileId(file.name, directory);
-      if (!existingFile) {
-        auto newFileId = databaseConnection(
-          insert_into(filesTable).set(filesTable.name = file.name));
-        databaseConnection(insert_into(fileParentTable)
-                             .set(fileParentTable.fileId = newFileId,
-                                  fileParentTable.directoryId = directory.id));
-        return newFileId;
+    auto fileIds = findFileIds(files, directories);
+
+    // Files which haven't been archived yet are added once, even if several
+    // revisions of them are being added.
+    auto insertFiles = insert_into(filesTable).columns(filesTable.name);
+    std::vector<FileKey> newFiles;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+      FileKey key{directories[i].id, files[i].name};
+      if (fileIds.contains(key))
+        continue;
+      insertFiles.values.add(filesTable.name = files[i].name);
+      fileIds.emplace(key, 0);
+      newFiles.push_back(std::move(key));
+    }
+    if (!newFiles.empty()) {
+      // See StagedDatabase::addFiles for why the IDs are evenly spaced.
+      const ArchivedFileID firstFileId = databaseConnection(insertFiles);
+      auto insertParents = insert_into(fileParentTable)
+                             .columns(fileParentTable.fileId,
+                                      fileParentTable.directoryId);
+      for (std::size_t i = 0; i < newFiles.size(); ++i) {
+        fileIds[newFiles[i]] = insertedId(firstFileId, i);
+        insertParents.values.add(
+          fileParentTable.fileId = insertedId(firstFileId, i),
+          fileParentTable.directoryId = newFiles[i].first);
       }
-      return existingFile.value();
-    }();
+      databaseConnection(insertParents);
+    }
 
-    const auto [revisionId, revisionIsDuplicate] =
-      [&]() -> std::pair<ArchivedFileRevisionID, bool> {
-      const auto duplicateRevision = findDuplicateRevisionId(file);
-      if (duplicateRevision) {
-        auto newRevisionId =
-          databaseConnection(insert_into(fileRevisionTable).default_values());
-        databaseConnection(
-          insert_into(fileRevisionArchiveOperationTable)
-            .set(fileRevisionArchiveOperationTable.revisionId = newRevisionId,
-                 fileRevisionArchiveOperationTable.archiveOperationId =
-                   archiveOperation));
-        databaseConnection(
-          insert_into(fileRevisionDuplicateTable)
-            .set(fileRevisionDuplicateTable.revisionId = newRevisionId,
-                 fileRevisionDuplicateTable.originalRevisionId =
-                   duplicateRevision.value()));
-        return {newRevisionId, true};
-      } else {
-        auto newRevisionId =
-          databaseConnection(insert_into(fileRevisionTable)
-                               .set(fileRevisionTable.hash = file.hash,
-                                    fileRevisionTable.size = file.size));
-        databaseConnection(
-          insert_into(fileRevisionArchiveOperationTable)
-            .set(fileRevisionArchiveOperationTable.revisionId = newRevisionId,
-                 fileRevisionArchiveOperationTable.archiveOperationId =
-                   archiveOperation));
-        databaseConnection(
-          insert_into(fileRevisionArchiveTable)
-            .set(fileRevisionArchiveTable.revisionId = newRevisionId,
-                 fileRevisionArchiveTable.archiveId = archive.id));
-        return {newRevisionId, false};
+    // As with files, contents which haven't been archived yet are added as
+    // one new revision, and every other file with the same contents becomes a
+    // duplicate of it.
+    auto insertRevisions =
+      insert_into(fileRevisionTable)
+        .columns(fileRevisionTable.hash, fileRevisionTable.fastHash,
+                 fileRevisionTable.hashAlgorithm, fileRevisionTable.size);
+    std::map<RevisionContents, std::size_t> newContents;
+    std::vector<std::size_t> newRevisionFiles;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+      const RevisionContents key{files[i].size, *files[i].hash};
+      if (archivedRevisions.contains(key) || newContents.contains(key))
+        continue;
+      insertRevisions.values.add(
+        fileRevisionTable.hash = toBlob(*files[i].hash),
+        fileRevisionTable.fastHash = toNullableBlob(files[i].fastHash),
+        fileRevisionTable.hashAlgorithm = toColumn(files[i].hashAlgorithm),
+        fileRevisionTable.size = files[i].size);
+      newContents.emplace(key, newRevisionFiles.size());
+      newRevisionFiles.push_back(i);
+    }
+    const ArchivedFileRevisionID firstRevisionId =
+      newRevisionFiles.empty() ? 0 : databaseConnection(insertRevisions);
+
+    std::vector<std::pair<ArchivedFileAddedType, ArchivedFileRevisionID>>
+      added(files.size());
+    std::vector<std::pair<std::size_t, ArchivedFileRevisionID>>
+      duplicateRevisions;
+    auto insertDuplicates = insert_into(fileRevisionTable)
+                              .columns(fileRevisionTable.hashAlgorithm);
+    for (std::size_t i = 0; i < files.size(); ++i) {
+      const RevisionContents key{files[i].size, *files[i].hash};
+      const auto newRevision = newContents.find(key);
+      if (newRevision != newContents.end() &&
+          newRevisionFiles[newRevision->second] == i) {
+        added[i] = {ArchivedFileAddedType::NewRevision,
+                    insertedId(firstRevisionId, newRevision->second)};
+        continue;
       }
-    }();
+      const auto originalRevisionId =
+        newRevision != newContents.end()
+          ? insertedId(firstRevisionId, newRevision->second)
+          : archivedRevisions.at(key);
+      insertDuplicates.values.add(fileRevisionTable.hashAlgorithm =
+                                    toColumn(HashAlgorithm::Linear));
+      duplicateRevisions.emplace_back(i, originalRevisionId);
+    }
+    if (!duplicateRevisions.empty()) {
+      const ArchivedFileRevisionID firstDuplicateId =
+        databaseConnection(insertDuplicates);
+      auto insertOriginals =
+        insert_into(fileRevisionDuplicateTable)
+          .columns(fileRevisionDuplicateTable.revisionId,
+                   fileRevisionDuplicateTable.originalRevisionId);
+      for (std::size_t i = 0; i < duplicateRevisions.size(); ++i) {
+        const auto& [fileIndex, originalRevisionId] = duplicateRevisions[i];
+        added[fileIndex] = {ArchivedFileAddedType::DuplicateRevision,
+                            insertedId(firstDuplicateId, i)};
+        insertOriginals.values.add(
+          fileRevisionDuplicateTable.revisionId =
+            insertedId(firstDuplicateId, i),
+          fileRevisionDuplicateTable.originalRevisionId = originalRevisionId);
+      }
+      databaseConnection(insertOriginals);
+    }
 
-    databaseConnection(insert_into(fileRevisionParentTable)
-                         .set(fileRevisionParentTable.revisionId = revisionId,
-                              fileRevisionParentTable.fileId = fileId));
+    if (!newRevisionFiles.empty()) {
+      auto insertArchives =
+        insert_into(fileRevisionArchiveTable)
+          .columns(fileRevisionArchiveTable.revisionId,
+                   fileRevisionArchiveTable.archiveId);
+      for (std::size_t i = 0; i < newRevisionFiles.size(); ++i) {
+        insertArchives.values.add(
+          fileRevisionArchiveTable.revisionId =
+            insertedId(firstRevisionId, i),
+          fileRevisionArchiveTable.archiveId =
+            archives[newRevisionFiles[i]].id);
+      }
+      databaseConnection(insertArchives);
+    }
+
+    auto insertOperations =
+      insert_into(fileRevisionArchiveOperationTable)
+        .columns(fileRevisionArchiveOperationTable.revisionId,
+                 fileRevisionArchiveOperationTable.archiveOperationId);
+    auto insertRevisionParents =
+      insert_into(fileRevisionParentTable)
+        .columns(fileRevisionParentTable.revisionId,
+                 fileRevisionParentTable.fileId);
+    for (std::size_t i = 0; i < files.size(); ++i) {
+      const auto revisionId = added[i].second;
+      insertOperations.values.add(
+        fileRevisionArchiveOperationTable.revisionId = revisionId,
+        fileRevisionArchiveOperationTable.archiveOperationId =
+          archiveOperation);
+      insertRevisionParents.values.add(
+        fileRevisionParentTable.revisionId = revisionId,
+        fileRevisionParentTable.fileId =
+          fileIds.at({directories[i].id, files[i].name}));
+    }
+    databaseConnection(insertOperations);
+    databaseConnection(insertRevisionParents);
 
-    return revisionIsDuplicate
-             ? std::pair{ArchivedFileAddedType::DuplicateRevision, revisionId}
-             : std::pair{ArchivedFileAddedType::NewRevision, revisionId};
+    return added;
   } catch (const sqlpp::exception& err) {
     throw ArchivedDatabaseException("Could not add file to archived files: {}",
                                     err);
   }
 }
 
-auto ArchivedDatabase::getFileId(const std::string& name,
-                                 const ArchivedDirectory& directory)
-  -> std::optional<ArchivedFileID> {
+auto ArchivedDatabase::findFileIds(
+  std::span<const StagedFile> files,
+  std::span<const ArchivedDirectory> directories)
+  -> std::map<FileKey, ArchivedFileID> {
+  std::vector<ArchivedDirectoryID> directoryIds;
+  std::vector<std::string> names;
+  directoryIds.reserve(files.size());
+  names.reserve(files.size());
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    directoryIds.push_back(directories[i].id);
+    names.push_back(files[i].name);
+  }
+
   try {
-    auto results = databaseConnection(
-      select(fileParentTable.fileId)
+    const auto& results = databaseConnection(
+      select(fileParentTable.fileId, fileParentTable.directoryId,
+             filesTable.name)
         .from(filesTable.join(fileParentTable)
                 .on(filesTable.id == fileParentTable.fileId))
-        .where(filesTable.name == verbatim_t<sqlpp::text>(FORMAT_LIB::format(
-                                    "\"{}\" COLLATE utf8mb3_bin", name)) and
-               fileParentTable.directoryId == directory.id));
-    if (results.empty())
-      return std::nullopt;
-    return results.front().fileId;
+        .where(fileParentTable.directoryId.in(value_list(directoryIds)) and
+               filesTable.name.in(value_list(names))));
+    std::map<FileKey, ArchivedFileID> fileIds;
+    for (const auto& row : results) {
+      fileIds.emplace(FileKey{row.directoryId, row.name.value()}, row.fileId);
+    }
+    return fileIds;
   } catch (const sqlpp::exception& err) {
-    throw ArchivedDatabaseException("Could not find file with name \"{}\" and "
-                                    "with parent directory id {}: {}",
-                                    name, directory.id, err);
+    throw ArchivedDatabaseException(
+      "Could not find the archived files of {} staged files: {}", files.size(),
+      err);
   }
 }
-auto ArchivedDatabase::findDuplicateRevisionId(const StagedFile& file)
-  -> std::optional<ArchivedFileRevisionID> {
+auto ArchivedDatabase::hasRevisionsWithContents(
+  std::span<const RawFile> files) -> std::vector<bool> {
+  std::vector<bool> found(files.size(), false);
+  if (files.empty())
+    return found;
+
+  try {
+    std::vector<Size> sizes;
+    std::vector<std::vector<std::uint8_t>> hashes;
+    sizes.reserve(files.size());
+    hashes.reserve(files.size());
+    for (const auto& file : files) {
+      if (!file.hash)
+        continue;
+      sizes.push_back(file.size);
+      hashes.push_back(toBlob(*file.hash));
+    }
+    if (hashes.empty())
+      return found;
+    // Every file is looked up in one query, which can also match the size of
+    // one file with the hash of another, so the pairs are matched up here.
+    const auto& results = databaseConnection(
+      select(fileRevisionTable.size, fileRevisionTable.hash)
+        .from(fileRevisionTable)
+        .where(fileRevisionTable.size.in(value_list(sizes)) and
+               fileRevisionTable.hash.in(value_list(hashes))));
+    std::set<std::pair<Size, FileHash>> archivedContents;
+    for (const auto& row : results) {
+      archivedContents.emplace(row.size.value(),
+                               FileHash::fromBytes(row.hash.value()));
+    }
+    for (std::size_t i = 0; i < files.size(); ++i) {
+      found[i] = files[i].hash &&
+                 archivedContents.contains({files[i].size, *files[i].hash});
+    }
+  } catch (const sqlpp::exception& err) {
+    throw ArchivedDatabaseException(
+      "Could not look up the archived revisions of {} files: {}", files.size(),
+      err);
+  }
+  return found;
+}
+auto ArchivedDatabase::findRevisionsWithContents(
+  std::span<const StagedFile> files)
+  -> std::map<RevisionContents, ArchivedFileRevisionID> {
+  std::map<RevisionContents, ArchivedFileRevisionID> revisionIds;
+  std::vector<Size> sizes;
+  std::vector<std::vector<std::uint8_t>> hashes;
+  sizes.reserve(files.size());
+  hashes.reserve(files.size());
+  for (const auto& file : files) {
+    if (!file.hash)
+      continue;
+    sizes.push_back(file.size);
+    hashes.push_back(toBlob(*file.hash));
+  }
+  if (hashes.empty())
+    return revisionIds;
+
+  try {
+    // As with hasRevisionsWithContents, this can match the size of one file
+    // with the hash of another, which is harmless as only the contents of the
+    // files are looked up in the result.
+    const auto& results = databaseConnection(
+      select(fileRevisionTable.id, fileRevisionTable.size,
+             fileRevisionTable.hash)
+        .from(fileRevisionTable)
+        .where(fileRevisionTable.size.in(value_list(sizes)) and
+               fileRevisionTable.hash.in(value_list(hashes))));
+    for (const auto& row : results) {
+      revisionIds.emplace(
+        RevisionContents{row.size.value(),
+                         FileHash::fromBytes(row.hash.value())},
+        row.id);
+    }
+    return revisionIds;
+  } catch (const sqlpp::exception& err) {
+    throw ArchivedDatabaseException(
+      "Could not find the archived revisions of {} staged files: {}",
+      files.size(), err);
+  }
+}
+auto ArchivedDatabase::hasRevisionsWithFastHashes(
+  std::span<const RawFile> files) -> std::vector<bool> {
+  std::vector<bool> found(files.size(), false);
+  if (files.empty())
+    return found;
+
   try {
-    auto results =
-      databaseConnection(select(fileRevisionTable.id)
-                           .from(fileRevisionTable)
-                           .where(fileRevisionTable.size == file.size and
-                                  fileRevisionTable.hash == file.hash));
-    if (results.empty())
-      return std::nullopt;
-    return results.front().id;
+    std::vector<Size> sizes;
+    std::vector<std::vector<std::uint8_t>> hashes;
+    sizes.reserve(files.size());
+    hashes.reserve(files.size());
+    for (const auto& file : files) {
+      sizes.push_back(file.size);
+      hashes.push_back(toBlob(file.fastHash));
+    }
+    // As with hasRevisionsWithContents, the pairs are matched up here.
+    const auto& results = databaseConnection(
+      select(fileRevisionTable.size, fileRevisionTable.fastHash)
+        .from(fileRevisionTable)
+        .where(fileRevisionTable.size.in(value_list(sizes)) and
+               fileRevisionTable.fastHash.in(value_list(hashes))));
+    std::set<std::pair<Size, FastHash>> archivedContents;
+    for (const auto& row : results) {
+      archivedContents.emplace(row.size.value(),
+                               FastHash::fromBytes(row.fastHash.value()));
+    }
+    for (std::size_t i = 0; i < files.size(); ++i) {
+      found[i] =
+        archivedContents.contains({files[i].size, files[i].fastHash});
+    }
   } catch (const sqlpp::exception& err) {
     throw ArchivedDatabaseException(
-      "Could not find duplicate revision for staged file with id {}, name "
-      "\"{}\", and hash \"{}\": {}",
-      file.id, file.name, file.hash, err);
+      "Could not look up the archived revisions of {} files by their fast "
+      "hashes: {}",
+      files.size(), err);
+  }
+  return found;
+}
+auto ArchivedDatabase::listLinearRevisionSizes(Size minimumSize)
+  -> std::set<Size> {
+  try {
+    // Duplicate revisions have no size, so they are left out.
+    const auto& results = databaseConnection(
+      select(fileRevisionTable.size)
+        .flags(sqlpp::distinct)
+        .from(fileRevisionTable)
+        .where(fileRevisionTable.hashAlgorithm ==
+                 toColumn(HashAlgorithm::Linear) and
+               fileRevisionTable.size >= minimumSize));
+    std::set<Size> sizes;
+    for (const auto& row : results)
+      sizes.insert(row.size.value());
+    return sizes;
+  } catch (const sqlpp::exception& err) {
+    throw ArchivedDatabaseException(
+      "Could not list the sizes of the linearly hashed revisions: {}", err);
   }
 }
 auto ArchivedDatabase::createArchiveOperation() -> ArchiveOperationID {
@@ -487,5 +776,18 @@ auto ArchivedDatabase::createArchiveOperation() -> ArchiveOperationID {
       "Count not create archive operation data: {}", err);
   }
 }
+auto ArchivedDatabase::hasArchiveOperation(ArchiveOperationID archiveOperation)
+  -> bool {
+  try {
+    return !databaseConnection(
+              select(archiveOperationTable.id)
+                .from(archiveOperationTable)
+                .where(archiveOperationTable.id == archiveOperation))
+              .empty();
+  } catch (const sqlpp::exception& err) {
+    throw ArchivedDatabaseException(
+      "Could not check for archive operation {}: {}", archiveOperation, err);
+  }
+}
 
 }
\ No newline at end of file
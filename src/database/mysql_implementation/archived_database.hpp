@@ -10,7 +10,10 @@
 #include "../archived_database.hpp"
 #include "archiver_database.h"
 #include "database.hpp"
+#include "prepared_statements.hpp"
+#include <map>
 #include <optional>
+#include <set>
 #include <sqlpp11/mysql/mysql.h>
 #include <sqlpp11/sqlpp11.h>
 #include <string>
@@ -35,8 +38,20 @@ public:
   void rollback() final;
 
   auto getArchiveForFile(const StagedFile& file) -> Archive final;
+  auto listArchiveSizes() -> std::vector<std::pair<Archive, Size>> final;
+  auto getArchiveTargetSize() -> Size final;
+  auto addArchive(const Extension& extension) -> Archive final;
+  void addToArchiveSizes(std::span<const std::pair<Archive, Size>> sizes) final;
   auto getNextArchivePartNumber(const Archive& archive) -> uint64_t final;
   void incrementNextArchivePartNumber(const Archive& archive) final;
+  auto reserveArchivePartNumbers(const Archive& archive, uint64_t count)
+    -> uint64_t final;
+  auto listArchiveParts(const Archive& archive)
+    -> std::vector<ArchivePart> final;
+  auto listUncompressedRevisions(const Archive& archive)
+    -> std::vector<std::pair<ArchivedFileRevisionID, Size>> final;
+  void addArchiveParts(const Archive& archive,
+                       std::span<const ArchivePart> parts) final;
 
   auto listChildDirectories(const ArchivedDirectory& directory)
     -> std::vector<ArchivedDirectory> final;
@@ -52,8 +67,23 @@ public:
                const Archive& archive,
                const ArchiveOperationID archiveOperation)
     -> std::pair<ArchivedFileAddedType, ArchivedFileRevisionID> final;
+  auto addFiles(
+    std::span<const StagedFile> files,
+    std::span<const ArchivedDirectory> directories,
+    std::span<const Archive> archives, const ArchiveOperationID archiveOperation,
+    const std::map<RevisionContents, ArchivedFileRevisionID>& archivedRevisions)
+    -> std::vector<std::pair<ArchivedFileAddedType, ArchivedFileRevisionID>>
+      final;
 
   auto createArchiveOperation() -> ArchiveOperationID final;
+  auto hasArchiveOperation(ArchiveOperationID archiveOperation) -> bool final;
+  auto hasRevisionsWithContents(std::span<const RawFile> files)
+    -> std::vector<bool> final;
+  auto findRevisionsWithContents(std::span<const StagedFile> files)
+    -> std::map<RevisionContents, ArchivedFileRevisionID> final;
+  auto hasRevisionsWithFastHashes(std::span<const RawFile> files)
+    -> std::vector<bool> final;
+  auto listLinearRevisionSizes(Size minimumSize) -> std::set<Size> final;
 
 private:
   archiver_database::Archive archivesTable;
@@ -69,21 +99,44 @@ private:
   archiver_database::FileRevisionArchiveOperation
     fileRevisionArchiveOperationTable;
   archiver_database::ArchiveOperation archiveOperationTable;
+  archiver_database::ArchivePart archivePartTable;
   Size targetSize;
 
+  struct PreparedStatements {
+    explicit PreparedStatements(sqlpp::mysql::connection& connection);
+
+    statements::Prepared<statements::selectChildDirectory>
+      selectChildDirectory;
+    statements::Prepared<statements::selectChildDirectories>
+      selectChildDirectories;
+    statements::Prepared<statements::insertDirectory> insertDirectory;
+    statements::Prepared<statements::insertDirectoryParent>
+      insertDirectoryParent;
+    statements::Prepared<statements::insertDirectoryArchiveOperation>
+      insertDirectoryArchiveOperation;
+    statements::Prepared<statements::selectChildFiles> selectChildFiles;
+    statements::Prepared<statements::selectChildFileRevisions>
+      selectChildFileRevisions;
+    statements::Prepared<statements::selectNextArchivePartNumber>
+      selectNextArchivePartNumber;
+    statements::Prepared<statements::incrementNextArchivePartNumber>
+      incrementNextArchivePartNumber;
+    statements::Prepared<statements::reserveArchivePartNumbers>
+      reserveArchivePartNumbers;
+    statements::Prepared<statements::addToArchiveSize> addToArchiveSize;
+  };
+  PreparedStatements prepared;
+
   static const std::string noExtensionArchiveContents;
 
-  auto getArchiveForExtension(const std::string& extension) -> Archive;
-  auto addArchiveForExtension(const std::string& extension) -> Archive;
-  auto getArchiveSize(const Archive& archive) -> Size;
-  auto getFileRevisionsForFile(ArchivedFileID fileId)
-    -> std::vector<ArchivedFileRevision>;
-  auto getFileId(const std::string& name, const ArchivedDirectory& directory)
-    -> std::optional<ArchivedFileID>;
-  //  auto addNewFile(std::string_view name, const ArchivedDirectory& directory)
-  //    -> ArchivedFile;
-  auto findDuplicateRevisionId(const StagedFile& file)
-    -> std::optional<ArchivedFileRevisionID>;
+  // A file is identified by its parent directory and name.
+  using FileKey = std::pair<ArchivedDirectoryID, std::string>;
+
+  // The IDs of those of the files which have already been archived to the
+  // directory each is being added to.
+  auto findFileIds(std::span<const StagedFile> files,
+                   std::span<const ArchivedDirectory> directories)
+    -> std::map<FileKey, ArchivedFileID>;
 };
 }
 #endif
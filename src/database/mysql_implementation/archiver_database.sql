@@ -14,7 +14,7 @@ CREATE TABLE `archive_operation`
 CREATE TABLE `directory`
 (
     `id`   BIGINT UNSIGNED NOT NULL AUTO_INCREMENT,
-    `name` VARCHAR(1024)   NOT NULL,
+    `name` VARCHAR(1024) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL,
     PRIMARY KEY (`id`)
 );
 
@@ -42,7 +42,7 @@ VALUES ("/");
 CREATE TABLE `file`
 (
     `id`   BIGINT UNSIGNED NOT NULL AUTO_INCREMENT,
-    `name` VARCHAR(1024)   NOT NULL,
+    `name` VARCHAR(1024) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL,
     PRIMARY KEY (`id`)
 );
 
@@ -59,6 +59,7 @@ CREATE TABLE `archive`
 (
     `id`               BIGINT UNSIGNED NOT NULL AUTO_INCREMENT,
     `next_part_number` BIGINT UNSIGNED NOT NULL DEFAULT 1,
+    `current_size`     BIGINT UNSIGNED NOT NULL DEFAULT 0,
     `contents`         VARCHAR(255)    NOT NULL,
     PRIMARY KEY (`id`)
 );
@@ -66,14 +67,29 @@ CREATE TABLE `archive`
 INSERT INTO `archive` (`contents`)
 VALUES ("<SINGLE>");
 
+CREATE TABLE `archive_part`
+(
+    `archive_id`  BIGINT UNSIGNED NOT NULL,
+    `part_number` BIGINT UNSIGNED NOT NULL,
+    `file_count`  BIGINT UNSIGNED NOT NULL,
+    `size`        BIGINT UNSIGNED NOT NULL,
+    PRIMARY KEY (`archive_id`, `part_number`),
+    FOREIGN KEY (`archive_id`) REFERENCES `archive` (`id`)
+);
+
 CREATE TABLE `file_revision`
 (
-    `id`   BIGINT UNSIGNED NOT NULL AUTO_INCREMENT,
-    `hash` TEXT(256),
-    `size` BIGINT UNSIGNED,
+    `id`             BIGINT UNSIGNED  NOT NULL AUTO_INCREMENT,
+    `hash`           BINARY(128),
+    `fast_hash`      BINARY(16),
+    `hash_algorithm` TINYINT UNSIGNED NOT NULL DEFAULT 0,
+    `size`           BIGINT UNSIGNED,
     PRIMARY KEY (`id`)
 );
 
+CREATE INDEX `file_revision_size_hash` ON `file_revision` (`size`, `hash`);
+CREATE INDEX `file_revision_size_fast_hash` ON `file_revision` (`size`, `fast_hash`);
+
 CREATE TABLE `file_revision_parent`
 (
     `revision_id` BIGINT UNSIGNED NOT NULL,
@@ -87,11 +103,14 @@ CREATE TABLE `file_revision_archive`
 (
     `revision_id` BIGINT UNSIGNED NOT NULL,
     `archive_id`  BIGINT UNSIGNED NOT NULL,
+    `part_number` BIGINT UNSIGNED,
     PRIMARY KEY (`revision_id`, `archive_id`),
     FOREIGN KEY (`revision_id`) REFERENCES `file_revision` (`id`),
     FOREIGN KEY (`archive_id`) REFERENCES `archive` (`id`)
 );
 
+CREATE INDEX `file_revision_archive_part` ON `file_revision_archive` (`archive_id`, `part_number`);
+
 CREATE TABLE `file_revision_duplicate`
 (
     `revision_id`          BIGINT UNSIGNED NOT NULL,
@@ -128,13 +147,18 @@ CREATE TABLE `staged_directory_parent`
 
 CREATE TABLE `staged_file`
 (
-    `id`   BIGINT UNSIGNED NOT NULL AUTO_INCREMENT,
-    `name` VARCHAR(1024)   NOT NULL,
-    `hash` TEXT(256)       NOT NULL,
-    `size` BIGINT UNSIGNED NOT NULL,
+    `id`             BIGINT UNSIGNED NOT NULL AUTO_INCREMENT,
+    `name`           VARCHAR(1024)   NOT NULL,
+    `hash`           BINARY(128),
+    `fast_hash`      BINARY(16),
+    `hash_algorithm` TINYINT UNSIGNED NOT NULL DEFAULT 0,
+    `size`           BIGINT UNSIGNED NOT NULL,
+    `reference_only` BOOLEAN         NOT NULL DEFAULT FALSE,
     PRIMARY KEY (`id`)
 );
 
+CREATE INDEX `staged_file_size_hash` ON `staged_file` (`size`, `hash`);
+
 CREATE TABLE `staged_file_parent`
 (
     `directory_id` BIGINT UNSIGNED NOT NULL,
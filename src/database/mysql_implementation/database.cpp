@@ -38,6 +38,28 @@ void Database::rollback() {
   }
 }
 
+SQLPP_ALIAS_PROVIDER(autoIncrementIncrement);
+auto InsertedIds::at(sqlpp::mysql::connection& connection, ID firstId,
+                     std::size_t index) -> ID {
+  if (!increment) {
+    try {
+      const auto& results = connection(sqlpp::select(
+        sqlpp::verbatim<sqlpp::integer>("@@auto_increment_increment")
+          .as(autoIncrementIncrement)));
+      increment = static_cast<ID>(results.front().autoIncrementIncrement);
+    } catch (const sqlpp::exception& err) {
+      throw DatabaseException(
+        "Could not read the auto increment increment of the database: {}",
+        err);
+    }
+  }
+  return firstId + index * *increment;
+}
+
+auto Database::insertedId(ID firstId, std::size_t index) -> ID {
+  return insertedIds.at(databaseConnection, firstId, index);
+}
+
 Database::Database(std::shared_ptr<ConnectionConfig>& config)
   : databaseConnection(config) {}
 Database::~Database() {
@@ -2,11 +2,56 @@
 #define ARCHIVER_DEFAULT_IMPLEMENTATION_DATABASE_HPP
 
 #include "../../app/common.h"
+#include "../../app/file_hash.hpp"
 #include "../database.hpp"
+#include <optional>
 #include <sqlpp11/mysql/mysql.h>
 #include <sqlpp11/sqlpp11.h>
 
 namespace database::mysql {
+// File hashes are stored in BINARY columns, which sqlpp11 treats as blobs.
+inline auto toBlob(const FileHash& hash) -> std::vector<std::uint8_t> {
+  return {hash.bytes.begin(), hash.bytes.end()};
+}
+inline auto toBlob(const FastHash& hash) -> std::vector<std::uint8_t> {
+  return {hash.bytes.begin(), hash.bytes.end()};
+}
+// For the hash columns which may be NULL.
+template <typename Hash>
+auto toNullableBlob(const std::optional<Hash>& hash)
+  -> sqlpp::value_or_null_t<sqlpp::blob> {
+  if (hash)
+    return sqlpp::value_or_null(toBlob(*hash));
+  return sqlpp::value_or_null<sqlpp::blob>(sqlpp::null);
+}
+inline auto toColumn(HashAlgorithm algorithm) -> std::int64_t {
+  return static_cast<std::int64_t>(algorithm);
+}
+template <typename Field>
+auto hashAlgorithmFrom(const Field& field) -> HashAlgorithm {
+  return static_cast<HashAlgorithm>(field.value());
+}
+template <typename Hash, typename Field>
+auto fromNullableBlob(const Field& field) -> std::optional<Hash> {
+  if (field.is_null())
+    return std::nullopt;
+  return Hash::fromBytes(field.value());
+}
+
+// The IDs of the rows of a multiple row insert. The rows get IDs
+// auto_increment_increment apart, which is more than 1 on servers set up for
+// several writers, such as in a Galera cluster.
+class InsertedIds {
+public:
+  // The ID of the row at index, given the ID of the first row.
+  auto at(sqlpp::mysql::connection& connection, ID firstId, std::size_t index)
+    -> ID;
+
+private:
+  // Read from the server the first time it is needed.
+  std::optional<ID> increment;
+};
+
 class Database : public ::Database {
 public:
   using ConnectionConfig = sqlpp::mysql::connection_config;
@@ -16,8 +61,11 @@ public:
   void rollback();
 
 protected:
+  auto insertedId(ID firstId, std::size_t index) -> ID;
+
   sqlpp::mysql::connection databaseConnection;
   bool hasTransaction = false;
+  InsertedIds insertedIds;
 
 public:
   Database() = delete;
@@ -0,0 +1,27 @@
+-- Converts the hex TEXT(256) hash columns of a database created before hashes
+-- were stored in binary to BINARY(128), and indexes them together with the
+-- file size. MySQL commits each schema change as it is made, so back up the
+-- database before running this.
+
+USE `archiver`;
+
+ALTER TABLE `file_revision`
+    ADD COLUMN `binary_hash` BINARY(128) AFTER `hash`;
+UPDATE `file_revision`
+SET `binary_hash` = UNHEX(`hash`)
+WHERE `hash` IS NOT NULL;
+ALTER TABLE `file_revision`
+    DROP COLUMN `hash`,
+    RENAME COLUMN `binary_hash` TO `hash`;
+CREATE INDEX `file_revision_size_hash` ON `file_revision` (`size`, `hash`);
+
+ALTER TABLE `staged_file`
+    ADD COLUMN `binary_hash` BINARY(128) AFTER `hash`;
+UPDATE `staged_file`
+SET `binary_hash` = UNHEX(`hash`);
+ALTER TABLE `staged_file`
+    DROP COLUMN `hash`,
+    RENAME COLUMN `binary_hash` TO `hash`;
+ALTER TABLE `staged_file`
+    MODIFY COLUMN `hash` BINARY(128) NOT NULL;
+CREATE INDEX `staged_file_size_hash` ON `staged_file` (`size`, `hash`);
@@ -0,0 +1,7 @@
+-- Adds the flag marking staged files which had no copy staged, as their
+-- contents were already archived when they were staged.
+
+USE `archiver`;
+
+ALTER TABLE `staged_file`
+    ADD COLUMN `reference_only` BOOLEAN NOT NULL DEFAULT FALSE AFTER `size`;
@@ -0,0 +1,15 @@
+-- Adds the fast hash of each file, and lets staged files be recorded without
+-- their cryptographic hash, which the tiered hash policy only computes when it
+-- is needed. Revisions archived before this have no fast hash, so files
+-- matching them are only found to be duplicates once they are archived.
+
+USE `archiver`;
+
+ALTER TABLE `file_revision`
+    ADD COLUMN `fast_hash` BINARY(16) AFTER `hash`;
+
+CREATE INDEX `file_revision_size_fast_hash` ON `file_revision` (`size`, `fast_hash`);
+
+ALTER TABLE `staged_file`
+    MODIFY COLUMN `hash` BINARY(128),
+    ADD COLUMN `fast_hash` BINARY(16) AFTER `hash`;
@@ -0,0 +1,11 @@
+-- Adds how the hashes of each file were computed, as files of at least 4 GiB
+-- are now tree hashed. Every existing hash was computed linearly, which is the
+-- default.
+
+USE `archiver`;
+
+ALTER TABLE `file_revision`
+    ADD COLUMN `hash_algorithm` TINYINT UNSIGNED NOT NULL DEFAULT 0 AFTER `fast_hash`;
+
+ALTER TABLE `staged_file`
+    ADD COLUMN `hash_algorithm` TINYINT UNSIGNED NOT NULL DEFAULT 0 AFTER `fast_hash`;
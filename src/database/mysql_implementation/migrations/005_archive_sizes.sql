@@ -0,0 +1,15 @@
+-- Adds the total size of the revisions in each archive, which is now kept up
+-- to date as files are archived rather than summed over every revision of the
+-- archive whenever a file is archived. Existing archives are summed once here.
+
+USE `archiver`;
+
+ALTER TABLE `archive`
+    ADD COLUMN `current_size` BIGINT UNSIGNED NOT NULL DEFAULT 0 AFTER `next_part_number`;
+
+UPDATE `archive`
+SET `current_size` = (SELECT COALESCE(SUM(`file_revision`.`size`), 0)
+                      FROM `file_revision`
+                               JOIN `file_revision_archive`
+                                    ON `file_revision`.`id` = `file_revision_archive`.`revision_id`
+                      WHERE `file_revision_archive`.`archive_id` = `archive`.`id`);
@@ -0,0 +1,11 @@
+-- Gives the names of archived directories and files a binary collation, so
+-- they are compared exactly by the prepared statements which look them up,
+-- rather than by formatting each name into the query with its own collation.
+
+USE `archiver`;
+
+ALTER TABLE `directory`
+    MODIFY `name` VARCHAR(1024) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL;
+
+ALTER TABLE `file`
+    MODIFY `name` VARCHAR(1024) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL;
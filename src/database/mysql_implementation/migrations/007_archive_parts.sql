@@ -0,0 +1,26 @@
+-- Records the parts each archive is compressed into, and which part each
+-- revision is in, so that only the revisions not yet in a part are compressed.
+-- Revisions archived before parts were recorded are all put in part 0, as
+-- which part they are in isn't known. The archive operation before this is run
+-- should have finished compressing its archives, as any revision it left
+-- uncompressed is still put in part 0 and won't be compressed.
+
+USE `archiver`;
+
+CREATE TABLE `archive_part`
+(
+    `archive_id`  BIGINT UNSIGNED NOT NULL,
+    `part_number` BIGINT UNSIGNED NOT NULL,
+    `file_count`  BIGINT UNSIGNED NOT NULL,
+    `size`        BIGINT UNSIGNED NOT NULL,
+    PRIMARY KEY (`archive_id`, `part_number`),
+    FOREIGN KEY (`archive_id`) REFERENCES `archive` (`id`)
+);
+
+ALTER TABLE `file_revision_archive`
+    ADD COLUMN `part_number` BIGINT UNSIGNED AFTER `archive_id`;
+
+UPDATE `file_revision_archive`
+SET `part_number` = 0;
+
+CREATE INDEX `file_revision_archive_part` ON `file_revision_archive` (`archive_id`, `part_number`);
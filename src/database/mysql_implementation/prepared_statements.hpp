@@ -0,0 +1,201 @@
+#ifndef ARCHIVER_MYSQL_PREPARED_STATEMENTS_HPP
+#define ARCHIVER_MYSQL_PREPARED_STATEMENTS_HPP
+
+#include "archiver_database.h"
+#include <sqlpp11/mysql/mysql.h>
+#include <sqlpp11/sqlpp11.h>
+#include <utility>
+
+// The statements which are run for every directory or archive part, rather
+// than once per batch of files. Each is prepared once per connection, so MySQL
+// parses and plans it once, and the values are bound to it as parameters on
+// every run rather than being written into the SQL.
+namespace database::mysql::statements {
+template <auto makeStatement>
+using Prepared = decltype(std::declval<sqlpp::mysql::connection&>().prepare(
+  makeStatement()));
+
+// Archived directories
+
+inline auto selectChildDirectory() {
+  archiver_database::Directory directories;
+  archiver_database::DirectoryParent directoryParents;
+  archiver_database::DirectoryArchiveOperation directoryArchiveOperations;
+  return sqlpp::select(directories.id,
+                       directoryArchiveOperations.archiveOperationId)
+    .from(directoryParents.join(directories)
+            .on(directoryParents.childId == directories.id)
+            .join(directoryArchiveOperations)
+            .on(directories.id == directoryArchiveOperations.directoryId))
+    .where(directoryParents.parentId ==
+             sqlpp::parameter(directoryParents.parentId) and
+           directories.name == sqlpp::parameter(directories.name));
+}
+inline auto selectChildDirectories() {
+  archiver_database::Directory directories;
+  archiver_database::DirectoryParent directoryParents;
+  archiver_database::DirectoryArchiveOperation directoryArchiveOperations;
+  return sqlpp::select(sqlpp::all_of(directories),
+                       directoryArchiveOperations.archiveOperationId)
+    .from(directories.join(directoryParents)
+            .on(directories.id == directoryParents.childId)
+            .join(directoryArchiveOperations)
+            .on(directories.id == directoryArchiveOperations.directoryId))
+    .where(directoryParents.parentId ==
+           sqlpp::parameter(directoryParents.parentId));
+}
+inline auto insertDirectory() {
+  archiver_database::Directory directories;
+  return sqlpp::insert_into(directories)
+    .set(directories.name = sqlpp::parameter(directories.name));
+}
+inline auto insertDirectoryParent() {
+  archiver_database::DirectoryParent directoryParents;
+  return sqlpp::insert_into(directoryParents)
+    .set(directoryParents.parentId =
+           sqlpp::parameter(directoryParents.parentId),
+         directoryParents.childId = sqlpp::parameter(directoryParents.childId));
+}
+inline auto insertDirectoryArchiveOperation() {
+  archiver_database::DirectoryArchiveOperation directoryArchiveOperations;
+  return sqlpp::insert_into(directoryArchiveOperations)
+    .set(directoryArchiveOperations.directoryId =
+           sqlpp::parameter(directoryArchiveOperations.directoryId),
+         directoryArchiveOperations.archiveOperationId =
+           sqlpp::parameter(directoryArchiveOperations.archiveOperationId));
+}
+
+// Archived files
+
+inline auto selectChildFiles() {
+  archiver_database::File files;
+  archiver_database::FileParent fileParents;
+  return sqlpp::select(sqlpp::all_of(files))
+    .from(files.join(fileParents).on(files.id == fileParents.fileId))
+    .where(fileParents.directoryId ==
+           sqlpp::parameter(fileParents.directoryId));
+}
+namespace child_file_revisions {
+SQLPP_ALIAS_PROVIDER(DuplicateRevisionTable);
+SQLPP_ALIAS_PROVIDER(RelevantRevisionTable);
+SQLPP_ALIAS_PROVIDER(RelevantRevisionWithDuplicateTable);
+SQLPP_ALIAS_PROVIDER(revisionId);
+SQLPP_ALIAS_PROVIDER(revisionSize);
+SQLPP_ALIAS_PROVIDER(revisionHash);
+SQLPP_ALIAS_PROVIDER(revisionFastHash);
+SQLPP_ALIAS_PROVIDER(revisionHashAlgorithm);
+SQLPP_ALIAS_PROVIDER(revisionArchiveId);
+SQLPP_ALIAS_PROVIDER(isDuplicate);
+}
+// The revisions of every file in a directory, each with the ID of its file. A
+// duplicate revision is listed with the contents and archive of the revision
+// it duplicates.
+inline auto selectChildFileRevisions() {
+  using namespace child_file_revisions;
+  archiver_database::FileParent fileParents;
+  archiver_database::FileRevision fileRevisions;
+  archiver_database::FileRevisionParent fileRevisionParents;
+  archiver_database::FileRevisionDuplicate fileRevisionDuplicates;
+  archiver_database::FileRevisionArchive fileRevisionArchives;
+  archiver_database::FileRevisionArchiveOperation
+    fileRevisionArchiveOperations;
+  auto duplicateRevisions = fileRevisions.as(DuplicateRevisionTable);
+  auto relevantFileRevisions =
+    sqlpp::select(
+      sqlpp::all_of(fileRevisions), fileRevisionParents.fileId,
+      fileRevisionDuplicates.originalRevisionId,
+      fileRevisionDuplicates.revisionId.is_not_null().as(isDuplicate),
+      fileRevisionArchiveOperations.archiveOperationId)
+      .from(fileRevisions.join(fileRevisionParents)
+              .on(fileRevisions.id == fileRevisionParents.revisionId)
+              .join(fileParents)
+              .on(fileRevisionParents.fileId == fileParents.fileId)
+              .left_outer_join(fileRevisionDuplicates)
+              .on(fileRevisions.id == fileRevisionDuplicates.revisionId)
+              .join(fileRevisionArchiveOperations)
+              .on(fileRevisions.id == fileRevisionArchiveOperations.revisionId))
+      .where(fileParents.directoryId ==
+             sqlpp::parameter(fileParents.directoryId))
+      .as(RelevantRevisionTable);
+  auto relevantFileRevisionsWithDuplicateInfo =
+    sqlpp::select(sqlpp::case_when(relevantFileRevisions.isDuplicate == false)
+                    .then(relevantFileRevisions.id)
+                    .else_(duplicateRevisions.id)
+                    .as(revisionId),
+                  sqlpp::case_when(relevantFileRevisions.isDuplicate == false)
+                    .then(relevantFileRevisions.hash)
+                    .else_(duplicateRevisions.hash)
+                    .as(revisionHash),
+                  sqlpp::case_when(relevantFileRevisions.isDuplicate == false)
+                    .then(relevantFileRevisions.fastHash)
+                    .else_(duplicateRevisions.fastHash)
+                    .as(revisionFastHash),
+                  sqlpp::case_when(relevantFileRevisions.isDuplicate == false)
+                    .then(relevantFileRevisions.hashAlgorithm)
+                    .else_(duplicateRevisions.hashAlgorithm)
+                    .as(revisionHashAlgorithm),
+                  sqlpp::case_when(relevantFileRevisions.isDuplicate == false)
+                    .then(relevantFileRevisions.size)
+                    .else_(duplicateRevisions.size)
+                    .as(revisionSize),
+                  relevantFileRevisions.fileId,
+                  relevantFileRevisions.archiveOperationId,
+                  relevantFileRevisions.isDuplicate)
+      .from(relevantFileRevisions.left_outer_join(duplicateRevisions)
+              .on(relevantFileRevisions.originalRevisionId ==
+                  duplicateRevisions.id))
+      .unconditionally()
+      .as(RelevantRevisionWithDuplicateTable);
+  return sqlpp::select(sqlpp::all_of(relevantFileRevisionsWithDuplicateInfo),
+                       fileRevisionArchives.archiveId.as(revisionArchiveId))
+    .from(relevantFileRevisionsWithDuplicateInfo
+            .left_outer_join(fileRevisionArchives)
+            .on(relevantFileRevisionsWithDuplicateInfo.revisionId ==
+                fileRevisionArchives.revisionId))
+    .unconditionally();
+}
+
+// Archives
+
+inline auto selectNextArchivePartNumber() {
+  archiver_database::Archive archives;
+  return sqlpp::select(archives.nextPartNumber)
+    .from(archives)
+    .where(archives.id == sqlpp::parameter(archives.id))
+    .limit(1u);
+}
+inline auto incrementNextArchivePartNumber() {
+  archiver_database::Archive archives;
+  return sqlpp::update(archives)
+    .set(archives.nextPartNumber = archives.nextPartNumber + 1)
+    .where(archives.id == sqlpp::parameter(archives.id));
+}
+inline auto reserveArchivePartNumbers() {
+  archiver_database::Archive archives;
+  return sqlpp::update(archives)
+    .set(archives.nextPartNumber =
+           archives.nextPartNumber + sqlpp::parameter(archives.nextPartNumber))
+    .where(archives.id == sqlpp::parameter(archives.id));
+}
+inline auto addToArchiveSize() {
+  archiver_database::Archive archives;
+  return sqlpp::update(archives)
+    .set(archives.currentSize =
+           archives.currentSize + sqlpp::parameter(archives.currentSize))
+    .where(archives.id == sqlpp::parameter(archives.id));
+}
+
+// Staged directories
+
+inline auto selectStagedChildDirectories() {
+  archiver_database::StagedDirectory stagedDirectories;
+  archiver_database::StagedDirectoryParent stagedDirectoryParents;
+  return sqlpp::select(sqlpp::all_of(stagedDirectories))
+    .from(stagedDirectories.join(stagedDirectoryParents)
+            .on(stagedDirectories.id == stagedDirectoryParents.childId))
+    .where(stagedDirectoryParents.parentId ==
+           sqlpp::parameter(stagedDirectoryParents.parentId));
+}
+}
+
+#endif
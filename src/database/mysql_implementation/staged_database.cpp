@@ -1,13 +1,17 @@
 #include "staged_database.hpp"
 #include "../../app/staged_file.hpp"
 #include "../staged_database.hpp"
+#include <map>
+#include <ranges>
 
 using namespace sqlpp;
 
 namespace database::mysql {
 StagedDatabase::StagedDatabase(
   std::shared_ptr<StagedDatabase::ConnectionConfig>& config)
-  : databaseConnection(config) {}
+  : databaseConnection(config),
+    selectChildDirectories(
+      databaseConnection.prepare(statements::selectStagedChildDirectories())) {}
 
 StagedDatabase::~StagedDatabase() {
   try {
@@ -40,6 +44,7 @@ void StagedDatabase::rollback() {
     try {
       databaseConnection.rollback_transaction(false);
       hasTransaction = false;
+      undoCachedDirectories();
     } catch (sqlpp::exception& err) {
       throw DatabaseException(
         "Could not rollback the transaction on the staged database: {}", err);
@@ -51,6 +56,7 @@ void StagedDatabase::commit() {
     try {
       databaseConnection.commit_transaction();
       hasTransaction = false;
+      directoriesAddedInTransaction.clear();
     } catch (sqlpp::exception& err) {
       throw DatabaseException(
         "Could not commit the transaction on the staged database: {}", err);
@@ -59,22 +65,52 @@ void StagedDatabase::commit() {
 }
 
 auto StagedDatabase::listAllFiles() -> std::vector<StagedFile> {
+  return listFiles(false);
+}
+auto StagedDatabase::listAllFilesSorted() -> std::vector<StagedFile> {
+  return listFiles(true);
+}
+
+auto StagedDatabase::streamFilesSorted() -> Generator<StagedFile> {
+  // Each page starts after the last row of the previous one, rather than at
+  // an offset, so reading a page doesn't get slower the further in it is.
+  StagedDirectoryID lastDirectoryId = 0;
+  StagedFileID lastFileId = 0;
+  while (true) {
+    auto page = listFilesPage(lastDirectoryId, lastFileId);
+    if (page.empty())
+      co_return;
+    lastDirectoryId = page.back().parent;
+    lastFileId = page.back().id;
+    for (auto& stagedFile : page)
+      co_yield stagedFile;
+    if (page.size() < StreamPageSize)
+      co_return;
+  }
+}
+
+auto StagedDatabase::listFilesPage(StagedDirectoryID afterDirectoryId,
+                                   StagedFileID afterFileId)
+  -> std::vector<StagedFile> {
   std::vector<StagedFile> stagedFiles;
+  stagedFiles.reserve(StreamPageSize);
   try {
-    auto results = databaseConnection(select(all_of(stagedFilesTable))
-                                        .from(stagedFilesTable)
-                                        .unconditionally());
-
-    for (const auto& stagedFile : results) {
-      const auto& stagedFileParent =
-        databaseConnection(
-          select(stagedFileParentTable.directoryId)
-            .from(stagedFileParentTable)
-            .where(stagedFileParentTable.fileId == stagedFile.id))
-          .front();
-      stagedFiles.push_back({stagedFile.id, stagedFileParent.directoryId,
-                             stagedFile.name, stagedFile.size,
-                             stagedFile.hash});
+    const auto& results = databaseConnection(
+      select(all_of(stagedFilesTable), stagedFileParentTable.directoryId)
+        .from(stagedFilesTable.join(stagedFileParentTable)
+                .on(stagedFilesTable.id == stagedFileParentTable.fileId))
+        .where(stagedFileParentTable.directoryId > afterDirectoryId or
+               (stagedFileParentTable.directoryId == afterDirectoryId and
+                stagedFileParentTable.fileId > afterFileId))
+        .order_by(stagedFileParentTable.directoryId.asc(),
+                  stagedFileParentTable.fileId.asc())
+        .limit(StreamPageSize));
+    for (const auto& row : results) {
+      stagedFiles.push_back({row.id, row.directoryId, row.name, row.size,
+                             fromNullableBlob<FileHash>(row.hash),
+                             row.referenceOnly.value(),
+                             fromNullableBlob<FastHash>(row.fastHash),
+                             hashAlgorithmFrom(row.hashAlgorithm)});
     }
   } catch (const sqlpp::exception& err) {
     throw StagedDatabaseException("Could not list staged files: {}", err);
@@ -82,6 +118,44 @@ auto StagedDatabase::listAllFiles() -> std::vector<StagedFile> {
   return stagedFiles;
 }
 
+auto StagedDatabase::listFiles(bool sorted) -> std::vector<StagedFile> {
+  std::vector<StagedFile> stagedFiles;
+  try {
+    const Size numberOfFiles =
+      databaseConnection(
+        select(count(1)).from(stagedFilesTable).unconditionally())
+        .front()
+        .count;
+    stagedFiles.reserve(numberOfFiles);
+
+    const auto query =
+      select(all_of(stagedFilesTable), stagedFileParentTable.directoryId)
+        .from(stagedFilesTable.join(stagedFileParentTable)
+                .on(stagedFilesTable.id == stagedFileParentTable.fileId))
+        .unconditionally();
+    const auto readFiles = [&](auto&& results) {
+      for (const auto& row : results) {
+        stagedFiles.push_back({row.id, row.directoryId, row.name, row.size,
+                               fromNullableBlob<FileHash>(row.hash),
+                               row.referenceOnly.value(),
+                               fromNullableBlob<FastHash>(row.fastHash),
+                               hashAlgorithmFrom(row.hashAlgorithm)});
+      }
+    };
+    // The order matches the primary key of staged_file_parent, so MySQL
+    // can read the files in order without sorting them.
+    if (sorted)
+      readFiles(databaseConnection(
+        query.order_by(stagedFileParentTable.directoryId.asc(),
+                       stagedFileParentTable.fileId.asc())));
+    else
+      readFiles(databaseConnection(query));
+  } catch (const sqlpp::exception& err) {
+    throw StagedDatabaseException("Could not list staged files: {}", err);
+  }
+  return stagedFiles;
+}
+
 auto StagedDatabase::add(const RawFile& file,
                          const std::filesystem::path& stagePath) -> StagedFile {
   try {
@@ -94,20 +168,102 @@ auto StagedDatabase::add(const RawFile& file,
     const auto stagedFileId = databaseConnection(
       insert_into(stagedFilesTable)
         .set(stagedFilesTable.name = stagePath.filename().string(),
-             stagedFilesTable.hash = file.hash,
+             stagedFilesTable.hash = toNullableBlob(file.hash),
+             stagedFilesTable.fastHash = toBlob(file.fastHash),
+             stagedFilesTable.hashAlgorithm = toColumn(file.hashAlgorithm),
              stagedFilesTable.size = file.size));
     databaseConnection(
       insert_into(stagedFileParentTable)
         .set(stagedFileParentTable.fileId = stagedFileId,
              stagedFileParentTable.directoryId = parentStagedDirectory->id));
     return {stagedFileId, parentStagedDirectory->id,
-            stagePath.filename().string(), file.size, file.hash};
+            stagePath.filename().string(), file.size, file.hash, false,
+            file.fastHash, file.hashAlgorithm};
   } catch (const sqlpp::exception& err) {
     throw StagedDatabaseException(
       "Could not add file to staged file database: {}", err);
   }
 }
 
+auto StagedDatabase::addFiles(std::span<const RawFile> files,
+                              std::span<const std::filesystem::path> stagePaths)
+  -> std::vector<StagedFile> {
+  return addStagedFiles(files, stagePaths, false);
+}
+auto StagedDatabase::addReferences(
+  std::span<const RawFile> files,
+  std::span<const std::filesystem::path> stagePaths)
+  -> std::vector<StagedFile> {
+  return addStagedFiles(files, stagePaths, true);
+}
+auto StagedDatabase::addStagedFiles(
+  std::span<const RawFile> files,
+  std::span<const std::filesystem::path> stagePaths, bool referenceOnly)
+  -> std::vector<StagedFile> {
+  if (files.size() != stagePaths.size()) {
+    throw StagedDatabaseException(
+      "Could not add files to staged file database as {} files were given "
+      "with {} stage paths",
+      files.size(), stagePaths.size());
+  }
+  if (files.empty())
+    return {};
+
+  try {
+    std::vector<StagedFile> stagedFiles;
+    stagedFiles.reserve(files.size());
+
+    auto insertFiles =
+      insert_into(stagedFilesTable)
+        .columns(stagedFilesTable.name, stagedFilesTable.hash,
+                 stagedFilesTable.fastHash, stagedFilesTable.hashAlgorithm,
+                 stagedFilesTable.size, stagedFilesTable.referenceOnly);
+    for (std::size_t i = 0; i < files.size(); ++i) {
+      const auto parentStagedDirectory =
+        getStagedDirectory(stagePaths[i].parent_path());
+      if (!parentStagedDirectory) {
+        throw StagedDatabaseException(
+          "Could not add file to staged file database as the parent "
+          "directory hasn't been added to the staged directory database");
+      }
+
+      const auto name = stagePaths[i].filename().string();
+      insertFiles.values.add(
+        stagedFilesTable.name = name,
+        stagedFilesTable.hash = toNullableBlob(files[i].hash),
+        stagedFilesTable.fastHash = toBlob(files[i].fastHash),
+        stagedFilesTable.hashAlgorithm = toColumn(files[i].hashAlgorithm),
+        stagedFilesTable.size = files[i].size,
+        stagedFilesTable.referenceOnly = referenceOnly);
+      stagedFiles.push_back({0, parentStagedDirectory->id, name, files[i].size,
+                             files[i].hash, referenceOnly, files[i].fastHash,
+                             files[i].hashAlgorithm});
+    }
+
+    // The number of rows is known up front, which makes this a "simple
+    // insert" to InnoDB, so the rows get evenly spaced IDs starting from the
+    // one returned.
+    const StagedFileID firstId = databaseConnection(insertFiles);
+
+    auto insertParents =
+      insert_into(stagedFileParentTable)
+        .columns(stagedFileParentTable.fileId,
+                 stagedFileParentTable.directoryId);
+    for (std::size_t i = 0; i < stagedFiles.size(); ++i) {
+      stagedFiles[i].id = insertedId(firstId, i);
+      insertParents.values.add(
+        stagedFileParentTable.fileId = stagedFiles[i].id,
+        stagedFileParentTable.directoryId = stagedFiles[i].parent);
+    }
+    databaseConnection(insertParents);
+
+    return stagedFiles;
+  } catch (const sqlpp::exception& err) {
+    throw StagedDatabaseException(
+      "Could not add files to staged file database: {}", err);
+  }
+}
+
 void StagedDatabase::remove(const StagedFile& stagedFile) {
   try {
     databaseConnection(remove_from(stagedFileParentTable)
@@ -131,26 +287,84 @@ void StagedDatabase::removeAllFiles() {
 }
 
 auto StagedDatabase::listAllDirectories() -> std::vector<StagedDirectory> {
+  return listDirectories(false);
+}
+auto StagedDatabase::listAllDirectoriesSorted()
+  -> std::vector<StagedDirectory> {
+  return listDirectories(true);
+}
+
+auto StagedDatabase::streamDirectoriesSorted() -> Generator<StagedDirectory> {
+  StagedDirectoryID lastId = 0;
+  while (true) {
+    auto page = listDirectoriesPage(lastId);
+    if (page.empty())
+      co_return;
+    lastId = page.back().id;
+    for (auto& stagedDirectory : page)
+      co_yield stagedDirectory;
+    if (page.size() < StreamPageSize)
+      co_return;
+  }
+}
+
+auto StagedDatabase::listDirectoriesPage(StagedDirectoryID afterId)
+  -> std::vector<StagedDirectory> {
   std::vector<StagedDirectory> stagedDirectories;
+  stagedDirectories.reserve(StreamPageSize);
   try {
-    auto results = databaseConnection(select(all_of(stagedDirectoriesTable))
-                                        .from(stagedDirectoriesTable)
-                                        .unconditionally());
+    const auto& results = databaseConnection(
+      select(all_of(stagedDirectoriesTable),
+             stagedDirectoryParentTable.parentId)
+        .from(stagedDirectoriesTable.left_outer_join(stagedDirectoryParentTable)
+                .on(stagedDirectoriesTable.id ==
+                    stagedDirectoryParentTable.childId))
+        .where(stagedDirectoriesTable.id > afterId)
+        .order_by(stagedDirectoriesTable.id.asc())
+        .limit(StreamPageSize));
+    for (const auto& row : results) {
+      stagedDirectories.push_back(
+        {row.id, row.name,
+         row.parentId.is_null() ? row.id.value() : row.parentId.value()});
+    }
+  } catch (const sqlpp::exception& err) {
+    throw StagedDatabaseException("Could not list staged directories: {}", err);
+  }
+  return stagedDirectories;
+}
 
-    for (const auto& stagedDirectory : results) {
-      const auto& stagedDirectoryParentResult = databaseConnection(
-        select(stagedDirectoryParentTable.parentId)
-          .from(stagedDirectoryParentTable)
-          .where(stagedDirectoryParentTable.childId == stagedDirectory.id));
-      if (stagedDirectoryParentResult.empty()) {
-        stagedDirectories.push_back(
-          {stagedDirectory.id, stagedDirectory.name, stagedDirectory.id});
-      } else {
+auto StagedDatabase::listDirectories(bool sorted)
+  -> std::vector<StagedDirectory> {
+  std::vector<StagedDirectory> stagedDirectories;
+  try {
+    const Size numberOfDirectories =
+      databaseConnection(
+        select(count(1)).from(stagedDirectoriesTable).unconditionally())
+        .front()
+        .count;
+    stagedDirectories.reserve(numberOfDirectories);
+
+    // The root directory is the only one without a parent, and is its own
+    // parent.
+    const auto query =
+      select(all_of(stagedDirectoriesTable),
+             stagedDirectoryParentTable.parentId)
+        .from(stagedDirectoriesTable.left_outer_join(stagedDirectoryParentTable)
+                .on(stagedDirectoriesTable.id ==
+                    stagedDirectoryParentTable.childId))
+        .unconditionally();
+    const auto readDirectories = [&](auto&& results) {
+      for (const auto& row : results) {
         stagedDirectories.push_back(
-          {stagedDirectory.id, stagedDirectory.name,
-           stagedDirectoryParentResult.front().parentId});
+          {row.id, row.name,
+           row.parentId.is_null() ? row.id.value() : row.parentId.value()});
       }
-    }
+    };
+    if (sorted)
+      readDirectories(
+        databaseConnection(query.order_by(stagedDirectoriesTable.id.asc())));
+    else
+      readDirectories(databaseConnection(query));
   } catch (const sqlpp::exception& err) {
     throw StagedDatabaseException("Could not list staged directories: {}", err);
   }
@@ -169,9 +383,13 @@ void StagedDatabase::add(const std::filesystem::path& stagePath) {
       return;
 
     if (pathToStage.string() == StagedDirectory::RootDirectoryName) {
-      databaseConnection(insert_into(stagedDirectoriesTable)
-                           .set(stagedDirectoriesTable.name = std::string{
-                                  StagedDirectory::RootDirectoryName}));
+      const auto rootId =
+        databaseConnection(insert_into(stagedDirectoriesTable)
+                             .set(stagedDirectoriesTable.name = std::string{
+                                    StagedDirectory::RootDirectoryName}));
+      cacheAddedDirectory(
+        pathToStage,
+        {rootId, std::string{StagedDirectory::RootDirectoryName}, rootId});
       return;
     }
 
@@ -188,12 +406,107 @@ void StagedDatabase::add(const std::filesystem::path& stagePath) {
       insert_into(stagedDirectoryParentTable)
         .set(stagedDirectoryParentTable.parentId = parentStagedDirectory->id,
              stagedDirectoryParentTable.childId = stagedDirectoryId));
+    cacheAddedDirectory(pathToStage, {stagedDirectoryId,
+                                      pathToStage.filename().string(),
+                                      parentStagedDirectory->id});
   } catch (const sqlpp::exception& err) {
     throw StagedDatabaseException(
       "Could not add directory to staged directory database: {}", err);
   }
 }
 
+void StagedDatabase::addDirectories(
+  std::span<const std::filesystem::path> stagePaths) {
+  struct NewDirectory {
+    std::filesystem::path path;
+    // Either the ID of an already staged parent, or the index of a parent
+    // which is being added in the same batch.
+    std::optional<StagedDirectoryID> parentId;
+    std::size_t parentIndex;
+  };
+  std::vector<NewDirectory> newDirectories;
+  std::map<std::filesystem::path, std::size_t> newDirectoryIndices;
+
+  const auto insertNewDirectories = [&]() {
+    if (newDirectories.empty())
+      return;
+
+    auto insertDirectories = insert_into(stagedDirectoriesTable)
+                               .columns(stagedDirectoriesTable.name);
+    for (const auto& directory : newDirectories) {
+      insertDirectories.values.add(stagedDirectoriesTable.name =
+                                     directory.path.filename().string());
+    }
+    // See addFiles for why the IDs are evenly spaced.
+    const StagedDirectoryID firstId = databaseConnection(insertDirectories);
+
+    auto insertParents = insert_into(stagedDirectoryParentTable)
+                           .columns(stagedDirectoryParentTable.parentId,
+                                    stagedDirectoryParentTable.childId);
+    for (std::size_t i = 0; i < newDirectories.size(); ++i) {
+      const auto& directory = newDirectories[i];
+      insertParents.values.add(
+        stagedDirectoryParentTable.parentId =
+          directory.parentId.value_or(
+            insertedId(firstId, directory.parentIndex)),
+        stagedDirectoryParentTable.childId = insertedId(firstId, i));
+    }
+    databaseConnection(insertParents);
+
+    // Parents come before their children, so each parent is already cached.
+    for (std::size_t i = 0; i < newDirectories.size(); ++i) {
+      const auto& directory = newDirectories[i];
+      cacheAddedDirectory(
+        directory.path,
+        {insertedId(firstId, i), directory.path.filename().string(),
+         directory.parentId.value_or(
+           insertedId(firstId, directory.parentIndex))});
+    }
+
+    newDirectories.clear();
+    newDirectoryIndices.clear();
+  };
+
+  try {
+    for (const auto& stagePath : stagePaths) {
+      const auto pathToStage = stagePath.filename().empty()
+                                 ? stagePath.parent_path()
+                                 : stagePath;
+      if (pathToStage.empty() || newDirectoryIndices.contains(pathToStage))
+        continue;
+
+      // A directory whose parent is new in this batch has no parent ID yet, so
+      // it is added in the same insert and refers to its parent by index.
+      const auto parentPath = pathToStage.parent_path();
+      if (const auto parentIndex = newDirectoryIndices.find(parentPath);
+          parentIndex != newDirectoryIndices.end()) {
+        newDirectoryIndices.emplace(pathToStage, newDirectories.size());
+        newDirectories.push_back({pathToStage, std::nullopt,
+                                  parentIndex->second});
+        continue;
+      }
+      if (getStagedDirectory(pathToStage))
+        continue;
+
+      const auto parent = getStagedDirectory(parentPath);
+      if (!parent ||
+          pathToStage.string() == StagedDirectory::RootDirectoryName) {
+        // The root directory, and directories whose parents have to be
+        // created first, are rare enough to be added one at a time.
+        insertNewDirectories();
+        add(pathToStage);
+        continue;
+      }
+      newDirectoryIndices.emplace(pathToStage, newDirectories.size());
+      newDirectories.push_back({pathToStage, parent->id, 0});
+    }
+    insertNewDirectories();
+  } catch (const sqlpp::exception& err) {
+    throw StagedDatabaseException(
+      "Could not add directories to staged directory database: {}", err);
+  }
+}
+
 void StagedDatabase::remove(const StagedDirectory& stagedDirectory) {
   try {
     const Size numberOfChildren =
@@ -214,6 +527,7 @@ void StagedDatabase::remove(const StagedDirectory& stagedDirectory) {
     databaseConnection(
       remove_from(stagedDirectoriesTable)
         .where(stagedDirectoriesTable.id == stagedDirectory.id));
+    clearDirectoryCache();
   } catch (const sqlpp::exception& err) {
     throw StagedDatabaseException(
       "Could not remove directory from staged directory database: {}", err);
@@ -225,6 +539,7 @@ void StagedDatabase::removeAllDirectories() {
     databaseConnection(
       remove_from(stagedDirectoryParentTable).unconditionally());
     databaseConnection(remove_from(stagedDirectoriesTable).unconditionally());
+    clearDirectoryCache();
     databaseConnection.execute(
       FORMAT_LIB::format("ALTER TABLE {} AUTO_INCREMENT = 1",
                          decltype(stagedDirectoriesTable)::_alias_t::_literal));
@@ -240,47 +555,123 @@ auto StagedDatabase::getRootDirectory() -> std::optional<StagedDirectory> {
 
 auto StagedDatabase::getStagedDirectory(const std::filesystem::path& stagePath)
   -> std::optional<StagedDirectory> {
-
-  StagedDirectory foundStagedDirectory;
-  ID currentId;
-
   try {
+    DirectoryNode* node = nullptr;
     for (const auto& name : stagePath) {
       if (name == StagedDirectory::RootDirectoryName) {
-        const auto& results = databaseConnection(
-          select(all_of(stagedDirectoriesTable))
-            .from(stagedDirectoriesTable)
-            .where(stagedDirectoriesTable.name == name.string()));
-        if (results.empty()) {
-          return std::nullopt;
-        }
-
-        const auto& row = results.front();
-        currentId = row.id;
-        foundStagedDirectory = StagedDirectory{row.id, row.name, row.id};
-      } else {
-        const auto& results = databaseConnection(
-          select(all_of(stagedDirectoriesTable),
-                 stagedDirectoryParentTable.parentId)
-            .from(stagedDirectoriesTable.join(stagedDirectoryParentTable)
-                    .on(stagedDirectoriesTable.id ==
-                        stagedDirectoryParentTable.childId))
-            .where(stagedDirectoryParentTable.parentId == currentId and
-                   stagedDirectoriesTable.name == name.string()));
-        if (results.empty()) {
-          return std::nullopt;
-        }
-
-        const auto& row = results.front();
-        currentId = row.id;
-        foundStagedDirectory = StagedDirectory{row.id, row.name, row.parentId};
+        node = getRootDirectoryNode();
+      } else if (node) {
+        auto& children = getChildren(*node);
+        const auto child = children.find(name.string());
+        node = child == children.end() ? nullptr : child->second.get();
       }
+      if (!node)
+        return std::nullopt;
     }
+    // An empty path.
+    if (!node)
+      return StagedDirectory{};
+    return node->directory;
   } catch (const sqlpp::exception& err) {
     throw StagedDatabaseException(
       "Could not get directory from staged directory database: {}", err);
   }
+}
+
+auto StagedDatabase::insertedId(ID firstId, std::size_t index) -> ID {
+  return insertedIds.at(databaseConnection, firstId, index);
+}
+
+auto StagedDatabase::getRootDirectoryNode() -> DirectoryNode* {
+  if (!rootDirectoryLoaded) {
+    const auto& results = databaseConnection(
+      select(all_of(stagedDirectoriesTable))
+        .from(stagedDirectoriesTable)
+        .where(stagedDirectoriesTable.name ==
+               std::string{StagedDirectory::RootDirectoryName}));
+    if (!results.empty()) {
+      const auto& row = results.front();
+      rootDirectoryNode = std::make_unique<DirectoryNode>(
+        DirectoryNode{{row.id, row.name, row.id}, std::nullopt});
+    }
+    rootDirectoryLoaded = true;
+  }
+  return rootDirectoryNode.get();
+}
 
-  return foundStagedDirectory;
+auto StagedDatabase::getChildren(DirectoryNode& node)
+  -> DirectoryNode::Children& {
+  if (!node.children) {
+    selectChildDirectories.params.parentId = node.directory.id;
+    DirectoryNode::Children children;
+    for (const auto& row : databaseConnection(selectChildDirectories)) {
+      children.emplace(row.name,
+                       std::make_unique<DirectoryNode>(DirectoryNode{
+                         {row.id, row.name, node.directory.id}, std::nullopt}));
+    }
+    node.children = std::move(children);
+  }
+  return *node.children;
+}
+
+auto StagedDatabase::findCachedDirectoryNode(
+  const std::filesystem::path& stagePath) -> DirectoryNode* {
+  DirectoryNode* node = nullptr;
+  for (const auto& name : stagePath) {
+    if (name == StagedDirectory::RootDirectoryName) {
+      node = rootDirectoryNode.get();
+    } else if (node && node->children) {
+      const auto child = node->children->find(name.string());
+      node = child == node->children->end() ? nullptr : child->second.get();
+    } else {
+      node = nullptr;
+    }
+    if (!node)
+      return nullptr;
+  }
+  return node;
+}
+
+void StagedDatabase::cacheAddedDirectory(
+  const std::filesystem::path& stagePath,
+  const StagedDirectory& stagedDirectory) {
+  if (hasTransaction)
+    directoriesAddedInTransaction.push_back(stagePath);
+
+  // A new directory has no children, so they don't need to be loaded.
+  auto node = std::make_unique<DirectoryNode>(
+    DirectoryNode{stagedDirectory, DirectoryNode::Children{}});
+  if (stagePath.string() == StagedDirectory::RootDirectoryName) {
+    rootDirectoryNode = std::move(node);
+    rootDirectoryLoaded = true;
+    return;
+  }
+  // If the parent's children haven't been loaded yet, the new directory will
+  // be loaded along with them.
+  auto parent = findCachedDirectoryNode(stagePath.parent_path());
+  if (parent && parent->children)
+    parent->children->emplace(stagedDirectory.name, std::move(node));
+}
+
+void StagedDatabase::undoCachedDirectories() {
+  // Directories added during the transaction may also have been loaded from
+  // the database as the children of another directory, so they are removed
+  // by path rather than only if cacheAddedDirectory inserted them.
+  for (const auto& stagePath :
+       std::views::reverse(directoriesAddedInTransaction)) {
+    if (stagePath.string() == StagedDirectory::RootDirectoryName) {
+      rootDirectoryNode.reset();
+      continue;
+    }
+    auto parent = findCachedDirectoryNode(stagePath.parent_path());
+    if (parent && parent->children)
+      parent->children->erase(stagePath.filename().string());
+  }
+  directoriesAddedInTransaction.clear();
+}
+
+void StagedDatabase::clearDirectoryCache() {
+  rootDirectoryNode.reset();
+  rootDirectoryLoaded = false;
+}
 }
-}
\ No newline at end of file
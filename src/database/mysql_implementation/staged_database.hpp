@@ -8,6 +8,9 @@
 #include "../staged_database.hpp"
 #include "archiver_database.h"
 #include "database.hpp"
+#include "prepared_statements.hpp"
+#include <map>
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -30,27 +33,82 @@ public:
   void rollback() final;
 
   auto listAllFiles() -> std::vector<StagedFile> final;
+  auto listAllFilesSorted() -> std::vector<StagedFile> final;
+  auto streamFilesSorted() -> Generator<StagedFile> final;
   auto add(const RawFile& file, const std::filesystem::path& stagePath)
     -> StagedFile final;
+  auto addFiles(std::span<const RawFile> files,
+                std::span<const std::filesystem::path> stagePaths)
+    -> std::vector<StagedFile> final;
+  auto addReferences(std::span<const RawFile> files,
+                     std::span<const std::filesystem::path> stagePaths)
+    -> std::vector<StagedFile> final;
   void remove(const StagedFile& stagedFile) final;
   void removeAllFiles() final;
 
   auto listAllDirectories() -> std::vector<StagedDirectory> final;
+  auto listAllDirectoriesSorted() -> std::vector<StagedDirectory> final;
+  auto streamDirectoriesSorted() -> Generator<StagedDirectory> final;
   void add(const std::filesystem::path& stagePath) final;
+  void addDirectories(std::span<const std::filesystem::path> stagePaths) final;
   void remove(const StagedDirectory& stagedDirectory) final;
   void removeAllDirectories() final;
   auto getRootDirectory() -> std::optional<StagedDirectory> final;
 
 private:
+  // The number of rows read at a time when streaming a listing.
+  static constexpr std::size_t StreamPageSize = 10000;
+
   sqlpp::mysql::connection databaseConnection;
+  statements::Prepared<statements::selectStagedChildDirectories>
+    selectChildDirectories;
   archiver_database::StagedFile stagedFilesTable;
   archiver_database::StagedFileParent stagedFileParentTable;
   archiver_database::StagedDirectory stagedDirectoriesTable;
   archiver_database::StagedDirectoryParent stagedDirectoryParentTable;
   bool hasTransaction = false;
+  InsertedIds insertedIds;
+
+  // A cache of the staged directory tree so paths can be resolved without a
+  // query per path component. The children of a directory are loaded the
+  // first time a path goes through it, and directories are added to the
+  // cache as this connection adds them to the database. The paths of the
+  // directories added during a transaction are kept so a rollback can remove
+  // them again. This assumes nothing else adds or removes staged directories
+  // while the connection is open.
+  struct DirectoryNode {
+    using Children =
+      std::map<std::string, std::unique_ptr<DirectoryNode>, std::less<>>;
+
+    StagedDirectory directory;
+    // Not set until the children have been loaded.
+    std::optional<Children> children;
+  };
+  std::unique_ptr<DirectoryNode> rootDirectoryNode;
+  bool rootDirectoryLoaded = false;
+  std::vector<std::filesystem::path> directoriesAddedInTransaction;
 
+  auto listFiles(bool sorted) -> std::vector<StagedFile>;
+  auto listDirectories(bool sorted) -> std::vector<StagedDirectory>;
+  // The next page of a sorted listing, starting after the given keys.
+  auto listFilesPage(StagedDirectoryID afterDirectoryId,
+                     StagedFileID afterFileId) -> std::vector<StagedFile>;
+  auto listDirectoriesPage(StagedDirectoryID afterId)
+    -> std::vector<StagedDirectory>;
+  auto addStagedFiles(std::span<const RawFile> files,
+                      std::span<const std::filesystem::path> stagePaths,
+                      bool referenceOnly) -> std::vector<StagedFile>;
   auto getStagedDirectory(const std::filesystem::path& stagePath)
     -> std::optional<StagedDirectory>;
+  auto insertedId(ID firstId, std::size_t index) -> ID;
+  auto getRootDirectoryNode() -> DirectoryNode*;
+  auto getChildren(DirectoryNode& node) -> DirectoryNode::Children&;
+  auto findCachedDirectoryNode(const std::filesystem::path& stagePath)
+    -> DirectoryNode*;
+  void cacheAddedDirectory(const std::filesystem::path& stagePath,
+                           const StagedDirectory& stagedDirectory);
+  void undoCachedDirectories();
+  void clearDirectoryCache();
 };
 }
 
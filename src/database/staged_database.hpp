@@ -5,19 +5,46 @@
 #include "../app/raw_file.hpp"
 #include "../app/staged_directory.h"
 #include "../app/staged_file.hpp"
+#include "../app/util/generator.hpp"
 #include "database.hpp"
 #include <concepts>
+#include <span>
 #include <vector>
 
 interface StagedDatabase : public Database {
   // Listing
   virtual auto listAllDirectories() -> std::vector<StagedDirectory> abstract;
   virtual auto listAllFiles() -> std::vector<StagedFile> abstract;
+  // The same as the above but the directories are in order of ID, so each
+  // directory comes after its parent, and the files are in order of their
+  // parent directory's ID and then their own ID.
+  virtual auto listAllDirectoriesSorted()
+    -> std::vector<StagedDirectory> abstract;
+  virtual auto listAllFilesSorted() -> std::vector<StagedFile> abstract;
+  // The same order as the sorted listings, but read a page at a time as the
+  // generator is iterated, so the whole stage is never held in memory. The
+  // database must outlive the generator.
+  virtual auto streamDirectoriesSorted() -> Generator<StagedDirectory> abstract;
+  virtual auto streamFilesSorted() -> Generator<StagedFile> abstract;
   virtual auto getRootDirectory() -> std::optional<StagedDirectory> abstract;
   // Adding
   virtual void add(const std::filesystem::path& stagePath) abstract;
   virtual auto add(const RawFile& file, const std::filesystem::path& stagePath)
     -> StagedFile abstract;
+  // Batched adding, these behave like calling add for each element in turn
+  // but use as few round trips to the database as they can. A directory may
+  // be the parent of one which comes after it, and files are returned in the
+  // order they were given, with the IDs they were staged under.
+  virtual void addDirectories(
+    std::span<const std::filesystem::path> stagePaths) abstract;
+  virtual auto addFiles(std::span<const RawFile> files,
+                        std::span<const std::filesystem::path> stagePaths)
+    -> std::vector<StagedFile> abstract;
+  // The same as addFiles, but for files which had no copy staged as their
+  // contents were already archived. They are listed as reference only.
+  virtual auto addReferences(std::span<const RawFile> files,
+                             std::span<const std::filesystem::path> stagePaths)
+    -> std::vector<StagedFile> abstract;
   // Removing
   virtual void remove(const StagedDirectory& directory) abstract;
   virtual void remove(const StagedFile& stagedFile) abstract;
@@ -0,0 +1,51 @@
+#include <catch2/catch_all.hpp>
+#include <limits>
+#include <src/app/archive_part.hpp>
+#include <utility>
+#include <vector>
+
+namespace {
+using Revisions = std::vector<std::pair<ArchivedFileRevisionID, Size>>;
+
+auto partRevisions(const std::vector<ArchivePart>& parts)
+  -> std::vector<std::vector<ArchivedFileRevisionID>> {
+  std::vector<std::vector<ArchivedFileRevisionID>> revisions;
+  for (const auto& part : parts)
+    revisions.push_back(part.revisions);
+  return revisions;
+}
+}
+
+TEST_CASE("Splitting revisions into archive parts", "[archive_part]") {
+  SECTION("Nothing to split") {
+    REQUIRE(splitIntoParts(Revisions{}, {}).empty());
+  }
+  SECTION("Parts are cut before they would go over the target size") {
+    const Revisions revisions = {{1, 40}, {2, 60}, {3, 1}, {4, 50}, {5, 50}};
+    const auto parts = splitIntoParts(revisions, {100, 10});
+    REQUIRE(partRevisions(parts) ==
+            std::vector<std::vector<ArchivedFileRevisionID>>{
+              {1, 2}, {3, 4}, {5}});
+    REQUIRE(parts[0].size == 100);
+    REQUIRE(parts[1].size == 51);
+    REQUIRE(parts[2].size == 50);
+  }
+  SECTION("Parts are cut at the maximum number of files") {
+    const Revisions revisions = {{1, 1}, {2, 1}, {3, 1}, {4, 1}, {5, 1}};
+    REQUIRE(partRevisions(splitIntoParts(revisions, {100, 2})) ==
+            std::vector<std::vector<ArchivedFileRevisionID>>{
+              {1, 2}, {3, 4}, {5}});
+  }
+  SECTION("A revision larger than the target size is a part by itself") {
+    const Revisions revisions = {{1, 10}, {2, 500}, {3, 10}};
+    const auto parts = splitIntoParts(revisions, {100, 10});
+    REQUIRE(partRevisions(parts) ==
+            std::vector<std::vector<ArchivedFileRevisionID>>{{1}, {2}, {3}});
+    REQUIRE(parts[1].size == 500);
+  }
+  SECTION("Sizes near the largest size don't overflow") {
+    const auto largest = std::numeric_limits<Size>::max();
+    const Revisions revisions = {{1, largest}, {2, largest}};
+    REQUIRE(std::size(splitIntoParts(revisions, {largest, 10})) == 2);
+  }
+}
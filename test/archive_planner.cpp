@@ -0,0 +1,132 @@
+#include "database/database_helpers.hpp"
+#include <catch2/catch_all.hpp>
+#include <optional>
+#include <src/app/archive_planner.hpp>
+
+namespace {
+constexpr Size TargetSize = 10240;
+constexpr Size SingleFileArchiveSize = 5120;
+
+auto stagedFile(std::string name, Size size,
+                std::optional<FileHash> hash = std::nullopt) -> StagedFile {
+  static StagedFileID nextId = 1;
+  return {nextId++, 1, std::move(name), size, hash};
+}
+
+auto hashOf(std::uint8_t value) -> FileHash {
+  FileHash hash;
+  hash.bytes.fill(value);
+  return hash;
+}
+
+auto recordedSize(ArchivedDatabase& archivedDatabase, const Archive& archive)
+  -> std::optional<Size> {
+  for (const auto& [listedArchive, size] : archivedDatabase.listArchiveSizes())
+    if (listedArchive == archive)
+      return size;
+  return std::nullopt;
+}
+}
+
+TEST_CASE("Archive planner", "[archive_planner]") {
+  auto archivedDatabase = std::static_pointer_cast<ArchivedDatabase>(
+    std::make_shared<database::mock::ArchivedDatabase>(TargetSize));
+  archivedDatabase->startTransaction();
+
+  SECTION("Files are assigned the archive of their extension") {
+    ArchivePlanner planner{archivedDatabase, SingleFileArchiveSize};
+    const std::vector files = {stagedFile("a.txt", 10), stagedFile("b.bin", 10),
+                               stagedFile("c.txt", 10), stagedFile("d", 10),
+                               stagedFile("e.", 10),
+                               stagedFile("f.txt", SingleFileArchiveSize)};
+    const auto archives = planner.assign(files);
+
+    REQUIRE(archives.size() == files.size());
+    REQUIRE(archives[0].extension == ".txt");
+    REQUIRE(archives[1].extension == ".bin");
+    REQUIRE(archives[2] == archives[0]);
+    REQUIRE(archives[3].extension == "<BLANK>");
+    REQUIRE(archives[4] == archives[3]);
+    REQUIRE(archives[5] == Archive{1, "<SINGLE>"});
+  }
+  SECTION("An archive is given files until it reaches the target size") {
+    ArchivePlanner planner{archivedDatabase, SingleFileArchiveSize};
+    const std::vector files = {stagedFile("a.txt", 4000),
+                               stagedFile("b.txt", 4000),
+                               stagedFile("c.txt", 4000),
+                               stagedFile("d.txt", 4000)};
+    const auto archives = planner.assign(files);
+
+    REQUIRE(archives[1] == archives[0]);
+    REQUIRE(archives[2] == archives[0]);
+    REQUIRE(archives[3] != archives[0]);
+    REQUIRE(archives[3].extension == ".txt");
+  }
+  SECTION("Only new contents fill up an archive") {
+    ArchivePlanner planner{archivedDatabase, SingleFileArchiveSize};
+    const std::vector files = {stagedFile("a.txt", 4000, hashOf(1)),
+                               stagedFile("b.txt", 4000, hashOf(1)),
+                               stagedFile("c.txt", 4000, hashOf(1)),
+                               stagedFile("d.txt", 4000, hashOf(2))};
+    const auto archives = planner.assign(files);
+    REQUIRE(archives[1] == archives[0]);
+    REQUIRE(archives[2] == archives[0]);
+    REQUIRE(archives[3] == archives[0]);
+
+    SECTION("Only the recorded sizes count towards the next assignment") {
+      const auto next = stagedFile("e.txt", 10);
+      REQUIRE(planner.assign({&next, 1}).front() == archives[0]);
+      planner.recordAdded(archives[0], 8000);
+      planner.recordAdded(archives[0], next.size);
+      REQUIRE(planner.assign({&next, 1}).front() == archives[0]);
+      planner.recordAdded(archives[0], 4000);
+      REQUIRE(planner.assign({&next, 1}).front() != archives[0]);
+    }
+  }
+  SECTION("A file whose contents are archived doesn't start an archive") {
+    ArchivePlanner planner{archivedDatabase, SingleFileArchiveSize};
+    const auto archived = stagedFile("a.bin", 10, hashOf(3));
+    const auto archive = planner.assign({&archived, 1}).front();
+    const auto root = archivedDatabase->getRootDirectory();
+    const auto operation = archivedDatabase->createArchiveOperation();
+    archivedDatabase->addFiles(
+      {&archived, 1}, {&root, 1}, {&archive, 1}, operation,
+      archivedDatabase->findRevisionsWithContents({&archived, 1}));
+
+    const auto duplicate = stagedFile("b.dup", 10, hashOf(3));
+    const auto archiveCount = archivedDatabase->listArchiveSizes().size();
+    REQUIRE(planner.assign({&duplicate, 1}).front() ==
+            Archive{1, "<SINGLE>"});
+    REQUIRE(archivedDatabase->listArchiveSizes().size() == archiveCount);
+  }
+  SECTION("Only the recorded sizes are saved") {
+    const auto first = stagedFile("a.txt", 4000);
+    const auto second = stagedFile("b.txt", 4000);
+    ArchivePlanner planner{archivedDatabase, SingleFileArchiveSize};
+    const auto archive = planner.assign({&first, 1}).front();
+    // The second file is planned, but turns out to be a duplicate, so only the
+    // first is recorded.
+    planner.assign({&second, 1});
+    planner.recordAdded(archive, first.size);
+    planner.save();
+    REQUIRE(recordedSize(*archivedDatabase, archive) == first.size);
+
+    SECTION("Sizes are loaded again by the next planner") {
+      ArchivePlanner nextPlanner{archivedDatabase, SingleFileArchiveSize};
+      REQUIRE(nextPlanner.assign({&second, 1}).front() == archive);
+      nextPlanner.recordAdded(archive, second.size);
+      nextPlanner.save();
+      REQUIRE(recordedSize(*archivedDatabase, archive) ==
+              first.size + second.size);
+
+      ArchivePlanner fullPlanner{archivedDatabase, SingleFileArchiveSize};
+      const std::vector files = {stagedFile("c.txt", 4000),
+                                 stagedFile("d.txt", 10)};
+      const auto archives = fullPlanner.assign(files);
+      REQUIRE(archives[0] == archive);
+      REQUIRE(archives[1] != archive);
+    }
+  }
+
+  archivedDatabase->rollback();
+}
@@ -212,4 +212,126 @@ TEST_CASE("Archiving files and directories", "[archiver]") {
        std::filesystem::directory_iterator{config.archive.archive_directory}) {
     std::filesystem::remove_all(dir);
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Archiving by moving staged files", "[archiver]") {
+  Config config("./config/test_config.json");
+
+  auto [dataPointer, size] = getFileReadBuffer(config.general.fileReadSizes);
+  std::span readBuffer{dataPointer.get(), size};
+
+  DatabaseConnector<MockDatabase> databaseConnector;
+  auto [stagedDatabase, archivedDatabase] =
+    databaseConnector.connect(config, readBuffer);
+
+  Stager stager{stagedDatabase, readBuffer, config.stager.stage_directory};
+  Archiver archiver{archivedDatabase, config.stager.stage_directory,
+                    config.archive.archive_directory,
+                    config.archive.single_archive_size,
+                    Archiver::PromotionMode::Move};
+
+  REQUIRE(std::filesystem::is_empty(config.stager.stage_directory));
+  REQUIRE(std::filesystem::is_empty(config.archive.archive_directory));
+
+  REQUIRE_NOTHROW(stager.stage({{"./test_data/"}}, "."));
+  const auto stagedFiles = stager.getFilesSorted();
+  REQUIRE_NOTHROW(archiver.archive(stager.getDirectoriesSorted(), stagedFiles));
+
+  const auto archivedDirectories = archivedDatabase->listChildDirectories(
+    archivedDatabase->getRootDirectory());
+  const auto archivedFiles =
+    archivedDatabase->listChildFiles(archivedDirectories.at(0));
+  REQUIRE(archivedFiles.size() == 5);
+
+  // Every new revision has been moved out of the stage directory, only the
+  // staged file which was a duplicate of another is left behind.
+  for (const auto& archivedFile : archivedFiles) {
+    const auto& revision = archivedFile.revisions.at(0);
+    REQUIRE(std::filesystem::exists(
+      {FORMAT_LIB::format("{}/{}/{}", config.archive.archive_directory,
+                          revision.containingArchiveId, revision.id)}));
+  }
+  REQUIRE(std::ranges::distance(std::filesystem::directory_iterator{
+            config.stager.stage_directory}) == 1);
+
+  // The promotion journal is removed once the archive operation completes.
+  for (const auto& entry :
+       std::filesystem::directory_iterator{config.archive.archive_directory}) {
+    REQUIRE_FALSE(entry.path().filename().string().ends_with(".journal"));
+  }
+
+  // Remove staged and archived files.
+  for (auto const& file :
+       std::filesystem::directory_iterator{config.stager.stage_directory}) {
+    std::filesystem::remove(file);
+  }
+  for (auto const& dir :
+       std::filesystem::directory_iterator{config.archive.archive_directory}) {
+    std::filesystem::remove_all(dir);
+  }
+}
+
+TEST_CASE("Archiving files whose contents were archived before they were "
+          "staged",
+          "[archiver]") {
+  Config config("./config/test_config.json");
+
+  auto [dataPointer, size] = getFileReadBuffer(config.general.fileReadSizes);
+  std::span readBuffer{dataPointer.get(), size};
+
+  DatabaseConnector<MockDatabase> databaseConnector;
+  auto [stagedDatabase, archivedDatabase] =
+    databaseConnector.connect(config, readBuffer);
+
+  Stager stager{stagedDatabase, readBuffer, config.stager.stage_directory, 0,
+                nullptr, archivedDatabase};
+  Archiver archiver{archivedDatabase, config.stager.stage_directory,
+                    config.archive.archive_directory,
+                    config.archive.single_archive_size};
+
+  REQUIRE(std::filesystem::is_empty(config.stager.stage_directory));
+  REQUIRE(std::filesystem::is_empty(config.archive.archive_directory));
+
+  REQUIRE_NOTHROW(stager.stage({{"./test_data/"}}, "."));
+  const auto initialStagedFiles = stager.getFilesSorted();
+  REQUIRE_NOTHROW(
+    archiver.archive(stager.getDirectoriesSorted(), initialStagedFiles));
+  const auto stagedCopies = std::ranges::distance(
+    std::filesystem::directory_iterator{config.stager.stage_directory});
+
+  // Staging the same files again only records them, nothing more is copied
+  // to the stage directory.
+  REQUIRE_NOTHROW(stager.stage({{"./test_data/"}}, "."));
+  auto newlyStagedFiles = stager.getFilesSorted();
+  std::erase_if(newlyStagedFiles, [&](auto& val) {
+    return val.id <= initialStagedFiles.back().id;
+  });
+  REQUIRE(newlyStagedFiles.size() == 5);
+  REQUIRE(ranges::all_of(newlyStagedFiles, &StagedFile::referenceOnly));
+  REQUIRE(std::ranges::distance(std::filesystem::directory_iterator{
+            config.stager.stage_directory}) == stagedCopies);
+
+  Archiver archiver2{archivedDatabase, config.stager.stage_directory,
+                     config.archive.archive_directory,
+                     config.archive.single_archive_size};
+  REQUIRE_NOTHROW(
+    archiver2.archive(stager.getDirectoriesSorted(), newlyStagedFiles));
+
+  const auto archivedDirectories = archivedDatabase->listChildDirectories(
+    archivedDatabase->getRootDirectory());
+  for (const auto& archivedFile :
+       archivedDatabase->listChildFiles(archivedDirectories.at(0))) {
+    REQUIRE(archivedFile.revisions.size() == 2);
+    REQUIRE(archivedFile.revisions.at(1).isDuplicate);
+  }
+
+  // Remove staged and archived files.
+  for (auto const& file :
+       std::filesystem::directory_iterator{config.stager.stage_directory}) {
+    std::filesystem::remove(file);
+  }
+  for (auto const& dir :
+       std::filesystem::directory_iterator{config.archive.archive_directory}) {
+    std::filesystem::remove_all(dir);
+  }
+}
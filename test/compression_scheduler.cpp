@@ -0,0 +1,62 @@
+#include <atomic>
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <src/app/compression_scheduler.hpp>
+#include <stdexcept>
+#include <thread>
+
+TEST_CASE("Compression scheduler worker count", "[compression_scheduler]") {
+  REQUIRE(CompressionScheduler::workerCountFor({4, 0, 1024}) == 4);
+  REQUIRE(CompressionScheduler::workerCountFor({0, 0, 1024}) >= 1);
+
+  SECTION("The memory limit reduces the number of workers") {
+    REQUIRE(CompressionScheduler::workerCountFor({4, 2048, 1024}) == 2);
+    REQUIRE(CompressionScheduler::workerCountFor({4, 4096, 1024}) == 4);
+    REQUIRE(CompressionScheduler::workerCountFor({0, 1024, 1024}) == 1);
+  }
+  SECTION("There is always a worker") {
+    REQUIRE(CompressionScheduler::workerCountFor({4, 512, 1024}) == 1);
+  }
+}
+
+TEST_CASE("Compression scheduler", "[compression_scheduler]") {
+  CompressionScheduler scheduler{{4, 0, 0}};
+  REQUIRE(scheduler.workerCount() == 4);
+
+  std::atomic<std::size_t> running = 0;
+  std::atomic<std::size_t> mostRunning = 0;
+  std::atomic<std::size_t> finished = 0;
+  const auto job = [&](const CompressionScheduler::Progress& progress) {
+    const auto nowRunning = ++running;
+    auto previous = mostRunning.load();
+    while (previous < nowRunning &&
+           !mostRunning.compare_exchange_weak(previous, nowRunning)) {
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    progress(1, 1);
+    --running;
+    ++finished;
+  };
+
+  SECTION("Every job is run, no more at once than there are workers") {
+    for (std::size_t i = 0; i < 16; ++i)
+      scheduler.submit(FORMAT_LIB::format("job {}", i), job);
+    REQUIRE_NOTHROW(scheduler.finish());
+    REQUIRE(finished == 16);
+    REQUIRE(mostRunning <= 4);
+  }
+  SECTION("An exception thrown by a job is rethrown once the others have "
+          "finished") {
+    scheduler.submit("failing job", [](const CompressionScheduler::Progress&) {
+      throw std::runtime_error("");
+    });
+    for (std::size_t i = 0; i < 3; ++i)
+      scheduler.submit(FORMAT_LIB::format("job {}", i), job);
+    REQUIRE_THROWS_AS(scheduler.finish(), std::runtime_error);
+    REQUIRE(running == 0);
+
+    // The error is only rethrown once.
+    scheduler.submit("job", job);
+    REQUIRE_NOTHROW(scheduler.finish());
+  }
+}
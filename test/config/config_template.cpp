@@ -1,4 +1,5 @@
 #include <catch2/catch_all.hpp>
+#include <src/app/archive_defaults.hpp>
 #include <src/config/config.h>
 
 TEST_CASE("Loading a complete config file", "[config]") {
@@ -7,9 +8,16 @@ TEST_CASE("Loading a complete config file", "[config]") {
 
   REQUIRE(config.general.fileReadSizes.size() == 1);
   REQUIRE(config.general.fileReadSizes.at(0) == 104857600);
+  REQUIRE(config.general.ioMode == IoMode::Buffered);
 
   REQUIRE(config.stager.stage_directory ==
           "${ARCHIVER_TEST_CONFIG_STAGE_DIRECTORY_VALUE}");
+  REQUIRE(config.stager.worker_count == 0);
+  REQUIRE(config.stager.hash_cache.empty());
+  REQUIRE(config.stager.hash_policy == HashPolicy::Full);
+  REQUIRE(config.stager.read_queue_depth == 32);
+  REQUIRE(config.stager.read_order == ReadOrder::Walk);
+  REQUIRE(config.stager.check_duplicates == false);
 
   REQUIRE(config.archive.archive_directory ==
           "${ARCHIVER_TEST_CONFIG_ARCHIVE_DIRECTORY_VALUE}");
@@ -17,6 +25,13 @@ TEST_CASE("Loading a complete config file", "[config]") {
           "${ARCHIVER_TEST_CONFIG_ARCHIVE_TEMP_DIRECTORY_VALUE}");
   REQUIRE(config.archive.target_size == 10240);
   REQUIRE(config.archive.single_archive_size == 5120);
+  REQUIRE(config.archive.move_staged_files == false);
+  REQUIRE(config.archive.compression_worker_count == 1);
+  REQUIRE(config.archive.compression_memory_limit == 0);
+  REQUIRE(config.archive.compression_job_memory ==
+          DefaultCompressionJobMemory);
+  REQUIRE(config.archive.part_target_size == DefaultArchivePartTargetSize);
+  REQUIRE(config.archive.part_max_files == DefaultArchivePartMaxFiles);
 
   REQUIRE(config.database.user ==
           "${ARCHIVER_TEST_CONFIG_DATABASE_USERNAME_VALUE}");
@@ -0,0 +1,100 @@
+#include "helper_macros.hpp"
+#include <catch2/catch_all.hpp>
+#include <fstream>
+#include <src/app/copy_engine.hpp>
+#include <src/app/file_reader.hpp>
+#include <src/app/raw_file.hpp>
+#include <src/app/util/get_file_read_buffer.hpp>
+#include <src/config/config.h>
+#include <string>
+
+using Catch::Matchers::StartsWith;
+
+using namespace std::string_literals;
+
+TEST_CASE("Copy engine", "[copy_engine]") {
+  Config config("./config/test_config.json");
+
+  auto [dataPointer, size] = getFileReadBuffer(config.general.fileReadSizes);
+  std::span readBuffer{dataPointer.get(), size};
+
+  const auto fileName =
+    GENERATE(values({"TestData1", "TestData_Single", "TestData_Single_Exact"}));
+  const auto filePath = "test_data/"s + fileName + ".test"s;
+  const auto copyPath = "test_files/"s + fileName + ".copy"s;
+  std::filesystem::remove(copyPath);
+
+  SECTION("Copying a file creates an identical copy") {
+    const auto useBuffer = GENERATE(true, false);
+    const auto strategy = REQUIRE_NOTHROW_RETURN(
+      copyFile(filePath, copyPath,
+               useBuffer ? readBuffer : std::span<char>{}));
+    CAPTURE(copyStrategyName(strategy));
+
+    REQUIRE(RawFile{copyPath, readBuffer}.hash ==
+            RawFile{filePath, readBuffer}.hash);
+    REQUIRE(std::filesystem::status(copyPath).permissions() ==
+            std::filesystem::status(filePath).permissions());
+  }
+  SECTION("Copying a sparse file keeps its holes") {
+    const std::filesystem::path sparsePath = "test_files/sparse.test";
+    const std::filesystem::path sparseCopyPath = "test_files/sparse.copy";
+    {
+      std::ofstream sparse(sparsePath, std::ios_base::binary);
+      sparse.seekp(1024 * 1024);
+      sparse << std::string(4096 * 3, 's');
+    }
+    std::filesystem::resize_file(sparsePath, 4 * 1024 * 1024);
+    std::filesystem::remove(sparseCopyPath);
+
+    const auto strategy = copyFile(sparsePath, sparseCopyPath, readBuffer);
+    CAPTURE(copyStrategyName(strategy));
+    REQUIRE(RawFile{sparseCopyPath, readBuffer}.hash ==
+            RawFile{sparsePath, readBuffer}.hash);
+    REQUIRE(FileReader{sparseCopyPath}.isSparse() ==
+            FileReader{sparsePath}.isSparse());
+
+    std::filesystem::remove(sparsePath);
+    std::filesystem::remove(sparseCopyPath);
+  }
+  SECTION("Copying a file can make holes from its blocks of zeros") {
+    const std::filesystem::path densePath = "test_files/dense.test";
+    const std::filesystem::path sparsePath = "test_files/dense.copy";
+    {
+      std::ofstream dense(densePath, std::ios_base::binary);
+      dense << std::string(4096 * 3, 'd') << std::string(1024 * 1024, '\0')
+            << std::string(10, 'd');
+    }
+    std::filesystem::remove(sparsePath);
+
+    const auto strategy =
+      copyFile(densePath, sparsePath, readBuffer, Holes::MakeFromZeros);
+    REQUIRE(strategy == CopyStrategy::Sparse);
+    REQUIRE(std::filesystem::file_size(sparsePath) ==
+            std::filesystem::file_size(densePath));
+    REQUIRE(RawFile{sparsePath, readBuffer}.hash ==
+            RawFile{densePath, readBuffer}.hash);
+
+    std::filesystem::remove(densePath);
+    std::filesystem::remove(sparsePath);
+  }
+  SECTION("Copying over an existing file throws an exception") {
+    copyFile(filePath, copyPath);
+
+    REQUIRE_THROWS_AS(copyFile(filePath, copyPath), CopyException);
+  }
+  SECTION("Copying a file that doesn't exist throws an exception") {
+    REQUIRE_THROWS_AS(copyFile("test_data/non_existent.test", copyPath),
+                      CopyException);
+    REQUIRE_FALSE(std::filesystem::exists(copyPath));
+  }
+  SECTION("A failed reflink leaves no file behind") {
+    if (!reflinkFile(filePath, copyPath))
+      REQUIRE_FALSE(std::filesystem::exists(copyPath));
+    else
+      REQUIRE(RawFile{copyPath, readBuffer}.hash ==
+              RawFile{filePath, readBuffer}.hash);
+  }
+
+  std::filesystem::remove(copyPath);
+}
@@ -3,7 +3,9 @@
 #include "../helper_functions.hpp"
 #include "../helper_macros.hpp"
 #include "database_helpers.hpp"
+#include <algorithm>
 #include <catch2/catch_all.hpp>
+#include <set>
 #include <span>
 #include <src/app/util/get_file_read_buffer.hpp>
 #include <src/config/config.h>
@@ -186,24 +188,32 @@ TEMPLATE_TEST_CASE("Connecting to, modifying, and retrieving data from the "
       REQUIRE_NOTHROW(
         archivedDatabase->incrementNextArchivePartNumber(archive));
       REQUIRE(archivedDatabase->getNextArchivePartNumber(archive) == 2);
+      REQUIRE(archivedDatabase->reserveArchivePartNumbers(archive, 3) == 2);
+      REQUIRE(archivedDatabase->getNextArchivePartNumber(archive) == 5);
     }
     SECTION("Full archive") {
       REQUIRE(stagedFiles.at(0).size < config.archive.single_archive_size);
       auto archiveFirst = REQUIRE_NOTHROW_RETURN(
         archivedDatabase->getArchiveForFile(stagedFiles.at(0)));
 
-      // Add a bunch of files
+      // Add a bunch of files, recording the size of each as it is added
       for (const auto& stagedFile : stagedFiles) {
         auto archive = REQUIRE_NOTHROW_RETURN(
           archivedDatabase->getArchiveForFile(stagedFile));
         REQUIRE_NOTHROW(archivedDatabase->addFile(
           stagedFile, archivedDirectories.back(), archive, operation));
+        const std::pair<Archive, Size> addedSize{archive, stagedFile.size};
+        REQUIRE_NOTHROW(archivedDatabase->addToArchiveSizes({&addedSize, 1}));
       }
 
       auto archiveLast = REQUIRE_NOTHROW_RETURN(
         archivedDatabase->getArchiveForFile(stagedFiles.at(0)));
 
       REQUIRE(archiveFirst.id != archiveLast.id);
+      const auto archiveSizes = archivedDatabase->listArchiveSizes();
+      REQUIRE(std::ranges::find(archiveSizes,
+                                std::pair{archiveLast, Size{0}}) !=
+              std::ranges::end(archiveSizes));
     }
   }
   SECTION("Adding and listing files") {
@@ -414,6 +424,78 @@ TEMPLATE_TEST_CASE("Connecting to, modifying, and retrieving data from the "
         REQUIRE(revision2.id > archivedFile.revisions.at(0).id);
       }
     }
+    SECTION("Adding files in a batch") {
+      // Every file is in the batch twice, so the second of each is a second
+      // revision of the same file, and a duplicate of the first.
+      std::vector<StagedFile> batch{stagedFiles.begin(), stagedFiles.end()};
+      batch.insert(batch.end(), stagedFiles.begin(), stagedFiles.end());
+      const std::vector<ArchivedDirectory> directories(
+        batch.size(), archivedDirectories.back());
+      std::vector<Archive> archives;
+      for (const auto& stagedFile : batch) {
+        archives.push_back(REQUIRE_NOTHROW_RETURN(
+          archivedDatabase->getArchiveForFile(stagedFile)));
+      }
+
+      const auto archivedFileResults = REQUIRE_NOTHROW_RETURN(
+        archivedDatabase->addFiles(
+          batch, directories, archives, operation,
+          archivedDatabase->findRevisionsWithContents(batch)));
+      REQUIRE(std::size(archivedFileResults) == std::size(batch));
+      for (std::size_t i = 0; i < std::size(stagedFiles); ++i) {
+        REQUIRE(archivedFileResults[i].first ==
+                ArchivedFileAddedType::NewRevision);
+        REQUIRE(archivedFileResults[i + std::size(stagedFiles)].first ==
+                ArchivedFileAddedType::DuplicateRevision);
+      }
+
+      const auto childFiles =
+        archivedDatabase->listChildFiles(archivedDirectories.back());
+      REQUIRE(std::size(childFiles) == std::size(stagedFiles));
+      for (const auto& archivedFile : childFiles) {
+        REQUIRE(std::size(archivedFile.revisions) == 2);
+        REQUIRE(archivedFile.revisions.at(0).id ==
+                archivedFile.revisions.at(1).id);
+        REQUIRE(archivedFile.revisions.at(0).isDuplicate !=
+                archivedFile.revisions.at(1).isDuplicate);
+      }
+
+      SECTION("Recording the parts of an archive") {
+        const auto& archive = archives.front();
+        const auto uncompressed = REQUIRE_NOTHROW_RETURN(
+          archivedDatabase->listUncompressedRevisions(archive));
+        REQUIRE_FALSE(uncompressed.empty());
+        REQUIRE(std::ranges::is_sorted(uncompressed));
+        REQUIRE(archivedDatabase->listArchiveParts(archive).empty());
+
+        // Every revision is a part of its own.
+        auto parts = splitIntoParts(uncompressed, {0, 1});
+        REQUIRE(std::size(parts) == std::size(uncompressed));
+        const auto firstPartNumber =
+          archivedDatabase->reserveArchivePartNumbers(archive, parts.size());
+        for (std::size_t i = 0; i < std::size(parts); ++i)
+          parts[i].number = firstPartNumber + i;
+        REQUIRE_NOTHROW(archivedDatabase->addArchiveParts(archive, parts));
+
+        REQUIRE(archivedDatabase->listUncompressedRevisions(archive).empty());
+        REQUIRE(archivedDatabase->listArchiveParts(archive) == parts);
+      }
+      SECTION("Listing the sizes of the linearly hashed revisions") {
+        std::set<Size> sizes;
+        for (const auto& stagedFile : stagedFiles)
+          sizes.insert(stagedFile.size);
+        REQUIRE(archivedDatabase->listLinearRevisionSizes(0) == sizes);
+        REQUIRE(
+          archivedDatabase->listLinearRevisionSizes(*sizes.rbegin() + 1)
+            .empty());
+      }
+      SECTION("Adding a batch with a directory or archive missing") {
+        REQUIRE_THROWS_AS(
+          archivedDatabase->addFiles(batch, std::span{directories}.first(1),
+                                     archives, operation, {}),
+          ArchivedDatabaseException);
+      }
+    }
   }
 
   REQUIRE_NOTHROW(archivedDatabase->rollback());
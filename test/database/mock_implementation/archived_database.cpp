@@ -1,7 +1,8 @@
 #include "archived_database.hpp"
+#include <algorithm>
 #include <concepts>
-#include <numeric>
 #include <ranges>
+#include <utility>
 
 using namespace std::string_literals;
 namespace ranges = std::ranges;
@@ -23,6 +24,9 @@ void ArchivedDatabase::startTransaction() {
   transactionArchivedFiles = archivedFiles;
   transactionArchives = archives;
   transactionArchiveNextPartNumbers = archiveNextPartNumbers;
+  transactionArchiveSizes = archiveSizes;
+  transactionArchiveParts = archiveParts;
+  transactionArchiveOperations = archiveOperations;
   hasTransaction = true;
 }
 void ArchivedDatabase::rollback() {
@@ -31,6 +35,9 @@ void ArchivedDatabase::rollback() {
     transactionArchivedFiles.clear();
     transactionArchives.clear();
     transactionArchiveNextPartNumbers.clear();
+    transactionArchiveSizes.clear();
+    transactionArchiveParts.clear();
+    transactionArchiveOperations.clear();
     hasTransaction = false;
   }
 }
@@ -40,28 +47,47 @@ void ArchivedDatabase::commit() {
     archivedFiles = transactionArchivedFiles;
     archives = transactionArchives;
     archiveNextPartNumbers = transactionArchiveNextPartNumbers;
+    archiveSizes = transactionArchiveSizes;
+    archiveParts = transactionArchiveParts;
+    archiveOperations = transactionArchiveOperations;
     hasTransaction = false;
   }
 }
 
 auto ArchivedDatabase::getArchiveForFile(const StagedFile& file) -> Archive {
-  const std::string_view fileName = file.name;
-  const auto fileExtension = [&]() {
-    if (fileName.find_last_of('.') == std::string_view::npos)
-      return std::string{"<BLANK>"};
-    else if (fileName.back() == '.')
-      return std::string{"<BLANK>"};
-    else
-      return std::string{fileName.substr(fileName.find_last_of('.'))};
-  }();
-  auto archiveForExtension = getArchiveForExtension(fileExtension);
-
-  if (getArchiveSize(archiveForExtension) < targetSize) {
-    return archiveForExtension;
+  const auto extension = archiveExtension(file.name);
+  auto newestFirst = getArchiveVector() | views::reverse;
+  const auto found =
+    ranges::find(newestFirst, extension, &Archive::extension);
+  if (found != ranges::end(newestFirst)) {
+    const auto size = ranges::find(getArchiveSizeVector(), found->id,
+                                   &decltype(archiveSizes)::value_type::first);
+    if (size->second < targetSize)
+      return *found;
   }
 
-  return addArchiveForExtension(fileExtension);
+  return addArchive(extension);
 }
+auto ArchivedDatabase::listArchiveSizes()
+  -> std::vector<std::pair<Archive, Size>> {
+  std::vector<std::pair<Archive, Size>> ret;
+  for (const auto& archive : getArchiveVector()) {
+    const auto size = ranges::find(getArchiveSizeVector(), archive.id,
+                                   &decltype(archiveSizes)::value_type::first);
+    // Archives are in the order they were added, so an older archive of the
+    // same extension is replaced.
+    const auto older =
+      ranges::find(ret, archive.extension, [](const auto& archiveSize) {
+        return archiveSize.first.extension;
+      });
+    if (older == ranges::end(ret))
+      ret.emplace_back(archive, size->second);
+    else
+      *older = {archive, size->second};
+  }
+  return ret;
+}
+auto ArchivedDatabase::getArchiveTargetSize() -> Size { return targetSize; }
 auto ArchivedDatabase::getNextArchivePartNumber(const Archive& archive)
   -> uint64_t {
   const auto found =
@@ -84,24 +110,54 @@ void ArchivedDatabase::incrementNextArchivePartNumber(const Archive& archive) {
       archive.id));
   ++(found->second);
 }
-
-auto ArchivedDatabase::getArchiveForExtension(const std::string& extension)
-  -> Archive {
-  std::string extensionName = extension;
-  if (extension.empty()) {
-    extensionName = noExtensionArchiveContents;
+auto ArchivedDatabase::reserveArchivePartNumbers(const Archive& archive,
+                                                 uint64_t count) -> uint64_t {
+  auto found =
+    ranges::find(getArchivePartNumberVector(), archive.id,
+                 &decltype(archiveNextPartNumbers)::value_type::first);
+  if (found == ranges::end(getArchivePartNumberVector()))
+    throw ArchivedDatabaseException(FORMAT_LIB::format(
+      "Could not reserve part numbers of archive with id {}", archive.id));
+  return std::exchange(found->second, found->second + count);
+}
+auto ArchivedDatabase::listArchiveParts(const Archive& archive)
+  -> std::vector<ArchivePart> {
+  std::vector<ArchivePart> parts;
+  for (const auto& [archiveId, part] : getArchivePartVector()) {
+    if (archiveId == archive.id)
+      parts.push_back(part);
   }
-  const auto found =
-    ranges::find(getArchiveVector(), extensionName, &Archive::extension);
+  ranges::sort(parts, {}, &ArchivePart::number);
+  return parts;
+}
+auto ArchivedDatabase::listUncompressedRevisions(const Archive& archive)
+  -> std::vector<std::pair<ArchivedFileRevisionID, Size>> {
+  const auto isCompressed = [&](ArchivedFileRevisionID revisionId) {
+    return ranges::any_of(getArchivePartVector(), [&](const auto& entry) {
+      return entry.first == archive.id &&
+             ranges::find(entry.second.revisions, revisionId) !=
+               ranges::end(entry.second.revisions);
+    });
+  };
 
-  if (found == ranges::end(getArchiveVector()))
-    return addArchiveForExtension(extensionName);
-  else
-    return *found;
+  std::vector<std::pair<ArchivedFileRevisionID, Size>> revisions;
+  for (const auto& file : getFileVector()) {
+    for (const auto& revision : file.revisions) {
+      if (!revision.isDuplicate && revision.containingArchiveId == archive.id &&
+          !isCompressed(revision.id))
+        revisions.emplace_back(revision.id, revision.size);
+    }
+  }
+  ranges::sort(revisions);
+  return revisions;
+}
+void ArchivedDatabase::addArchiveParts(const Archive& archive,
+                                       std::span<const ArchivePart> parts) {
+  for (const auto& part : parts)
+    getArchivePartVector().emplace_back(archive.id, part);
 }
 
-auto ArchivedDatabase::addArchiveForExtension(const std::string& extension)
-  -> Archive {
+auto ArchivedDatabase::addArchive(const Extension& extension) -> Archive {
   std::string extensionName = extension;
   if (extension.empty()) {
     extensionName = noExtensionArchiveContents;
@@ -109,29 +165,20 @@ auto ArchivedDatabase::addArchiveForExtension(const std::string& extension)
 
   getArchiveVector().push_back({nextArchiveId, extensionName});
   getArchivePartNumberVector().push_back({nextArchiveId, 1});
+  getArchiveSizeVector().push_back({nextArchiveId, 0});
   ++nextArchiveId;
   return getArchiveVector().back();
 }
-
-auto ArchivedDatabase::getArchiveSize(const Archive& archive) -> Size {
-  auto allRevisions =
-    getFileVector() |
-    views::transform(
-      [](ArchivedFile& file) -> decltype(ArchivedFile::revisions)& {
-        return file.revisions;
-      }) |
-    views::join;
-  auto revisionsInArchive =
-    allRevisions | views::filter([&](const ArchivedFileRevision& rev) {
-      return rev.containingArchiveId == archive.id;
-    });
-  auto revisionSizes =
-    revisionsInArchive |
-    views::transform([&](ArchivedFileRevision& rev) { return rev.size; }) |
-    views::common;
-
-  return std::accumulate(ranges::begin(revisionSizes),
-                         ranges::end(revisionSizes), Size{0});
+void ArchivedDatabase::addToArchiveSizes(
+  std::span<const std::pair<Archive, Size>> sizes) {
+  for (const auto& [archive, size] : sizes) {
+    auto found = ranges::find(getArchiveSizeVector(), archive.id,
+                              &decltype(archiveSizes)::value_type::first);
+    if (found == ranges::end(getArchiveSizeVector()))
+      throw ArchivedDatabaseException(FORMAT_LIB::format(
+        "Could not update the size of archive with id {}", archive.id));
+    found->second += size;
+  }
 }
 
 auto ArchivedDatabase::listChildDirectories(const ArchivedDirectory& directory)
@@ -189,7 +236,8 @@ auto ArchivedDatabase::addFile(const StagedFile& stagedFile,
                                const ArchiveOperationID archiveOperation)
   -> std::pair<ArchivedFileAddedType, ArchivedFileRevisionID> {
   if (ranges::find(getArchiveVector(), archive) ==
-      ranges::end(getArchiveVector()))
+        ranges::end(getArchiveVector()) ||
+      !stagedFile.hash)
     throw ArchivedDatabaseException("Could not add file to archived files");
 
   if (ranges::find(getArchiveOperationVector(), archiveOperation,
@@ -227,8 +275,11 @@ auto ArchivedDatabase::addFile(const StagedFile& stagedFile,
 
   if (duplicateRevision == ranges::end(allRevisions)) {
     auto revisionId = nextFileRevisionId++;
-    addedFile.revisions.push_back({revisionId, stagedFile.hash, stagedFile.size,
-                                   archive.id, archiveOperation, false});
+    addedFile.revisions.push_back({revisionId, *stagedFile.hash,
+                                   stagedFile.size, archive.id,
+                                   archiveOperation, false,
+                                   stagedFile.fastHash,
+                                   stagedFile.hashAlgorithm});
     return {ArchivedFileAddedType::NewRevision, revisionId};
   } else {
     auto dupRevision = *duplicateRevision;
@@ -238,12 +289,116 @@ auto ArchivedDatabase::addFile(const StagedFile& stagedFile,
   }
 }
 
+auto ArchivedDatabase::addFiles(
+  std::span<const StagedFile> stagedFiles,
+  std::span<const ArchivedDirectory> directories,
+  std::span<const Archive> archives, const ArchiveOperationID archiveOperation,
+  const std::map<RevisionContents, ArchivedFileRevisionID>&)
+  -> std::vector<std::pair<ArchivedFileAddedType, ArchivedFileRevisionID>> {
+  if (stagedFiles.size() != directories.size() ||
+      stagedFiles.size() != archives.size())
+    throw ArchivedDatabaseException("Could not add files to archived files");
+
+  std::vector<std::pair<ArchivedFileAddedType, ArchivedFileRevisionID>> added;
+  added.reserve(stagedFiles.size());
+  for (std::size_t i = 0; i < stagedFiles.size(); ++i) {
+    added.push_back(addFile(stagedFiles[i], directories[i], archives[i],
+                            archiveOperation));
+  }
+  return added;
+}
+
 auto ArchivedDatabase::createArchiveOperation() -> ArchiveOperationID {
   auto archiveOperationId = nextArchiveOperationId++;
   getArchiveOperationVector().push_back(
     {archiveOperationId, std::chrono::system_clock::now()});
   return archiveOperationId;
 }
+auto ArchivedDatabase::hasArchiveOperation(ArchiveOperationID archiveOperation)
+  -> bool {
+  return ranges::find(getArchiveOperationVector(), archiveOperation,
+                      &ArchiveOperation::id) !=
+         ranges::end(getArchiveOperationVector());
+}
+
+auto ArchivedDatabase::hasRevisionsWithContents(std::span<const RawFile> files)
+  -> std::vector<bool> {
+  auto allRevisions =
+    getFileVector() |
+    views::transform(
+      [](ArchivedFile& file) -> decltype(ArchivedFile::revisions)& {
+        return file.revisions;
+      }) |
+    views::join;
+
+  std::vector<bool> found;
+  for (const auto& file : files) {
+    found.push_back(ranges::any_of(
+      allRevisions, [&](const ArchivedFileRevision& revision) {
+        return revision.hash == file.hash && revision.size == file.size;
+      }));
+  }
+  return found;
+}
+auto ArchivedDatabase::findRevisionsWithContents(
+  std::span<const StagedFile> files)
+  -> std::map<RevisionContents, ArchivedFileRevisionID> {
+  auto allRevisions =
+    getFileVector() |
+    views::transform(
+      [](ArchivedFile& file) -> decltype(ArchivedFile::revisions)& {
+        return file.revisions;
+      }) |
+    views::join;
+
+  std::map<RevisionContents, ArchivedFileRevisionID> revisionIds;
+  for (const auto& file : files) {
+    if (!file.hash)
+      continue;
+    const auto revision =
+      ranges::find_if(allRevisions, [&](const ArchivedFileRevision& revision) {
+        return revision.hash == file.hash && revision.size == file.size;
+      });
+    if (revision != ranges::end(allRevisions))
+      revisionIds.emplace(RevisionContents{file.size, *file.hash},
+                          (*revision).id);
+  }
+  return revisionIds;
+}
+auto ArchivedDatabase::hasRevisionsWithFastHashes(
+  std::span<const RawFile> files) -> std::vector<bool> {
+  auto allRevisions =
+    getFileVector() |
+    views::transform(
+      [](ArchivedFile& file) -> decltype(ArchivedFile::revisions)& {
+        return file.revisions;
+      }) |
+    views::join;
+
+  std::vector<bool> found;
+  for (const auto& file : files) {
+    found.push_back(ranges::any_of(
+      allRevisions, [&](const ArchivedFileRevision& revision) {
+        return revision.fastHash == file.fastHash &&
+               revision.size == file.size;
+      }));
+  }
+  return found;
+}
+
+auto ArchivedDatabase::listLinearRevisionSizes(Size minimumSize)
+  -> std::set<Size> {
+  std::set<Size> sizes;
+  for (const auto& file : getFileVector()) {
+    for (const auto& revision : file.revisions) {
+      if (!revision.isDuplicate &&
+          revision.hashAlgorithm == HashAlgorithm::Linear &&
+          revision.size >= minimumSize)
+        sizes.insert(revision.size);
+    }
+  }
+  return sizes;
+}
 
 auto ArchivedDatabase::getFileVector() -> decltype(archivedFiles)& {
   if (hasTransaction)
@@ -270,6 +425,18 @@ auto ArchivedDatabase::getArchivePartNumberVector()
   else
     return archiveNextPartNumbers;
 }
+auto ArchivedDatabase::getArchiveSizeVector() -> decltype(archiveSizes)& {
+  if (hasTransaction)
+    return transactionArchiveSizes;
+  else
+    return archiveSizes;
+}
+auto ArchivedDatabase::getArchivePartVector() -> decltype(archiveParts)& {
+  if (hasTransaction)
+    return transactionArchiveParts;
+  else
+    return archiveParts;
+}
 auto ArchivedDatabase::getArchiveOperationVector()
   -> decltype(archiveOperations)& {
   if (hasTransaction)
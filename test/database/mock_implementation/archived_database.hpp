@@ -1,6 +1,7 @@
 #ifndef ARCHIVER_TEST_DATABASE_MOCK_ARCHIVED_DATABASE_HPP
 #define ARCHIVER_TEST_DATABASE_MOCK_ARCHIVED_DATABASE_HPP
 
+#include <map>
 #include <optional>
 #include <src/app/archive_operation.hpp>
 #include <src/app/archived_directory.hpp>
@@ -9,6 +10,7 @@
 #include <src/app/staged_directory.h>
 #include <src/app/staged_file.hpp>
 #include <src/database/archived_database.hpp>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -29,8 +31,20 @@ public:
   void rollback() final;
 
   auto getArchiveForFile(const StagedFile& file) -> Archive final;
+  auto listArchiveSizes() -> std::vector<std::pair<Archive, Size>> final;
+  auto getArchiveTargetSize() -> Size final;
+  auto addArchive(const Extension& extension) -> Archive final;
+  void addToArchiveSizes(std::span<const std::pair<Archive, Size>> sizes) final;
   auto getNextArchivePartNumber(const Archive& archive) -> uint64_t final;
   void incrementNextArchivePartNumber(const Archive& archive) final;
+  auto reserveArchivePartNumbers(const Archive& archive, uint64_t count)
+    -> uint64_t final;
+  auto listArchiveParts(const Archive& archive)
+    -> std::vector<ArchivePart> final;
+  auto listUncompressedRevisions(const Archive& archive)
+    -> std::vector<std::pair<ArchivedFileRevisionID, Size>> final;
+  void addArchiveParts(const Archive& archive,
+                       std::span<const ArchivePart> parts) final;
 
   auto listChildDirectories(const ArchivedDirectory& directory)
     -> std::vector<ArchivedDirectory> final;
@@ -46,8 +60,23 @@ public:
                const Archive& archive,
                const ArchiveOperationID archiveOperation)
     -> std::pair<ArchivedFileAddedType, ArchivedFileRevisionID> final;
+  auto addFiles(
+    std::span<const StagedFile> stagedFiles,
+    std::span<const ArchivedDirectory> directories,
+    std::span<const Archive> archives, const ArchiveOperationID archiveOperation,
+    const std::map<RevisionContents, ArchivedFileRevisionID>& archivedRevisions)
+    -> std::vector<std::pair<ArchivedFileAddedType, ArchivedFileRevisionID>>
+      final;
 
   auto createArchiveOperation() -> ArchiveOperationID final;
+  auto hasArchiveOperation(ArchiveOperationID archiveOperation) -> bool final;
+  auto hasRevisionsWithContents(std::span<const RawFile> files)
+    -> std::vector<bool> final;
+  auto findRevisionsWithContents(std::span<const StagedFile> files)
+    -> std::map<RevisionContents, ArchivedFileRevisionID> final;
+  auto hasRevisionsWithFastHashes(std::span<const RawFile> files)
+    -> std::vector<bool> final;
+  auto listLinearRevisionSizes(Size minimumSize) -> std::set<Size> final;
 
 private:
   std::vector<ArchivedDirectory> archivedDirectories = {
@@ -55,11 +84,15 @@ private:
   std::vector<ArchivedFile> archivedFiles;
   std::vector<Archive> archives = {{1, "<SINGLE>"}};
   std::vector<std::pair<ArchiveID, uint64_t>> archiveNextPartNumbers;
+  std::vector<std::pair<ArchiveID, Size>> archiveSizes = {{1, 0}};
+  std::vector<std::pair<ArchiveID, ArchivePart>> archiveParts;
   std::vector<ArchiveOperation> archiveOperations;
   std::vector<ArchivedDirectory> transactionArchivedDirectories;
   std::vector<ArchivedFile> transactionArchivedFiles;
   std::vector<Archive> transactionArchives;
   std::vector<std::pair<ArchiveID, uint64_t>> transactionArchiveNextPartNumbers;
+  std::vector<std::pair<ArchiveID, Size>> transactionArchiveSizes;
+  std::vector<std::pair<ArchiveID, ArchivePart>> transactionArchiveParts;
   std::vector<ArchiveOperation> transactionArchiveOperations;
   bool hasTransaction = false;
   ArchivedFileID nextArchivedFileId = 1;
@@ -71,14 +104,12 @@ private:
 
   static const std::string noExtensionArchiveContents;
 
-  auto getArchiveForExtension(const std::string& extension) -> Archive;
-  auto addArchiveForExtension(const std::string& extension) -> Archive;
-  auto getArchiveSize(const Archive& archive) -> Size;
-
   auto getFileVector() -> decltype(archivedFiles)&;
   auto getDirectoryVector() -> decltype(archivedDirectories)&;
   auto getArchiveVector() -> decltype(archives)&;
   auto getArchivePartNumberVector() -> decltype(archiveNextPartNumbers)&;
+  auto getArchiveSizeVector() -> decltype(archiveSizes)&;
+  auto getArchivePartVector() -> decltype(archiveParts)&;
   auto getArchiveOperationVector() -> decltype(archiveOperations)&;
 };
 }
@@ -1,8 +1,10 @@
 #include "staged_database.hpp"
+#include <algorithm>
 #include <concepts>
 #include <ranges>
 #include <src/app/staged_file.hpp>
 #include <src/database/staged_database.hpp>
+#include <tuple>
 
 namespace ranges = std::ranges;
 
@@ -34,6 +36,17 @@ void StagedDatabase::commit() {
 auto StagedDatabase::listAllFiles() -> std::vector<StagedFile> {
   return getFileVector();
 }
+auto StagedDatabase::listAllFilesSorted() -> std::vector<StagedFile> {
+  auto files = getFileVector();
+  ranges::sort(files, [](const auto& lhs, const auto& rhs) {
+    return std::tie(lhs.parent, lhs.id) < std::tie(rhs.parent, rhs.id);
+  });
+  return files;
+}
+auto StagedDatabase::streamFilesSorted() -> Generator<StagedFile> {
+  for (auto& stagedFile : listAllFilesSorted())
+    co_yield stagedFile;
+}
 
 auto StagedDatabase::add(const RawFile& file,
                          const std::filesystem::path& stagePath) -> StagedFile {
@@ -46,10 +59,38 @@ auto StagedDatabase::add(const RawFile& file,
 
   getFileVector().push_back({nextStagedFileId++, parentStagedDirectory->id,
                              stagePath.filename().string(), file.size,
-                             file.hash});
+                             file.hash, false, file.fastHash,
+                             file.hashAlgorithm});
   return getFileVector().back();
 }
 
+auto StagedDatabase::addFiles(std::span<const RawFile> files,
+                              std::span<const std::filesystem::path> stagePaths)
+  -> std::vector<StagedFile> {
+  if (files.size() != stagePaths.size()) {
+    throw StagedDatabaseException(
+      "Could not add files to staged file database as {} files were given "
+      "with {} stage paths",
+      files.size(), stagePaths.size());
+  }
+  std::vector<StagedFile> stagedFiles;
+  for (std::size_t i = 0; i < files.size(); ++i)
+    stagedFiles.push_back(add(files[i], stagePaths[i]));
+  return stagedFiles;
+}
+auto StagedDatabase::addReferences(
+  std::span<const RawFile> files,
+  std::span<const std::filesystem::path> stagePaths)
+  -> std::vector<StagedFile> {
+  auto stagedFiles = addFiles(files, stagePaths);
+  for (auto& stagedFile : stagedFiles) {
+    stagedFile.referenceOnly = true;
+    ranges::find(getFileVector(), stagedFile.id, &StagedFile::id)
+      ->referenceOnly = true;
+  }
+  return stagedFiles;
+}
+
 void StagedDatabase::remove(const StagedFile& stagedFile) {
   std::erase_if(getFileVector(), [&](const StagedFile& file) {
     return file.id == stagedFile.id;
@@ -64,6 +105,16 @@ void StagedDatabase::removeAllFiles() {
 auto StagedDatabase::listAllDirectories() -> std::vector<StagedDirectory> {
   return getDirectoryVector();
 }
+auto StagedDatabase::listAllDirectoriesSorted()
+  -> std::vector<StagedDirectory> {
+  auto directories = getDirectoryVector();
+  ranges::sort(directories, {}, &StagedDirectory::id);
+  return directories;
+}
+auto StagedDatabase::streamDirectoriesSorted() -> Generator<StagedDirectory> {
+  for (auto& stagedDirectory : listAllDirectoriesSorted())
+    co_yield stagedDirectory;
+}
 
 void StagedDatabase::add(const std::filesystem::path& stagePath) {
   const auto pathToStage = [](const std::filesystem::path& stagePath) {
@@ -96,6 +147,12 @@ void StagedDatabase::add(const std::filesystem::path& stagePath) {
                                   parentStagedDirectory->id});
 }
 
+void StagedDatabase::addDirectories(
+  std::span<const std::filesystem::path> stagePaths) {
+  for (const auto& stagePath : stagePaths)
+    add(stagePath);
+}
+
 void StagedDatabase::remove(const StagedDirectory& stagedDirectory) {
 
   if (ranges::find(getDirectoryVector(), stagedDirectory.id,
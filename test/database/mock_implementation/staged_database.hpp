@@ -17,13 +17,24 @@ public:
   void rollback() final;
 
   auto listAllFiles() -> std::vector<StagedFile> final;
+  auto listAllFilesSorted() -> std::vector<StagedFile> final;
+  auto streamFilesSorted() -> Generator<StagedFile> final;
   auto add(const RawFile& file, const std::filesystem::path& stagePath)
     -> StagedFile final;
+  auto addFiles(std::span<const RawFile> files,
+                std::span<const std::filesystem::path> stagePaths)
+    -> std::vector<StagedFile> final;
+  auto addReferences(std::span<const RawFile> files,
+                     std::span<const std::filesystem::path> stagePaths)
+    -> std::vector<StagedFile> final;
   void remove(const StagedFile& stagedFile) final;
   void removeAllFiles() final;
 
   auto listAllDirectories() -> std::vector<StagedDirectory> final;
+  auto listAllDirectoriesSorted() -> std::vector<StagedDirectory> final;
+  auto streamDirectoriesSorted() -> Generator<StagedDirectory> final;
   void add(const std::filesystem::path& stagePath) final;
+  void addDirectories(std::span<const std::filesystem::path> stagePaths) final;
   void remove(const StagedDirectory& stagedDirectory) final;
   void removeAllDirectories() final;
   auto getRootDirectory() -> std::optional<StagedDirectory> final;
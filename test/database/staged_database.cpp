@@ -86,6 +86,56 @@ TEMPLATE_TEST_CASE("Connecting to, modifying, and retrieving data from the "
           REQUIRE(cur.id == next.parent);
         });
       }
+      SECTION("Adding a path after rolling back the same path") {
+        REQUIRE_NOTHROW(stagedDatabase->add(path));
+        REQUIRE_NOTHROW(stagedDatabase->rollback());
+        REQUIRE_NOTHROW(stagedDatabase->startTransaction());
+        REQUIRE(!stagedDatabase->getRootDirectory().has_value());
+
+        REQUIRE_NOTHROW(stagedDatabase->add(path));
+        REQUIRE(stagedDatabase->listAllDirectories().size() ==
+                getNumberPathElements(path));
+        REQUIRE(stagedDatabase->getRootDirectory().has_value());
+      }
+    }
+
+    SECTION("Adding a batch of directories") {
+      const std::vector<std::filesystem::path> batch = {
+        path, path / "batch_a", path / "batch_a/batch_b", path / "batch_c",
+        path / "batch_a/"};
+      REQUIRE_NOTHROW(stagedDatabase->addDirectories(batch));
+
+      SECTION("Adding the same batch multiple times has no effect") {
+        REQUIRE_NOTHROW(stagedDatabase->addDirectories(batch));
+      }
+
+      const auto stagedDirectories = stagedDatabase->listAllDirectories();
+      REQUIRE(stagedDirectories.size() == getNumberPathElements(path) + 3);
+
+      const auto findDirectory = [&](std::string_view name) {
+        return *REQUIRE_NOT_EQUAL_RETURN(
+          std::ranges::find(stagedDirectories, name, &StagedDirectory::name),
+          std::ranges::end(stagedDirectories));
+      };
+      const auto batchA = findDirectory("batch_a");
+      const auto batchB = findDirectory("batch_b");
+      const auto batchC = findDirectory("batch_c");
+      REQUIRE(batchB.parent == batchA.id);
+      REQUIRE(batchA.parent == batchC.parent);
+      REQUIRE(batchA.parent ==
+              findDirectory(getLastElement(path).string()).id);
+
+      const auto sortedDirectories = stagedDatabase->listAllDirectoriesSorted();
+      REQUIRE(sortedDirectories.size() == stagedDirectories.size());
+      REQUIRE(
+        std::ranges::is_sorted(sortedDirectories, {}, &StagedDirectory::id));
+
+      std::vector<StagedDirectoryID> streamedDirectoryIds;
+      for (const auto& stagedDirectory :
+           stagedDatabase->streamDirectoriesSorted())
+        streamedDirectoryIds.push_back(stagedDirectory.id);
+      REQUIRE(std::ranges::equal(streamedDirectoryIds, sortedDirectories, {},
+                                 {}, &StagedDirectory::id));
     }
 
     SECTION("Removing directories") {
@@ -203,6 +253,54 @@ TEMPLATE_TEST_CASE("Connecting to, modifying, and retrieving data from the "
       }
     }
 
+    SECTION("Adding a batch of files") {
+      stagedDatabase->add(path);
+
+      std::vector<std::filesystem::path> stagePaths;
+      for (const auto& rawFile : rawFiles)
+        stagePaths.push_back(path / rawFile.path.filename());
+
+      SECTION("Every file needs a stage path") {
+        REQUIRE_THROWS_AS(
+          stagedDatabase->addFiles(rawFiles, std::span{stagePaths}.first(
+                                               stagePaths.size() - 1)),
+          StagedDatabaseException);
+      }
+
+      const auto addedFiles = stagedDatabase->addFiles(rawFiles, stagePaths);
+      auto stagedDirectories = stagedDatabase->listAllDirectories();
+      const auto parentDirectory = getLastElement(stagedDirectories);
+
+      // The files are returned in the order they were given, with the same
+      // IDs they are listed with.
+      REQUIRE(std::size(addedFiles) == std::size(rawFiles));
+      auto stagedFiles = stagedDatabase->listAllFiles();
+      for (std::size_t i = 0; i < std::size(rawFiles); ++i) {
+        REQUIRE(addedFiles.at(i).name ==
+                rawFiles.at(i).path.filename().string());
+        REQUIRE(addedFiles.at(i).size == rawFiles.at(i).size);
+        REQUIRE(addedFiles.at(i).hash == rawFiles.at(i).hash);
+        REQUIRE(addedFiles.at(i).parent == parentDirectory.id);
+
+        const auto stagedFile = *REQUIRE_NOT_EQUAL_RETURN(
+          std::ranges::find(stagedFiles, addedFiles.at(i).id, &StagedFile::id),
+          std::ranges::end(stagedFiles));
+        REQUIRE(stagedFile.name == addedFiles.at(i).name);
+        REQUIRE(stagedFile.parent == parentDirectory.id);
+      }
+
+      // Every file has the same parent, so they are only sorted by ID.
+      const auto sortedFiles = stagedDatabase->listAllFilesSorted();
+      REQUIRE(sortedFiles.size() == stagedFiles.size());
+      REQUIRE(std::ranges::is_sorted(sortedFiles, {}, &StagedFile::id));
+
+      std::vector<StagedFileID> streamedFileIds;
+      for (const auto& stagedFile : stagedDatabase->streamFilesSorted())
+        streamedFileIds.push_back(stagedFile.id);
+      REQUIRE(std::ranges::equal(streamedFileIds, sortedFiles, {}, {},
+                                 &StagedFile::id));
+    }
+
     SECTION("Removing files") {
       stagedDatabase->add(path);
       for (const auto& rawFile : rawFiles) {
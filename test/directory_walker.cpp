@@ -0,0 +1,100 @@
+#include <catch2/catch_all.hpp>
+#include <fstream>
+#include <set>
+#include <src/app/directory_walker.hpp>
+
+using EntryType = DirectoryWalker::EntryType;
+
+TEST_CASE("Directory walker", "[directory_walker]") {
+  const std::filesystem::path root = "test_files/walker";
+  std::filesystem::remove_all(root);
+  for (const auto* directory : {"a/b/c", "a/d", "e", "f/g/h/i"})
+    std::filesystem::create_directories(root / directory);
+  for (const auto* file : {"1", "a/2", "a/b/3", "a/b/c/4", "e/5", "f/g/h/i/6"})
+    std::ofstream{root / file} << file;
+  std::filesystem::create_directory_symlink("../a", root / "e/link");
+
+  SECTION("Every entry is listed, parents before their children") {
+    const auto workerCount = GENERATE(as<std::size_t>{}, 0, 1, 2, 8);
+    CAPTURE(workerCount);
+
+    std::set<std::filesystem::path> listedDirectories;
+    std::set<std::filesystem::path> entries;
+    DirectoryWalker{workerCount}.walk(
+      root, [&](DirectoryWalker::Listing&& listing) {
+        REQUIRE((listing.directory == root ||
+                 entries.contains(listing.directory)));
+        REQUIRE(listedDirectories.insert(listing.directory).second);
+        for (const auto& entry : listing.entries)
+          entries.insert(entry.path);
+      });
+
+    std::set<std::filesystem::path> expected;
+    for (const auto& entry :
+         std::filesystem::recursive_directory_iterator(root))
+      expected.insert(entry.path());
+    REQUIRE(entries == expected);
+    // The symlinked directory is listed but not walked into.
+    REQUIRE(listedDirectories.size() == 10);
+    REQUIRE_FALSE(listedDirectories.contains(root / "e/link"));
+  }
+  SECTION("Every directory of a wide tree is listed by many workers") {
+    // Workers taking each other's subdirectories as soon as they are queued
+    // mustn't end the walk early.
+    for (std::size_t i = 0; i < 50; ++i)
+      for (std::size_t j = 0; j < 4; ++j)
+        std::filesystem::create_directories(
+          root / FORMAT_LIB::format("wide/{}/{}", i, j));
+
+    for (std::size_t run = 0; run < 20; ++run) {
+      std::size_t listed = 0;
+      DirectoryWalker{8}.walk(root / "wide",
+                              [&](DirectoryWalker::Listing&&) { ++listed; });
+      REQUIRE(listed == 1 + 50 + 50 * 4);
+    }
+  }
+  SECTION("Entries are classified following symlinks") {
+    const auto entries = DirectoryWalker::list(root / "e");
+    REQUIRE(entries.size() == 2);
+    for (const auto& entry : entries) {
+      if (entry.path.filename() == "link") {
+        REQUIRE(entry.type == EntryType::Directory);
+        REQUIRE(entry.isSymlink);
+      } else {
+        REQUIRE(entry.type == EntryType::File);
+        REQUIRE_FALSE(entry.isSymlink);
+      }
+    }
+  }
+  SECTION("Files with more than one hard link are identified") {
+    std::filesystem::create_hard_link(root / "e/5", root / "a/d/5");
+
+    const auto linked = DirectoryWalker::list(root / "a/d");
+    REQUIRE(linked.size() == 1);
+    REQUIRE(linked.at(0).hardLink);
+    for (const auto& entry : DirectoryWalker::list(root / "e")) {
+      if (entry.type == EntryType::File)
+        REQUIRE(entry.hardLink == linked.at(0).hardLink);
+      else
+        REQUIRE_FALSE(entry.hardLink);
+    }
+    for (const auto& entry : DirectoryWalker::list(root / "a"))
+      REQUIRE_FALSE(entry.hardLink);
+  }
+  SECTION("An error listing a directory is rethrown") {
+    REQUIRE_THROWS_AS(
+      DirectoryWalker{2}.walk(root / "missing", [](auto&&) {}),
+      DirectoryWalkerException);
+  }
+  SECTION("An exception thrown by the visitor stops the walk") {
+    int visits = 0;
+    const auto visit = [&](DirectoryWalker::Listing&&) {
+      if (++visits == 3)
+        throw std::runtime_error("Visitor failed");
+    };
+    REQUIRE_THROWS_AS(DirectoryWalker{4}.walk(root, visit), std::runtime_error);
+    REQUIRE(visits == 3);
+  }
+
+  std::filesystem::remove_all(root);
+}
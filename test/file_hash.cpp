@@ -0,0 +1,40 @@
+#include <catch2/catch_all.hpp>
+#include <src/app/file_hash.hpp>
+
+TEST_CASE("File hash", "[file_hash]") {
+  SECTION("A hash round trips through its hex string") {
+    FileHash hash;
+    for (std::size_t i = 0; i < FileHash::Size; ++i)
+      hash.bytes[i] = static_cast<std::uint8_t>(i * 37 + 11);
+
+    const auto hex = hash.toHexString();
+    REQUIRE(hex.size() == 2 * FileHash::Size);
+    REQUIRE(hex.starts_with("0b30557a"));
+    REQUIRE(FileHash::fromHexString(hex) == hash);
+    REQUIRE(FileHash::fromBytes(hash.bytes) == hash);
+  }
+  SECTION("Upper case hex digits are accepted") {
+    const std::string hex(2 * FileHash::Size, 'F');
+    REQUIRE(FileHash::fromHexString(hex).bytes[0] == 0xFF);
+    REQUIRE(FileHash::fromHexString(hex) ==
+            FileHash::fromHexString(std::string(2 * FileHash::Size, 'f')));
+  }
+  SECTION("Malformed hashes are rejected") {
+    REQUIRE_THROWS_AS(FileHash::fromHexString(""), FileHashException);
+    REQUIRE_THROWS_AS(
+      FileHash::fromHexString(std::string(2 * FileHash::Size - 1, '0')),
+      FileHashException);
+    REQUIRE_THROWS_AS(
+      FileHash::fromHexString(std::string(2 * FileHash::Size, 'g')),
+      FileHashException);
+    const std::vector<std::uint8_t> shortHash(FileHash::Size - 1);
+    REQUIRE_THROWS_AS(FileHash::fromBytes(shortHash), FileHashException);
+  }
+  SECTION("A fast hash must be exactly its size") {
+    const std::vector<std::uint8_t> bytes(FastHash::Size, 0xAB);
+    REQUIRE(FastHash::fromBytes(bytes).toHexString() ==
+            "abababababababababababababababab");
+    REQUIRE_THROWS_AS(FastHash::fromBytes(FileHash{}.bytes),
+                      FileHashException);
+  }
+}
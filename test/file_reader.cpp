@@ -0,0 +1,76 @@
+#include <catch2/catch_all.hpp>
+#include <fstream>
+#include <src/app/file_reader.hpp>
+#include <src/app/io_mode.hpp>
+#include <src/app/raw_file.hpp>
+#include <vector>
+
+namespace {
+constexpr std::size_t BlockSize = 1024 * 1024;
+
+// Writes data at the start and at the middle of the file, with holes between
+// them and at the end if the filesystem supports them.
+auto writeSparseFile(const std::filesystem::path& path) -> std::vector<char> {
+  std::vector<char> contents(8 * BlockSize, 0);
+  for (std::size_t i = 0; i < BlockSize; ++i) {
+    contents[i] = static_cast<char>(i * 3 + 1);
+    contents[4 * BlockSize + i] = static_cast<char>(i * 5 + 2);
+  }
+  {
+    std::ofstream file(path, std::ios_base::binary | std::ios_base::trunc);
+    file.write(contents.data(), BlockSize);
+    file.seekp(4 * BlockSize);
+    file.write(contents.data() + 4 * BlockSize, BlockSize);
+  }
+  std::filesystem::resize_file(path, contents.size());
+  return contents;
+}
+}
+
+TEST_CASE("File reader", "[file_reader]") {
+  const std::filesystem::path filePath = "test_files/sparse";
+  const auto contents = writeSparseFile(filePath);
+  const auto chunkBuffer = makeAlignedBuffer(3 * BlockSize + 123);
+  std::span<char> chunk{chunkBuffer.get(), 3 * BlockSize + 123};
+
+  SECTION("The holes of a file are read as zeros") {
+    const auto mode =
+      GENERATE(IoMode::Buffered, IoMode::Direct, IoMode::DontNeed);
+    CAPTURE(mode);
+    setIoMode(mode);
+    FileReader reader{filePath};
+    REQUIRE(reader.size() == contents.size());
+
+    const auto offset = GENERATE(as<std::uint64_t>{}, 0, BlockSize - 7,
+                                 2 * BlockSize, 6 * BlockSize + 5);
+    CAPTURE(offset);
+    const auto read = reader.read(chunk, offset);
+    REQUIRE(read == std::min<std::uint64_t>(chunk.size(),
+                                            contents.size() - offset));
+    REQUIRE(std::equal(chunk.begin(), chunk.begin() + read,
+                       contents.begin() + offset));
+  }
+  SECTION("Reading past the end of the file reads nothing") {
+    FileReader reader{filePath};
+    REQUIRE(reader.read(chunk, contents.size()) == 0);
+    REQUIRE(reader.read(chunk, contents.size() + 1) == 0);
+  }
+  SECTION("Opening a file that doesn't exist throws an exception") {
+    REQUIRE_THROWS_AS(FileReader{"test_files/non_existent"}, FileException);
+  }
+  SECTION("Runs of zeros are found by block") {
+    std::vector<std::pair<std::size_t, bool>> runs;
+    forEachZeroRun(std::span{contents}.first(5 * BlockSize + 10), BlockSize,
+                   [&](std::span<const char> run, bool isZeros) {
+                     runs.emplace_back(run.size(), isZeros);
+                   });
+    REQUIRE(runs == std::vector<std::pair<std::size_t, bool>>{
+                      {BlockSize, false},
+                      {3 * BlockSize, true},
+                      {BlockSize, false},
+                      {10, true}});
+  }
+
+  setIoMode(IoMode::Buffered);
+  std::filesystem::remove(filePath);
+}
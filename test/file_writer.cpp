@@ -0,0 +1,58 @@
+#include <catch2/catch_all.hpp>
+#include <src/app/file_reader.hpp>
+#include <src/app/file_writer.hpp>
+#include <src/app/io_mode.hpp>
+#include <src/app/raw_file.hpp>
+#include <vector>
+
+TEST_CASE("File writer", "[file_writer]") {
+  const std::filesystem::path filePath = "test_files/file_writer";
+  const auto mode =
+    GENERATE(IoMode::Buffered, IoMode::Direct, IoMode::DontNeed);
+  CAPTURE(mode);
+  setIoMode(mode);
+
+  const auto buffer = makeAlignedBuffer(4 * DirectIoAlignment);
+  std::span<char> data{buffer.get(), 4 * DirectIoAlignment};
+  for (std::size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<char>(i % 251 + 1);
+
+  SECTION("Aligned and unaligned writes are all written") {
+    FileWriter writer{filePath};
+    writer.write(data.first(2 * DirectIoAlignment), 0);
+    writer.write(data.subspan(2 * DirectIoAlignment, 100),
+                 2 * DirectIoAlignment);
+    writer.write(data.first(DirectIoAlignment), 3 * DirectIoAlignment);
+    writer.finish(4 * DirectIoAlignment + 10);
+
+    std::vector<char> contents(8 * DirectIoAlignment);
+    FileReader reader{filePath};
+    REQUIRE(reader.size() == 4 * DirectIoAlignment + 10);
+    REQUIRE(reader.read(contents, 0) == reader.size());
+    REQUIRE(std::equal(data.begin(), data.begin() + 2 * DirectIoAlignment + 100,
+                       contents.begin()));
+    REQUIRE(std::all_of(contents.begin() + 2 * DirectIoAlignment + 100,
+                        contents.begin() + 3 * DirectIoAlignment,
+                        [](char byte) { return byte == 0; }));
+    REQUIRE(std::equal(data.begin(), data.begin() + DirectIoAlignment,
+                       contents.begin() + 3 * DirectIoAlignment));
+    REQUIRE(std::all_of(contents.begin() + 4 * DirectIoAlignment,
+                        contents.begin() + reader.size(),
+                        [](char byte) { return byte == 0; }));
+  }
+  SECTION("Finishing a file can shorten it") {
+    FileWriter writer{filePath};
+    writer.write(data, 0);
+    writer.finish(10);
+
+    REQUIRE(std::filesystem::file_size(filePath) == 10);
+  }
+  SECTION("Creating a file in a directory that doesn't exist throws an "
+          "exception") {
+    REQUIRE_THROWS_AS(FileWriter{"test_files/non_existent/file"},
+                      FileException);
+  }
+
+  setIoMode(IoMode::Buffered);
+  std::filesystem::remove(filePath);
+}
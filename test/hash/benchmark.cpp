@@ -0,0 +1,44 @@
+#include "hash_helpers.hpp"
+#include <Hash/src/blake2.h>
+#include <Hash/src/sha3.h>
+#include <catch2/catch_all.hpp>
+#include <src/app/common.h>
+#include <src/app/hash/blake2b.hpp>
+#include <src/app/hash/sha3_512.hpp>
+#include <src/app/hash/xxh3_128.hpp>
+
+// Throughput of the hash kernels compared to the Chocobo1 implementation that
+// RawFile used previously. Hidden as it is slow, run with
+// "Archiver-Tests [benchmark]".
+TEST_CASE("Hash throughput", "[hash][benchmark][.]") {
+  constexpr std::size_t dataSize = 64 * 1024 * 1024;
+  const auto data = randomBytes(dataSize, 1);
+
+  BENCHMARK("Chocobo1 SHA3-512") {
+    Chocobo1::SHA3_512 sha3;
+    sha3.addData(data.data(), data.size());
+    return sha3.finalize().toString();
+  };
+  for (const auto kernel : hash::Sha3_512::availableKernels()) {
+    BENCHMARK(FORMAT_LIB::format("SHA3-512 {}", hash::kernelName(kernel))) {
+      return hashInChunks(hash::Sha3_512{kernel}, data, dataSize);
+    };
+  }
+
+  BENCHMARK("Chocobo1 BLAKE2b") {
+    Chocobo1::Blake2 blake2B;
+    blake2B.addData(data.data(), data.size());
+    return blake2B.finalize().toString();
+  };
+  for (const auto kernel : hash::Blake2b::availableKernels()) {
+    BENCHMARK(FORMAT_LIB::format("BLAKE2b {}", hash::kernelName(kernel))) {
+      return hashInChunks(hash::Blake2b{kernel}, data, dataSize);
+    };
+  }
+
+  for (const auto kernel : hash::Xxh3_128::availableKernels()) {
+    BENCHMARK(FORMAT_LIB::format("XXH3-128 {}", hash::kernelName(kernel))) {
+      return hashInChunks(hash::Xxh3_128{kernel}, data, dataSize);
+    };
+  }
+}
@@ -0,0 +1,44 @@
+#include "hash_helpers.hpp"
+#include <Hash/src/blake2.h>
+#include <catch2/catch_all.hpp>
+#include <src/app/hash/blake2b.hpp>
+
+TEST_CASE("BLAKE2b kernels", "[hash]") {
+  const auto kernel = GENERATE(from_range(hash::Blake2b::availableKernels()));
+  CAPTURE(hash::kernelName(kernel));
+
+  SECTION("The digest of empty input matches the known value") {
+    REQUIRE(hashInChunks(hash::Blake2b{kernel}, {}, 1) ==
+            "786a02f742015903c6c6fd852552d272912f4740e15847618a86e217f71f5419"
+            "d25e1031afee585313896444934eb04b903a685b1448b755d56f701afe9be2ce");
+  }
+  SECTION("The digest matches the reference implementation") {
+    const auto size = GENERATE(0, 1, 127, 128, 129, 255, 256, 257, 1000, 65537);
+    const auto chunkSize = GENERATE(1, 7, 128, 4096, 1 << 20);
+    CAPTURE(size, chunkSize);
+
+    const auto data = randomBytes(static_cast<std::size_t>(size),
+                                  static_cast<std::uint32_t>(size));
+    Chocobo1::Blake2 reference;
+    reference.addData(data.data(), data.size());
+
+    REQUIRE(hashInChunks(hash::Blake2b{kernel}, data,
+                         static_cast<std::size_t>(chunkSize)) ==
+            reference.finalize().toString());
+  }
+}
+
+TEST_CASE("BLAKE2b kernel selection", "[hash]") {
+  SECTION("The portable kernel is always available") {
+    REQUIRE(hash::Blake2b::availableKernels().front() ==
+            hash::Kernel::Portable);
+  }
+  SECTION("The default kernel is one of the available kernels") {
+    const auto kernels = hash::Blake2b::availableKernels();
+    REQUIRE(std::find(kernels.begin(), kernels.end(),
+                      hash::Blake2b::defaultKernel()) != kernels.end());
+  }
+  SECTION("Requesting a kernel that isn't available throws") {
+    REQUIRE_THROWS_AS(hash::Blake2b{hash::Kernel::Avx512}, std::logic_error);
+  }
+}
@@ -0,0 +1,34 @@
+#ifndef ARCHIVER_TEST_HASH_HELPERS_HPP
+#define ARCHIVER_TEST_HASH_HELPERS_HPP
+
+#include <algorithm>
+#include <catch2/internal/catch_random_number_generator.hpp>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <src/app/util/hex_string.hpp>
+#include <vector>
+
+namespace {
+std::vector<char> randomBytes(std::size_t size, std::uint32_t seed) {
+  Catch::SimplePcg32 rng(seed);
+  std::uniform_int_distribution<int> distribution(0, 255);
+  std::vector<char> bytes(size);
+  for (auto& byte : bytes)
+    byte = static_cast<char>(distribution(rng));
+  return bytes;
+}
+
+// Feeds the data to the hasher in pieces of chunkSize bytes and returns the
+// digest as a hex string.
+template <typename Hasher>
+std::string hashInChunks(Hasher&& hasher, std::span<const char> data,
+                         std::size_t chunkSize) {
+  for (std::size_t offset = 0; offset < data.size(); offset += chunkSize)
+    hasher.addData(data.data() + offset,
+                   std::min(chunkSize, data.size() - offset));
+  return toHexString(hasher.finalize());
+}
+}
+
+#endif
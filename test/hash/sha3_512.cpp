@@ -0,0 +1,44 @@
+#include "hash_helpers.hpp"
+#include <Hash/src/sha3.h>
+#include <catch2/catch_all.hpp>
+#include <src/app/hash/sha3_512.hpp>
+
+TEST_CASE("SHA3-512 kernels", "[hash]") {
+  const auto kernel = GENERATE(from_range(hash::Sha3_512::availableKernels()));
+  CAPTURE(hash::kernelName(kernel));
+
+  SECTION("The digest of empty input matches the known value") {
+    REQUIRE(hashInChunks(hash::Sha3_512{kernel}, {}, 1) ==
+            "a69f73cca23a9ac5c8b567dc185a756e97c982164fe25859e0d1dcc1475c80a6"
+            "15b2123af1f5f94c11e3e9402c3ac558f500199d95b6d3e301758586281dcd26");
+  }
+  SECTION("The digest matches the reference implementation") {
+    const auto size = GENERATE(0, 1, 71, 72, 73, 143, 144, 145, 1000, 65537);
+    const auto chunkSize = GENERATE(1, 7, 72, 4096, 1 << 20);
+    CAPTURE(size, chunkSize);
+
+    const auto data = randomBytes(static_cast<std::size_t>(size),
+                                  static_cast<std::uint32_t>(size));
+    Chocobo1::SHA3_512 reference;
+    reference.addData(data.data(), data.size());
+
+    REQUIRE(hashInChunks(hash::Sha3_512{kernel}, data,
+                         static_cast<std::size_t>(chunkSize)) ==
+            reference.finalize().toString());
+  }
+}
+
+TEST_CASE("SHA3-512 kernel selection", "[hash]") {
+  SECTION("The portable kernel is always available") {
+    REQUIRE(hash::Sha3_512::availableKernels().front() ==
+            hash::Kernel::Portable);
+  }
+  SECTION("The default kernel is one of the available kernels") {
+    const auto kernels = hash::Sha3_512::availableKernels();
+    REQUIRE(std::find(kernels.begin(), kernels.end(),
+                      hash::Sha3_512::defaultKernel()) != kernels.end());
+  }
+  SECTION("Requesting a kernel that isn't available throws") {
+    REQUIRE_THROWS_AS(hash::Sha3_512{hash::Kernel::Avx2}, std::logic_error);
+  }
+}
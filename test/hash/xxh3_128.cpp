@@ -0,0 +1,71 @@
+#include "hash_helpers.hpp"
+#include <catch2/catch_all.hpp>
+#include <src/app/hash/xxh3_128.hpp>
+
+namespace {
+// The bytes 0 to 250 repeated, which the known digests are of.
+std::vector<char> countingBytes(std::size_t size) {
+  std::vector<char> bytes(size);
+  for (std::size_t i = 0; i < size; ++i)
+    bytes[i] = static_cast<char>(i % 251);
+  return bytes;
+}
+}
+
+TEST_CASE("XXH3-128 kernels", "[hash]") {
+  const auto kernel = GENERATE(from_range(hash::Xxh3_128::availableKernels()));
+  CAPTURE(hash::kernelName(kernel));
+
+  SECTION("The digest matches the known value") {
+    // Each size is at the edge of one of the ways XXH3 hashes its input.
+    const auto [size, digest] = GENERATE(table<int, std::string>(
+      {{0, "99aa06d3014798d86001c324468d497f"},
+       {1, "a6cd5e9392000f6ac44bdff4074eecdb"},
+       {3, "e3b55f57945a17cf5f4299fc161c9cbb"},
+       {4, "eb70bf5fc779e9e6a6111d53e80a3db5"},
+       {8, "e1e4432a62217fe4cfd50c61c8bb98c1"},
+       {9, "16c769d83e4aebce907931979dca3746"},
+       {16, "72950631827607e2842812cc870dcae2"},
+       {17, "685bc458b37d057fc06e233df7729217"},
+       {128, "14792fc3af88dc6c05321a0b64d67b41"},
+       {129, "dd5e74ac6b45f54ebc30b63382b09a3b"},
+       {240, "65b5be86da5540e7c92b68e16f83bbb6"},
+       {241, "1da1cb61bcb8a2a102e8cd95421c6d02"},
+       {1024, "d0ac1f7b93bf57b9e5d78bafa45b2aa5"},
+       {1025, "2882ebca04ec915ce95c42288f28186e"},
+       {65537, "0924e7a3a30e818770331d53d92bbc56"}}));
+    const auto chunkSize = GENERATE(1, 7, 64, 257, 4096, 1 << 20);
+    CAPTURE(size, chunkSize);
+
+    REQUIRE(hashInChunks(hash::Xxh3_128{kernel},
+                         countingBytes(static_cast<std::size_t>(size)),
+                         static_cast<std::size_t>(chunkSize)) == digest);
+  }
+  SECTION("The digest matches the portable kernel") {
+    const auto size = GENERATE(255, 256, 257, 1087, 1088, 1089, 1 << 20);
+    const auto chunkSize = GENERATE(1, 63, 256, 1 << 20);
+    CAPTURE(size, chunkSize);
+
+    const auto data = randomBytes(static_cast<std::size_t>(size),
+                                  static_cast<std::uint32_t>(size));
+    REQUIRE(hashInChunks(hash::Xxh3_128{kernel}, data,
+                         static_cast<std::size_t>(chunkSize)) ==
+            hashInChunks(hash::Xxh3_128{hash::Kernel::Portable}, data,
+                         data.size() + 1));
+  }
+}
+
+TEST_CASE("XXH3-128 kernel selection", "[hash]") {
+  SECTION("The portable kernel is always available") {
+    REQUIRE(hash::Xxh3_128::availableKernels().front() ==
+            hash::Kernel::Portable);
+  }
+  SECTION("The default kernel is one of the available kernels") {
+    const auto kernels = hash::Xxh3_128::availableKernels();
+    REQUIRE(std::find(kernels.begin(), kernels.end(),
+                      hash::Xxh3_128::defaultKernel()) != kernels.end());
+  }
+  SECTION("Requesting a kernel that isn't available throws") {
+    REQUIRE_THROWS_AS(hash::Xxh3_128{hash::Kernel::Avx512}, std::logic_error);
+  }
+}
@@ -0,0 +1,121 @@
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <fstream>
+#include <src/app/hash_cache.hpp>
+
+namespace {
+auto makeHash(std::uint8_t value) -> HashCache::Hashes {
+  HashCache::Hashes hashes{FastHash{}, FileHash{}};
+  hashes.fastHash.bytes.fill(value);
+  hashes.hash->bytes.fill(value);
+  return hashes;
+}
+auto makeFastHash(std::uint8_t value) -> HashCache::Hashes {
+  auto hashes = makeHash(value);
+  hashes.hash = std::nullopt;
+  return hashes;
+}
+void insert(HashCache& cache, const HashCache::Fingerprint& fingerprint,
+            const HashCache::Hashes& hashes) {
+  cache.insert(fingerprint, hashes.fastHash, hashes.hash);
+}
+}
+
+TEST_CASE("Hash cache", "[hash_cache]") {
+  const std::filesystem::path cachePath = "test_files/hash_cache";
+  std::filesystem::remove(cachePath);
+
+  // Old enough not to be considered racy.
+  const HashCache::Fingerprint fingerprint{1, 2, 3, 1000, 2000};
+
+  SECTION("Entries can be found by their fingerprint") {
+    HashCache cache{cachePath};
+    REQUIRE_FALSE(cache.find(fingerprint).has_value());
+    insert(cache, fingerprint, makeHash(1));
+    REQUIRE(cache.find(fingerprint) == makeHash(1));
+  }
+  SECTION("A changed file replaces its entry") {
+    HashCache cache{cachePath};
+    insert(cache, fingerprint, makeHash(1));
+
+    auto changed = fingerprint;
+    changed.modificationTime += 1;
+    REQUIRE_FALSE(cache.find(changed).has_value());
+    insert(cache, changed, makeHash(2));
+    REQUIRE(cache.find(changed) == makeHash(2));
+    REQUIRE_FALSE(cache.find(fingerprint).has_value());
+  }
+  SECTION("Recently changed files aren't cached") {
+    HashCache cache{cachePath};
+    auto recent = HashCache::Fingerprint{1, 2, 3, 0, 0};
+    recent.changeTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+    insert(cache, recent, makeHash(1));
+    REQUIRE_FALSE(cache.find(recent).has_value());
+  }
+  SECTION("Entries can have only a fast hash") {
+    HashCache cache{cachePath};
+    insert(cache, fingerprint, makeFastHash(1));
+    REQUIRE(cache.find(fingerprint) == makeFastHash(1));
+  }
+  SECTION("A known hash isn't lost by recording only the fast hash") {
+    HashCache cache{cachePath};
+    insert(cache, fingerprint, makeHash(1));
+    insert(cache, fingerprint, makeFastHash(1));
+    REQUIRE(cache.find(fingerprint) == makeHash(1));
+
+    insert(cache, fingerprint, makeFastHash(2));
+    REQUIRE(cache.find(fingerprint) == makeFastHash(2));
+  }
+  SECTION("Entries persist after the cache is closed") {
+    {
+      HashCache cache{cachePath};
+      insert(cache, fingerprint, makeHash(1));
+    }
+    HashCache cache{cachePath};
+    REQUIRE(cache.find(fingerprint) == makeHash(1));
+  }
+  SECTION("The cache grows to fit more entries") {
+    HashCache cache{cachePath};
+    constexpr std::uint64_t count = 50000;
+    for (std::uint64_t inode = 1; inode <= count; ++inode)
+      insert(cache, {1, inode, 3, 1000, 2000},
+             makeHash(static_cast<std::uint8_t>(inode)));
+    for (std::uint64_t inode = 1; inode <= count; ++inode) {
+      REQUIRE(cache.find({1, inode, 3, 1000, 2000}) ==
+              makeHash(static_cast<std::uint8_t>(inode)));
+    }
+  }
+  SECTION("An invalid cache file is emptied") {
+    {
+      std::ofstream file(cachePath, std::ios_base::trunc);
+      file << "not a hash cache";
+    }
+    HashCache cache{cachePath};
+    REQUIRE_FALSE(cache.find(fingerprint).has_value());
+    insert(cache, fingerprint, makeHash(1));
+    REQUIRE(cache.find(fingerprint) == makeHash(1));
+  }
+  SECTION("A cache can only be opened once at a time") {
+    HashCache cache{cachePath};
+    REQUIRE_THROWS_AS(HashCache{cachePath}, HashCacheException);
+  }
+  SECTION("Fingerprints change when a file is written to") {
+    const std::filesystem::path filePath = "test_files/hash_cache_file";
+    {
+      std::ofstream file(filePath, std::ios_base::trunc);
+      file << "contents";
+    }
+    const auto before = HashCache::fingerprint(filePath);
+    REQUIRE(before.has_value());
+    REQUIRE(before->size == 8);
+    {
+      std::ofstream file(filePath, std::ios_base::app);
+      file << " and more";
+    }
+    REQUIRE(HashCache::fingerprint(filePath) != before);
+    REQUIRE_FALSE(
+      HashCache::fingerprint("test_files/hash_cache_missing").has_value());
+  }
+}
@@ -0,0 +1,87 @@
+#include <catch2/catch_all.hpp>
+#include <fstream>
+#include <src/app/promotion_journal.hpp>
+
+namespace {
+void writeFile(const std::filesystem::path& path, std::string_view contents) {
+  std::ofstream file(path, std::ios_base::trunc);
+  file << contents;
+}
+}
+
+TEST_CASE("Promotion journal", "[promotion_journal]") {
+  const std::filesystem::path stageDirectory = "test_files/journal_stage";
+  const std::filesystem::path archiveDirectory = "test_files/journal_archive";
+  std::filesystem::remove_all(stageDirectory);
+  std::filesystem::remove_all(archiveDirectory);
+  std::filesystem::create_directories(stageDirectory);
+  std::filesystem::create_directories(archiveDirectory);
+
+  const auto stagedPath = stageDirectory / "1";
+  const auto archivedPath = archiveDirectory / "1";
+  const auto journalPath = archiveDirectory / ".promotion_7.journal";
+  writeFile(stagedPath, "staged contents");
+
+  SECTION("Promoting moves the staged file into the archive directory") {
+    PromotionJournal journal{archiveDirectory, 7};
+    REQUIRE_NOTHROW(journal.promote(stagedPath, archivedPath));
+    REQUIRE(std::filesystem::exists(journalPath));
+
+    REQUIRE_FALSE(std::filesystem::exists(stagedPath));
+    REQUIRE(std::filesystem::exists(archivedPath));
+
+    REQUIRE_NOTHROW(journal.sync());
+    journal.complete();
+    REQUIRE_FALSE(std::filesystem::exists(stagedPath));
+    REQUIRE(std::filesystem::exists(archivedPath));
+    REQUIRE_FALSE(std::filesystem::exists(journalPath));
+  }
+  SECTION("Rolling back restores the staged file") {
+    PromotionJournal journal{archiveDirectory, 7};
+    journal.promote(stagedPath, archivedPath);
+    journal.rollback();
+
+    REQUIRE(std::filesystem::exists(stagedPath));
+    REQUIRE_FALSE(std::filesystem::exists(archivedPath));
+    REQUIRE_FALSE(std::filesystem::exists(journalPath));
+  }
+  SECTION("Recovering a journal left behind by an interrupted operation") {
+    const auto isCommitted = GENERATE(true, false);
+    {
+      PromotionJournal journal{archiveDirectory, 7};
+      journal.promote(stagedPath, archivedPath);
+      // The journal goes out of scope without being completed or rolled back,
+      // as if the process had died.
+    }
+    REQUIRE(std::filesystem::exists(journalPath));
+
+    PromotionJournal::recover(archiveDirectory,
+                              [&](ArchiveOperationID archiveOperation) {
+                                REQUIRE(archiveOperation == 7);
+                                return isCommitted;
+                              });
+
+    REQUIRE(std::filesystem::exists(stagedPath) == !isCommitted);
+    REQUIRE(std::filesystem::exists(archivedPath) == isCommitted);
+    REQUIRE_FALSE(std::filesystem::exists(journalPath));
+  }
+  SECTION("Recovering ignores a partially written entry") {
+    writeFile(journalPath, "rename\n" + stagedPath.string());
+
+    PromotionJournal::recover(archiveDirectory,
+                              [](ArchiveOperationID) { return false; });
+
+    REQUIRE(std::filesystem::exists(stagedPath));
+    REQUIRE_FALSE(std::filesystem::exists(journalPath));
+  }
+
+  SECTION("Recovering before the archive directory exists does nothing") {
+    std::filesystem::remove_all(archiveDirectory);
+    REQUIRE_NOTHROW(PromotionJournal::recover(
+      archiveDirectory, [](ArchiveOperationID) { return false; }));
+    REQUIRE_FALSE(std::filesystem::exists(archiveDirectory));
+  }
+
+  std::filesystem::remove_all(stageDirectory);
+  std::filesystem::remove_all(archiveDirectory);
+}
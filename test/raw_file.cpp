@@ -1,6 +1,8 @@
 #include "additional_matchers.hpp"
 #include <catch2/catch_all.hpp>
+#include <fstream>
 #include <span>
+#include <src/app/file_reader.hpp>
 #include <src/app/raw_file.hpp>
 #include <src/app/util/get_file_read_buffer.hpp>
 #include <src/config/config.h>
@@ -35,8 +37,8 @@ TEST_CASE("Raw file") {
       RawFile file1{file1Path, readBuffer};
       RawFile file2{file2Path, readBuffer};
 
-      REQUIRE(file1.hash != "");
-      REQUIRE(file2.hash != "");
+      REQUIRE(file1.hash != FileHash{});
+      REQUIRE(file2.hash != FileHash{});
       REQUIRE(file1.hash != file2.hash);
     }
   }
@@ -52,8 +54,8 @@ TEST_CASE("Raw file") {
     RawFile file1{file1Path, readBuffer};
     RawFile file2{file2Path, readBuffer};
 
-    REQUIRE(file1.hash != "");
-    REQUIRE(file2.hash != "");
+    REQUIRE(file1.hash != FileHash{});
+    REQUIRE(file2.hash != FileHash{});
     REQUIRE(file1.hash == file2.hash);
   }
   SECTION("The size of a read file matches the filesystem value") {
@@ -68,6 +70,73 @@ TEST_CASE("Raw file") {
     REQUIRE(file.size != 0);
     REQUIRE(file.size == std::filesystem::file_size(filePath));
   }
+  SECTION("Copying a file while hashing it writes an identical copy") {
+    const auto fileName =
+      GENERATE(values({"TestData1", "TestData_Single",
+                       "TestData_Single_Exact"}));
+
+    const auto filePath = "test_data/"s + fileName + ".test"s;
+    const auto copyPath = "test_files/"s + fileName + ".copy"s;
+
+    RawFile file{filePath, readBuffer, copyPath};
+    RawFile copy{copyPath, readBuffer};
+
+    REQUIRE(file.hash == RawFile{filePath, readBuffer}.hash);
+    REQUIRE(copy.hash == file.hash);
+    REQUIRE(copy.size == file.size);
+
+    std::filesystem::remove(copyPath);
+  }
+  SECTION("A sparse file hashes the same as a file with its zeros written") {
+    const std::filesystem::path sparsePath = "test_files/sparse.test";
+    const std::filesystem::path densePath = "test_files/dense.test";
+    const std::filesystem::path copyPath = "test_files/sparse.copy";
+    const std::string data(4096 * 3, 'd');
+    {
+      std::ofstream sparse(sparsePath, std::ios_base::binary);
+      std::ofstream dense(densePath, std::ios_base::binary);
+      const std::string zeros(1024 * 1024, '\0');
+      sparse.seekp(static_cast<std::streamoff>(zeros.size()));
+      sparse << data;
+      dense << zeros << data << zeros;
+    }
+    std::filesystem::resize_file(sparsePath,
+                                 std::filesystem::file_size(densePath));
+
+    RawFile sparse{sparsePath, readBuffer, copyPath};
+    RawFile dense{densePath, readBuffer};
+    REQUIRE(sparse.size == dense.size);
+    REQUIRE(sparse.fastHash == dense.fastHash);
+    REQUIRE(sparse.hash == dense.hash);
+
+    REQUIRE(RawFile{copyPath, readBuffer}.hash == dense.hash);
+    REQUIRE(FileReader{copyPath}.isSparse() ==
+            FileReader{sparsePath}.isSparse());
+
+    std::filesystem::remove(sparsePath);
+    std::filesystem::remove(densePath);
+    std::filesystem::remove(copyPath);
+  }
+  SECTION("Under the tiered hash policy only the fast hash is computed") {
+    const auto fileName =
+      GENERATE(values({"TestData1", "TestData_Not_Single", "TestData_Single",
+                       "TestData_Single_Exact"}));
+
+    const auto filePath = "test_data/"s + fileName + ".test"s;
+
+    RawFile tiered{filePath, readBuffer, HashPolicy::Tiered};
+    RawFile full{filePath, readBuffer, HashPolicy::Full};
+
+    REQUIRE_FALSE(tiered.hash.has_value());
+    REQUIRE(full.hash.has_value());
+    REQUIRE(tiered.fastHash != FastHash{});
+    REQUIRE(tiered.fastHash == full.fastHash);
+    REQUIRE(tiered.size == full.size);
+    if (fileName != "TestData1"s) {
+      REQUIRE(tiered.fastHash !=
+              RawFile{"test_data/TestData1.test", readBuffer}.fastHash);
+    }
+  }
   SECTION("Opening a file that doesn't exist throws an exception") {
     REQUIRE_THROWS_MATCHES(
       (RawFile{"test_data/non_existent.test", readBuffer}), FileDoesNotExist,
@@ -0,0 +1,51 @@
+#include <catch2/catch_all.hpp>
+#include <fstream>
+#include <src/app/read_order.hpp>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
+
+TEST_CASE("Ordering files by their physical location", "[read_order]") {
+  const std::filesystem::path directory = "test_files/read_order";
+  std::filesystem::create_directories(directory);
+  std::vector<std::filesystem::path> paths;
+  for (std::size_t i = 0; i < 20; ++i) {
+    paths.push_back(directory / FORMAT_LIB::format("{}", i));
+    std::ofstream{paths.back(), std::ios_base::binary}
+      << std::string(i * 4096, static_cast<char>('a' + i));
+  }
+
+  SECTION("Read orders are parsed from their names") {
+    REQUIRE(parseReadOrder("walk") == ReadOrder::Walk);
+    REQUIRE(parseReadOrder("physical") == ReadOrder::Physical);
+    REQUIRE_FALSE(parseReadOrder("inode").has_value());
+  }
+#ifdef __linux__
+  SECTION("Files without data are located by their inode") {
+    struct stat status;
+    REQUIRE(::stat(paths.front().c_str(), &status) == 0);
+    const auto location = physicalLocation(paths.front());
+    REQUIRE(location.device == static_cast<std::uint64_t>(status.st_dev));
+    REQUIRE(location.isInode);
+    REQUIRE(location.offset == static_cast<std::uint64_t>(status.st_ino));
+  }
+#endif
+  SECTION("Files are sorted by their location, those which can't be found "
+          "first") {
+    auto sorted = paths;
+    sorted.push_back(directory / "non_existent");
+    sortByPhysicalLocation(sorted, std::identity{});
+
+    REQUIRE(sorted.front() == directory / "non_existent");
+    REQUIRE(std::is_permutation(paths.begin(), paths.end(),
+                                sorted.begin() + 1, sorted.end()));
+    std::vector<PhysicalLocation> locations;
+    for (const auto& path : sorted)
+      locations.push_back(physicalLocation(path));
+    REQUIRE(std::ranges::is_sorted(locations));
+  }
+
+  std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <catch2/catch_all.hpp>
+#include <cstring>
+#include <src/app/read_pipeline.hpp>
+
+using Catch::Matchers::Message;
+
+namespace {
+auto makeSource(const std::vector<char>& input, std::size_t& position) {
+  return [&input, &position](std::span<char> chunk) {
+    const auto toCopy = std::min(chunk.size(), input.size() - position);
+    std::memcpy(chunk.data(), input.data() + position, toCopy);
+    position += toCopy;
+    return toCopy;
+  };
+}
+auto makeCollector(std::vector<char>& output) {
+  return [&output](std::span<const char> data) {
+    output.insert(output.end(), data.begin(), data.end());
+  };
+}
+}
+
+TEST_CASE("Read pipeline", "[read_pipeline]") {
+  SECTION("Every consumer receives the whole input in order") {
+    const auto bufferSize = GENERATE(
+      as<std::size_t>{}, 100, 5000, 3 * ReadPipeline::SlotAlignment + 17,
+      1024 * 1024, 4 * ReadPipeline::MaxSlotSize);
+    const auto inputSize = GENERATE(as<std::size_t>{}, 0, 1, 4095, 4096, 8192,
+                                    100000, 3000000, 40000000);
+    CAPTURE(bufferSize, inputSize);
+
+    std::vector<char> buffer(bufferSize);
+    std::vector<char> input(inputSize);
+    for (std::size_t i = 0; i < inputSize; ++i)
+      input[i] = static_cast<char>(i * 7 + i / 4096);
+
+    std::size_t position = 0;
+    std::vector<char> output1;
+    std::vector<char> output2;
+    const ReadPipeline::Consumer consumers[] = {makeCollector(output1),
+                                                makeCollector(output2)};
+
+    REQUIRE(ReadPipeline(buffer).run(makeSource(input, position),
+                                     consumers) == inputSize);
+    REQUIRE(output1 == input);
+    REQUIRE(output2 == input);
+  }
+  SECTION("An exception thrown by the source is rethrown") {
+    std::vector<char> buffer(1024 * 1024);
+    int reads = 0;
+    const auto source = [&reads](std::span<char> chunk) -> std::size_t {
+      if (++reads == 5)
+        throw std::runtime_error("Source failed");
+      return chunk.size();
+    };
+    const ReadPipeline::Consumer consumers[] = {[](std::span<const char>) {}};
+
+    REQUIRE_THROWS_MATCHES(ReadPipeline(buffer).run(source, consumers),
+                           std::runtime_error, Message("Source failed"));
+  }
+  SECTION("An exception thrown by a consumer stops the pipeline") {
+    std::vector<char> buffer(1024 * 1024);
+    const auto source = [](std::span<char> chunk) { return chunk.size(); };
+    int calls = 0;
+    const ReadPipeline::Consumer consumers[] = {
+      [&calls](std::span<const char>) {
+        if (++calls == 3)
+          throw std::runtime_error("Consumer failed");
+      },
+      [](std::span<const char>) {}};
+
+    REQUIRE_THROWS_MATCHES(ReadPipeline(buffer).run(source, consumers),
+                           std::runtime_error, Message("Consumer failed"));
+  }
+}
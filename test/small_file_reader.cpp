@@ -0,0 +1,118 @@
+#include <catch2/catch_all.hpp>
+#include <fstream>
+#include <map>
+#include <src/app/io_mode.hpp>
+#include <src/app/raw_file.hpp>
+#include <src/app/small_file_reader.hpp>
+#include <vector>
+
+namespace {
+constexpr std::size_t BufferSize = 8 * 1024 * 1024;
+
+// Writes count files of between 0 and 16 KiB, each filled with a different
+// byte, and returns their contents by path.
+auto writeSmallFiles(const std::filesystem::path& directory, std::size_t count)
+  -> std::map<std::filesystem::path, std::string> {
+  std::filesystem::create_directories(directory);
+  std::map<std::filesystem::path, std::string> files;
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto path = directory / FORMAT_LIB::format("{}", i);
+    std::string contents(i * 997 % (16 * 1024),
+                         static_cast<char>('a' + i % 26));
+    std::ofstream{path, std::ios_base::binary} << contents;
+    files.emplace(path, std::move(contents));
+  }
+  return files;
+}
+
+auto pathsOf(const std::map<std::filesystem::path, std::string>& files)
+  -> std::vector<std::filesystem::path> {
+  std::vector<std::filesystem::path> paths;
+  for (const auto& [path, contents] : files)
+    paths.push_back(path);
+  return paths;
+}
+}
+
+TEST_CASE("Small file reader", "[small_file_reader]") {
+  const std::filesystem::path directory = "test_files/small_files";
+  const auto files = writeSmallFiles(directory, 100);
+  auto paths = pathsOf(files);
+  const auto buffer = makeAlignedBuffer(BufferSize);
+  SmallFileReader reader{{buffer.get(), BufferSize}, 16};
+  CAPTURE(reader.usesIoUring());
+
+  std::map<std::filesystem::path, std::string> read;
+  const auto collect = [&](std::size_t index, std::span<const char> contents) {
+    REQUIRE_FALSE(read.contains(paths.at(index)));
+    read.emplace(paths.at(index),
+                 std::string{contents.begin(), contents.end()});
+  };
+
+  SECTION("Every file smaller than a slot is read whole") {
+    const std::filesystem::path largePath = directory / "large";
+    const std::string large(reader.slotSize(), 'z');
+    std::ofstream{largePath, std::ios_base::binary} << large;
+    paths.push_back(largePath);
+    paths.push_back(directory / "non_existent");
+    paths.push_back(directory);
+
+    reader.read(paths, collect);
+    // Without io_uring nothing is read, and every file is left to be read one
+    // at a time.
+    if (reader.usesIoUring())
+      REQUIRE(read == files);
+    else
+      REQUIRE(read.empty());
+  }
+  SECTION("Files aren't read unless the io mode is buffered") {
+    setIoMode(IoMode::Direct);
+    reader.read(paths, collect);
+    REQUIRE(read.empty());
+  }
+  SECTION("An exception thrown for one file is rethrown once the others have "
+          "finished") {
+    if (reader.usesIoUring()) {
+      REQUIRE_THROWS_AS(reader.read(paths,
+                                    [](std::size_t, std::span<const char>) {
+                                      throw std::runtime_error("");
+                                    }),
+                        std::runtime_error);
+    }
+    reader.read(paths, collect);
+    REQUIRE(read.size() == (reader.usesIoUring() ? files.size() : 0));
+  }
+
+  setIoMode(IoMode::Buffered);
+  std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Hashing small files", "[.][benchmark][small_file_reader]") {
+  const std::filesystem::path directory = "test_files/small_file_corpus";
+  const auto paths = pathsOf(writeSmallFiles(directory, 10000));
+  const auto buffer = makeAlignedBuffer(BufferSize);
+  std::span<char> readBuffer{buffer.get(), BufferSize};
+
+  BENCHMARK("One at a time") {
+    std::uint64_t size = 0;
+    for (const auto& path : paths)
+      size += RawFile{path, readBuffer, HashPolicy::Tiered}.size;
+    return size;
+  };
+  for (const std::size_t queueDepth : {8, 32, 128}) {
+    SmallFileReader reader{readBuffer, queueDepth};
+    BENCHMARK(
+      FORMAT_LIB::format("Through io_uring, {} in flight", queueDepth)) {
+      std::uint64_t size = 0;
+      reader.read(paths,
+                  [&](std::size_t index, std::span<const char> contents) {
+                    size += RawFile::fromContents(paths[index], contents,
+                                                  HashPolicy::Tiered)
+                              .size;
+                  });
+      return size;
+    };
+  }
+
+  std::filesystem::remove_all(directory);
+}
@@ -1,10 +1,12 @@
 #include "additional_matchers.hpp"
 #include "database/database_helpers.hpp"
 #include <catch2/catch_all.hpp>
+#include <fstream>
 #include <span>
 #include <src/app/stager.hpp>
 #include <src/app/util/get_file_read_buffer.hpp>
 #include <src/config/config.h>
+#include <sys/stat.h>
 #include <test/test_constant.hpp>
 
 using Catch::Matchers::StartsWith;
@@ -35,6 +37,9 @@ TEST_CASE("Staging files and directories", "[stager]") {
   auto initialStagedFiles = stagedDatabase->listAllFiles();
   REQUIRE(initialStagedDirectories.size() == 2);
   REQUIRE(initialStagedFiles.size() == 5);
+  // Only the completed staged copies should be left in the stage directory.
+  REQUIRE(std::ranges::distance(std::filesystem::directory_iterator{
+            config.stager.stage_directory}) == 5);
 
   SECTION(
     "Having multiple stagers sharing the same stage directory and database") {
@@ -90,6 +95,10 @@ TEST_CASE("Staging files and directories", "[stager]") {
   REQUIRE(testData->size == ArchiverTest::TestData1::size);
   REQUIRE(std::filesystem::exists({FORMAT_LIB::format(
     "{}/{}", config.stager.stage_directory, testData->id)}));
+  REQUIRE(RawFile{FORMAT_LIB::format("{}/{}", config.stager.stage_directory,
+                                     testData->id),
+                  readBuffer}
+            .hash == ArchiverTest::TestData1::hash);
 
   auto testDataCopy =
     ranges::find(stagedFiles, "TestData_Copy.test", &StagedFile::name);
@@ -147,4 +156,305 @@ TEST_CASE("Staging files and directories", "[stager]") {
        std::filesystem::directory_iterator{config.stager.stage_directory}) {
     std::filesystem::remove(file);
   }
-}
\ No newline at end of file
+}
+TEST_CASE("Staging files with the same contents", "[stager]") {
+  Config config("./config/test_config.json");
+
+  auto [dataPointer, size] = getFileReadBuffer(config.general.fileReadSizes);
+  std::span readBuffer{dataPointer.get(), size};
+
+  DatabaseConnector<MockDatabase> databaseConnector;
+  auto [stagedDatabase, archivedDatabase] =
+    databaseConnector.connect(config, readBuffer);
+
+  Stager stager{stagedDatabase, readBuffer, config.stager.stage_directory, 0,
+                nullptr, archivedDatabase};
+
+  REQUIRE(std::filesystem::is_empty(config.stager.stage_directory));
+  REQUIRE(databasesAreEmpty(stagedDatabase, archivedDatabase));
+
+  REQUIRE_NOTHROW(stager.stage({{"./test_data/"}}, "."));
+
+  auto stagedFiles = stagedDatabase->listAllFiles();
+  REQUIRE(stagedFiles.size() == 5);
+  REQUIRE(ranges::none_of(stagedFiles, &StagedFile::referenceOnly));
+  REQUIRE(std::ranges::distance(std::filesystem::directory_iterator{
+            config.stager.stage_directory}) == 5);
+
+  // TestData_Copy.test is a copy of TestData_Not_Single.test, so only one of
+  // them is copied and the other is linked to that copy.
+  for (const auto& name : {"TestData_Copy.test", "TestData_Not_Single.test"}) {
+    auto stagedFile = ranges::find(stagedFiles, name, &StagedFile::name);
+    REQUIRE(stagedFile != ranges::end(stagedFiles));
+    REQUIRE(std::filesystem::hard_link_count({FORMAT_LIB::format(
+              "{}/{}", config.stager.stage_directory, stagedFile->id)}) == 2);
+  }
+  auto testData =
+    ranges::find(stagedFiles, "TestData1.test", &StagedFile::name);
+  REQUIRE(testData != ranges::end(stagedFiles));
+  REQUIRE(RawFile{FORMAT_LIB::format("{}/{}", config.stager.stage_directory,
+                                     testData->id),
+                  readBuffer}
+            .hash == ArchiverTest::TestData1::hash);
+
+  // Remove staged files.
+  for (auto const& file :
+       std::filesystem::directory_iterator{config.stager.stage_directory}) {
+    std::filesystem::remove(file);
+  }
+}
+
+TEST_CASE("Staging files without checking for duplicates", "[stager]") {
+  Config config("./config/test_config.json");
+
+  auto [dataPointer, size] = getFileReadBuffer(config.general.fileReadSizes);
+  std::span readBuffer{dataPointer.get(), size};
+
+  DatabaseConnector<MockDatabase> databaseConnector;
+  auto [stagedDatabase, archivedDatabase] =
+    databaseConnector.connect(config, readBuffer);
+
+  Stager stager{stagedDatabase,
+                readBuffer,
+                config.stager.stage_directory,
+                0,
+                nullptr,
+                archivedDatabase,
+                HashPolicy::Full,
+                0,
+                ReadOrder::Walk,
+                false};
+
+  REQUIRE(std::filesystem::is_empty(config.stager.stage_directory));
+  REQUIRE_NOTHROW(stager.stage({{"./test_data/"}}, "."));
+
+  // Every file is copied as it is hashed, including the copies.
+  auto stagedFiles = stagedDatabase->listAllFiles();
+  REQUIRE(stagedFiles.size() == 5);
+  for (const auto& name : {"TestData_Copy.test", "TestData_Not_Single.test"}) {
+    auto stagedFile = ranges::find(stagedFiles, name, &StagedFile::name);
+    REQUIRE(stagedFile != ranges::end(stagedFiles));
+    REQUIRE(std::filesystem::hard_link_count({FORMAT_LIB::format(
+              "{}/{}", config.stager.stage_directory, stagedFile->id)}) == 1);
+  }
+
+  // Remove staged files.
+  for (auto const& file :
+       std::filesystem::directory_iterator{config.stager.stage_directory}) {
+    std::filesystem::remove(file);
+  }
+}
+
+TEST_CASE("Staging files under the tiered hash policy", "[stager]") {
+  Config config("./config/test_config.json");
+
+  auto [dataPointer, size] = getFileReadBuffer(config.general.fileReadSizes);
+  std::span readBuffer{dataPointer.get(), size};
+
+  DatabaseConnector<MockDatabase> databaseConnector;
+  auto [stagedDatabase, archivedDatabase] =
+    databaseConnector.connect(config, readBuffer);
+
+  Stager stager{stagedDatabase, readBuffer, config.stager.stage_directory, 0,
+                nullptr, archivedDatabase, HashPolicy::Tiered};
+
+  REQUIRE(std::filesystem::is_empty(config.stager.stage_directory));
+  REQUIRE(databasesAreEmpty(stagedDatabase, archivedDatabase));
+
+  REQUIRE_NOTHROW(stager.stage({{"./test_data/"}}, "."));
+
+  auto stagedFiles = stagedDatabase->listAllFiles();
+  REQUIRE(stagedFiles.size() == 5);
+  REQUIRE(std::ranges::distance(std::filesystem::directory_iterator{
+            config.stager.stage_directory}) == 5);
+  REQUIRE(ranges::all_of(stagedFiles, [](const auto& stagedFile) {
+    return stagedFile.fastHash.has_value();
+  }));
+
+  // The copies share a fast hash, so they are compared, which gives them
+  // their cryptographic hashes, before one is linked to the other's copy.
+  for (const auto& name : {"TestData_Copy.test", "TestData_Not_Single.test"}) {
+    auto stagedFile = ranges::find(stagedFiles, name, &StagedFile::name);
+    REQUIRE(stagedFile != ranges::end(stagedFiles));
+    REQUIRE(std::filesystem::hard_link_count({FORMAT_LIB::format(
+              "{}/{}", config.stager.stage_directory, stagedFile->id)}) == 2);
+  }
+  REQUIRE(ranges::count_if(stagedFiles, [](const auto& stagedFile) {
+            return stagedFile.hash.has_value();
+          }) >= 1);
+  auto testData =
+    ranges::find(stagedFiles, "TestData1.test", &StagedFile::name);
+  REQUIRE(testData != ranges::end(stagedFiles));
+  REQUIRE_FALSE(testData->hash.has_value());
+
+  // Remove staged files.
+  for (auto const& file :
+       std::filesystem::directory_iterator{config.stager.stage_directory}) {
+    std::filesystem::remove(file);
+  }
+}
+
+TEST_CASE("Staging small files read together", "[stager]") {
+  Config config("./config/test_config.json");
+
+  auto [dataPointer, size] = getFileReadBuffer(config.general.fileReadSizes);
+  std::span readBuffer{dataPointer.get(), size};
+
+  DatabaseConnector<MockDatabase> databaseConnector;
+  auto [stagedDatabase, archivedDatabase] =
+    databaseConnector.connect(config, readBuffer);
+
+  // Files are either copied as they are hashed or hashed before they are
+  // copied, depending on whether duplicates are checked for.
+  const auto checkDuplicates = GENERATE(false, true);
+  CAPTURE(checkDuplicates);
+  Stager stager{stagedDatabase,
+                readBuffer,
+                config.stager.stage_directory,
+                2,
+                nullptr,
+                checkDuplicates ? archivedDatabase : nullptr,
+                HashPolicy::Full,
+                8};
+
+  REQUIRE(std::filesystem::is_empty(config.stager.stage_directory));
+  REQUIRE(databasesAreEmpty(stagedDatabase, archivedDatabase));
+
+  REQUIRE_NOTHROW(stager.stage({{"./test_data/"}}, "."));
+
+  auto stagedFiles = stagedDatabase->listAllFiles();
+  REQUIRE(stagedFiles.size() == 5);
+  REQUIRE(std::ranges::distance(std::filesystem::directory_iterator{
+            config.stager.stage_directory}) == 5);
+  auto testData =
+    ranges::find(stagedFiles, "TestData1.test", &StagedFile::name);
+  REQUIRE(testData != ranges::end(stagedFiles));
+  REQUIRE(testData->hash == ArchiverTest::TestData1::hash);
+  REQUIRE(testData->size == ArchiverTest::TestData1::size);
+  REQUIRE(RawFile{FORMAT_LIB::format("{}/{}", config.stager.stage_directory,
+                                     testData->id),
+                  readBuffer}
+            .hash == ArchiverTest::TestData1::hash);
+
+  // Remove staged files.
+  for (auto const& file :
+       std::filesystem::directory_iterator{config.stager.stage_directory}) {
+    std::filesystem::remove(file);
+  }
+}
+
+TEST_CASE("Staging files in the order they are laid out on disk",
+          "[stager]") {
+  Config config("./config/test_config.json");
+
+  auto [dataPointer, size] = getFileReadBuffer(config.general.fileReadSizes);
+  std::span readBuffer{dataPointer.get(), size};
+
+  DatabaseConnector<MockDatabase> databaseConnector;
+  auto [stagedDatabase, archivedDatabase] =
+    databaseConnector.connect(config, readBuffer);
+
+  Stager stager{stagedDatabase,
+                readBuffer,
+                config.stager.stage_directory,
+                1,
+                nullptr,
+                nullptr,
+                HashPolicy::Full,
+                0,
+                ReadOrder::Physical};
+
+  REQUIRE(std::filesystem::is_empty(config.stager.stage_directory));
+  REQUIRE(databasesAreEmpty(stagedDatabase, archivedDatabase));
+
+  REQUIRE_NOTHROW(stager.stage({{"./test_data/"}}, "."));
+
+  // Every file is still staged, under a directory added before it.
+  auto stagedDirectories = stagedDatabase->listAllDirectories();
+  auto stagedFiles = stagedDatabase->listAllFiles();
+  REQUIRE(stagedDirectories.size() == 2);
+  REQUIRE(stagedFiles.size() == 5);
+  REQUIRE(ranges::all_of(stagedFiles, [&](const auto& stagedFile) {
+    return stagedFile.parent == stagedDirectories.at(1).id;
+  }));
+  auto testData =
+    ranges::find(stagedFiles, "TestData1.test", &StagedFile::name);
+  REQUIRE(testData != ranges::end(stagedFiles));
+  REQUIRE(testData->hash == ArchiverTest::TestData1::hash);
+
+  // Remove staged files.
+  for (auto const& file :
+       std::filesystem::directory_iterator{config.stager.stage_directory}) {
+    std::filesystem::remove(file);
+  }
+}
+
+TEST_CASE("Staging a path which fails after a batch was added", "[stager]") {
+  Config config("./config/test_config.json");
+
+  auto [dataPointer, size] = getFileReadBuffer(config.general.fileReadSizes);
+  std::span readBuffer{dataPointer.get(), size};
+
+  DatabaseConnector<MockDatabase> databaseConnector;
+  auto [stagedDatabase, archivedDatabase] =
+    databaseConnector.connect(config, readBuffer);
+
+  // More files than fit in one batch are found before the fifo, which can't
+  // be staged, is found in the subdirectory.
+  const std::filesystem::path root = "test_files/failed_batch";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root / "last");
+  for (int i = 0; i < 1500; ++i)
+    std::ofstream(root / FORMAT_LIB::format("{}", i)) << i;
+  REQUIRE(::mkfifo((root / "last/fifo").c_str(), 0600) == 0);
+
+  Stager stager{stagedDatabase, readBuffer, config.stager.stage_directory};
+
+  REQUIRE(std::filesystem::is_empty(config.stager.stage_directory));
+  REQUIRE_NOTHROW(stager.stage({root}, "."));
+
+  // The copies staged by the earlier batches are removed with their files.
+  REQUIRE(stagedDatabase->listAllFiles().empty());
+  REQUIRE(std::filesystem::is_empty(config.stager.stage_directory));
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("Staging hard links", "[stager]") {
+  Config config("./config/test_config.json");
+
+  auto [dataPointer, size] = getFileReadBuffer(config.general.fileReadSizes);
+  std::span readBuffer{dataPointer.get(), size};
+
+  DatabaseConnector<MockDatabase> databaseConnector;
+  auto [stagedDatabase, archivedDatabase] =
+    databaseConnector.connect(config, readBuffer);
+
+  const std::filesystem::path root = "test_files/hard_links";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root / "links");
+  std::filesystem::copy_file("./test_data/TestData1.test", root / "original");
+  for (const auto* link : {"links/1", "links/2", "links/3"})
+    std::filesystem::create_hard_link(root / "original", root / link);
+
+  Stager stager{stagedDatabase, readBuffer, config.stager.stage_directory};
+
+  REQUIRE(std::filesystem::is_empty(config.stager.stage_directory));
+  REQUIRE_NOTHROW(stager.stage({root}, "."));
+
+  // Every link is staged, sharing the one staged copy.
+  const auto stagedFiles = stagedDatabase->listAllFiles();
+  REQUIRE(stagedFiles.size() == 4);
+  for (const auto& stagedFile : stagedFiles) {
+    REQUIRE(stagedFile.hash == ArchiverTest::TestData1::hash);
+    REQUIRE(std::filesystem::hard_link_count({FORMAT_LIB::format(
+              "{}/{}", config.stager.stage_directory, stagedFile.id)}) == 4);
+  }
+
+  // Remove staged files.
+  for (auto const& file :
+       std::filesystem::directory_iterator{config.stager.stage_directory}) {
+    std::filesystem::remove(file);
+  }
+  std::filesystem::remove_all(root);
+}
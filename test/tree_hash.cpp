@@ -0,0 +1,85 @@
+#include <catch2/catch_all.hpp>
+#include <fstream>
+#include <src/app/raw_file.hpp>
+#include <src/app/read_pipeline.hpp>
+#include <src/app/tree_hash.hpp>
+#include <vector>
+
+namespace {
+constexpr std::uint64_t TestLeafSize = 1024 * 1024;
+
+void writeFile(const std::filesystem::path& path, std::size_t size,
+               char firstByte = 0) {
+  std::vector<char> contents(size);
+  for (std::size_t i = 0; i < size; ++i)
+    contents[i] = static_cast<char>(i * 7 + i / 4096);
+  if (size > 0)
+    contents[0] = firstByte;
+  std::ofstream file(path, std::ios_base::binary | std::ios_base::trunc);
+  file.write(contents.data(), static_cast<std::streamsize>(size));
+}
+}
+
+TEST_CASE("Tree hash", "[tree_hash]") {
+  const std::filesystem::path filePath = "test_files/tree_hash";
+  const auto fileSize = GENERATE(as<std::size_t>{}, 0, 1, TestLeafSize,
+                                 5 * TestLeafSize + 12345);
+  CAPTURE(fileSize);
+  writeFile(filePath, fileSize);
+
+  std::vector<char> buffer(8 * ReadPipeline::SlotAlignment * 16);
+  const auto digests =
+    tree_hash::hashFile<FullHashing>(filePath, buffer, TestLeafSize, 1);
+
+  SECTION("The digests don't depend on how many threads hash the leaves") {
+    const auto threadCount = GENERATE(as<std::size_t>{}, 0, 2, 3, 8);
+    const auto bufferSize =
+      GENERATE(as<std::size_t>{}, ReadPipeline::SlotAlignment,
+               3 * ReadPipeline::SlotAlignment + 17, 4 * TestLeafSize);
+    CAPTURE(threadCount, bufferSize);
+
+    std::vector<char> otherBuffer(bufferSize);
+    const auto otherDigests = tree_hash::hashFile<FullHashing>(
+      filePath, otherBuffer, TestLeafSize, threadCount);
+    REQUIRE(otherDigests.size == fileSize);
+    REQUIRE(otherDigests.fastHash == digests.fastHash);
+    REQUIRE(otherDigests.hash == digests.hash);
+  }
+  SECTION("The tiered policy gives the same fast hash") {
+    const auto tieredDigests =
+      tree_hash::hashFile<TieredHashing>(filePath, buffer, TestLeafSize, 2);
+    REQUIRE(tieredDigests.fastHash == digests.fastHash);
+    REQUIRE_FALSE(tieredDigests.hash.has_value());
+  }
+  SECTION("Tree hashes aren't the same as linear hashes") {
+    const RawFile linear{filePath, buffer, HashPolicy::Full,
+                         HashAlgorithm::Linear};
+    REQUIRE(linear.hashAlgorithm == HashAlgorithm::Linear);
+    REQUIRE(linear.fastHash != digests.fastHash);
+    REQUIRE(linear.hash != digests.hash);
+
+    const RawFile tree{filePath, buffer, HashPolicy::Full,
+                       HashAlgorithm::Tree};
+    REQUIRE(tree.hashAlgorithm == HashAlgorithm::Tree);
+    REQUIRE(tree.size == fileSize);
+    REQUIRE(tree.hash == tree_hash::hashFile<FullHashing>(filePath, buffer)
+                           .hash);
+  }
+  SECTION("The digests depend on the leaf size") {
+    const auto otherLeafSizeDigests =
+      tree_hash::hashFile<FullHashing>(filePath, buffer, TestLeafSize / 2);
+    REQUIRE(otherLeafSizeDigests.fastHash != digests.fastHash);
+    REQUIRE(otherLeafSizeDigests.hash != digests.hash);
+  }
+  SECTION("The digests depend on the contents") {
+    if (fileSize > 0) {
+      writeFile(filePath, fileSize, 1);
+      const auto changedDigests =
+        tree_hash::hashFile<FullHashing>(filePath, buffer, TestLeafSize, 2);
+      REQUIRE(changedDigests.fastHash != digests.fastHash);
+      REQUIRE(changedDigests.hash != digests.hash);
+    }
+  }
+
+  std::filesystem::remove(filePath);
+}
@@ -0,0 +1,64 @@
+#include <catch2/catch_all.hpp>
+#include <src/app/util/generator.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+auto countTo(int count, bool& finished) -> Generator<int> {
+  for (int i = 0; i < count; ++i)
+    co_yield i;
+  finished = true;
+}
+auto yieldReferences(std::vector<std::string>& strings)
+  -> Generator<std::string&> {
+  for (auto& string : strings)
+    co_yield string;
+}
+auto throwAfter(int count) -> Generator<int> {
+  for (int i = 0; i < count; ++i)
+    co_yield i;
+  throw std::runtime_error("generator error");
+}
+}
+
+TEST_CASE("Generator", "[util]") {
+  SECTION("Yields every element in order") {
+    const auto count = GENERATE(0, 1, 10);
+    bool finished = false;
+    std::vector<int> elements;
+    for (const auto element : countTo(count, finished))
+      elements.push_back(element);
+
+    REQUIRE(finished);
+    REQUIRE(elements.size() == static_cast<std::size_t>(count));
+    for (int i = 0; i < count; ++i)
+      REQUIRE(elements.at(i) == i);
+  }
+  SECTION("Only runs as far as it is iterated") {
+    bool finished = false;
+    auto generator = countTo(10, finished);
+    auto iterator = generator.begin();
+    REQUIRE(*iterator == 0);
+    ++iterator;
+    REQUIRE(*iterator == 1);
+    REQUIRE(!finished);
+  }
+  SECTION("Yielded references refer to the original elements") {
+    std::vector<std::string> strings{"a", "b"};
+    for (auto& string : yieldReferences(strings))
+      string += "c";
+    REQUIRE(strings == std::vector<std::string>{"ac", "bc"});
+  }
+  SECTION("Exceptions thrown by the coroutine are rethrown when iterating") {
+    const auto count = GENERATE(0, 3);
+    int iterated = 0;
+    REQUIRE_THROWS_AS(
+      [&]() {
+        for ([[maybe_unused]] const auto element : throwAfter(count))
+          ++iterated;
+      }(),
+      std::runtime_error);
+    REQUIRE(iterated == count);
+  }
+}
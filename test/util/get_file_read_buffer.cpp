@@ -14,6 +14,7 @@ TEST_CASE("getFileReadBuffer", "[util]") {
 
     REQUIRE(size == sizeList[0]);
     REQUIRE(pointer != nullptr);
+    REQUIRE(isDirectIoAligned(pointer.get(), 0, 0));
   }
   SECTION("If the first size is too big, the second is taken") {
     std::vector<Size> sizeList = GENERATE(take(